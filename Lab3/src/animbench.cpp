@@ -0,0 +1,106 @@
+/*
+Description:
+Move animation cost at replay speed. Every board plays random legal games at
+a fixed rate while the animator is evaluated at the simulation tick rate, on
+simulated time so the run does not wait. Prints the time per tick and per
+moving piece.
+
+Usage: animbench [--boards N] [--rate PLIES_PER_SECOND] [--seconds S] [--tick-rate HZ]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <common/animation.hpp>
+#include <common/boardlayout.hpp>
+#include <common/movegen.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: animbench [--boards N] [--rate PLIES_PER_SECOND] [--seconds S] [--tick-rate HZ]\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    int boardCount = 256;
+    double rate = 20.0;
+    double seconds = 10.0;
+    double tickRate = 240.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--boards") == 0 && i + 1 < argc) {
+            boardCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            tickRate = atof(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (rate <= 0.0 || seconds <= 0.0 || tickRate <= 0.0) {
+        printUsage();
+        return 1;
+    }
+    initBitboards();
+
+    std::vector<Position> boards(boardCount);
+    std::vector<glm::vec3> offsets;
+    for (int b = 0; b < boardCount; b++) {
+        offsets.push_back(boardGridOffset(b, boardCount));
+    }
+    MoveAnimator animator;
+    animator.setDuration(std::min(MOVE_ANIMATION_SECONDS, (float)(0.8 / rate)));
+    std::mt19937 random(1);
+
+    typedef std::chrono::steady_clock Clock;
+    std::vector<PieceInstance> instances;
+    std::vector<int> landed;
+    double evaluateSeconds = 0.0;
+    double worstTick = 0.0;
+    uint64_t ticks = 0;
+    uint64_t trackTicks = 0;
+    uint64_t moves = 0;
+    double nextMove = 0.0;
+    for (double now = 0.0; now < seconds; now += 1.0 / tickRate) {
+        if (now >= nextMove) {
+            nextMove += 1.0 / rate;
+            for (int b = 0; b < boardCount; b++) {
+                MoveList legal;
+                generateLegalMoves(boards[b], legal);
+                if (legal.size() == 0 || boards[b].gamePly() >= 200) {
+                    boards[b] = Position();
+                    animator.finishBoard(b);
+                    continue;
+                }
+                boards[b].makeMove(legal[random() % legal.size()]);
+                animator.addMove(b, boards[b], offsets[b], now);
+                moves++;
+            }
+        }
+        instances.clear();
+        landed.clear();
+        trackTicks += animator.activeTracks();
+        Clock::time_point start = Clock::now();
+        animator.evaluate(now, instances, landed);
+        double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        evaluateSeconds += elapsed;
+        worstTick = std::max(worstTick, elapsed);
+        ticks++;
+    }
+
+    printf("%d boards, %.0f plies/s each, %.2f s per move, %.0f ticks/s for %.0f s\n", boardCount, rate,
+           animator.moveDuration(), tickRate, seconds);
+    printf("%llu moves animated, %.0f pieces moving per tick on average\n", (unsigned long long)moves,
+           ticks > 0 ? (double)trackTicks / ticks : 0.0);
+    printf("Animation %.1f us per tick (max %.1f us), %.1f ns per moving piece\n",
+           ticks > 0 ? evaluateSeconds / ticks * 1e6 : 0.0, worstTick * 1e6,
+           trackTicks > 0 ? evaluateSeconds / trackTicks * 1e9 : 0.0);
+    return 0;
+}
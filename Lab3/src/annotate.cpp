@@ -0,0 +1,201 @@
+/*
+Description:
+Batch game annotator. Analyses every position of every game in a PGN file on
+a work-stealing thread pool and writes the games back with an evaluation
+after each move, and the engine's choice next to inaccuracies, mistakes and
+blunders. Reports positions per second and how busy the threads were.
+
+Usage: annotate IN.pgn OUT.pgn [options]
+  --threads N      search threads, one position each (default: hardware threads)
+  --movetime MS    search time per position (default 500)
+  --total S        time budget for the whole file in seconds, shared out
+                   between positions as they start (overrides --movetime)
+  --depth N        depth limit per position
+  --hash MB        transposition table per game (default 16)
+  --games N        only the first N games
+  --weights FILE   evaluation weights written by the tuner
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <common/batchanalysis.hpp>
+#include <common/evaluate.hpp>
+#include <common/movegen.hpp>
+#include <common/pgn.hpp>
+#include <common/search.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: annotate IN.pgn OUT.pgn [--threads N] [--movetime MS] [--total S] [--depth N] "
+                        "[--hash MB] [--games N] [--weights FILE]\n");
+    }
+
+    /**
+     * @brief Score in pawns or as a mate distance, "+0.35" or "#-3", from White's point of view
+     */
+    std::string formatEval(int score, int sideToMove) {
+        int white = sideToMove == WHITE ? score : -score;
+        char text[32];
+        if (white > SCORE_MATE_IN_MAX_PLY || white < -SCORE_MATE_IN_MAX_PLY) {
+            int moves = (SCORE_MATE - abs(white) + 1) / 2;
+            snprintf(text, sizeof(text), "#%s%d", white < 0 ? "-" : "", moves);
+        } else {
+            snprintf(text, sizeof(text), "%+.2f", white / 100.0);
+        }
+        return text;
+    }
+
+    /// Keeps mates comparable with ordinary scores when measuring what a move lost
+    int clampScore(int score) {
+        return score > 2000 ? 2000 : score < -2000 ? -2000 : score;
+    }
+
+    /**
+     * @brief Writes one game with evaluations, NAGs and the better move after weak ones
+     */
+    std::string annotateGame(const PgnGame& game, const BatchGame& batchGame,
+                             const std::vector<PositionAnalysis>& analysis) {
+        std::string text;
+        for (size_t t = 0; t < game.tags.size(); t++) {
+            text += "[" + game.tags[t].name.str() + " \"" + game.tags[t].value.str() + "\"]\n";
+        }
+        text += "\n";
+
+        std::string moves;
+        size_t lineStart = 0;
+        Position position = batchGame.start;
+        for (size_t ply = 0; ply < batchGame.moves.size(); ply++) {
+            Move move = batchGame.moves[ply];
+            int mover = position.sideToMove();
+            if (mover == WHITE || ply == 0) {
+                appendMovetext(moves, lineStart,
+                               std::to_string(position.fullmoveNumber()) + (mover == WHITE ? "." : "..."));
+            }
+            const PositionAnalysis& before = analysis[ply];
+            std::string san = moveToSan(position, move);
+            std::string bestSan = before.bestMove != NO_MOVE && before.bestMove != move
+                                  ? moveToSan(position, before.bestMove) : std::string();
+            position.makeMove(move);
+            const PositionAnalysis& after = analysis[ply + 1];
+
+            // What the move cost the mover compared with the engine's choice
+            int loss = clampScore(before.score) + clampScore(after.score);
+            const char* nag = NULL;
+            if (!bestSan.empty()) {
+                nag = loss >= 300 ? "$4" : loss >= 100 ? "$2" : loss >= 50 ? "$6" : NULL;
+            }
+            appendMovetext(moves, lineStart, san);
+            if (nag) {
+                appendMovetext(moves, lineStart, nag);
+            }
+            appendMovetext(moves, lineStart, "{[%eval " + formatEval(after.score, position.sideToMove()) + "]}");
+            if (nag) {
+                std::string number = std::to_string(position.fullmoveNumber() - (mover == BLACK ? 1 : 0)) +
+                                     (mover == WHITE ? "." : "...");
+                appendMovetext(moves, lineStart, "(" + number + " " + bestSan + ")");
+            }
+        }
+        appendMovetext(moves, lineStart, game.result.empty() ? "*" : game.result.str());
+        return text + moves + "\n\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    BatchOptions options;
+    options.threads = (int)std::thread::hardware_concurrency();
+    options.movetimeMs = 500;
+    long maxGames = -1;
+    const char* weightsPath = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc) {
+            options.movetimeMs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--total") == 0 && i + 1 < argc) {
+            options.totalTimeMs = (int64_t)(atof(argv[++i]) * 1000.0);
+        } else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            options.maxDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc) {
+            options.hashMbPerGame = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            maxGames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            weightsPath = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (options.threads < 1) {
+        options.threads = 1;
+    }
+    initBitboards();
+    if (weightsPath && !loadEvalWeights(weightsPath, evalWeights())) {
+        return 1;
+    }
+
+    PgnFile file;
+    if (!file.open(argv[1])) {
+        return 1;
+    }
+    // Games are copied out of the reader, which reuses its PgnGame
+    std::vector<PgnGame> pgnGames;
+    std::vector<BatchGame> games;
+    PgnReader reader(file.text().begin, file.text().end);
+    PgnGame game;
+    while ((maxGames < 0 || (long)games.size() < maxGames) && reader.next(game)) {
+        if (!game.valid) {
+            fprintf(stderr, "Warning: Game %zu stops at unreadable move \"%s\"\n", games.size() + 1,
+                    game.error.str().c_str());
+        }
+        pgnGames.push_back(game);
+        BatchGame batchGame;
+        batchGame.start = game.start;
+        batchGame.moves = game.moves;
+        games.push_back(batchGame);
+    }
+    size_t positions = 0;
+    for (size_t g = 0; g < games.size(); g++) {
+        positions += games[g].moves.size() + 1;
+    }
+    printf("Analysing %zu games, %zu positions on %d threads, ", games.size(), positions, options.threads);
+    if (options.totalTimeMs > 0) {
+        printf("%.0f s in total\n", options.totalTimeMs / 1000.0);
+    } else {
+        printf("%lld ms per position\n", (long long)options.movetimeMs);
+    }
+
+    std::vector<std::vector<PositionAnalysis> > results;
+    BatchStats stats = analyzeGames(games, options, results);
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+        return 1;
+    }
+    for (size_t g = 0; g < games.size(); g++) {
+        std::string text = annotateGame(pgnGames[g], games[g], results[g]);
+        fwrite(text.data(), text.size(), 1, out);
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("Analysed %llu positions in %.1f s: %.1f positions/s, %.0f knps\n",
+           (unsigned long long)stats.positions, stats.wallSeconds, stats.positionsPerSecond(),
+           stats.wallSeconds > 0.0 ? stats.nodes / stats.wallSeconds / 1000.0 : 0.0);
+    printf("Thread utilization %.1f%% (%.1f of %.1f thread-seconds searching), %llu jobs stolen\n",
+           stats.utilization() * 100.0, stats.busySeconds, stats.wallSeconds * stats.threads,
+           (unsigned long long)stats.steals);
+    printf("Wrote %s\n", argv[2]);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+Description:
+Offline lighting bake for the board. Traces the scene light's direct light
+with soft shadows and the ambient occlusion of every lightmap texel of the
+board, on all cores, and writes the lightmap the viewer picks up on start.
+Pieces are only baked in with --fen, for scenes where they never move; the
+viewer's shadow map already covers pieces that do.
+
+Usage: bake [--out FILE] [--size N] [--fen FEN] [--threads N]
+            [--light-samples N] [--ao-samples N]
+Run from Lab3/, like the viewer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <common/boardlayout.hpp>
+#include <common/lightmap.hpp>
+#include <common/objloader.hpp>
+#include <common/position.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: bake [--out FILE] [--size N] [--fen FEN] [--threads N]\n"
+                        "            [--light-samples N] [--ao-samples N]\n");
+    }
+
+    void appendTriangles(const std::vector<glm::vec3>& vertices, const std::vector<unsigned short>& indices,
+                         const glm::mat4& matrix, std::vector<glm::vec3>& triangles) {
+        for (unsigned short index : indices) {
+            triangles.push_back(glm::vec3(matrix * glm::vec4(vertices[index], 1.0f)));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = DEFAULT_LIGHTMAP_PATH;
+    const char* fen = NULL;
+    BakeSettings settings;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            settings.size = std::max(16, std::min(4096, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--light-samples") == 0 && i + 1 < argc) {
+            settings.lightSamples = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--ao-samples") == 0 && i + 1 < argc) {
+            settings.aoSamples = std::max(0, atoi(argv[++i]));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    if (!loadOBJ("Stone_Chess_Board/12951_Stone_Chess_Board_v1_L3.obj", vertices, uvs, normals)) {
+        fprintf(stderr, "Failed to load chess board.\n");
+        return 1;
+    }
+
+    // The single-board scene's board, which the viewer lights from (0, 25, 0)
+    glm::mat4 boardMatrix = boardModelMatrix(glm::vec3(0.0f));
+    std::vector<glm::vec3> occluders;
+    for (const glm::vec3& vertex : vertices) {
+        occluders.push_back(glm::vec3(boardMatrix * glm::vec4(vertex, 1.0f)));
+    }
+
+    if (fen) {
+        Position position;
+        if (!position.setFromFen(fen)) {
+            fprintf(stderr, "Error: Invalid FEN %s\n", fen);
+            return 1;
+        }
+        std::vector<ChessPiece> meshes;
+        if (!loadAssImp("Chess/chess.obj", meshes, false)) {
+            fprintf(stderr, "Failed to load chess pieces.\n");
+            return 1;
+        }
+        std::vector<PieceInstance> pieces;
+        buildBoardInstances(position, pieces);
+        for (const PieceInstance& piece : pieces) {
+            if (piece.mesh >= 0 && piece.mesh < (int)meshes.size()) {
+                appendTriangles(meshes[piece.mesh].vertices, meshes[piece.mesh].indices, piece.ModelMatrix, occluders);
+            }
+        }
+        printf("%zu pieces baked in\n", pieces.size());
+    }
+
+    int threads = settings.threads > 0 ? settings.threads : std::max(1, (int)std::thread::hardware_concurrency());
+    printf("Baking %dx%d, %zu occluding triangles, %d threads\n", settings.size, settings.size,
+           occluders.size() / 3, threads);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Lightmap lightmap;
+    size_t texels = bakeLightmap(vertices, uvs, normals, boardMatrix, occluders, settings, lightmap);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double rays = (double)texels * (settings.lightSamples + settings.aoSamples);
+    printf("%zu texels in %.2f s, %.2f Mrays/s\n", texels, seconds, rays / seconds / 1e6);
+
+    if (!saveLightmap(outPath, lightmap)) {
+        return 1;
+    }
+    printf("Wrote %s\n", outPath);
+    return 0;
+}
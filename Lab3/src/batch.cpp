@@ -0,0 +1,260 @@
+/*
+Description:
+Batch position renderer. Reads FEN positions from a file, renders each one
+headlessly with the same scene as the interactive application and writes one
+image per position. Assets stay resident for the whole run, readback goes
+through a PBO ring and encoding runs on writer threads, so the GPU, the readback
+and the disk all work on different positions at the same time.
+
+Usage: batch_render <fen-file> <output-dir> [options]
+  --size WxH         image size in pixels (default 1024x768)
+  --format png|ppm   output format (default png)
+  --threads N        image writer threads (default: hardware threads - 1)
+  --distance D       camera distance from the board centre (default 70)
+  --elevation DEG    camera elevation above the board (default 55)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <common/boardlayout.hpp>
+#include <common/framebuffer.hpp>
+#include <common/imagewriter.hpp>
+#include <common/readback.hpp>
+#include <common/scene.hpp>
+
+namespace {
+    struct BatchOptions {
+        const char* fenPath;
+        const char* outputDir;
+        int width;
+        int height;
+        ImageFormat format;
+        int threads;
+        float distance;
+        float elevation;
+    };
+
+    void printUsage() {
+        fprintf(stderr, "Usage: batch_render <fen-file> <output-dir> [--size WxH] [--format png|ppm]\n"
+                        "                    [--threads N] [--distance D] [--elevation DEG]\n");
+    }
+
+    bool parseOptions(int argc, char** argv, BatchOptions& options) {
+        if (argc < 3) {
+            return false;
+        }
+        options.fenPath = argv[1];
+        options.outputDir = argv[2];
+        options.width = 1024;
+        options.height = 768;
+        options.format = IMAGE_PNG;
+        int hardwareThreads = (int)std::thread::hardware_concurrency();
+        options.threads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        options.distance = 70.0f;
+        options.elevation = 55.0f;
+
+        for (int i = 3; i < argc; i++) {
+            bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "--size") == 0 && hasValue) {
+                if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    return false;
+                }
+            } else if (strcmp(argv[i], "--format") == 0 && hasValue) {
+                const char* format = argv[++i];
+                if (strcmp(format, "png") == 0) {
+                    options.format = IMAGE_PNG;
+                } else if (strcmp(format, "ppm") == 0) {
+                    options.format = IMAGE_PPM;
+                } else {
+                    return false;
+                }
+            } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+                options.threads = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--distance") == 0 && hasValue) {
+                options.distance = (float)atof(argv[++i]);
+            } else if (strcmp(argv[i], "--elevation") == 0 && hasValue) {
+                options.elevation = (float)atof(argv[++i]);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string outputPath(const BatchOptions& options, long long index) {
+        char name[64];
+        snprintf(name, sizeof(name), "/position_%05lld.%s", index + 1,
+                 options.format == IMAGE_PNG ? "png" : "ppm");
+        return std::string(options.outputDir) + name;
+    }
+
+    /**
+     * @brief Hands finished readbacks to the writer pool
+     * @param wait Block on the oldest readback instead of only taking finished ones
+     * @param all Keep going until the ring is empty
+     * @return false if a readback failed, which stops the drain
+     */
+    bool drainReadbacks(PboRing& ring, ImageWriterPool& writers, const BatchOptions& options,
+                        bool wait, bool all) {
+        std::vector<unsigned char> pixels = writers.acquireBuffer();
+        bool ok = true;
+        while (!ring.empty()) {
+            long long index;
+            PboRing::Status status = ring.dequeue(pixels, index, wait);
+            if (status == PboRing::FAILED) {
+                fprintf(stderr, "Error: Lost the image of entry %lld\n", index + 1);
+                ok = false;
+                break;
+            }
+            if (status == PboRing::PENDING) {
+                if (!all) {
+                    break;
+                }
+                continue;
+            }
+            writers.submit(outputPath(options, index), ring.width(), ring.height(), pixels, options.format);
+            pixels = writers.acquireBuffer();
+            if (!all) {
+                wait = false;
+            }
+        }
+        writers.releaseBuffer(pixels);
+        return ok;
+    }
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> fens;
+    if (!readFenFile(options.fenPath, fens)) {
+        return 1;
+    }
+
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return 1;
+    }
+
+    // A hidden window only provides the GL context, rendering goes offscreen
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "ChessBatch", NULL, NULL);
+    if (window == NULL) {
+        fprintf(stderr, "Failed to open GLFW window\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+
+    glewExperimental = true;
+    if (glewInit() != GLEW_OK) {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+
+    ChessScene scene;
+    OffscreenTarget target;
+    PboRing ring;
+    if (!scene.load() ||
+        !target.init(options.width, options.height) ||
+        !ring.init(options.width, options.height, 4)) {
+        fprintf(stderr, "Failed to set up offscreen rendering.\n");
+        ring.release();
+        target.release();
+        scene.release();
+        glfwTerminate();
+        return 1;
+    }
+
+    // Fixed camera looking down at the board from the white side
+    FramePacket packet;
+    float elevation = glm::radians(options.elevation);
+    glm::vec3 eye(0.0f, options.distance * sin(elevation), options.distance * cos(elevation));
+    packet.ViewMatrix = glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    packet.ProjectionMatrix = glm::perspective(glm::radians(45.0f),
+                                               float(options.width) / float(options.height), 0.1f, 200.0f);
+    packet.lightPosition = glm::vec3(0, 25, 0);
+    packet.lightEnabled = true;
+    packet.boards.push_back(boardModelMatrix(glm::vec3(0.0f)));
+
+    ImageWriterPool writers(options.threads);
+    Position position;
+    int rendered = 0;
+    int readbackFailures = 0;
+    double startTime = glfwGetTime();
+
+    for (size_t i = 0; i < fens.size(); i++) {
+        if (!position.setFromFen(fens[i].c_str())) {
+            fprintf(stderr, "Skipping invalid FEN on entry %zu: %s\n", i + 1, fens[i].c_str());
+            continue;
+        }
+        packet.pieces.clear();
+        buildBoardInstances(position, packet.pieces);
+        packet.restingPieces = packet.pieces.size();
+        packet.staticVersion++;
+        packet.layoutVersion++;
+
+        target.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        scene.draw(packet);
+        target.resolve();
+
+        // Only wait on the GPU when every readback slot is still busy
+        if (ring.full() && !drainReadbacks(ring, writers, options, true, false)) {
+            readbackFailures++;
+        }
+        if (!ring.enqueue((long long)i)) {
+            fprintf(stderr, "Error: No readback slot free for entry %zu\n", i + 1);
+            readbackFailures++;
+            continue;
+        }
+        if (!drainReadbacks(ring, writers, options, false, false)) {
+            readbackFailures++;
+        }
+        rendered++;
+    }
+    // A failure stops a drain, the remaining readbacks may still be good
+    while (!ring.empty()) {
+        if (!drainReadbacks(ring, writers, options, true, true)) {
+            readbackFailures++;
+        }
+    }
+    int failures = writers.finish() + readbackFailures;
+
+    double elapsed = glfwGetTime() - startTime;
+    printf("Rendered %d positions in %.2f s (%.0f positions/min, %.2f ms/position)\n",
+           rendered, elapsed, elapsed > 0.0 ? 60.0 * rendered / elapsed : 0.0,
+           rendered > 0 ? 1000.0 * elapsed / rendered : 0.0);
+    if (failures > 0) {
+        fprintf(stderr, "%d images failed to read back or write\n", failures);
+    }
+
+    ring.release();
+    target.release();
+    scene.release();
+    glfwTerminate();
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+/*
+Description:
+Search benchmark. Searches a fixed set of positions to a fixed depth with an
+increasing number of threads and reports nodes per second and time to depth
+for each thread count, so Lazy SMP scaling can be compared across machines.
+The transposition table is cleared before every position.
+
+Usage: bench [options]
+  --depth N        search depth per position (default 10)
+  --threads LIST   comma separated thread counts (default 1,2,4,8,... up to
+                   twice the hardware threads)
+  --hash MB        transposition table size (default 64)
+  --net FILE       evaluate with this network instead of the hand-written evaluation
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <common/movegen.hpp>
+#include <common/search.hpp>
+
+namespace {
+    const char* const BENCH_POSITIONS[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R1BQ1RK1 w - - 0 9",
+        "2r2rk1/pp1bqpp1/2n1p2p/3pP3/3P4/P1PB1N2/5PPP/R2QR1K1 w - - 0 17",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+    };
+
+    void printUsage() {
+        fprintf(stderr, "Usage: bench [--depth N] [--threads 1,2,4,...] [--hash MB] [--net FILE]\n");
+    }
+
+    std::vector<int> parseThreadList(const char* text) {
+        std::vector<int> counts;
+        for (const char* c = text; *c; ) {
+            int count = atoi(c);
+            if (count > 0) {
+                counts.push_back(count);
+            }
+            const char* comma = strchr(c, ',');
+            if (!comma) {
+                break;
+            }
+            c = comma + 1;
+        }
+        return counts;
+    }
+}
+
+int main(int argc, char** argv) {
+    int depth = 10;
+    int hashMegabytes = 64;
+    const char* netPath = NULL;
+    std::vector<int> threadCounts;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--depth") == 0 && hasValue) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threadCounts = parseThreadList(argv[++i]);
+        } else if (strcmp(argv[i], "--hash") == 0 && hasValue) {
+            hashMegabytes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--net") == 0 && hasValue) {
+            netPath = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (depth < 1 || hashMegabytes < 1) {
+        printUsage();
+        return 1;
+    }
+    if (threadCounts.empty()) {
+        int hardwareThreads = (int)std::thread::hardware_concurrency();
+        int maxThreads = hardwareThreads > 0 ? 2 * hardwareThreads : 8;
+        for (int count = 1; count <= maxThreads; count *= 2) {
+            threadCounts.push_back(count);
+        }
+    }
+
+    initBitboards();
+    TranspositionTable table;
+    if (!table.resize(hashMegabytes)) {
+        fprintf(stderr, "Error: Could not allocate a %d MB hash table\n", hashMegabytes);
+        return 1;
+    }
+    SearchEngine engine(table);
+    NnueNetwork network;
+    if (netPath) {
+        if (!network.load(netPath)) {
+            return 1;
+        }
+        engine.setNetwork(&network);
+    }
+    size_t positionCount = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
+
+    printf("%zu positions, depth %d, %d MB hash\n", positionCount, depth, hashMegabytes);
+    printf("%8s %14s %12s %12s %10s\n", "threads", "nodes", "knps", "ms to depth", "speedup");
+
+    double baseTime = 0.0;
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+        engine.setThreads(threadCounts[t]);
+        engine.setNetwork(netPath ? &network : NULL);
+        uint64_t nodes = 0;
+        int64_t timeMs = 0;
+
+        for (size_t i = 0; i < positionCount; i++) {
+            Position position;
+            position.setFromFen(BENCH_POSITIONS[i]);
+            table.clear(threadCounts[t]);
+            engine.clearHistory();
+
+            SearchLimits limits;
+            limits.depth = depth;
+            SearchInfo info = engine.search(position, limits);
+            nodes += info.nodes;
+            timeMs += info.timeMs;
+        }
+
+        if (t == 0) {
+            baseTime = (double)timeMs;
+        }
+        printf("%8d %14llu %12.0f %12lld %9.2fx\n", threadCounts[t], (unsigned long long)nodes,
+               timeMs > 0 ? (double)nodes / timeMs : 0.0, (long long)timeMs,
+               timeMs > 0 ? baseTime / timeMs : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*
+Description:
+Polyglot book lookup tool and latency benchmark. Lists the book moves of a
+position, or times lookups over positions reached by random playouts from the
+start position (most of them inside the opening, where a book is consulted).
+The first pass is timed separately: it pays for the page faults of the mapping.
+
+Usage: bookbench --book FILE --randoms FILE [options]
+  --fen FEN          list the book moves of a position (default: start position)
+  --bench N          time N lookups instead of listing moves
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <common/book.hpp>
+#include <common/movegen.hpp>
+
+namespace {
+    const int MAX_PLAYOUT_PLIES = 16;
+
+    void printUsage() {
+        fprintf(stderr, "Usage: bookbench --book FILE --randoms FILE [--fen FEN] [--bench N]\n");
+    }
+
+    void listMoves(const PolyglotBook& book, const Position& position) {
+        std::vector<BookMove> moves;
+        int count = book.probe(position, moves);
+        printf("%s\nkey %016llx, %d book moves\n", position.fen().c_str(),
+               (unsigned long long)book.key(position), count);
+        int total = 0;
+        for (int i = 0; i < count; i++) {
+            total += moves[i].weight;
+        }
+        for (int i = 0; i < count; i++) {
+            printf("  %-6s weight %5d  %5.1f%%\n", moveToUci(moves[i].move).c_str(), moves[i].weight,
+                   total > 0 ? 100.0 * moves[i].weight / total : 0.0);
+        }
+    }
+
+    /// Random playouts of 0..MAX_PLAYOUT_PLIES plies, stopping early at mate or stalemate
+    std::vector<Position*> playoutPositions(int count) {
+        std::vector<Position*> positions;
+        std::mt19937_64 random(1);
+        for (int i = 0; i < count; i++) {
+            Position* position = new Position();
+            position->setFromFen(START_FEN);
+            int plies = (int)(random() % (MAX_PLAYOUT_PLIES + 1));
+            for (int ply = 0; ply < plies; ply++) {
+                MoveList list;
+                generateLegalMoves(*position, list);
+                if (list.size() == 0) {
+                    break;
+                }
+                position->makeMove(list[(int)(random() % list.size())]);
+            }
+            positions.push_back(position);
+        }
+        return positions;
+    }
+
+    double nanosecondsSince(std::chrono::steady_clock::time_point start, int count) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+    }
+
+    void bench(const PolyglotBook& book, int lookups) {
+        // A few hundred distinct positions, reused round robin, as in a real opening phase
+        int distinct = lookups < 512 ? lookups : 512;
+        std::vector<Position*> positions = playoutPositions(distinct);
+        std::vector<uint64_t> keys(distinct);
+        std::vector<BookMove> moves;
+        unsigned long long found = 0;
+        unsigned long long checksum = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < distinct; i++) {
+            found += book.probe(*positions[i], moves) > 0;
+        }
+        double cold = nanosecondsSince(start, distinct);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            keys[i % distinct] = book.key(*positions[i % distinct]);
+        }
+        double keyTime = nanosecondsSince(start, lookups);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            checksum += book.lowerBound(keys[i % distinct]);
+        }
+        double searchTime = nanosecondsSince(start, lookups);
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            checksum += book.probe(*positions[i % distinct], moves);
+        }
+        double probeTime = nanosecondsSince(start, lookups);
+
+        printf("%zu entries, %d distinct positions, %llu in book\n", book.size(), distinct, found);
+        printf("%-22s %10.0f ns\n", "first probe (cold)", cold);
+        printf("%-22s %10.0f ns\n", "key", keyTime);
+        printf("%-22s %10.0f ns\n", "binary search", searchTime);
+        printf("%-22s %10.0f ns\n", "full probe", probeTime);
+        printf("(checksum %llu)\n", checksum);
+
+        for (size_t i = 0; i < positions.size(); i++) {
+            delete positions[i];
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* bookPath = NULL;
+    const char* randomsPath = NULL;
+    const char* fen = START_FEN;
+    int lookups = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--book") == 0 && hasValue) {
+            bookPath = argv[++i];
+        } else if (strcmp(argv[i], "--randoms") == 0 && hasValue) {
+            randomsPath = argv[++i];
+        } else if (strcmp(argv[i], "--fen") == 0 && hasValue) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && hasValue) {
+            lookups = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (!bookPath || !randomsPath || lookups < 0) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    PolyglotBook book;
+    if (!book.loadRandoms(randomsPath) || !book.open(bookPath)) {
+        return 1;
+    }
+
+    if (lookups > 0) {
+        bench(book, lookups);
+        return 0;
+    }
+    Position position;
+    if (!position.setFromFen(fen)) {
+        fprintf(stderr, "Error: Invalid FEN %s\n", fen);
+        return 1;
+    }
+    listMoves(book, position);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+Description:
+Evaluation throughput benchmark. Walks the full move tree of a few positions
+to a fixed depth and evaluates every node, once with the hand-written
+evaluation, once with the network refreshing its accumulator from scratch and
+once with incremental accumulator updates. A walk without evaluation is timed
+too, so its cost can be told apart. Every incremental score is also checked
+against a full refresh; the program exits non-zero on any difference.
+
+Usage: evalbench [options]
+  --net FILE         network to load (default: write a random one to random.nnue)
+  --write-net FILE   write a random network to FILE and use it
+  --depth N          tree depth per position (default 3)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <common/evaluate.hpp>
+#include <common/movegen.hpp>
+#include <common/nnue.hpp>
+
+namespace {
+    const char* const POSITIONS[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+
+    enum EvalMode { EVAL_NONE, EVAL_CLASSIC, EVAL_NNUE_FULL, EVAL_NNUE_INCREMENTAL, EVAL_VERIFY };
+
+    struct WalkStats {
+        unsigned long long nodes;
+        long long checksum;      ///< Sum of all scores, keeps the work from being optimised out
+        unsigned long long mismatches;
+    };
+
+    void walk(Position& position, int depth, EvalMode mode, const NnueNetwork& network,
+              NnueAccumulatorStack& accumulators, WalkStats& stats) {
+        stats.nodes++;
+        switch (mode) {
+        case EVAL_CLASSIC:
+            stats.checksum += evaluate(position);
+            break;
+        case EVAL_NNUE_FULL:
+            stats.checksum += network.evaluateFull(position);
+            break;
+        case EVAL_NNUE_INCREMENTAL:
+            stats.checksum += accumulators.evaluate(network, position);
+            break;
+        case EVAL_VERIFY:
+            if (accumulators.evaluate(network, position) != network.evaluateFull(position)) {
+                stats.mismatches++;
+            }
+            break;
+        case EVAL_NONE:
+            break;
+        }
+        if (depth == 0) {
+            return;
+        }
+
+        MoveList list;
+        generateLegalMoves(position, list);
+        for (int i = 0; i < list.size(); i++) {
+            position.makeMove(list[i]);
+            walk(position, depth - 1, mode, network, accumulators, stats);
+            position.unmakeMove();
+        }
+    }
+
+    void printUsage() {
+        fprintf(stderr, "Usage: evalbench [--net FILE | --write-net FILE] [--depth N]\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* netPath = NULL;
+    const char* writePath = NULL;
+    int depth = 3;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--net") == 0 && hasValue) {
+            netPath = argv[++i];
+        } else if (strcmp(argv[i], "--write-net") == 0 && hasValue) {
+            writePath = argv[++i];
+        } else if (strcmp(argv[i], "--depth") == 0 && hasValue) {
+            depth = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (depth < 0) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    if (!netPath) {
+        netPath = writePath ? writePath : "random.nnue";
+        if (!writeRandomNetwork(netPath, 1)) {
+            fprintf(stderr, "Error: Could not write %s\n", netPath);
+            return 1;
+        }
+        printf("Wrote a random network to %s\n", netPath);
+    }
+    NnueNetwork network;
+    if (!network.load(netPath)) {
+        return 1;
+    }
+    printf("%s kernels, depth %d\n", nnueKernelName(), depth);
+
+    const char* const NAMES[] = { "walk only", "hand-written", "nnue refresh", "nnue incremental" };
+    printf("%-18s %14s %10s %14s\n", "evaluation", "nodes", "ms", "evals/s");
+    for (int mode = EVAL_NONE; mode <= EVAL_NNUE_INCREMENTAL; mode++) {
+        WalkStats stats = { 0, 0, 0 };
+        NnueAccumulatorStack accumulators;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < sizeof(POSITIONS) / sizeof(POSITIONS[0]); i++) {
+            Position position;
+            position.setFromFen(POSITIONS[i]);
+            walk(position, depth, (EvalMode)mode, network, accumulators, stats);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-18s %14llu %10.0f %14.0f\n", NAMES[mode], stats.nodes, seconds * 1000.0,
+               seconds > 0.0 ? stats.nodes / seconds : 0.0);
+        if (mode == EVAL_NNUE_INCREMENTAL) {
+            printf("%llu updates, %llu refreshes (checksum %lld)\n",
+                   (unsigned long long)accumulators.updateCount(),
+                   (unsigned long long)accumulators.refreshCount(), stats.checksum);
+        }
+    }
+
+    WalkStats verify = { 0, 0, 0 };
+    NnueAccumulatorStack accumulators;
+    for (size_t i = 0; i < sizeof(POSITIONS) / sizeof(POSITIONS[0]); i++) {
+        Position position;
+        position.setFromFen(POSITIONS[i]);
+        walk(position, depth > 3 ? 3 : depth, EVAL_VERIFY, network, accumulators, verify);
+    }
+    if (verify.mismatches) {
+        printf("FAIL: %llu of %llu incremental evaluations differ from a refresh\n",
+               verify.mismatches, verify.nodes);
+        return 1;
+    }
+    printf("Incremental evaluation matches a full refresh on %llu nodes\n", verify.nodes);
+    return 0;
+}
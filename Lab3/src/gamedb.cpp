@@ -0,0 +1,553 @@
+/*
+Description:
+Game database tool.
+
+  gamedb synth OUT.pgn N [--seed S]
+      writes N random games with comments, NAGs and variations, as test input
+  gamedb parse FILE.pgn [--threads LIST] [--no-moves]
+      parses every game, splitting the file at game boundaries across threads,
+      and reports games/s and MB/s; --no-moves skips SAN resolution
+  gamedb show FILE N
+      prints the tags, moves and final position of game N (0-based) of a PGN
+      file or a game store (.cgs)
+  gamedb convert FILE.pgn OUT.cgs [--threads N] [--keyframes N]
+      converts a PGN file to the binary game store, parsing in parallel, and
+      reports the sizes of both
+  gamedb bench FILE.cgs [--jumps N]
+      decodes every game of a store, then times random jumps to a ply
+  gamedb index FILE.cgs OUT.cpi [--threads N] [--memory MB]
+      builds the position index of a store with an external sort in bounded memory
+  gamedb query FILE.cgs INDEX.cpi (--fen FEN | --game N --ply P | --bench N)
+      lists the games that reached a position, or times N random lookups
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <common/gamestore.hpp>
+#include <common/movegen.hpp>
+#include <common/pgn.hpp>
+#include <common/positionindex.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: gamedb synth OUT.pgn N [--seed S]\n"
+                        "       gamedb parse FILE.pgn [--threads LIST] [--no-moves]\n"
+                        "       gamedb show FILE N\n"
+                        "       gamedb convert FILE.pgn OUT.cgs [--threads N] [--keyframes N]\n"
+                        "       gamedb bench FILE.cgs [--jumps N]\n"
+                        "       gamedb index FILE.cgs OUT.cpi [--threads N] [--memory MB]\n"
+                        "       gamedb query FILE.cgs INDEX.cpi (--fen FEN | --game N --ply P | --bench N)\n");
+    }
+
+    std::vector<int> parseList(const char* text) {
+        std::vector<int> values;
+        for (const char* c = text; *c; ) {
+            int value = atoi(c);
+            if (value > 0) {
+                values.push_back(value);
+            }
+            while (*c && *c != ',') c++;
+            if (*c == ',') c++;
+        }
+        return values;
+    }
+
+    int synth(const char* path, int count, unsigned seed) {
+        FILE* out = fopen(path, "wb");
+        if (!out) {
+            fprintf(stderr, "Error: Could not write %s\n", path);
+            return 1;
+        }
+        static const char* const NAMES[] = { "Anderssen", "Morphy", "Steinitz", "Lasker", "Capablanca",
+                                             "Alekhine", "Euwe", "Botvinnik", "Tal", "Petrosian" };
+        std::mt19937 random(seed);
+        Position position;
+        std::string text;
+        for (int game = 0; game < count; game++) {
+            position.setFromFen(START_FEN);
+            int plies = 20 + (int)(random() % 180);
+            std::string moves;
+            size_t lineStart = 0;
+            const char* result = NULL;
+            for (int ply = 0; ply < plies; ply++) {
+                MoveList list;
+                generateLegalMoves(position, list);
+                if (list.size() == 0) {
+                    result = !position.inCheck() ? "1/2-1/2" : position.sideToMove() == WHITE ? "0-1" : "1-0";
+                    break;
+                }
+                if (ply % 2 == 0) {
+                    appendMovetext(moves, lineStart, std::to_string(ply / 2 + 1) + ".");
+                }
+                Move move = list[(int)(random() % list.size())];
+                appendMovetext(moves, lineStart, moveToSan(position, move));
+                switch (random() % 32) {
+                case 0:
+                    appendMovetext(moves, lineStart, "{A comment (with parentheses)}");
+                    break;
+                case 1:
+                    appendMovetext(moves, lineStart, "$" + std::to_string(1 + random() % 6));
+                    break;
+                case 2: {
+                    // One-move variation replacing the move just played
+                    Move alternative = list[(int)(random() % list.size())];
+                    std::string number = std::to_string(ply / 2 + 1) + (ply % 2 ? "..." : ".");
+                    appendMovetext(moves, lineStart, "(" + number + " " + moveToSan(position, alternative) + ")");
+                    break;
+                }
+                default:
+                    break;
+                }
+                position.makeMove(move);
+            }
+            if (!result) {
+                static const char* const RESULTS[] = { "1-0", "0-1", "1/2-1/2", "*" };
+                result = RESULTS[random() % 4];
+            }
+            appendMovetext(moves, lineStart, result);
+
+            char header[512];
+            snprintf(header, sizeof(header),
+                     "[Event \"Synthetic game %d\"]\n[Site \"Local\"]\n[Date \"2024.%02d.%02d\"]\n"
+                     "[Round \"%d\"]\n[White \"%s\"]\n[Black \"%s\"]\n[Result \"%s\"]\n\n",
+                     game + 1, 1 + game % 12, 1 + game % 28, 1 + game % 9,
+                     NAMES[random() % 10], NAMES[random() % 10], result);
+            text = header;
+            text += moves;
+            text += "\n\n";
+            fwrite(text.data(), text.size(), 1, out);
+        }
+        if (fclose(out) != 0) {
+            fprintf(stderr, "Error: Could not write %s\n", path);
+            return 1;
+        }
+        printf("Wrote %d games to %s\n", count, path);
+        return 0;
+    }
+
+    struct ParseStats {
+        uint64_t games;
+        uint64_t plies;
+        uint64_t invalid;
+    };
+
+    void parsePart(TextSpan part, bool resolveMoves, ParseStats* stats) {
+        PgnReader reader(part.begin, part.end);
+        PgnGame game;
+        ParseStats local = { 0, 0, 0 };
+        while (reader.next(game, resolveMoves)) {
+            local.games++;
+            local.plies += resolveMoves ? game.moves.size() : (uint64_t)game.sanCount;
+            local.invalid += game.valid ? 0 : 1;
+        }
+        *stats = local;
+    }
+
+    int parse(const char* path, const std::vector<int>& threadCounts, bool resolveMoves) {
+        PgnFile file;
+        if (!file.open(path)) {
+            return 1;
+        }
+        double megabytes = file.text().size() / (1024.0 * 1024.0);
+        printf("%s: %.1f MB, %s\n", path, megabytes, resolveMoves ? "resolving moves" : "tokenizing only");
+        printf("%8s %10s %12s %8s %10s %12s %10s\n", "threads", "games", "plies", "invalid", "ms", "games/s", "MB/s");
+        for (size_t t = 0; t < threadCounts.size(); t++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::vector<TextSpan> parts = file.split(threadCounts[t]);
+            std::vector<ParseStats> stats(parts.size());
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < parts.size(); i++) {
+                workers.push_back(std::thread(parsePart, parts[i], resolveMoves, &stats[i]));
+            }
+            parsePart(parts[0], resolveMoves, &stats[0]);
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            ParseStats total = { 0, 0, 0 };
+            for (size_t i = 0; i < stats.size(); i++) {
+                total.games += stats[i].games;
+                total.plies += stats[i].plies;
+                total.invalid += stats[i].invalid;
+            }
+            printf("%8d %10llu %12llu %8llu %10.0f %12.0f %10.1f\n", threadCounts[t],
+                   (unsigned long long)total.games, (unsigned long long)total.plies,
+                   (unsigned long long)total.invalid, seconds * 1000.0,
+                   seconds > 0.0 ? total.games / seconds : 0.0, seconds > 0.0 ? megabytes / seconds : 0.0);
+        }
+        return 0;
+    }
+
+    void printMoves(const std::vector<PgnTag>& tags, Position position, const std::vector<Move>& moves,
+                    const std::string& result) {
+        for (size_t t = 0; t < tags.size(); t++) {
+            printf("[%s \"%s\"]\n", tags[t].name.str().c_str(), tags[t].value.str().c_str());
+        }
+        std::string line;
+        for (size_t m = 0; m < moves.size(); m++) {
+            if (position.sideToMove() == WHITE || m == 0) {
+                line += std::to_string(position.fullmoveNumber()) + (position.sideToMove() == WHITE ? ". " : "... ");
+            }
+            line += moveToSan(position, moves[m]) + " ";
+            position.makeMove(moves[m]);
+        }
+        printf("\n%s%s\n", line.c_str(), result.c_str());
+        printf("Final position: %s\n", position.fen().c_str());
+    }
+
+    bool isStorePath(const char* path) {
+        size_t length = strlen(path);
+        return length > 4 && strcmp(path + length - 4, ".cgs") == 0;
+    }
+
+    int showStored(const char* path, long index) {
+        GameStore store;
+        if (!store.open(path)) {
+            return 1;
+        }
+        if (index < 0 || (uint64_t)index >= store.gameCount()) {
+            fprintf(stderr, "Error: %s has fewer than %ld games\n", path, index + 1);
+            return 1;
+        }
+        std::vector<PgnTag> tags;
+        store.tags(index, tags);
+        Position start;
+        std::vector<Move> moves;
+        if (!store.moves(index, start, moves)) {
+            fprintf(stderr, "Error: Game %ld of %s is corrupt\n", index, path);
+            return 1;
+        }
+        printMoves(tags, start, moves, store.tag(index, "Result").str());
+        return 0;
+    }
+
+    int show(const char* path, long index) {
+        if (isStorePath(path)) {
+            return showStored(path, index);
+        }
+        PgnFile file;
+        if (!file.open(path)) {
+            return 1;
+        }
+        PgnReader reader(file.text().begin, file.text().end);
+        PgnGame game;
+        for (long i = 0; reader.next(game, i == index); i++) {
+            if (i < index) {
+                continue;
+            }
+            printMoves(game.tags, game.start, game.moves, game.result.str());
+            if (!game.valid) {
+                printf("Stopped at unreadable move \"%s\"\n", game.error.str().c_str());
+            }
+            return 0;
+        }
+        fprintf(stderr, "Error: %s has fewer than %ld games\n", path, index + 1);
+        return 1;
+    }
+
+    void encodePart(TextSpan part, int keyframeInterval, GameBatch* batch) {
+        PgnReader reader(part.begin, part.end);
+        PgnGame game;
+        while (reader.next(game)) {
+            batch->add(game, keyframeInterval);
+        }
+    }
+
+    int convert(const char* path, const char* outPath, int threads, int keyframeInterval) {
+        PgnFile file;
+        if (!file.open(path)) {
+            return 1;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<TextSpan> parts = file.split(threads);
+        std::vector<GameBatch> batches(parts.size());
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < parts.size(); i++) {
+            workers.push_back(std::thread(encodePart, parts[i], keyframeInterval, &batches[i]));
+        }
+        encodePart(parts[0], keyframeInterval, &batches[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        GameStoreWriter writer;
+        if (!writer.open(outPath, keyframeInterval)) {
+            return 1;
+        }
+        uint64_t games = 0, plies = 0, keyframeBytes = 0, tagBytes = 0;
+        for (size_t i = 0; i < batches.size(); i++) {
+            if (!writer.append(batches[i])) {
+                return 1;
+            }
+            games += batches[i].records.size();
+            plies += batches[i].moves.size();
+            keyframeBytes += batches[i].keyframes.size();
+            tagBytes += batches[i].tags.size();
+        }
+        if (!writer.finish()) {
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        GameStore store;
+        if (!store.open(outPath)) {
+            return 1;
+        }
+        double pgnBytes = (double)file.text().size();
+        double storeBytes = (double)store.fileSize();
+        printf("Converted %llu games, %llu plies in %.2f s with %d threads\n",
+               (unsigned long long)games, (unsigned long long)plies, seconds, (int)parts.size());
+        printf("PGN   %12.0f bytes\n", pgnBytes);
+        printf("Store %12.0f bytes (%.1f%%): moves %llu, keyframes %llu, tags %llu, records %llu\n",
+               storeBytes, 100.0 * storeBytes / pgnBytes, (unsigned long long)plies,
+               (unsigned long long)keyframeBytes, (unsigned long long)tagBytes, (unsigned long long)games * 32);
+        printf("Bytes per move: PGN %.2f, store %.2f (moves alone 1.00)\n",
+               plies ? pgnBytes / plies : 0.0, plies ? storeBytes / plies : 0.0);
+        return 0;
+    }
+
+    int bench(const char* path, int jumps) {
+        GameStore store;
+        if (!store.open(path)) {
+            return 1;
+        }
+        printf("%s: %llu games, %.1f MB, keyframe every %d plies\n", path, (unsigned long long)store.gameCount(),
+               store.fileSize() / (1024.0 * 1024.0), store.keyframeInterval());
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Position position;
+        std::vector<Move> moves;
+        uint64_t plies = 0, corrupt = 0;
+        for (uint64_t game = 0; game < store.gameCount(); game++) {
+            if (store.moves(game, position, moves)) {
+                plies += moves.size();
+            } else {
+                corrupt++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Decoded %llu plies (%llu corrupt games) in %.0f ms: %.0f games/s, %.1fM moves/s\n",
+               (unsigned long long)plies, (unsigned long long)corrupt, seconds * 1000.0,
+               seconds > 0.0 ? store.gameCount() / seconds : 0.0, seconds > 0.0 ? plies / seconds / 1e6 : 0.0);
+
+        if (store.gameCount() == 0) {
+            return 0;
+        }
+        std::mt19937_64 random(1);
+        uint64_t replayed = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < jumps; i++) {
+            uint64_t game = random() % store.gameCount();
+            int ply = (int)(random() % (uint64_t)(store.plyCount(game) + 1));
+            replayed += (uint64_t)(ply % store.keyframeInterval());
+            if (!store.positionAt(game, ply, position)) {
+                corrupt++;
+            }
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%d random jumps: %.2f us each, %.1f moves replayed on average\n",
+               jumps, jumps > 0 ? seconds * 1e6 / jumps : 0.0, jumps > 0 ? (double)replayed / jumps : 0.0);
+        return corrupt ? 1 : 0;
+    }
+
+    int index(const char* path, const char* outPath, int threads, size_t memoryBytes) {
+        GameStore store;
+        if (!store.open(path)) {
+            return 1;
+        }
+        PositionIndexStats stats;
+        if (!buildPositionIndex(store, outPath, threads, memoryBytes, &stats)) {
+            return 1;
+        }
+        PositionIndex positions;
+        if (!positions.open(outPath)) {
+            return 1;
+        }
+        printf("Indexed %llu positions of %llu games (%llu corrupt) with %d threads and %zu MB\n",
+               (unsigned long long)stats.entries, (unsigned long long)store.gameCount(),
+               (unsigned long long)stats.corruptGames, threads, memoryBytes / (1024 * 1024));
+        printf("Scan and sort %.2f s (%llu runs), merge %.2f s\n", stats.scanSeconds,
+               (unsigned long long)stats.runs, stats.mergeSeconds);
+        printf("Index %.1f MB, %zu pages, fences %.1f KB in memory\n", positions.pageCount() * 4096.0 / (1024 * 1024),
+               positions.pageCount(), positions.pageCount() * 8.0 / 1024);
+        return 0;
+    }
+
+    void printHits(const GameStore& store, const PositionIndex& positions, uint64_t key) {
+        const size_t SHOWN = 20;
+        std::vector<PositionHit> hits;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t count = positions.find(key, hits, SHOWN);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Position reached %zu times (lookup %.1f us)\n", count, seconds * 1e6);
+        for (size_t i = 0; i < hits.size(); i++) {
+            printf("  game %7u ply %3u  %s - %s  %s\n", hits[i].game, hits[i].ply,
+                   store.tag(hits[i].game, "White").str().c_str(), store.tag(hits[i].game, "Black").str().c_str(),
+                   store.tag(hits[i].game, "Result").str().c_str());
+        }
+        if (count > hits.size()) {
+            printf("  ... and %zu more\n", count - hits.size());
+        }
+    }
+
+    int queryBench(const GameStore& store, const PositionIndex& positions, int lookups) {
+        if (store.gameCount() == 0 || lookups <= 0) {
+            return 0;
+        }
+        // Keys of random positions from the store, so every lookup has hits
+        std::mt19937_64 random(1);
+        std::vector<uint64_t> keys;
+        Position position;
+        for (int i = 0; i < lookups; i++) {
+            uint64_t game = random() % store.gameCount();
+            int ply = (int)(random() % (uint64_t)(store.plyCount(game) + 1));
+            if (store.positionAt(game, ply, position)) {
+                keys.push_back(position.key());
+            }
+        }
+        std::vector<PositionHit> hits;
+        uint64_t total = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keys.size(); i++) {
+            total += positions.find(keys[i], hits, 64);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%zu random lookups: %.2f us each, %.1f hits on average\n", keys.size(),
+               keys.empty() ? 0.0 : seconds * 1e6 / keys.size(), keys.empty() ? 0.0 : (double)total / keys.size());
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    initBitboards();
+    const char* command = argv[1];
+    const char* path = argv[2];
+
+    if (strcmp(command, "synth") == 0 && argc >= 4) {
+        unsigned seed = 1;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+                seed = (unsigned)atoi(argv[++i]);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        return synth(path, atoi(argv[3]), seed);
+    }
+    if (strcmp(command, "parse") == 0) {
+        std::vector<int> threadCounts;
+        bool resolveMoves = true;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threadCounts = parseList(argv[++i]);
+            } else if (strcmp(argv[i], "--no-moves") == 0) {
+                resolveMoves = false;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        if (threadCounts.empty()) {
+            int hardwareThreads = (int)std::thread::hardware_concurrency();
+            for (int threads = 1; threads <= (hardwareThreads > 1 ? hardwareThreads : 1); threads *= 2) {
+                threadCounts.push_back(threads);
+            }
+        }
+        return parse(path, threadCounts, resolveMoves);
+    }
+    if (strcmp(command, "show") == 0 && argc == 4) {
+        return show(path, atol(argv[3]));
+    }
+    if (strcmp(command, "convert") == 0 && argc >= 4) {
+        int threads = (int)std::thread::hardware_concurrency();
+        int keyframeInterval = GAMESTORE_DEFAULT_KEYFRAME_INTERVAL;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threads = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--keyframes") == 0 && i + 1 < argc) {
+                keyframeInterval = atoi(argv[++i]);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        return convert(path, argv[3], threads > 0 ? threads : 1, keyframeInterval > 0 ? keyframeInterval : 1);
+    }
+    if (strcmp(command, "bench") == 0) {
+        int jumps = 100000;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--jumps") == 0 && i + 1 < argc) {
+                jumps = atoi(argv[++i]);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        return bench(path, jumps);
+    }
+    if (strcmp(command, "index") == 0 && argc >= 4) {
+        int threads = (int)std::thread::hardware_concurrency();
+        size_t memoryMb = 256;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threads = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+                memoryMb = (size_t)atol(argv[++i]);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        return index(path, argv[3], threads > 0 ? threads : 1, (memoryMb > 0 ? memoryMb : 1) * 1024 * 1024);
+    }
+    if (strcmp(command, "query") == 0 && argc >= 4) {
+        GameStore store;
+        PositionIndex positions;
+        if (!store.open(path) || !positions.open(argv[3])) {
+            return 1;
+        }
+        const char* fen = NULL;
+        long game = -1;
+        int ply = 0;
+        int lookups = 0;
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+                fen = argv[++i];
+            } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+                game = atol(argv[++i]);
+            } else if (strcmp(argv[i], "--ply") == 0 && i + 1 < argc) {
+                ply = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+                lookups = atoi(argv[++i]);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        if (lookups > 0) {
+            return queryBench(store, positions, lookups);
+        }
+        Position position;
+        if (fen ? !position.setFromFen(fen) : game < 0 || !store.positionAt((uint64_t)game, ply, position)) {
+            fprintf(stderr, "Error: No such position\n");
+            return 1;
+        }
+        printf("%s\n", position.fen().c_str());
+        printHits(store, positions, position.key());
+        return 0;
+    }
+    printUsage();
+    return 1;
+}
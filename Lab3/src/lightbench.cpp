@@ -0,0 +1,86 @@
+/*
+Description:
+Clustered light assignment cost. Hangs 1, 2, 4, ... lamps over a grid of
+boards, as the viewer does with --lamps, and assigns them to the clusters of
+a camera framing the whole grid. Prints the assignment time per frame and the
+lights per cluster, which bounds the lights each fragment loops over.
+
+Usage: lightbench [--boards N] [--max-lights N] [--threads N] [--frames N]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <common/boardlayout.hpp>
+#include <common/lighting.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: lightbench [--boards N] [--max-lights N] [--threads N] [--frames N]\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    int boardCount = 64;
+    int maxLights = 256;
+    int threads = 1;
+    int frames = 500;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--boards") == 0 && i + 1 < argc) {
+            boardCount = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--max-lights") == 0 && i + 1 < argc) {
+            maxLights = std::max(1, std::min(MAX_POINT_LIGHTS, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // The viewer's camera: framing the grid from above the white side, turning around it
+    int columns = 1;
+    while (columns * columns < boardCount) {
+        columns++;
+    }
+    float distance = boardCount > 1 ? BOARD_PITCH * (columns + 1) : 60.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, std::max(100.0f, 3.0f * distance));
+
+    LightClusterer clusterer(threads);
+    ClusteredLights clusters;
+    printf("%d boards, %d threads, %d frames per count\n", boardCount, clusterer.threadCount(), frames);
+    printf("%8s %14s %14s %14s\n", "lights", "us/frame", "avg/cluster", "max/cluster");
+    typedef std::chrono::steady_clock Clock;
+    for (int count = 1; count <= maxLights; count *= 2) {
+        std::vector<PointLight> lamps = hallLamps(count, columns * BOARD_PITCH);
+        double seconds = 0.0;
+        size_t entries = 0;
+        size_t litClusters = 0;
+        uint32_t most = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            float angle = 0.01f * frame;
+            glm::vec3 eye(distance * 0.7f * sinf(angle), distance * 0.7f, distance * 0.7f * cosf(angle));
+            glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+            Clock::time_point start = Clock::now();
+            clusterer.assign(lamps, view, projection, clusters);
+            seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+            entries += clusters.indices.size();
+            for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+                uint32_t lights = clusters.ranges[2 * cluster + 1];
+                litClusters += lights > 0;
+                most = std::max(most, lights);
+            }
+        }
+        printf("%8d %14.1f %14.2f %14u\n", count, seconds / frames * 1e6,
+               litClusters > 0 ? (double)entries / litClusters : 0.0, most);
+    }
+    return 0;
+}
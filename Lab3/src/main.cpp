@@ -36,19 +36,349 @@ The system provides smooth camera control and proper piece placement on the boar
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <thread>
 #include <vector>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <glm/gtc/matrix_transform.hpp>
-#include <common/shader.hpp>
-#include <common/texture.hpp>
+#include <common/analysis.hpp>
+#include <common/arrow.hpp>
+#include <common/boardlayout.hpp>
+#include <common/capture.hpp>
 #include <common/controls.hpp>
-#include <common/objloader.hpp>
-#include <common/vboindexer.hpp>
+#include <common/evaluate.hpp>
+#include <common/gamestore.hpp>
+#include <common/gpuresource.hpp>
+#include <common/input.hpp>
+#include <common/movegen.hpp>
+#include <common/picking.hpp>
+#include <common/positionindex.hpp>
+#include <common/scene.hpp>
+#include <common/simulation.hpp>
+#include <common/uciengine.hpp>
 
 GLFWwindow* window;
 
-void render() {
+/**
+ * @brief Command line options of the interactive viewer
+ */
+struct RenderOptions {
+	const char* recordPath;         ///< Start recording to this file, NULL to wait for R
+	int boardCount;                 ///< Number of boards shown in the grid
+	std::vector<std::string> fens;  ///< Placements cycled across the boards
+	bool scalingBench;              ///< Run the board count benchmark and exit
+	const char* bookPath;           ///< Polyglot book answering analysis, NULL for none
+	const char* randomsPath;        ///< Random64 constants for the book keys
+	const char* tablebasePath;      ///< Endgame table directory, NULL for none
+	const char* replayPath;         ///< Game store stepped through on the first board, NULL for none
+	long replayGame;                ///< First game shown from the store
+	const char* indexPath;          ///< Position index of the replay store, NULL for none
+	const char* weightsPath;        ///< Evaluation weights, e.g. from the tuner, NULL for the built-in ones
+	const char* engineCommand;      ///< External UCI engine analysing instead of the built-in search
+	int engineMovetimeMs;           ///< Time per move when the engine plays a game
+	double autoplayRate;            ///< Plies per second played on every board from --replay, 0 for off
+	bool shadows;                   ///< Shadow mapping on
+	bool shadowCaching;             ///< Shadow layers only redrawn when what they hold changes
+	int lampCount;                  ///< Point lights hung over the boards
+	bool normalMapping;             ///< Board normal map on
+	const char* lightmapPath;       ///< Baked board lighting besides the default one, NULL for none
+	bool bakedLighting;             ///< Baked board lighting used when loaded
+
+	RenderOptions() : recordPath(NULL), boardCount(1), scalingBench(false), bookPath(NULL), randomsPath(NULL),
+		tablebasePath(NULL), replayPath(NULL), replayGame(0), indexPath(NULL), weightsPath(NULL),
+		engineCommand(NULL), engineMovetimeMs(1000), autoplayRate(0.0), shadows(true), shadowCaching(true),
+		lampCount(0), normalMapping(true), lightmapPath(NULL), bakedLighting(true) {}
+};
+
+/**
+ * @brief Sets up count boards on the simulation and frames them with the camera
+ * The simulation must be stopped.
+ */
+void setupBoards(Simulation& simulation, int count, const std::vector<std::string>& fens) {
+	std::vector<std::string> boardFens;
+	for (int i = 0; i < count; i++) {
+		boardFens.push_back(fens.empty() ? std::string(START_FEN) : fens[i % fens.size()]);
+	}
+	simulation.setBoards(boardFens);
+
+	int columns = 1;
+	while (columns * columns < count) {
+		columns++;
+	}
+	if (count > 1) {
+		setCameraDistance(BOARD_PITCH * (columns + 1));
+	}
+}
+
+/**
+ * @brief Places a position on the first board without an animation; the simulation keeps running
+ */
+void showOnFirstBoard(Simulation& simulation, const Position& position, std::vector<std::string>& fens) {
+	if (fens.empty()) {
+		fens.push_back(START_FEN);
+	}
+	fens[0] = position.fen();
+	simulation.setBoardPosition(0, fens[0]);
+}
+
+/**
+ * @brief Animates a move on the first board; position is the board after the move
+ */
+void playOnFirstBoard(Simulation& simulation, const Position& position, Move move, std::vector<std::string>& fens) {
+	if (fens.empty()) {
+		fens.push_back(START_FEN);
+	}
+	fens[0] = position.fen();
+	simulation.playMove(0, move);
+}
+
+/**
+ * @brief A stored game being played on one board by --autoplay
+ */
+struct AutoplayBoard {
+	uint64_t game;
+	Position start;
+	std::vector<Move> moves;
+	size_t ply;
+};
+
+/**
+ * @brief Puts the start of an autoplay board's game on the board
+ */
+void loadAutoplayGame(Simulation& simulation, const GameStore& store, AutoplayBoard& board, int index,
+					  Position& analysisRoot) {
+	board.moves.clear();
+	board.ply = 0;
+	if (!store.moves(board.game, board.start, board.moves)) {
+		return;
+	}
+	simulation.setBoardPosition(index, board.start.fen());
+	if (index == 0) {
+		analysisRoot = board.start;
+	}
+}
+
+/**
+ * @brief Plays the next ply on every board, moving a board on to a new game when its game ends
+ * Board i plays games first + i, first + i + boards, ...
+ */
+void autoplayStep(Simulation& simulation, const GameStore& store, std::vector<AutoplayBoard>& boards, Position& analysisRoot) {
+	for (size_t b = 0; b < boards.size(); b++) {
+		AutoplayBoard& board = boards[b];
+		if (board.ply < board.moves.size()) {
+			Move move = board.moves[board.ply++];
+			simulation.playMove((int)b, move);
+			if (b == 0) {
+				analysisRoot.makeMove(move);
+			}
+		} else {
+			// A finished game stays up for one step, then the board moves on
+			board.game = (board.game + boards.size()) % store.gameCount();
+			loadAutoplayGame(simulation, store, board, (int)b, analysisRoot);
+		}
+	}
+}
+
+/**
+ * @brief Shows one ply of a stored game on the first board
+ * The position also becomes the analysis root.
+ *
+ * @return false if the game could not be decoded
+ */
+bool showStoredPly(Simulation& simulation, const GameStore& store, uint64_t game, int ply,
+				   std::vector<std::string>& fens, Position& analysisRoot) {
+	Position position;
+	if (!store.positionAt(game, ply, position)) {
+		fprintf(stderr, "Could not decode game %llu\n", (unsigned long long)game);
+		return false;
+	}
+	showOnFirstBoard(simulation, position, fens);
+	analysisRoot = position;
+	printf("Game %llu (%s - %s), ply %d/%d: %s\n", (unsigned long long)game,
+		   store.tag(game, "White").str().c_str(), store.tag(game, "Black").str().c_str(),
+		   ply, store.plyCount(game), fens[0].c_str());
+	return true;
+}
+
+/**
+ * @brief Prints the other games of the store that reached a position
+ */
+void printPositionGames(const PositionIndex& index, const GameStore& store, const Position& position, uint64_t shownGame) {
+	const size_t LISTED = 8;
+	std::vector<PositionHit> hits;
+	size_t count = index.find(position.key(), hits, LISTED + 1);
+	printf("Position occurs %zu times in the database\n", count);
+	for (size_t i = 0, listed = 0; i < hits.size() && listed < LISTED; i++) {
+		if (hits[i].game != shownGame) {
+			printf("  game %u, ply %u: %s - %s %s\n", hits[i].game, hits[i].ply,
+				   store.tag(hits[i].game, "White").str().c_str(), store.tag(hits[i].game, "Black").str().c_str(),
+				   store.tag(hits[i].game, "Result").str().c_str());
+			listed++;
+		}
+	}
+}
+
+/**
+ * @brief Renders a doubling number of boards without vsync and prints frame times
+ * Each count is timed without shadows, with cached shadow layers and with the
+ * shadow map redrawn every frame.
+ */
+void runScalingBench(ChessScene& scene, Simulation& simulation, const std::vector<std::string>& fens) {
+	const int FRAMES = 120;
+	const int WARMUP_FRAMES = 10;
+	const char* modes[3] = { "no shadows", "cached", "uncached" };
+
+	glfwSwapInterval(0);
+	printf("%8s %8s %12s %12s %12s %12s %12s %12s\n", "boards", "pieces", modes[0], modes[1], modes[2], "draw calls",
+		   "CPU KiB", "VRAM KiB");
+	for (int count = 1; count <= 256 && !glfwWindowShouldClose(window); count *= 2) {
+		simulation.stop();
+		setupBoards(simulation, count, fens);
+		simulation.start();
+
+		double msPerFrame[3];
+		size_t pieces = 0;
+		for (int mode = 0; mode < 3; mode++) {
+			scene.setShadows(mode != 0, mode == 1);
+			double start = 0.0;
+			for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++) {
+				if (frame == WARMUP_FRAMES) {
+					start = glfwGetTime();
+				}
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glfwPollEvents();
+				const FramePacket& packet = simulation.acquireFrame();
+				scene.draw(packet);
+				pieces = packet.pieces.size();
+				glfwSwapBuffers(window);
+				// Wait for the GPU so the time covers the whole frame, not just submission
+				glFinish();
+			}
+			msPerFrame[mode] = 1000.0 * (glfwGetTime() - start) / FRAMES;
+		}
+		// Everything the scene holds, which only the instance data should grow
+		GpuUsage usage = gpuUsageTotal();
+		printf("%8d %8zu %12.3f %12.3f %12.3f %12d %12.1f %12.1f\n", count, pieces, msPerFrame[0], msPerFrame[1],
+			   msPerFrame[2], scene.drawCalls(), usage.cpuBytes / 1024.0, usage.vramBytes / 1024.0);
+	}
+	scene.setShadows(true);
+}
+
+/**
+ * @brief Collects the arrows to draw for an analysis snapshot
+ * @return Number of arrows written, at most 2
+ */
+int analysisArrows(const AnalysisSnapshot& snapshot, MoveArrow* arrows) {
+	if (!snapshot.searching && !snapshot.fromBook) {
+		return 0;
+	}
+	int count = 0;
+	if (snapshot.pondering) {
+		arrows[count++] = MoveArrow{ snapshot.ponderMove, glm::vec4(0.8f, 0.8f, 0.8f, 0.6f) };
+	}
+	if (snapshot.bestMove() != NO_MOVE) {
+		glm::vec4 color = snapshot.pondering ? glm::vec4(0.2f, 0.5f, 1.0f, 0.75f) : glm::vec4(0.1f, 0.9f, 0.2f, 0.75f);
+		arrows[count++] = MoveArrow{ snapshot.bestMove(), color };
+	}
+	return count;
+}
+
+/**
+ * @brief Finds the legal move between two squares, promoting to a queen
+ * @return NO_MOVE if there is none
+ */
+Move findClickedMove(const Position& position, int from, int to) {
+	MoveList legal;
+	generateLegalMoves(position, legal);
+	for (int i = 0; i < legal.size(); i++) {
+		Move move = legal[i];
+		if (moveFrom(move) == from && moveTo(move) == to && (!isPromotion(move) || promotionType(move) == QUEEN)) {
+			return move;
+		}
+	}
+	return NO_MOVE;
+}
+
+/**
+ * @brief Appends an arrow for every legal move from a selected square
+ * @return Number of arrows written, at most capacity
+ */
+int selectionArrows(const Position& position, int square, MoveArrow* arrows, int capacity) {
+	MoveList legal;
+	generateLegalMoves(position, legal);
+	int count = 0;
+	for (int i = 0; i < legal.size() && count < capacity; i++) {
+		Move move = legal[i];
+		if (moveFrom(move) == square && (!isPromotion(move) || promotionType(move) == QUEEN)) {
+			arrows[count++] = MoveArrow{ move, glm::vec4(1.0f, 0.85f, 0.2f, 0.5f) };
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Folds the engine updates that arrived since the last frame into a snapshot
+ * At most the queue's capacity is taken per frame, however fast the engine prints.
+ *
+ * @param search Search whose updates are wanted; older ones are skipped
+ * @return Best move if that search finished, NO_MOVE otherwise
+ */
+Move pollEngine(UciEngine& engine, unsigned search, AnalysisSnapshot& snapshot) {
+	Move finished = NO_MOVE;
+	UciUpdate update;
+	while (engine.poll(update)) {
+		if (update.type == UCI_READY) {
+			printf("Engine %s ready\n", update.name[0] ? update.name : "(unnamed)");
+		} else if (update.type == UCI_EXITED) {
+			printf("Engine exited\n");
+			snapshot.searching = false;
+		} else if (update.search != search) {
+			continue;
+		} else if (update.type == UCI_INFO) {
+			snapshot.depth = update.depth;
+			snapshot.seldepth = update.seldepth;
+			snapshot.score = !update.mate ? update.score
+				: update.score > 0 ? SCORE_MATE - (2 * update.score - 1) : -SCORE_MATE - 2 * update.score;
+			snapshot.nodes = update.nodes;
+			snapshot.nps = update.nps;
+			if (update.pvLength > 0) {
+				snapshot.pvLength = std::min(update.pvLength, ANALYSIS_MAX_PV);
+				std::copy(update.pv, update.pv + snapshot.pvLength, snapshot.pv);
+			}
+		} else if (update.type == UCI_BESTMOVE) {
+			snapshot.searching = false;
+			finished = update.bestMove();
+		}
+	}
+	return finished;
+}
+
+/**
+ * @brief Prints depth, score, speed and principal variation of a snapshot
+ */
+void printAnalysis(const AnalysisSnapshot& snapshot) {
+	printf("%s depth %d/%d score %d cp, %.2f Mnps, pv", snapshot.pondering ? "ponder" : "analysis",
+		   snapshot.depth, snapshot.seldepth, snapshot.score, snapshot.nps / 1e6);
+	for (int i = 0; i < snapshot.pvLength; i++) {
+		printf(" %s", moveToUci(snapshot.pv[i]).c_str());
+	}
+	printf("\n");
+}
+
+/**
+ * @brief Starts recording the window contents at framebuffer resolution
+ */
+void startRecording(VideoCapture& capture, const char* path) {
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	capture.start(path, width, height);
+}
+
+void render(const RenderOptions& options) {
+	const char* recordPath = options.recordPath;
 	if (!glfwInit()) {
 		fprintf(stderr, "Failed to initialize GLFW\n");
 		getchar();
@@ -78,286 +408,394 @@ void render() {
 
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	initInput(window);
 	glfwPollEvents();
-	glfwSetCursorPos(window, 1024/2, 768/2);
+	consumeInput();
 
 	glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 	glEnable(GL_CULL_FACE);
 
-	GLuint VertexArrayID;
-	glGenVertexArrays(1, &VertexArrayID);
-	glBindVertexArray(VertexArrayID);
-
-	// Create and compile shaders
-	GLuint programID = LoadShaders("shaders/StandardShading.vertexshader", "shaders/StandardShading.fragmentshader");
-
-	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
-
-	// Load textures
-	GLuint boardTexture = loadBMP_custom("Stone_Chess_Board/12951_Stone_Chess_Board_diff.bmp");
-	GLuint TextureID = glGetUniformLocation(programID, "myTextureSampler");
-
-	// Load board model
-	std::vector<glm::vec3> boardVertices;
-	std::vector<glm::vec2> boardUvs;
-	std::vector<glm::vec3> boardNormals;
-	if (!loadOBJ("Stone_Chess_Board/12951_Stone_Chess_Board_v1_L3.obj",
-				 boardVertices, boardUvs, boardNormals)) {
-				 }
-
-	std::vector<unsigned short> boardIndices;
-	std::vector<glm::vec3> indexedBoardvertices;
-	std::vector<glm::vec2> indexedBoarduvs;
-	std::vector<glm::vec3> indexedBoardnormals;
-	indexVBO(boardVertices, boardUvs, boardNormals,
-			 boardIndices, indexedBoardvertices, indexedBoarduvs, indexedBoardnormals);
-
-	// Setup board buffers
-	GLuint boardVertexbuffer;
-	glGenBuffers(1, &boardVertexbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, boardVertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexedBoardvertices.size() * sizeof(glm::vec3),
-				 &indexedBoardvertices[0], GL_STATIC_DRAW);
-	GLuint boardUvbuffer;
-	glGenBuffers(1, &boardUvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, boardUvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexedBoarduvs.size() * sizeof(glm::vec2),
-				 &indexedBoarduvs[0], GL_STATIC_DRAW);
-
-	GLuint boardNormalbuffer;
-	glGenBuffers(1, &boardNormalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, boardNormalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexedBoardnormals.size() * sizeof(glm::vec3),
-				 &indexedBoardnormals[0], GL_STATIC_DRAW);
-
-	GLuint boardElementbuffer;
-	glGenBuffers(1, &boardElementbuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boardElementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, boardIndices.size() * sizeof(unsigned short),
-				 &boardIndices[0], GL_STATIC_DRAW);
-
-	std::vector<ChessPiece> chessPieces;
-	// Load chess pieces
-	if (!loadAssImp("Chess/chess.obj", chessPieces)) {
-		fprintf(stderr, "Failed to load chess pieces.\n");
-	}
-
-	// Setup chess piece buffers
-	for (ChessPiece& piece : chessPieces) {
-		piece.setBuffers();
-	}
-
-	// Setup lighting
-	glUseProgram(programID);
-	GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-	GLuint lightEnableID = glGetUniformLocation(programID, "enableLight");
+	ChessScene scene;
+	if (!scene.load()) {
+		fprintf(stderr, "Failed to load the chess scene.\n");
+	}
+	scene.setShadows(options.shadows, options.shadowCaching);
+	scene.setNormalMapping(options.normalMapping);
+	if (options.lightmapPath) {
+		scene.loadBakedLighting(options.lightmapPath);
+	}
+	scene.setBakedLighting(options.bakedLighting);
+	printGpuMemoryReport();
+
+	// Input, camera and piece placement run on the simulation thread from here on
+	Simulation simulation;
+	if (options.scalingBench) {
+		runScalingBench(scene, simulation, options.fens);
+		simulation.stop();
+		scene.release();
+		glfwTerminate();
+		return;
+	}
+	setupBoards(simulation, options.boardCount, options.fens);
+	simulation.setLamps(options.lampCount);
+	simulation.start();
+
+	// G starts/stops analysing the first board, H ponders on the current best move.
+	// Searches leave one core to the render and simulation threads.
+	Position analysisRoot;
+	if (!options.fens.empty()) {
+		analysisRoot.setFromFen(options.fens[0].c_str());
+	}
+	glm::vec3 analysisBoardOffset = boardGridOffset(0, options.boardCount);
+
+	// With --replay, LEFT/RIGHT step through the plies of a stored game and
+	// PAGE_UP/PAGE_DOWN switch games; with --index every position shown also
+	// lists the games that reached it
+	GameStore replayStore;
+	PositionIndex positionIndex;
+	std::vector<std::string> boardFens = options.fens;
+	uint64_t replayGame = 0;
+	int replayPly = 0;
+	if (options.replayPath && replayStore.open(options.replayPath) && replayStore.gameCount() > 0) {
+		replayGame = (uint64_t)options.replayGame < replayStore.gameCount() ? (uint64_t)options.replayGame : 0;
+		if (showStoredPly(simulation, replayStore, replayGame, replayPly, boardFens, analysisRoot) &&
+			options.indexPath && positionIndex.open(options.indexPath)) {
+			printPositionGames(positionIndex, replayStore, analysisRoot, replayGame);
+		}
+	}
+	// With --autoplay every board plays stored games on its own at the given rate
+	std::vector<AutoplayBoard> autoplayBoards;
+	double nextAutoplay = glfwGetTime();
+	if (options.autoplayRate > 0.0 && replayStore.gameCount() > 0) {
+		autoplayBoards.resize(options.boardCount);
+		for (int b = 0; b < options.boardCount; b++) {
+			autoplayBoards[b].game = (replayGame + b) % replayStore.gameCount();
+			loadAutoplayGame(simulation, replayStore, autoplayBoards[b], b, analysisRoot);
+		}
+		// Moves finish before the next one starts, however fast the replay
+		simulation.setMoveDuration(std::min(MOVE_ANIMATION_SECONDS, (float)(0.8 / options.autoplayRate)));
+	}
+	int hardwareThreads = (int)std::thread::hardware_concurrency();
+	PolyglotBook book;
+	Tablebases tablebases;
+	AnalysisService analysis(64, hardwareThreads > 2 ? hardwareThreads - 1 : 1);
+	if (options.bookPath && options.randomsPath && book.loadRandoms(options.randomsPath) &&
+		book.open(options.bookPath)) {
+		printf("Opening book %s, %zu entries\n", options.bookPath, book.size());
+		analysis.setBook(&book);
+	}
+	if (options.weightsPath && loadEvalWeights(options.weightsPath, evalWeights())) {
+		printf("Evaluation weights %s\n", options.weightsPath);
+	}
+	if (options.tablebasePath) {
+		tablebases.setPath(options.tablebasePath);
+		analysis.setTablebases(&tablebases);
+	}
+	// With --engine, G analyses with the external engine instead and P lets it
+	// play the first board against itself
+	UciEngine engine;
+	AnalysisSnapshot engineSnapshot;
+	unsigned engineSearch = 0;
+	bool engineGame = false;
+	bool useEngine = options.engineCommand && engine.start(options.engineCommand);
+	ArrowOverlay arrows;
+	if (!arrows.load()) {
+		fprintf(stderr, "Failed to load the arrow shader.\n");
+	}
+
+	// Left click picks the piece or square at the window centre, or under the
+	// cursor once C has freed it. Picks are read back a frame or more later;
+	// a piece of the side to move on the first board is selected, and a click
+	// on one of its target squares plays the move.
+	PickBuffer picker;
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	picker.init(framebufferWidth, framebufferHeight, 2);
+	bool freeCursor = false;
+	int selectedSquare = -1;
+	long long frameIndex = 0;
+
+	// R toggles recording, --record starts it right away
+	VideoCapture capture;
+	if (recordPath) {
+		startRecording(capture, recordPath);
+	}
 
 	double lastTime = glfwGetTime();
 	int nbFrames = 0;
+	int shadowLayers = 0;
+	unsigned long lastPresentedPacket = 0;
+	bool analysisRunning = false;
+	unsigned long printedBookRequest = 0;
 
 	do {
 		double currentTime = glfwGetTime();
+		// Never blocks: the newest snapshot is swapped in without a lock
+		const AnalysisSnapshot& serviceSnapshot = analysis.acquireSnapshot();
+		Move engineMove = useEngine ? pollEngine(engine, engineSearch, engineSnapshot) : NO_MOVE;
+		const AnalysisSnapshot& snapshot = useEngine ? engineSnapshot : serviceSnapshot;
+		if (engineGame && engineMove != NO_MOVE) {
+			analysisRoot.makeMove(engineMove);
+			playOnFirstBoard(simulation, analysisRoot, engineMove, boardFens);
+			MoveList replies;
+			generateLegalMoves(analysisRoot, replies);
+			if (replies.size() > 0 && !analysisRoot.isRepetition() && analysisRoot.halfmoveClock() < 100) {
+				std::string limits = "movetime " + std::to_string(options.engineMovetimeMs);
+				engineSearch = engine.go(analysisRoot, limits.c_str());
+				engineSnapshot = AnalysisSnapshot();
+				engineSnapshot.searching = true;
+			} else {
+				printf("Engine game over: %s\n", analysisRoot.fen().c_str());
+				engineGame = false;
+			}
+		}
+		if (analysisRunning && !snapshot.searching && !useEngine) {
+			printf("Analysis stopped %.2f ms after the request\n", snapshot.stopLatencyMs);
+		}
+		analysisRunning = snapshot.searching;
+		if (snapshot.fromBook && snapshot.request != printedBookRequest) {
+			printf("Book move %s\n", moveToUci(snapshot.bestMove()).c_str());
+			printedBookRequest = snapshot.request;
+		}
 		nbFrames++;
 		if (currentTime - lastTime >= 1.0) {
-			printf("%f ms/frame\n", 1000.0/double(nbFrames));
+			LatencyStats latency = takeLatencyStats();
+			printf("%f ms/frame, input-to-present %.2f ms avg / %.2f ms max (%d frames), %d shadow layers redrawn\n",
+				   1000.0/double(nbFrames), latency.avgMs, latency.maxMs, latency.samples, shadowLayers);
+			if (snapshot.searching) {
+				printAnalysis(snapshot);
+			}
+			if (useEngine) {
+				printf("Engine: %llu lines read, %llu updates dropped\n", (unsigned long long)engine.lineCount(),
+					   (unsigned long long)engine.droppedCount());
+			}
 			nbFrames = 0;
+			shadowLayers = 0;
 			lastTime += 1.0;
 		}
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		computeMatricesFromInputs();
-
-	    glm::mat4 ProjectionMatrix = getProjectionMatrix();
-	    glm::mat4 ViewMatrix = getViewMatrix();
-
-	    glUseProgram(programID);
-
-	    glm::vec3 lightPos = glm::vec3(0, 25, 0);
-	    glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
-	    glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-	    glUniform1i(lightEnableID, lightEnabled);
-
-	    glm::mat4 ModelMatrix = glm::mat4(1.0);
-	    ModelMatrix = glm::rotate(ModelMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-	    ModelMatrix = glm::translate(ModelMatrix, glm::vec3(0.0f, 0.0f, 0.5f));
-
-	    glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-	    glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	    glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-
-	    // Bind texture
-	    glActiveTexture(GL_TEXTURE0);
-	    glBindTexture(GL_TEXTURE_2D, boardTexture);
-	    glUniform1i(TextureID, 0);
-
-	    // Set up vertex attributes
-	    glEnableVertexAttribArray(0);
-	    glBindBuffer(GL_ARRAY_BUFFER, boardVertexbuffer);
-	    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	    glEnableVertexAttribArray(1);
-	    glBindBuffer(GL_ARRAY_BUFFER, boardUvbuffer);
-	    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	    glEnableVertexAttribArray(2);
-	    glBindBuffer(GL_ARRAY_BUFFER, boardNormalbuffer);
-	    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	    // Draw board
-	    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boardElementbuffer);
-	    glDrawElements(GL_TRIANGLES, boardIndices.size(), GL_UNSIGNED_SHORT, (void*)0);
-
-		float spacing = 5.5f;
-
-	    // Reset all piece matrices
-	    for (ChessPiece& piece : chessPieces) {
-	        piece.ModelMatrix = glm::mat4(1.0f);
-	    }
-
-	    // Pawn
-		for (int col = 0; col < 8; col++)
-		{
-			chessPieces[5].ModelMatrix = glm::mat4(1.0f);
-	        chessPieces[5].ModelMatrix = glm::translate(chessPieces[5].ModelMatrix, glm::vec3((col - 1) * spacing, 0.0f, 30.0f));
-			chessPieces[5].ModelMatrix = glm::translate(chessPieces[5].ModelMatrix, glm::vec3(-27.3f, 0.0f, 0.0f));
-
-	        chessPieces[5].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		// Deliver input to the simulation thread, then take the newest packet
+		// as late as possible, right before the first draw call
+		glfwPollEvents();
+		const FramePacket& packet = simulation.acquireFrame();
+		scene.draw(packet);
+		shadowLayers += scene.shadowLayersDrawn();
+
+		MoveArrow arrowList[2 + 32];
+		int arrowCount = analysisArrows(snapshot, arrowList);
+		if (selectedSquare >= 0) {
+			arrowCount += selectionArrows(analysisRoot, selectedSquare, arrowList + arrowCount, 32);
+		}
+		arrows.draw(packet, arrowList, arrowCount, analysisBoardOffset);
+
+		frameIndex++;
+		PickResult pick;
+		while (picker.poll(pick)) {
+			if (!pick.hit()) {
+				selectedSquare = -1;
+				continue;
+			}
+			printf("Picked %s %c%d on board %d, %lld frames after the click\n", pick.piece ? "piece on" : "square",
+				   'a' + squareFile(pick.square64), 1 + squareRank(pick.square64), pick.board, frameIndex - pick.request);
+			if (pick.board != 0 || !autoplayBoards.empty() || engineGame) {
+				continue;
+			}
+			Move move = selectedSquare >= 0 ? findClickedMove(analysisRoot, selectedSquare, pick.square64) : NO_MOVE;
+			if (move != NO_MOVE) {
+				if (useEngine && snapshot.searching) {
+					engine.stop();
+				} else if (!useEngine) {
+					analysis.stop();
+				}
+				analysisRoot.makeMove(move);
+				playOnFirstBoard(simulation, analysisRoot, move, boardFens);
+				printf("Played %s: %s\n", moveToUci(move).c_str(), boardFens[0].c_str());
+				selectedSquare = -1;
+			} else {
+				int piece = analysisRoot.pieceOn(pick.square64);
+				bool own = piece != NO_PIECE && pieceColor(piece) == analysisRoot.sideToMove();
+				selectedSquare = own ? pick.square64 : -1;
+			}
+		}
+		double clickX, clickY;
+		if (takeButtonPresses(GLFW_MOUSE_BUTTON_LEFT, &clickX, &clickY) > 0) {
+			int windowWidth, windowHeight;
+			glfwGetWindowSize(window, &windowWidth, &windowHeight);
+			glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+			if (!freeCursor) {
+				clickX = 0.5 * windowWidth;
+				clickY = 0.5 * windowHeight;
+			}
+			// Window coordinates differ from pixels on high-DPI displays
+			int x = windowWidth > 0 ? (int)(clickX * framebufferWidth / windowWidth) : 0;
+			int y = windowHeight > 0 ? (int)(clickY * framebufferHeight / windowHeight) : 0;
+			if (picker.begin(framebufferWidth, framebufferHeight, x, y)) {
+				scene.drawIds(packet);
+				picker.end(frameIndex);
+			}
 		}
-		// Knight
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[3].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[3].ModelMatrix = glm::translate(chessPieces[3].ModelMatrix, glm::vec3((i-1) * spacing * 5, 0.0f, 25.0f));
-			chessPieces[3].ModelMatrix = glm::translate(chessPieces[3].ModelMatrix, glm::vec3(22.0f, 0.0f, 0.0f));
-
-			chessPieces[3].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		if (takeKeyPresses(GLFW_KEY_C) % 2 != 0) {
+			freeCursor = !freeCursor;
+			glfwSetInputMode(window, GLFW_CURSOR, freeCursor ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+			setMouseLook(!freeCursor);
 		}
 
-		// Bishop
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[1].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[1].ModelMatrix = glm::translate(chessPieces[1].ModelMatrix, glm::vec3((i-1) * spacing * 3, 0.0f, 25.0f));
-			chessPieces[1].ModelMatrix = glm::translate(chessPieces[1].ModelMatrix, glm::vec3(11.5f, 0.0f, 0.0f));
-			chessPieces[1].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		if (useEngine && takeKeyPresses(GLFW_KEY_G) % 2 != 0) {
+			if (snapshot.searching) {
+				engine.stop();
+				engineGame = false;
+			} else {
+				engineSearch = engine.go(analysisRoot, "infinite");
+				engineSnapshot = AnalysisSnapshot();
+				engineSnapshot.searching = true;
+			}
 		}
-		// Rook
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[11].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[11].ModelMatrix = glm::translate(chessPieces[11].ModelMatrix, glm::vec3((i-1) * spacing * 7, 0.0f, 25.0f));
-			chessPieces[11].ModelMatrix = glm::translate(chessPieces[11].ModelMatrix, glm::vec3(34.0f, 0.0f, 0.0f));
-
-			chessPieces[11].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		if (useEngine && takeKeyPresses(GLFW_KEY_P) % 2 != 0) {
+			engineGame = !engineGame;
+			if (engineGame && snapshot.searching) {
+				// The running analysis ends and its best move is played
+				engine.stop();
+			} else if (engineGame) {
+				std::string limits = "movetime " + std::to_string(options.engineMovetimeMs);
+				engineSearch = engine.go(analysisRoot, limits.c_str());
+				engineSnapshot = AnalysisSnapshot();
+				engineSnapshot.searching = true;
+			}
 		}
-		// King
-		chessPieces[9].ModelMatrix = glm::mat4(1.0f);
-		chessPieces[9].ModelMatrix = glm::translate(chessPieces[9].ModelMatrix, glm::vec3(0.0f, 0.0f, 25.0f));
-
-		chessPieces[9].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
-		// Queen
-		chessPieces[7].ModelMatrix = glm::mat4(1.0f);
-		chessPieces[7].ModelMatrix = glm::translate(chessPieces[7].ModelMatrix, glm::vec3(0.0f, 0.0f, 25.0f));
-		chessPieces[7].ModelMatrix = glm::translate(chessPieces[7].ModelMatrix, glm::vec3(-11.0f, 0.0f, 0.0f));
-		chessPieces[7].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
-
-
-	    // Setup black pieces
-	    float currentX = 5.0f;
-
-	    // Pawn
-		for (int col = 0; col < 8; col++)
-		{
-			chessPieces[4].ModelMatrix = glm::mat4(1.0f);
-	        chessPieces[4].ModelMatrix = glm::translate(chessPieces[4].ModelMatrix, glm::vec3(currentX + (col - 1) * spacing, 0.0f, 45.0f));
-			chessPieces[4].ModelMatrix = glm::translate(chessPieces[4].ModelMatrix, glm::vec3(-32.0f, 0.0f, 0.0f));
-
-	        chessPieces[4].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		if (!useEngine && takeKeyPresses(GLFW_KEY_G) % 2 != 0) {
+			if (snapshot.searching || snapshot.fromBook) {
+				analysis.stop();
+			} else {
+				analysis.analyze(analysisRoot);
+			}
+		}
+		if (!useEngine && takeKeyPresses(GLFW_KEY_H) > 0 && snapshot.searching && !snapshot.pondering &&
+			snapshot.bestMove() != NO_MOVE) {
+			analysis.ponder(analysisRoot, snapshot.bestMove());
+		}
+
+		if (!autoplayBoards.empty() && currentTime >= nextAutoplay) {
+			autoplayStep(simulation, replayStore, autoplayBoards, analysisRoot);
+			nextAutoplay = std::max(nextAutoplay + 1.0 / options.autoplayRate, currentTime);
 		}
-		// Knight
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[2].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[2].ModelMatrix = glm::translate(chessPieces[2].ModelMatrix, glm::vec3((i-1) * spacing * 5, 0.0f, 0.0f));
-			chessPieces[2].ModelMatrix = glm::translate(chessPieces[2].ModelMatrix, glm::vec3(5.3f, 0.0f, 0.0f));
-			chessPieces[2].ModelMatrix = glm::translate(chessPieces[2].ModelMatrix, glm::vec3(0.0f, 0.0f, -12.0f));
-			chessPieces[2].ModelMatrix = glm::rotate(chessPieces[2].ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-			chessPieces[2].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+
+		int plySteps = takeKeyPresses(GLFW_KEY_RIGHT) - takeKeyPresses(GLFW_KEY_LEFT);
+		int gameSteps = takeKeyPresses(GLFW_KEY_PAGE_DOWN) - takeKeyPresses(GLFW_KEY_PAGE_UP);
+		Position replayStart;
+		std::vector<Move> replayMoves;
+		if (autoplayBoards.empty() && plySteps == 1 && gameSteps == 0 &&
+			replayStore.moves(replayGame, replayStart, replayMoves) && replayPly < (int)replayMoves.size()) {
+			// A single step forward is animated; anything else jumps
+			Move move = replayMoves[replayPly++];
+			analysis.stop();
+			analysisRoot.makeMove(move);
+			playOnFirstBoard(simulation, analysisRoot, move, boardFens);
+			printf("Game %llu, ply %d/%d: %s\n", (unsigned long long)replayGame, replayPly, (int)replayMoves.size(),
+				   boardFens[0].c_str());
+			if (positionIndex.isOpen()) {
+				printPositionGames(positionIndex, replayStore, analysisRoot, replayGame);
+			}
+		} else if (autoplayBoards.empty() && replayStore.gameCount() > 0 && (plySteps != 0 || gameSteps != 0)) {
+			if (gameSteps != 0) {
+				long long game = (long long)replayGame + gameSteps;
+				long long games = (long long)replayStore.gameCount();
+				replayGame = (uint64_t)(((game % games) + games) % games);
+				replayPly = 0;
+			}
+			replayPly = std::max(0, std::min(replayStore.plyCount(replayGame), replayPly + plySteps));
+			analysis.stop();
+			if (showStoredPly(simulation, replayStore, replayGame, replayPly, boardFens, analysisRoot) &&
+				positionIndex.isOpen()) {
+				printPositionGames(positionIndex, replayStore, analysisRoot, replayGame);
+			}
 		}
-		// Bishop
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[0].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[0].ModelMatrix = glm::translate(chessPieces[0].ModelMatrix, glm::vec3((i-1) * spacing * 3, 0.0f, 0.0f));
-			chessPieces[0].ModelMatrix = glm::translate(chessPieces[0].ModelMatrix, glm::vec3(5.3f, 0.0f, 0.0f));
-			chessPieces[0].ModelMatrix = glm::translate(chessPieces[0].ModelMatrix, glm::vec3(0.0f, 0.0f, -12.0f));
-			chessPieces[0].ModelMatrix = glm::rotate(chessPieces[0].ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-			chessPieces[0].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+
+		if (takeKeyPresses(GLFW_KEY_R) % 2 != 0) {
+			if (capture.recording()) {
+				capture.stop();
+			} else {
+				startRecording(capture, recordPath ? recordPath : "capture.y4m");
+			}
 		}
-		// Rook
-		for (int i = 0; i <=1; i++)
-		{
-			chessPieces[10].ModelMatrix = glm::mat4(1.0f);
-			chessPieces[10].ModelMatrix = glm::translate(chessPieces[10].ModelMatrix, glm::vec3((i-1) * spacing * 7, 0.0f, 0.0f));
-			chessPieces[10].ModelMatrix = glm::translate(chessPieces[10].ModelMatrix, glm::vec3(5.3f, 0.0f, 0.0f));
-			chessPieces[10].ModelMatrix = glm::translate(chessPieces[10].ModelMatrix, glm::vec3(0.0f, 0.0f, -12.0f));
-			chessPieces[10].ModelMatrix = glm::rotate(chessPieces[10].ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-			chessPieces[10].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
+		if (capture.recording()) {
+			glReadBuffer(GL_BACK);
+			capture.captureFrame();
 		}
-		// King
-		chessPieces[8].ModelMatrix = glm::mat4(1.0f);
-		chessPieces[8].ModelMatrix = glm::translate(chessPieces[8].ModelMatrix, glm::vec3(5.3f, 0.0f, 0.0f));
-		chessPieces[8].ModelMatrix = glm::translate(chessPieces[8].ModelMatrix, glm::vec3(0.0f, 0.0f, -12.0f));
-		chessPieces[8].ModelMatrix = glm::rotate(chessPieces[8].ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		chessPieces[8].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
-		// Queen
-		chessPieces[6].ModelMatrix = glm::mat4(1.0f);
-		chessPieces[6].ModelMatrix = glm::translate(chessPieces[6].ModelMatrix, glm::vec3(5.3f, 0.0f, 0.0f));
-		chessPieces[6].ModelMatrix = glm::translate(chessPieces[6].ModelMatrix, glm::vec3(0.0f, 0.0f, -12.0f));
-		chessPieces[6].ModelMatrix = glm::rotate(chessPieces[6].ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		chessPieces[6].render(programID, MatrixID, ViewMatrixID, ModelMatrixID,
-	                          ProjectionMatrix, ViewMatrix);
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
 
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		if (packet.frameNumber != lastPresentedPacket) {
+			recordPresent(packet.inputTime);
+			lastPresentedPacket = packet.frameNumber;
+		}
 	} // Check if the ESC key was pressed or the window was closed
-	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
-		   glfwWindowShouldClose(window) == 0 );
+	while( glfwWindowShouldClose(window) == 0 );
 
-	glDeleteBuffers(1, &boardVertexbuffer);
-	glDeleteBuffers(1, &boardUvbuffer);
-	glDeleteBuffers(1, &boardNormalbuffer);
-	glDeleteBuffers(1, &boardElementbuffer);
-	glDeleteProgram(programID);
-	glDeleteTextures(1, &boardTexture);
-	glDeleteVertexArrays(1, &VertexArrayID);
+	printGpuMemoryReport();
+	capture.stop();
+	analysis.stop();
+	engine.quit();
+	simulation.stop();
+	picker.release();
+	arrows.release();
+	scene.release();
 
 	glfwTerminate();
 }
 
-int main() {
-	render();
+int main(int argc, char** argv) {
+	RenderOptions options;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			options.recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--boards") == 0 && i + 1 < argc) {
+			options.boardCount = atoi(argv[++i]);
+			if (options.boardCount < 1) {
+				options.boardCount = 1;
+			}
+		} else if (strcmp(argv[i], "--fens") == 0 && i + 1 < argc) {
+			if (!readFenFile(argv[++i], options.fens)) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--scaling-bench") == 0) {
+			options.scalingBench = true;
+		} else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc) {
+			options.bookPath = argv[++i];
+		} else if (strcmp(argv[i], "--randoms") == 0 && i + 1 < argc) {
+			options.randomsPath = argv[++i];
+		} else if (strcmp(argv[i], "--tb") == 0 && i + 1 < argc) {
+			options.tablebasePath = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			options.replayPath = argv[++i];
+		} else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+			options.replayGame = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+			options.indexPath = argv[++i];
+		} else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+			options.weightsPath = argv[++i];
+		} else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+			options.engineCommand = argv[++i];
+		} else if (strcmp(argv[i], "--engine-movetime") == 0 && i + 1 < argc) {
+			options.engineMovetimeMs = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--autoplay") == 0 && i + 1 < argc) {
+			options.autoplayRate = std::max(0.0, atof(argv[++i]));
+		} else if (strcmp(argv[i], "--shadows") == 0 && i + 1 < argc) {
+			const char* mode = argv[++i];
+			options.shadows = strcmp(mode, "off") != 0;
+			options.shadowCaching = strcmp(mode, "uncached") != 0;
+		} else if (strcmp(argv[i], "--lamps") == 0 && i + 1 < argc) {
+			options.lampCount = std::max(0, std::min(MAX_POINT_LIGHTS, atoi(argv[++i])));
+		} else if (strcmp(argv[i], "--normal-map") == 0 && i + 1 < argc) {
+			options.normalMapping = strcmp(argv[++i], "off") != 0;
+		} else if (strcmp(argv[i], "--lightmap") == 0 && i + 1 < argc) {
+			const char* lightmap = argv[++i];
+			options.bakedLighting = strcmp(lightmap, "off") != 0;
+			options.lightmapPath = options.bakedLighting ? lightmap : NULL;
+		}
+	}
+	render(options);
 	return 0;
 }
\ No newline at end of file
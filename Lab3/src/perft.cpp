@@ -0,0 +1,203 @@
+/*
+Description:
+Move generator benchmark and correctness check. Counts the leaf nodes of the
+legal move tree for a set of reference positions, compares them with the known
+totals and reports nodes per second. Exits non-zero on any mismatch, so it can
+guard move generation changes. With --hash, subtrees already counted are taken
+from the transposition table, and the suite reports the speedup over plain perft.
+
+Usage: perft [options]
+  --depth N    maximum depth for the reference suite (default 5)
+  --fen FEN    count a single position instead of the suite
+  --divide     with --fen, print the node count below each root move
+  --hash MB    also run hashed perft with a table of this size
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <common/movegen.hpp>
+#include <common/tt.hpp>
+
+namespace {
+    /**
+     * @brief Reference position with known perft totals for depths 1..6
+     */
+    struct PerftCase {
+        const char* name;
+        const char* fen;
+        unsigned long long nodes[6]; ///< 0 where no reference total is listed
+    };
+
+    const PerftCase SUITE[] = {
+        { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+          { 20, 400, 8902, 197281, 4865609, 119060324 } },
+        { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+          { 48, 2039, 97862, 4085603, 193690690, 0 } },
+        { "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+          { 14, 191, 2812, 43238, 674624, 11030083 } },
+        { "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+          { 6, 264, 9467, 422333, 15833292, 0 } },
+        { "discovered", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+          { 44, 1486, 62379, 2103487, 89941194, 0 } },
+        { "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+          { 46, 2079, 89890, 3894594, 164075551, 0 } },
+    };
+
+    /**
+     * @brief Perft that caches subtree counts by Zobrist key and depth
+     */
+    unsigned long long perftHashed(Position& position, int depth, TranspositionTable& table) {
+        if (depth <= 1) {
+            return perft(position, depth);
+        }
+        uint64_t cached;
+        if (table.probeCount(position.key(), depth, cached)) {
+            return cached;
+        }
+
+        MoveList list;
+        generateLegalMoves(position, list);
+        unsigned long long nodes = 0;
+        for (int i = 0; i < list.size(); i++) {
+            position.makeMove(list[i]);
+            nodes += perftHashed(position, depth - 1, table);
+            position.unmakeMove();
+        }
+        table.storeCount(position.key(), depth, nodes);
+        return nodes;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void printUsage() {
+        fprintf(stderr, "Usage: perft [--depth N] [--fen FEN [--divide]] [--hash MB]\n");
+    }
+
+    int runSingle(const char* fen, int depth, bool divide, TranspositionTable* table) {
+        Position position;
+        if (!position.setFromFen(fen)) {
+            fprintf(stderr, "Error: Invalid FEN: %s\n", fen);
+            return 1;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned long long nodes = 0;
+        if (divide && depth > 0) {
+            MoveList list;
+            generateLegalMoves(position, list);
+            for (int i = 0; i < list.size(); i++) {
+                position.makeMove(list[i]);
+                unsigned long long count = perft(position, depth - 1);
+                position.unmakeMove();
+                printf("%s: %llu\n", moveToUci(list[i]).c_str(), count);
+                nodes += count;
+            }
+        } else if (table) {
+            nodes = perftHashed(position, depth, *table);
+        } else {
+            nodes = perft(position, depth);
+        }
+        double elapsed = secondsSince(start);
+        printf("depth %d: %llu nodes in %.3f s (%.1f Mnps)\n",
+               depth, nodes, elapsed, elapsed > 0.0 ? nodes / elapsed / 1e6 : 0.0);
+        return 0;
+    }
+
+    int runSuite(int maxDepth, TranspositionTable* table) {
+        unsigned long long totalNodes = 0;
+        double totalTime = 0.0;
+        double totalHashedTime = 0.0;
+        int failures = 0;
+
+        printf("%-12s %5s %12s %10s %10s", "position", "depth", "nodes", "seconds", "Mnps");
+        printf(table ? " %10s %8s\n" : "\n", "hashed s", "speedup");
+        for (size_t i = 0; i < sizeof(SUITE) / sizeof(SUITE[0]); i++) {
+            const PerftCase& test = SUITE[i];
+            int depth = maxDepth < 6 ? maxDepth : 6;
+            while (depth > 1 && test.nodes[depth - 1] == 0) {
+                depth--;
+            }
+
+            Position position;
+            position.setFromFen(test.fen);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            unsigned long long nodes = perft(position, depth);
+            double elapsed = secondsSince(start);
+
+            bool ok = nodes == test.nodes[depth - 1];
+            printf("%-12s %5d %12llu %10.3f %10.1f", test.name, depth, nodes, elapsed,
+                   elapsed > 0.0 ? nodes / elapsed / 1e6 : 0.0);
+            if (table) {
+                table->clear();
+                start = std::chrono::steady_clock::now();
+                unsigned long long hashedNodes = perftHashed(position, depth, *table);
+                double hashedTime = secondsSince(start);
+                ok = ok && hashedNodes == nodes;
+                printf(" %10.3f %7.1fx", hashedTime, hashedTime > 0.0 ? elapsed / hashedTime : 0.0);
+                totalHashedTime += hashedTime;
+            }
+            printf("%s\n", ok ? "" : "  MISMATCH");
+            if (!ok) {
+                fprintf(stderr, "%s: expected %llu nodes at depth %d\n", test.name, test.nodes[depth - 1], depth);
+                failures++;
+            }
+            totalNodes += nodes;
+            totalTime += elapsed;
+        }
+
+        printf("total: %llu nodes in %.3f s (%.1f Mnps)\n", totalNodes, totalTime,
+               totalTime > 0.0 ? totalNodes / totalTime / 1e6 : 0.0);
+        if (table) {
+            printf("hashed: %.3f s (%.1fx)\n", totalHashedTime,
+                   totalHashedTime > 0.0 ? totalTime / totalHashedTime : 0.0);
+        }
+        return failures > 0 ? 1 : 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    int depth = 5;
+    const char* fen = NULL;
+    bool divide = false;
+    int hashMegabytes = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--depth") == 0 && hasValue) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fen") == 0 && hasValue) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--divide") == 0) {
+            divide = true;
+        } else if (strcmp(argv[i], "--hash") == 0 && hasValue) {
+            hashMegabytes = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (depth < 1) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    TranspositionTable table;
+    if (hashMegabytes > 0) {
+        if (!table.resize(hashMegabytes)) {
+            fprintf(stderr, "Error: Could not allocate a %d MB hash table\n", hashMegabytes);
+            return 1;
+        }
+        printf("Hash table: %zu MB", table.sizeBytes() >> 20);
+        if (table.hugePagesRequested()) {
+            printf(", huge pages requested, %zu MB backed by them", table.hugePageBytes() >> 20);
+        }
+        printf("\n");
+    }
+    TranspositionTable* hashed = hashMegabytes > 0 ? &table : NULL;
+    return fen ? runSingle(fen, depth, divide, hashed) : runSuite(depth, hashed);
+}
@@ -0,0 +1,277 @@
+/*
+Description:
+Tablebase generation and batch probing. Generates pawnless tables, prints the
+WDL, DTZ and best move of single positions, and probes a batch of positions
+from several threads at once to measure probes per second and show how the
+mapped file cache behaves.
+
+Usage: tbprobe --path DIR [options]
+  --generate SIG     generate the tables of SIG (e.g. KRvK) and its captures
+  --fen FEN          print the result of one position
+  --fens FILE        batch-probe the positions in FILE, one FEN per line
+  --random SIG N     batch-probe N random legal positions of SIG instead
+  --threads LIST     comma separated probing thread counts (default 1,2,4)
+  --repeat N         passes over the batch per thread (default 10)
+  --max-mapped N     files kept mapped at once (default 8)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <common/movegen.hpp>
+#include <common/tablebase.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: tbprobe --path DIR [--generate SIG] [--fen FEN] [--fens FILE | --random SIG N]\n"
+                        "               [--threads LIST] [--repeat N] [--max-mapped N]\n");
+    }
+
+    const char* wdlName(int wdl) {
+        return wdl == WDL_WIN ? "win" : wdl == WDL_LOSS ? "loss" : "draw";
+    }
+
+    /**
+     * @brief Move that keeps the best result fastest: the quickest zeroing
+     * win, or the slowest loss
+     */
+    Move bestTablebaseMove(Tablebases& tablebases, Position& position) {
+        MoveList list;
+        generateLegalMoves(position, list);
+        Move best = NO_MOVE;
+        int bestRank = -1000;
+        for (int i = 0; i < list.size(); i++) {
+            position.makeMove(list[i]);
+            int wdl;
+            int dtz;
+            bool found = tablebases.probeWdl(position, wdl) && tablebases.probeDtz(position, dtz);
+            bool mates = found && position.inCheck() && wdl == WDL_LOSS && dtz == 0;
+            position.unmakeMove();
+            if (!found) {
+                continue;
+            }
+            // From our side: the opponent losing is our win. Captures and mates zero the counter.
+            int rank;
+            if (-wdl == WDL_WIN) {
+                rank = mates ? 600 : isCapture(list[i]) ? 500 : 500 - (-dtz);
+            } else if (-wdl == WDL_DRAW) {
+                rank = 0;
+            } else {
+                rank = -500 + (isCapture(list[i]) ? 0 : dtz);
+            }
+            if (rank > bestRank) {
+                bestRank = rank;
+                best = list[i];
+            }
+        }
+        return best;
+    }
+
+    std::vector<std::string> readFens(const char* path) {
+        std::vector<std::string> fens;
+        std::ifstream file(path);
+        if (!file) {
+            fprintf(stderr, "Could not open %s\n", path);
+            return fens;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line[line.size() - 1] == '\r') {
+                line.erase(line.size() - 1);
+            }
+            if (!line.empty() && line[0] != '#') {
+                fens.push_back(line);
+            }
+        }
+        return fens;
+    }
+
+    /**
+     * @brief Random legal positions of a material signature, stronger side as white
+     */
+    std::vector<std::string> randomPositions(const std::string& signature, int count) {
+        std::vector<std::string> fens;
+        std::vector<int> pieces;
+        int color = WHITE;
+        for (size_t i = 0; i < signature.size(); i++) {
+            const char* letter = strchr("PNBRQK", signature[i]);
+            if (signature[i] == 'v') {
+                color = BLACK;
+            } else if (letter && *letter) {
+                pieces.push_back(makePiece(color, (int)(letter - "PNBRQK")));
+            }
+        }
+        std::mt19937 random(1);
+        std::vector<int> squares(pieces.size());
+        Position position;
+        for (int attempts = 0; (int)fens.size() < count && attempts < count * 100; attempts++) {
+            for (size_t i = 0; i < squares.size(); i++) {
+                squares[i] = (int)(random() % 64);
+            }
+            if (position.setFromPieces(&pieces[0], &squares[0], (int)pieces.size(), (int)(random() % 2))) {
+                fens.push_back(position.fen());
+            }
+        }
+        return fens;
+    }
+
+    struct BatchResult {
+        uint64_t probes;
+        uint64_t found;
+        int results[3];
+    };
+
+    void probeBatch(Tablebases& tablebases, const std::vector<Position>* positions, int repeat,
+                    BatchResult* result) {
+        BatchResult local = { 0, 0, { 0, 0, 0 } };
+        for (int pass = 0; pass < repeat; pass++) {
+            for (size_t i = 0; i < positions->size(); i++) {
+                int wdl;
+                local.probes++;
+                if (tablebases.probeWdl((*positions)[i], wdl)) {
+                    local.found++;
+                    local.results[wdl + 1]++;
+                }
+            }
+        }
+        *result = local;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+    std::vector<std::string> generate;
+    const char* fen = NULL;
+    const char* fenFile = NULL;
+    std::string randomSignature;
+    int randomCount = 0;
+    std::vector<int> threadCounts;
+    int repeat = 10;
+    int maxMapped = 8;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--path") == 0 && hasValue) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--generate") == 0 && hasValue) {
+            generate.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--fen") == 0 && hasValue) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--fens") == 0 && hasValue) {
+            fenFile = argv[++i];
+        } else if (strcmp(argv[i], "--random") == 0 && i + 2 < argc) {
+            randomSignature = argv[++i];
+            randomCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            for (const char* c = argv[++i]; *c; ) {
+                int count = atoi(c);
+                if (count > 0) {
+                    threadCounts.push_back(count);
+                }
+                while (*c && *c != ',') c++;
+                if (*c == ',') c++;
+            }
+        } else if (strcmp(argv[i], "--repeat") == 0 && hasValue) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-mapped") == 0 && hasValue) {
+            maxMapped = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (!path || repeat < 1) {
+        printUsage();
+        return 1;
+    }
+    if (threadCounts.empty()) {
+        threadCounts.push_back(1);
+        threadCounts.push_back(2);
+        threadCounts.push_back(4);
+    }
+
+    initBitboards();
+    for (size_t i = 0; i < generate.size(); i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!generateTablebase(path, generate[i].c_str())) {
+            return 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Generated %s in %.1f s\n", generate[i].c_str(), seconds);
+    }
+
+    Tablebases tablebases;
+    tablebases.setPath(path, maxMapped);
+
+    if (fen) {
+        Position position;
+        if (!position.setFromFen(fen)) {
+            fprintf(stderr, "Error: Invalid FEN %s\n", fen);
+            return 1;
+        }
+        int wdl;
+        int dtz;
+        if (!tablebases.probeWdl(position, wdl) || !tablebases.probeDtz(position, dtz)) {
+            printf("%s: not in the tablebases\n", fen);
+            return 1;
+        }
+        Move best = bestTablebaseMove(tablebases, position);
+        printf("%s: %s, dtz %d, best move %s\n", fen, wdlName(wdl), dtz,
+               best != NO_MOVE ? moveToUci(best).c_str() : "none");
+    }
+
+    std::vector<std::string> fens;
+    if (fenFile) {
+        fens = readFens(fenFile);
+    } else if (!randomSignature.empty()) {
+        fens = randomPositions(randomSignature, randomCount);
+    }
+    if (fens.empty()) {
+        return 0;
+    }
+    std::vector<Position> positions;
+    for (size_t i = 0; i < fens.size(); i++) {
+        Position position;
+        if (position.setFromFen(fens[i].c_str())) {
+            positions.push_back(position);
+        }
+    }
+
+    printf("%zu positions, %d passes per thread, at most %d files mapped\n", positions.size(), repeat, maxMapped);
+    printf("%8s %12s %12s %14s %8s %8s %8s\n", "threads", "probes", "found", "probes/s", "wins", "draws", "losses");
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+        int threads = threadCounts[t];
+        std::vector<BatchResult> results(threads);
+        std::vector<std::thread> workers;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 1; i < threads; i++) {
+            workers.push_back(std::thread(probeBatch, std::ref(tablebases), &positions, repeat, &results[i]));
+        }
+        probeBatch(tablebases, &positions, repeat, &results[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        BatchResult total = { 0, 0, { 0, 0, 0 } };
+        for (int i = 0; i < threads; i++) {
+            total.probes += results[i].probes;
+            total.found += results[i].found;
+            for (int r = 0; r < 3; r++) {
+                total.results[r] += results[i].results[r];
+            }
+        }
+        printf("%8d %12llu %12llu %14.0f %8d %8d %8d\n", threads, (unsigned long long)total.probes,
+               (unsigned long long)total.found, seconds > 0.0 ? total.probes / seconds : 0.0,
+               total.results[2], total.results[1], total.results[0]);
+    }
+    printf("%llu files mapped, %llu evicted\n", (unsigned long long)tablebases.mapCount(),
+           (unsigned long long)tablebases.evictionCount());
+    return 0;
+}
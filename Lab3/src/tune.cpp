@@ -0,0 +1,117 @@
+/*
+Description:
+Evaluation tuner. Loads quiet positions labelled with their game results from
+a PGN file or a game store and fits the hand-written evaluation weights to
+them with Adam, reporting the loss and positions per second every epoch. The
+tuned weights are written as text and can be loaded by the viewer and the
+annotator with --weights.
+
+Usage: tune FILE [options]
+  --threads N      loading and evaluation threads (default: hardware threads)
+  --positions N    positions kept at most (default: all)
+  --epochs N       full passes over the positions (default 200)
+  --rate R         Adam step size in centipawns (default 1)
+  --start FILE     weights to start from instead of the built-in ones
+  --out FILE       where to write the tuned weights (default tuned.weights)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <common/tuner.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: tune FILE.pgn|FILE.cgs [--threads N] [--positions N] [--epochs N] [--rate R] "
+                        "[--start FILE] [--out FILE]\n");
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    int threads = (int)std::thread::hardware_concurrency();
+    size_t maxPositions = 0;
+    int epochs = 200;
+    double rate = 1.0;
+    const char* startPath = NULL;
+    const char* outPath = "tuned.weights";
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--positions") == 0 && i + 1 < argc) {
+            maxPositions = (size_t)atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--epochs") == 0 && i + 1 < argc) {
+            epochs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            startPath = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    threads = threads > 0 ? threads : 1;
+    initBitboards();
+    if (startPath && !loadEvalWeights(startPath, evalWeights())) {
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    TuningData data;
+    if (!loadTuningData(argv[1], threads, maxPositions, data)) {
+        return 1;
+    }
+    if (data.size() == 0) {
+        fprintf(stderr, "Error: %s has no quiet positions from finished games\n", argv[1]);
+        return 1;
+    }
+    printf("Loaded %zu positions in %.2f s on %zu threads, %.1f MB\n", data.size(), secondsSince(start),
+           data.chunks.size(), data.memoryBytes() / (1024.0 * 1024.0));
+
+    EvalTuner tuner(data);
+    start = std::chrono::steady_clock::now();
+    double scale = tuner.fitScale();
+    printf("Sigmoid scale %.3f, loss %.6f (%.2f s)\n", scale, tuner.loss(), secondsSince(start));
+
+    printf("%8s %12s %10s %14s\n", "epoch", "loss", "ms", "positions/s");
+    double totalSeconds = 0.0;
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        start = std::chrono::steady_clock::now();
+        double loss = tuner.step(rate);
+        double seconds = secondsSince(start);
+        totalSeconds += seconds;
+        if (epoch == 1 || epoch % 10 == 0 || epoch == epochs) {
+            printf("%8d %12.6f %10.1f %14.0f\n", epoch, loss, seconds * 1000.0, seconds > 0.0 ? data.size() / seconds : 0.0);
+        }
+    }
+    printf("Final loss %.6f; %.0f positions/s per epoch on average\n", tuner.loss(),
+           totalSeconds > 0.0 ? data.size() * (double)epochs / totalSeconds : 0.0);
+
+    EvalWeights tuned = tuner.weights();
+    printf("Material mg:");
+    for (int type = PAWN; type <= QUEEN; type++) {
+        printf(" %d", tuned.material[MIDGAME][type]);
+    }
+    printf(", eg:");
+    for (int type = PAWN; type <= QUEEN; type++) {
+        printf(" %d", tuned.material[ENDGAME][type]);
+    }
+    printf(", bishop pair %d/%d, tempo %d\n", tuned.bishopPair[MIDGAME], tuned.bishopPair[ENDGAME], tuned.tempo);
+    if (!saveEvalWeights(outPath, tuned)) {
+        return 1;
+    }
+    printf("Wrote %s\n", outPath);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+Description:
+Measures what an external UCI engine costs the render loop. The engine
+searches one position while this program polls its updates once per
+simulated frame, exactly as the viewer does, and reports how long the polls
+took, how many lines the engine printed and how many updates were dropped.
+
+Usage: ucibench "ENGINE COMMAND" [options]
+  --fen FEN        position to search (default: the starting position)
+  --movetime MS    search time (default 5000)
+  --frame-ms MS    frame interval to poll at (default 16)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <common/movegen.hpp>
+#include <common/uciengine.hpp>
+
+namespace {
+    void printUsage() {
+        fprintf(stderr, "Usage: ucibench \"ENGINE COMMAND\" [--fen FEN] [--movetime MS] [--frame-ms MS]\n");
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    std::string fen = START_FEN;
+    int movetimeMs = 5000;
+    int frameMs = 16;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "--movetime") == 0 && i + 1 < argc) {
+            movetimeMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frame-ms") == 0 && i + 1 < argc) {
+            frameMs = atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    initBitboards();
+    Position root;
+    if (!root.setFromFen(fen.c_str())) {
+        fprintf(stderr, "Error: Invalid FEN \"%s\"\n", fen.c_str());
+        return 1;
+    }
+
+    UciEngine engine;
+    if (!engine.start(argv[1])) {
+        return 1;
+    }
+    // Wait for uciok so the search time is not spent starting the engine
+    UciUpdate update;
+    std::chrono::steady_clock::time_point startup = std::chrono::steady_clock::now();
+    bool ready = false;
+    while (!ready && secondsSince(startup) < 10.0) {
+        while (engine.poll(update)) {
+            ready = ready || update.type == UCI_READY;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!ready) {
+        fprintf(stderr, "Error: Engine did not answer uci\n");
+        return 1;
+    }
+    printf("Engine %s, searching for %d ms, polling every %d ms\n", update.name[0] ? update.name : "(unnamed)",
+           movetimeMs, frameMs);
+
+    std::string limits = "movetime " + std::to_string(movetimeMs);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned search = engine.go(root, limits.c_str());
+    std::vector<double> pollMicros;
+    uint64_t updates = 0;
+    UciUpdate last;
+    Move best = NO_MOVE;
+    bool exited = false;
+    while (best == NO_MOVE && !exited) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(frameMs));
+        std::chrono::steady_clock::time_point frame = std::chrono::steady_clock::now();
+        while (engine.poll(update)) {
+            updates++;
+            if (update.type == UCI_EXITED) {
+                exited = true;
+            } else if (update.search == search && update.type == UCI_INFO) {
+                last = update;
+            } else if (update.search == search && update.type == UCI_BESTMOVE) {
+                best = update.bestMove();
+            }
+        }
+        pollMicros.push_back(secondsSince(frame) * 1e6);
+    }
+    double seconds = secondsSince(start);
+    if (exited) {
+        fprintf(stderr, "Error: Engine exited during the search\n");
+        return 1;
+    }
+
+    std::sort(pollMicros.begin(), pollMicros.end());
+    double total = 0.0;
+    for (size_t i = 0; i < pollMicros.size(); i++) {
+        total += pollMicros[i];
+    }
+    printf("Best move %s, depth %d, score %s%d, %llu nodes\n", best != NO_MOVE ? moveToUci(best).c_str() : "(none)",
+           last.depth, last.mate ? "mate " : "cp ", last.score, (unsigned long long)last.nodes);
+    printf("%llu lines in %.2f s (%.0f lines/s), %llu updates polled, %llu dropped\n",
+           (unsigned long long)engine.lineCount(), seconds, engine.lineCount() / seconds,
+           (unsigned long long)updates, (unsigned long long)engine.droppedCount());
+    printf("Poll time per frame over %zu frames: mean %.1f us, median %.1f us, max %.1f us\n", pollMicros.size(),
+           total / pollMicros.size(), pollMicros[pollMicros.size() / 2], pollMicros.back());
+    engine.quit();
+    return 0;
+}
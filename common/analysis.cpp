@@ -0,0 +1,160 @@
+/*
+Description:
+Analysis service thread. Commands are handed over through a one-slot mailbox;
+each one bumps a request counter and stops the running search, and a search
+that sees a newer request when it reports an iteration stops itself, so a
+command can never be lost between taking it and starting the search.
+*/
+
+#include <chrono>
+
+#include "analysis.hpp"
+
+namespace {
+    int64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+AnalysisService::AnalysisService(int hashMegabytes, int threads)
+    : book(NULL), showingBookMove(false), engine(table), pendingType(COMMAND_NONE), pendingPonderMove(NO_MOVE), latestRequest(0),
+      stopRequestedUs(0), lastStopLatencyMs(0.0) {
+    table.resize(hashMegabytes);
+    engine.setThreads(threads);
+    worker = std::thread(&AnalysisService::run, this);
+}
+
+AnalysisService::~AnalysisService() {
+    post(COMMAND_QUIT, NULL, NO_MOVE);
+    worker.join();
+}
+
+void AnalysisService::setBook(const PolyglotBook* openingBook) {
+    book = openingBook;
+}
+
+void AnalysisService::setTablebases(Tablebases* tablebases) {
+    engine.setTablebases(tablebases);
+}
+
+void AnalysisService::analyze(const Position& position) {
+    post(COMMAND_ANALYZE, &position, NO_MOVE);
+}
+
+void AnalysisService::ponder(const Position& position, Move ponderMove) {
+    post(COMMAND_PONDER, &position, ponderMove);
+}
+
+void AnalysisService::stop() {
+    post(COMMAND_STOP, NULL, NO_MOVE);
+}
+
+const AnalysisSnapshot& AnalysisService::acquireSnapshot() {
+    snapshots.update();
+    return snapshots.readBuffer();
+}
+
+void AnalysisService::post(CommandType type, const Position* position, Move ponderMove) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pendingType = type;
+        if (position) {
+            pendingPosition = *position;
+        }
+        pendingPonderMove = ponderMove;
+        stopRequestedUs.store(nowUs(), std::memory_order_relaxed);
+        latestRequest.fetch_add(1);
+    }
+    engine.stop();
+    commandReady.notify_one();
+}
+
+void AnalysisService::run() {
+    for (;;) {
+        CommandType type;
+        Position root;
+        Move ponderMove;
+        unsigned long request;
+        {
+            std::unique_lock<std::mutex> lock(commandMutex);
+            commandReady.wait(lock, [this] { return pendingType != COMMAND_NONE; });
+            type = pendingType;
+            root = pendingPosition;
+            ponderMove = pendingPonderMove;
+            request = latestRequest.load();
+            pendingType = COMMAND_NONE;
+        }
+
+        if (type == COMMAND_QUIT) {
+            return;
+        }
+        if (type == COMMAND_STOP) {
+            // The stopped search already published its final snapshot, a book answer is withdrawn
+            if (showingBookMove) {
+                publish(SearchInfo(), root, NO_MOVE, request, false, false);
+                showingBookMove = false;
+            }
+            continue;
+        }
+        runSearch(root, type == COMMAND_PONDER ? ponderMove : NO_MOVE, request);
+    }
+}
+
+void AnalysisService::runSearch(const Position& root, Move ponderMove, unsigned long request) {
+    Position searched = root;
+    if (ponderMove != NO_MOVE) {
+        searched.makeMove(ponderMove);
+    }
+    showingBookMove = answerFromBook(searched, ponderMove, request);
+    if (showingBookMove) {
+        return;
+    }
+    publish(SearchInfo(), searched, ponderMove, request, true, false);
+
+    SearchLimits limits; // No limits: runs until the next command
+    SearchInfo info = engine.search(searched, limits, [&](const SearchInfo& iteration) {
+        if (latestRequest.load(std::memory_order_relaxed) != request) {
+            // A command arrived before this search reset the stop flag
+            engine.stop();
+            return;
+        }
+        publish(iteration, searched, ponderMove, request, true, false);
+    });
+
+    lastStopLatencyMs = (nowUs() - stopRequestedUs.load(std::memory_order_relaxed)) / 1000.0;
+    publish(info, searched, ponderMove, request, false, false);
+}
+
+bool AnalysisService::answerFromBook(const Position& root, Move ponderMove, unsigned long request) {
+    std::vector<BookMove> moves;
+    if (!book || book->probe(root, moves) == 0) {
+        return false;
+    }
+    SearchInfo info;
+    info.pv.push_back(moves[0].move);
+    publish(info, root, ponderMove, request, false, true);
+    return true;
+}
+
+void AnalysisService::publish(const SearchInfo& info, const Position& root, Move ponderMove,
+                              unsigned long request, bool searching, bool fromBook) {
+    AnalysisSnapshot& snapshot = snapshots.writeBuffer();
+    snapshot.request = request;
+    snapshot.searching = searching;
+    snapshot.fromBook = fromBook;
+    snapshot.pondering = ponderMove != NO_MOVE;
+    snapshot.ponderMove = ponderMove;
+    snapshot.positionKey = root.key();
+    snapshot.depth = info.depth;
+    snapshot.seldepth = info.seldepth;
+    snapshot.score = info.score;
+    snapshot.nodes = info.nodes;
+    snapshot.nps = info.timeMs > 0 ? info.nodes * 1000 / (uint64_t)info.timeMs : 0;
+    snapshot.pvLength = info.pv.size() < (size_t)ANALYSIS_MAX_PV ? (int)info.pv.size() : ANALYSIS_MAX_PV;
+    for (int i = 0; i < snapshot.pvLength; i++) {
+        snapshot.pv[i] = info.pv[i];
+    }
+    snapshot.stopLatencyMs = lastStopLatencyMs;
+    snapshots.publish();
+}
@@ -0,0 +1,141 @@
+/*
+Description:
+Background analysis service. Searches run on their own thread so the render
+loop never waits on them; commands return immediately and results come back as
+snapshots through a triple buffer, which the render thread reads each frame
+without locking.
+*/
+
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "book.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "triplebuffer.hpp"
+#include "tt.hpp"
+
+/// Longest principal variation carried by a snapshot
+const int ANALYSIS_MAX_PV = 16;
+
+/**
+ * @brief State of the analysis as last published by the service thread
+ * Fixed size so publishing never allocates.
+ */
+struct AnalysisSnapshot {
+    unsigned long request;  ///< Command that produced this snapshot, 0 before the first one
+    bool searching;         ///< A search is running
+    bool fromBook;          ///< pv[0] is the top book move, nothing was searched
+    bool pondering;         ///< Searching the position after ponderMove
+    Move ponderMove;        ///< Move assumed to be played, NO_MOVE unless pondering
+    uint64_t positionKey;   ///< Key of the searched position
+    int depth;
+    int seldepth;
+    int score;              ///< Centipawns from the searched side's point of view
+    uint64_t nodes;
+    uint64_t nps;
+    Move pv[ANALYSIS_MAX_PV];
+    int pvLength;
+    double stopLatencyMs;   ///< Time from the last cancellation to the search returning
+
+    AnalysisSnapshot()
+        : request(0), searching(false), fromBook(false), pondering(false), ponderMove(NO_MOVE), positionKey(0),
+          depth(0), seldepth(0), score(0), nodes(0), nps(0), pvLength(0), stopLatencyMs(0.0) {}
+    Move bestMove() const { return pvLength > 0 ? pv[0] : NO_MOVE; }
+};
+
+/**
+ * @brief Runs searches on a service thread and publishes their progress
+ * Commands may be issued from one thread only, usually the render thread.
+ */
+class AnalysisService {
+public:
+    /**
+     * @brief Starts the idle service thread
+     * @param hashMegabytes Transposition table size
+     * @param threads Search threads, including the service thread itself
+     */
+    AnalysisService(int hashMegabytes, int threads);
+    ~AnalysisService();
+
+    AnalysisService(const AnalysisService&) = delete;
+    AnalysisService& operator=(const AnalysisService&) = delete;
+
+    /**
+     * @brief Answers positions found in an opening book from the book
+     * Such positions cost no search: the top book move is published at once.
+     * Must be set before the first command; the book must outlive the service.
+     *
+     * @param book Open book, NULL to always search
+     */
+    void setBook(const PolyglotBook* book);
+
+    /**
+     * @brief Lets the searches probe endgame tablebases
+     * Must be set before the first command; the tables must outlive the service.
+     */
+    void setTablebases(Tablebases* tablebases);
+
+    /**
+     * @brief Analyses a position until stopped, replacing any running search
+     */
+    void analyze(const Position& position);
+
+    /**
+     * @brief Analyses the position after ponderMove until stopped
+     * @param position Position before the expected move
+     * @param ponderMove Legal move expected to be played in position
+     */
+    void ponder(const Position& position, Move ponderMove);
+
+    /**
+     * @brief Cancels the running search, if any
+     * Returns at once; the search ends within a few thousand nodes.
+     */
+    void stop();
+
+    /**
+     * @brief Gives the consuming thread the newest snapshot
+     * Must only be called from one thread; never blocks.
+     *
+     * @return Newest published snapshot, valid until the next call
+     */
+    const AnalysisSnapshot& acquireSnapshot();
+
+private:
+    enum CommandType { COMMAND_NONE, COMMAND_ANALYZE, COMMAND_PONDER, COMMAND_STOP, COMMAND_QUIT };
+
+    void run();
+    void runSearch(const Position& root, Move ponderMove, unsigned long request);
+    bool answerFromBook(const Position& root, Move ponderMove, unsigned long request);
+    void publish(const SearchInfo& info, const Position& root, Move ponderMove,
+                 unsigned long request, bool searching, bool fromBook);
+    void post(CommandType type, const Position* position, Move ponderMove);
+
+    TranspositionTable table;
+    const PolyglotBook* book;
+    bool showingBookMove;   ///< Last snapshot was a book answer; service thread only
+    SearchEngine engine;
+    TripleBuffer<AnalysisSnapshot> snapshots;
+    std::thread worker;
+
+    // Pending command, handed over under the mutex
+    std::mutex commandMutex;
+    std::condition_variable commandReady;
+    CommandType pendingType;
+    Position pendingPosition;
+    Move pendingPonderMove;
+
+    /// Bumped by every command; a search whose request is older stops itself
+    std::atomic<unsigned long> latestRequest;
+    std::atomic<int64_t> stopRequestedUs;
+    double lastStopLatencyMs;
+};
+
+#endif
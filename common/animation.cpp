@@ -0,0 +1,376 @@
+/*
+Description:
+Move tracks and their evaluation. The curve and slerp pass uses SSE when the
+compiler targets it (always on x86-64) and plain C++ otherwise. Slerp is
+approximated by a normalised lerp with a corrected interpolation parameter,
+which needs no trigonometry and stays within about 1e-4 radians of slerp.
+*/
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "animation.hpp"
+#include "boardlayout.hpp"
+
+namespace {
+    /// Height a moving piece is lifted to, and the top of a knight's arc
+    const float LIFT_HEIGHT = 1.5f;
+    const float KNIGHT_ARC_HEIGHT = 5.0f;
+    /// Share of the move spent lifting and setting down (knights arc all the way)
+    const float LIFT_SHARE = 0.25f;
+    /// Lean of a moving piece into its direction of travel
+    const float LEAN_DEGREES = 12.0f;
+    /// How far a captured piece topples and sinks while it shrinks away
+    const float TOPPLE_DEGREES = 80.0f;
+    const float SINK_DEPTH = 1.0f;
+    /// Age of the epoch at which track times are moved to a new one, well within float precision
+    const double EPOCH_REBASE_SECONDS = 1000.0;
+
+    /**
+     * @brief Rotation by an angle about a unit axis, as a quaternion (x, y, z, w)
+     */
+    glm::vec4 axisAngle(const glm::vec3& axis, float degrees) {
+        float half = degrees * 0.5f * 3.14159265f / 180.0f;
+        float s = sinf(half);
+        return glm::vec4(axis.x * s, axis.y * s, axis.z * s, cosf(half));
+    }
+
+    /**
+     * @brief Horizontal axis that tips the up vector towards a direction on the board
+     */
+    glm::vec3 leanAxis(const glm::vec3& from, const glm::vec3& to) {
+        glm::vec3 direction(to.x - from.x, 0.0f, to.z - from.z);
+        float length = sqrtf(direction.x * direction.x + direction.z * direction.z);
+        if (length < 1e-6f) {
+            return glm::vec3(1.0f, 0.0f, 0.0f);
+        }
+        // cross(up, direction) for up = +Y
+        return glm::vec3(direction.z / length, 0.0f, -direction.x / length);
+    }
+
+    /**
+     * @brief Model matrix of a piece on a square, moved so the square centre is at the origin
+     */
+    glm::mat4 pivotedModelMatrix(int piece, int square, const glm::vec3& offset) {
+        glm::mat4 placed = glm::translate(glm::mat4(1.0f), offset) *
+                           squareModelMatrix(piece, squareFile(square), squareRank(square));
+        return glm::translate(glm::mat4(1.0f), -squareCentre(square, offset)) * placed;
+    }
+
+#if defined(__SSE2__) || defined(_M_X64)
+    inline __m128 clamp01(__m128 x) {
+        return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    }
+
+    /// x * x * (3 - 2x)
+    inline __m128 smoothstep(__m128 x) {
+        return _mm_mul_ps(_mm_mul_ps(x, x), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(x, x)));
+    }
+
+    /// a + (b - a) * t
+    inline __m128 lerp(__m128 a, __m128 b, __m128 t) {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+#else
+    inline float clamp01(float x) {
+        return x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+    }
+
+    inline float smoothstep(float x) {
+        return x * x * (3.0f - 2.0f * x);
+    }
+
+    inline float lerp(float a, float b, float t) {
+        return a + (b - a) * t;
+    }
+#endif
+}
+
+MoveAnimator::MoveAnimator() : duration(MOVE_ANIMATION_SECONDS), epoch(0.0), count(0) {}
+
+void MoveAnimator::addMove(int boardIndex, const Position& position, const glm::vec3& offset, double now) {
+    finishBoard(boardIndex);
+    if (count == 0) {
+        epoch = now;
+    }
+    rebase(now);
+    if (position.gamePly() == 0) {
+        return;
+    }
+    DirtyPieces dirty = position.dirtyPieces(position.gamePly());
+    if (dirty.count == 0) {
+        return;
+    }
+    if ((size_t)boardIndex >= hidden.size()) {
+        hidden.resize(boardIndex + 1, 0);
+    }
+    // A promoting pawn flies to the square its new piece appears on
+    int promotionSquare = NO_SQUARE;
+    for (int i = 0; i < dirty.count; i++) {
+        if (dirty.from[i] == NO_SQUARE) {
+            promotionSquare = dirty.to[i];
+        }
+    }
+    glm::vec3 moverFrom = squareCentre(dirty.from[0], offset);
+    float start = (float)(now - epoch);
+
+    for (int i = 0; i < dirty.count; i++) {
+        int from = dirty.from[i];
+        int to = i == 0 && dirty.to[i] == NO_SQUARE ? promotionSquare : dirty.to[i];
+        if (from == NO_SQUARE) {
+            continue;
+        }
+        glm::vec3 centre = squareCentre(from, offset);
+        size_t track = addTrack(boardIndex, pieceMesh(dirty.piece[i]), to == NO_SQUARE ? -1 : to,
+                                pivotedModelMatrix(dirty.piece[i], from, offset));
+        lanes[FROM_X][track] = centre.x;
+        lanes[FROM_Y][track] = centre.y;
+        lanes[FROM_Z][track] = centre.z;
+        lanes[Q0_X][track] = lanes[Q0_Y][track] = lanes[Q0_Z][track] = 0.0f;
+        lanes[Q0_W][track] = 1.0f;
+        lanes[SCALE_FROM][track] = 1.0f;
+
+        if (to != NO_SQUARE) {
+            glm::vec3 target = squareCentre(to, offset);
+            bool knight = pieceType(dirty.piece[i]) == KNIGHT;
+            lanes[START][track] = start;
+            lanes[INV_DURATION][track] = 1.0f / duration;
+            lanes[TO_X][track] = target.x;
+            lanes[TO_Y][track] = target.y;
+            lanes[TO_Z][track] = target.z;
+            lanes[LIFT][track] = knight ? KNIGHT_ARC_HEIGHT : LIFT_HEIGHT;
+            lanes[INV_RAMP][track] = knight ? 2.0f : 1.0f / LIFT_SHARE;
+            lanes[SCALE_TO][track] = 1.0f;
+            setTarget(track, axisAngle(leanAxis(centre, target), LEAN_DEGREES));
+            lanes[RETURN_SHARE][track] = 1.0f;
+            hidden[boardIndex] |= squareBB(to);
+        } else {
+            // Captured: falls over, away from the capturing piece, in the second half of the move
+            lanes[START][track] = start + 0.5f * duration;
+            lanes[INV_DURATION][track] = 2.0f / duration;
+            lanes[TO_X][track] = centre.x;
+            lanes[TO_Y][track] = centre.y - SINK_DEPTH;
+            lanes[TO_Z][track] = centre.z;
+            lanes[LIFT][track] = 0.0f;
+            lanes[INV_RAMP][track] = 1.0f;
+            lanes[SCALE_TO][track] = 0.0f;
+            setTarget(track, axisAngle(leanAxis(moverFrom, centre), TOPPLE_DEGREES));
+            lanes[RETURN_SHARE][track] = 0.0f;
+        }
+    }
+}
+
+void MoveAnimator::setTarget(size_t track, const glm::vec4& rotation) {
+    lanes[Q1_X][track] = rotation.x;
+    lanes[Q1_Y][track] = rotation.y;
+    lanes[Q1_Z][track] = rotation.z;
+    lanes[Q1_W][track] = rotation.w;
+}
+
+size_t MoveAnimator::addTrack(int boardIndex, int pieceMeshIndex, int landingSquare, const glm::mat4& localMatrix) {
+    if (lanes[0].size() < count + 1) {
+        // Padding up to a multiple of four lets the pass run whole vectors past the last track
+        size_t padded = lanes[0].empty() ? 64 : lanes[0].size() * 2;
+        for (int lane = 0; lane < LANE_COUNT; lane++) {
+            lanes[lane].resize(padded, 0.0f);
+        }
+        for (int output = 0; output < OUTPUT_COUNT; output++) {
+            outputs[output].resize(padded, 0.0f);
+        }
+    }
+    local.push_back(localMatrix);
+    mesh.push_back(pieceMeshIndex);
+    board.push_back(boardIndex);
+    landing.push_back(landingSquare);
+    return count++;
+}
+
+void MoveAnimator::removeTrack(size_t track) {
+    size_t last = count - 1;
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        lanes[lane][track] = lanes[lane][last];
+    }
+    local[track] = local[last];
+    mesh[track] = mesh[last];
+    board[track] = board[last];
+    landing[track] = landing[last];
+    local.pop_back();
+    mesh.pop_back();
+    board.pop_back();
+    landing.pop_back();
+    count--;
+}
+
+bool MoveAnimator::finishBoard(int boardIndex) {
+    bool found = false;
+    for (size_t track = count; track-- > 0; ) {
+        if (board[track] == boardIndex) {
+            removeTrack(track);
+            found = true;
+        }
+    }
+    if ((size_t)boardIndex < hidden.size()) {
+        hidden[boardIndex] = 0;
+    }
+    return found;
+}
+
+void MoveAnimator::clear() {
+    count = 0;
+    local.clear();
+    mesh.clear();
+    board.clear();
+    landing.clear();
+    hidden.clear();
+}
+
+Bitboard MoveAnimator::hiddenSquares(int boardIndex) const {
+    return (size_t)boardIndex < hidden.size() ? hidden[boardIndex] : 0;
+}
+
+void MoveAnimator::evaluateLanes(float time, size_t first, size_t end) {
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 now = _mm_set1_ps(time);
+    for (size_t i = first; i < end; i += 4) {
+#define LANE(name) _mm_loadu_ps(&lanes[name][i])
+        __m128 t = clamp01(_mm_mul_ps(_mm_sub_ps(now, LANE(START)), LANE(INV_DURATION)));
+        __m128 u = smoothstep(t);
+        // Lift: up at the start, down at the end, a plain arc when the ramp is half the move
+        __m128 ramp = smoothstep(clamp01(_mm_mul_ps(_mm_min_ps(t, _mm_sub_ps(one, t)), LANE(INV_RAMP))));
+        __m128 x = lerp(LANE(FROM_X), LANE(TO_X), u);
+        __m128 y = _mm_add_ps(lerp(LANE(FROM_Y), LANE(TO_Y), u), _mm_mul_ps(LANE(LIFT), ramp));
+        __m128 z = lerp(LANE(FROM_Z), LANE(TO_Z), u);
+        __m128 scale = lerp(LANE(SCALE_FROM), LANE(SCALE_TO), u);
+
+        // Rotation weight: either follows the move or goes out and back, peaking halfway
+        __m128 outAndBack = _mm_mul_ps(_mm_set1_ps(4.0f), _mm_mul_ps(t, _mm_sub_ps(one, t)));
+        __m128 w = lerp(u, outAndBack, LANE(RETURN_SHARE));
+
+        __m128 ax = LANE(Q0_X), ay = LANE(Q0_Y), az = LANE(Q0_Z), aw = LANE(Q0_W);
+        __m128 bx = LANE(Q1_X), by = LANE(Q1_Y), bz = LANE(Q1_Z), bw = LANE(Q1_W);
+#undef LANE
+        __m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                                   _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        // Take the short way round: flip the target when the quaternions are more than 90 degrees apart
+        __m128 flip = _mm_and_ps(cosine, signBit);
+        bx = _mm_xor_ps(bx, flip);
+        by = _mm_xor_ps(by, flip);
+        bz = _mm_xor_ps(bz, flip);
+        bw = _mm_xor_ps(bw, flip);
+        __m128 d = _mm_andnot_ps(signBit, cosine);
+
+        // Corrected lerp parameter, fitted so the normalised lerp follows slerp's constant speed
+        __m128 a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+                   _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+        __m128 b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f),
+                   _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+        __m128 centred = _mm_sub_ps(w, half);
+        __m128 k = _mm_add_ps(_mm_mul_ps(a, _mm_mul_ps(centred, centred)), b);
+        __m128 corrected = _mm_add_ps(w, _mm_mul_ps(_mm_mul_ps(w, centred), _mm_mul_ps(_mm_sub_ps(w, one), k)));
+
+        __m128 qx = lerp(ax, bx, corrected), qy = lerp(ay, by, corrected);
+        __m128 qz = lerp(az, bz, corrected), qw = lerp(aw, bw, corrected);
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+                                               _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw))));
+        // Padding lanes hold zero quaternions; keep them finite
+        __m128 inverse = _mm_div_ps(one, _mm_max_ps(length, _mm_set1_ps(1e-20f)));
+
+        _mm_storeu_ps(&outputs[PROGRESS][i], t);
+        _mm_storeu_ps(&outputs[POS_X][i], x);
+        _mm_storeu_ps(&outputs[POS_Y][i], y);
+        _mm_storeu_ps(&outputs[POS_Z][i], z);
+        _mm_storeu_ps(&outputs[ROT_X][i], _mm_mul_ps(qx, inverse));
+        _mm_storeu_ps(&outputs[ROT_Y][i], _mm_mul_ps(qy, inverse));
+        _mm_storeu_ps(&outputs[ROT_Z][i], _mm_mul_ps(qz, inverse));
+        _mm_storeu_ps(&outputs[ROT_W][i], _mm_mul_ps(qw, inverse));
+        _mm_storeu_ps(&outputs[SCALE][i], scale);
+    }
+#else
+    for (size_t i = first; i < end; i++) {
+        float t = clamp01((time - lanes[START][i]) * lanes[INV_DURATION][i]);
+        float u = smoothstep(t);
+        float ramp = smoothstep(clamp01((t < 1.0f - t ? t : 1.0f - t) * lanes[INV_RAMP][i]));
+        float w = lerp(u, 4.0f * t * (1.0f - t), lanes[RETURN_SHARE][i]);
+
+        float cosine = lanes[Q0_X][i] * lanes[Q1_X][i] + lanes[Q0_Y][i] * lanes[Q1_Y][i] +
+                       lanes[Q0_Z][i] * lanes[Q1_Z][i] + lanes[Q0_W][i] * lanes[Q1_W][i];
+        float sign = cosine < 0.0f ? -1.0f : 1.0f;
+        float d = cosine * sign;
+        float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+        float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+        float k = a * (w - 0.5f) * (w - 0.5f) + b;
+        float corrected = w + w * (w - 0.5f) * (w - 1.0f) * k;
+
+        float q[4];
+        for (int c = 0; c < 4; c++) {
+            q[c] = lerp(lanes[Q0_X + c][i], sign * lanes[Q1_X + c][i], corrected);
+        }
+        float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        float inverse = 1.0f / (length > 1e-20f ? length : 1e-20f);
+
+        outputs[PROGRESS][i] = t;
+        outputs[POS_X][i] = lerp(lanes[FROM_X][i], lanes[TO_X][i], u);
+        outputs[POS_Y][i] = lerp(lanes[FROM_Y][i], lanes[TO_Y][i], u) + lanes[LIFT][i] * ramp;
+        outputs[POS_Z][i] = lerp(lanes[FROM_Z][i], lanes[TO_Z][i], u);
+        for (int c = 0; c < 4; c++) {
+            outputs[ROT_X + c][i] = q[c] * inverse;
+        }
+        outputs[SCALE][i] = lerp(lanes[SCALE_FROM][i], lanes[SCALE_TO][i], u);
+    }
+#endif
+}
+
+void MoveAnimator::rebase(double now) {
+    if (now - epoch < EPOCH_REBASE_SECONDS) {
+        return;
+    }
+    // Whole seconds, so the start times shift without rounding
+    double shift = floor(now - epoch);
+    epoch += shift;
+    for (size_t track = 0; track < count; track++) {
+        lanes[START][track] -= (float)shift;
+    }
+}
+
+void MoveAnimator::evaluate(double now, std::vector<PieceInstance>& instances, std::vector<int>& landedBoards) {
+    if (count == 0) {
+        return;
+    }
+    rebase(now);
+    evaluateLanes((float)(now - epoch), 0, count);
+
+    // Backwards, so removing a track only moves one that was already handled
+    for (size_t track = count; track-- > 0; ) {
+        if (outputs[PROGRESS][track] >= 1.0f) {
+            if (landing[track] >= 0) {
+                hidden[board[track]] &= ~squareBB(landing[track]);
+                landedBoards.push_back(board[track]);
+            }
+            removeTrack(track);
+            continue;
+        }
+        float x = outputs[ROT_X][track], y = outputs[ROT_Y][track];
+        float z = outputs[ROT_Z][track], w = outputs[ROT_W][track];
+        float s = outputs[SCALE][track];
+        // Translation * rotation * uniform scale, column by column
+        glm::mat4 transform(
+            glm::vec4((1.0f - 2.0f * (y * y + z * z)) * s, 2.0f * (x * y + w * z) * s, 2.0f * (x * z - w * y) * s, 0.0f),
+            glm::vec4(2.0f * (x * y - w * z) * s, (1.0f - 2.0f * (x * x + z * z)) * s, 2.0f * (y * z + w * x) * s, 0.0f),
+            glm::vec4(2.0f * (x * z + w * y) * s, 2.0f * (y * z - w * x) * s, (1.0f - 2.0f * (x * x + y * y)) * s, 0.0f),
+            glm::vec4(outputs[POS_X][track], outputs[POS_Y][track], outputs[POS_Z][track], 1.0f));
+        PieceInstance instance;
+        instance.mesh = mesh[track];
+        instance.board = board[track];
+        instance.square = landing[track];
+        instance.ModelMatrix = transform * local[track];
+        instances.push_back(instance);
+    }
+}
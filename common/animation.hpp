@@ -0,0 +1,117 @@
+/*
+Description:
+Move animation for the simulation thread. A move starts one track per piece
+it touches: the moving piece lifts, slides (or arcs, for a knight) to its new
+square and leans into the motion, and a captured piece topples, sinks and
+shrinks away once the mover is halfway there.
+
+Tracks are stored as structure of arrays, one float array per parameter, so
+a single pass over all tracks of all boards evaluates the curves and the
+quaternion slerps four tracks at a time. Only the final matrix product is
+done per track, and a track costs nothing once it has landed: the piece goes
+back into the static instances of its board.
+*/
+
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "framepacket.hpp"
+#include "position.hpp"
+
+/// Default time a piece takes to move, in seconds
+const float MOVE_ANIMATION_SECONDS = 0.35f;
+
+/**
+ * @brief Active move animations of every board
+ */
+class MoveAnimator {
+public:
+    MoveAnimator();
+
+    /**
+     * @brief Sets the duration of moves started from now on
+     */
+    void setDuration(float seconds) { duration = seconds > 0.0f ? seconds : MOVE_ANIMATION_SECONDS; }
+    float moveDuration() const { return duration; }
+
+    /**
+     * @brief Starts the tracks of a move that has just been made
+     * Tracks still running on the board are finished first.
+     *
+     * @param board Board index, used to report finished boards
+     * @param position Board position right after the move
+     * @param offset World-space offset of the board
+     * @param now Current time in seconds
+     */
+    void addMove(int board, const Position& position, const glm::vec3& offset, double now);
+
+    /**
+     * @brief Drops the tracks of one board, leaving its pieces where the moves end
+     * @return true if the board had tracks
+     */
+    bool finishBoard(int board);
+
+    /**
+     * @brief Drops every track
+     */
+    void clear();
+
+    /**
+     * @brief Squares whose piece is drawn by a track, not by the static instances
+     */
+    Bitboard hiddenSquares(int board) const;
+
+    /**
+     * @brief Evaluates all tracks at a time and appends one instance per moving piece
+     * Tracks that have ended are removed.
+     *
+     * @param now Current time in seconds
+     * @param instances Instances to append to
+     * @param landedBoards Receives each board whose last moving piece landed
+     */
+    void evaluate(double now, std::vector<PieceInstance>& instances, std::vector<int>& landedBoards);
+
+    size_t activeTracks() const { return count; }
+
+private:
+    /// Per track parameters, one array each
+    enum Lane {
+        START, INV_DURATION,
+        FROM_X, FROM_Y, FROM_Z, TO_X, TO_Y, TO_Z,
+        LIFT, INV_RAMP,
+        SCALE_FROM, SCALE_TO,
+        Q0_X, Q0_Y, Q0_Z, Q0_W, Q1_X, Q1_Y, Q1_Z, Q1_W,
+        RETURN_SHARE,
+        LANE_COUNT
+    };
+    /// Per track results of the evaluation pass
+    enum Output {
+        PROGRESS, POS_X, POS_Y, POS_Z, ROT_X, ROT_Y, ROT_Z, ROT_W, SCALE,
+        OUTPUT_COUNT
+    };
+
+    size_t addTrack(int board, int mesh, int landing, const glm::mat4& local);
+    void removeTrack(size_t track);
+    void setTarget(size_t track, const glm::vec4& rotation);
+    void evaluateLanes(float time, size_t first, size_t end);
+    /// Moves the epoch up to now once it is old enough for float times to lose precision
+    void rebase(double now);
+
+    float duration;
+    double epoch;   ///< Track times are floats relative to this, kept recent by rebase()
+    size_t count;
+    std::vector<float> lanes[LANE_COUNT];     ///< Padded to a multiple of four tracks
+    std::vector<float> outputs[OUTPUT_COUNT];
+    // Per track, only touched when building the matrices
+    std::vector<glm::mat4> local;    ///< Piece model matrix moved so its square centre is the origin
+    std::vector<int> mesh;
+    std::vector<int> board;
+    std::vector<int> landing;        ///< Square the piece lands on, -1 for a captured piece
+    std::vector<Bitboard> hidden;    ///< Per board: squares of pieces still moving
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+Description:
+Arrow geometry: a shaft quad and a head triangle per arrow, lying slightly
+above the board surface between the square centres.
+*/
+
+#include "arrow.hpp"
+#include "boardlayout.hpp"
+#include "shader.hpp"
+
+namespace {
+    const float ARROW_LIFT = 0.3f;
+    const float SHAFT_HALF_WIDTH = 0.45f;
+    const float HEAD_HALF_WIDTH = 1.3f;
+    const float HEAD_LENGTH = 2.2f;
+    const int FLOATS_PER_VERTEX = 7;
+
+    void pushVertex(std::vector<float>& vertices, const glm::vec3& position, const glm::vec4& color) {
+        vertices.push_back(position.x);
+        vertices.push_back(position.y);
+        vertices.push_back(position.z);
+        vertices.push_back(color.x);
+        vertices.push_back(color.y);
+        vertices.push_back(color.z);
+        vertices.push_back(color.w);
+    }
+
+    bool sameArrows(const std::vector<MoveArrow>& built, const MoveArrow* arrows, int count) {
+        if ((int)built.size() != count) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (built[i].move != arrows[i].move || built[i].color != arrows[i].color) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+ArrowOverlay::ArrowOverlay()
+    : programID(0), ViewMatrixID(0), ProjectionMatrixID(0), vertexCount(0),
+      builtOffset(0.0f) {}
+
+bool ArrowOverlay::load() {
+    programID = LoadShaders("shaders/Arrow.vertexshader", "shaders/Arrow.fragmentshader");
+    if (programID == 0) {
+        return false;
+    }
+    ViewMatrixID = glGetUniformLocation(programID, "V");
+    ProjectionMatrixID = glGetUniformLocation(programID, "P");
+    return true;
+}
+
+void ArrowOverlay::draw(const FramePacket& packet, const MoveArrow* arrows, int count,
+                        const glm::vec3& boardOffset) {
+    if (programID == 0 || count <= 0) {
+        return;
+    }
+    if (!sameArrows(builtArrows, arrows, count) || builtOffset != boardOffset) {
+        buildGeometry(arrows, count, boardOffset);
+    }
+    if (vertexCount == 0) {
+        return;
+    }
+
+    glUseProgram(programID);
+    glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &packet.ViewMatrix[0][0]);
+    glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &packet.ProjectionMatrix[0][0]);
+
+    // Pieces would hide most of the arrow, so draw it over everything, from either side
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GLsizei stride = FLOATS_PER_VERTEX * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer.id());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+
+    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void ArrowOverlay::buildGeometry(const MoveArrow* arrows, int count, const glm::vec3& boardOffset) {
+    builtArrows.assign(arrows, arrows + count);
+    builtOffset = boardOffset;
+    vertices.clear();
+
+    const glm::vec3 lift(0.0f, ARROW_LIFT, 0.0f);
+    for (int i = 0; i < count; i++) {
+        Move move = arrows[i].move;
+        if (move == NO_MOVE) {
+            continue;
+        }
+        glm::vec3 from = squareCentre(moveFrom(move), boardOffset) + lift;
+        glm::vec3 to = squareCentre(moveTo(move), boardOffset) + lift;
+        glm::vec3 direction = to - from;
+        float length = glm::length(direction);
+        if (length <= HEAD_LENGTH) {
+            continue;
+        }
+        direction /= length;
+        // Perpendicular within the board plane
+        glm::vec3 side(-direction.z, 0.0f, direction.x);
+        glm::vec3 headBase = to - direction * HEAD_LENGTH;
+        const glm::vec4& color = arrows[i].color;
+
+        glm::vec3 shaft[4] = { from - side * SHAFT_HALF_WIDTH, from + side * SHAFT_HALF_WIDTH,
+                               headBase + side * SHAFT_HALF_WIDTH, headBase - side * SHAFT_HALF_WIDTH };
+        pushVertex(vertices, shaft[0], color);
+        pushVertex(vertices, shaft[1], color);
+        pushVertex(vertices, shaft[2], color);
+        pushVertex(vertices, shaft[0], color);
+        pushVertex(vertices, shaft[2], color);
+        pushVertex(vertices, shaft[3], color);
+
+        pushVertex(vertices, headBase - side * HEAD_HALF_WIDTH, color);
+        pushVertex(vertices, headBase + side * HEAD_HALF_WIDTH, color);
+        pushVertex(vertices, to, color);
+    }
+
+    vertexCount = (GLsizei)(vertices.size() / FLOATS_PER_VERTEX);
+    vertexBuffer.upload(GPU_OVERLAY, GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
+                        vertices.empty() ? NULL : &vertices[0], GL_DYNAMIC_DRAW);
+    vertexMemory.set(GPU_OVERLAY, vertices.capacity() * sizeof(float));
+}
+
+void ArrowOverlay::release() {
+    vertexBuffer.reset();
+    glDeleteProgram(programID);
+    programID = 0;
+    vertexCount = 0;
+    builtArrows.clear();
+    std::vector<float>().swap(vertices);
+    vertexMemory.reset();
+}
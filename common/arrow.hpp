@@ -0,0 +1,72 @@
+/*
+Description:
+Move arrows drawn flat over the board, e.g. for the analysis best move. The
+arrow geometry is rebuilt only when the arrows change, so an unchanged arrow
+costs one small draw call per frame.
+*/
+
+#ifndef ARROW_HPP
+#define ARROW_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "framepacket.hpp"
+#include "gpuresource.hpp"
+#include "position.hpp"
+
+/**
+ * @brief One arrow from a move's origin to its target square
+ */
+struct MoveArrow {
+    Move move;
+    glm::vec4 color; ///< RGBA, alpha blends with the board
+};
+
+/**
+ * @brief Shader and vertex buffer for move arrows
+ */
+class ArrowOverlay {
+public:
+    ArrowOverlay();
+
+    /**
+     * @brief Compiles the arrow shader; requires a current GL context
+     * @return true if the shader compiled
+     */
+    bool load();
+
+    /**
+     * @brief Draws arrows on top of the scene, ignoring depth
+     *
+     * @param packet Camera matrices of the frame
+     * @param arrows Arrows to draw
+     * @param count Number of arrows
+     * @param boardOffset World-space offset of the board the moves belong to
+     */
+    void draw(const FramePacket& packet, const MoveArrow* arrows, int count,
+              const glm::vec3& boardOffset = glm::vec3(0.0f));
+
+    /**
+     * @brief Deletes the GL objects created by load()
+     */
+    void release();
+
+private:
+    void buildGeometry(const MoveArrow* arrows, int count, const glm::vec3& boardOffset);
+
+    GLuint programID;
+    GLuint ViewMatrixID;
+    GLuint ProjectionMatrixID;
+    GpuBuffer vertexBuffer; ///< Charged to GPU_OVERLAY, as is the CPU copy
+    GLsizei vertexCount;
+
+    // Arrows in the buffer, to skip rebuilding unchanged ones
+    std::vector<MoveArrow> builtArrows;
+    glm::vec3 builtOffset;
+    std::vector<float> vertices; ///< Interleaved position (3) and color (4)
+    CpuCharge vertexMemory;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+Description:
+Work-stealing batch analysis: per-thread job deques, per-game transposition
+tables and the time budget shared out as jobs start.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "batchanalysis.hpp"
+#include "movegen.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+namespace {
+    struct Job {
+        uint32_t game;
+        uint32_t ply;
+    };
+
+    /**
+     * @brief Jobs of one thread; the owner takes from the front, thieves from the back
+     */
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    /**
+     * @brief Transposition table of one game, alive while its positions are analysed
+     */
+    struct GameTable {
+        std::mutex mutex;
+        std::unique_ptr<TranspositionTable> table;
+        int pending;
+    };
+
+    struct ThreadStats {
+        uint64_t positions;
+        uint64_t nodes;
+        uint64_t steals;
+        double busySeconds;
+    };
+
+    /**
+     * @brief State shared by the pool threads during one run
+     */
+    struct Batch {
+        const std::vector<BatchGame>* games;
+        const BatchOptions* options;
+        std::vector<std::vector<PositionAnalysis> >* results;
+        std::vector<JobQueue> queues;
+        std::vector<GameTable> tables;
+        std::atomic<int64_t> jobsLeft;
+        std::chrono::steady_clock::time_point start;
+
+        Batch(size_t threads, size_t gameCount) : queues(threads), tables(gameCount), jobsLeft(0) {}
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool takeOwn(JobQueue& queue, Job& job) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            return false;
+        }
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+        return true;
+    }
+
+    bool steal(Batch& batch, size_t thief, Job& job) {
+        size_t count = batch.queues.size();
+        for (size_t i = 1; i < count; i++) {
+            JobQueue& victim = batch.queues[(thief + i) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    TranspositionTable& acquireTable(Batch& batch, uint32_t game) {
+        GameTable& entry = batch.tables[game];
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if (!entry.table) {
+            entry.table.reset(new TranspositionTable());
+            entry.table->resize(batch.options->hashMbPerGame, false);
+        }
+        return *entry.table;
+    }
+
+    void releaseTable(Batch& batch, uint32_t game) {
+        GameTable& entry = batch.tables[game];
+        std::lock_guard<std::mutex> lock(entry.mutex);
+        if (--entry.pending == 0) {
+            entry.table.reset();
+        }
+    }
+
+    /**
+     * @brief Search time for a job that is starting now
+     */
+    int64_t jobBudgetMs(Batch& batch) {
+        const BatchOptions& options = *batch.options;
+        int64_t jobsLeft = batch.jobsLeft.fetch_sub(1, std::memory_order_relaxed);
+        if (options.totalTimeMs <= 0) {
+            return options.movetimeMs;
+        }
+        int64_t remainingMs = options.totalTimeMs - (int64_t)(secondsSince(batch.start) * 1000.0);
+        int64_t budget = remainingMs * options.threads / std::max<int64_t>(jobsLeft, 1);
+        return std::max<int64_t>(budget, 1);
+    }
+
+    void analyzeJob(Batch& batch, const Job& job, ThreadStats& stats) {
+        const BatchGame& game = (*batch.games)[job.game];
+        PositionAnalysis& result = (*batch.results)[job.game][job.ply];
+        int64_t budgetMs = jobBudgetMs(batch);
+
+        Position position = game.start;
+        for (uint32_t ply = 0; ply < job.ply; ply++) {
+            position.makeMove(game.moves[ply]);
+        }
+        MoveList list;
+        generateLegalMoves(position, list);
+        if (list.size() == 0) {
+            result.score = position.inCheck() ? -SCORE_MATE : 0;
+            releaseTable(batch, job.game);
+            stats.positions++;
+            return;
+        }
+
+        SearchLimits limits;
+        limits.depth = batch.options->maxDepth;
+        // A forced move needs a score, not a choice
+        limits.movetimeMs = list.size() == 1 ? std::max<int64_t>(budgetMs / 8, 1) : budgetMs;
+        SearchEngine engine(acquireTable(batch, job.game));
+        SearchInfo info = engine.search(position, limits);
+        releaseTable(batch, job.game);
+
+        result.score = info.score;
+        result.depth = info.depth;
+        result.bestMove = info.bestMove() != NO_MOVE ? info.bestMove() : list[0];
+        result.nodes = info.nodes;
+        result.timeMs = info.timeMs;
+        stats.positions++;
+        stats.nodes += info.nodes;
+    }
+
+    void runThread(Batch* batch, size_t index, ThreadStats* stats) {
+        ThreadStats local = { 0, 0, 0, 0.0 };
+        Job job;
+        for (;;) {
+            bool own = takeOwn(batch->queues[index], job);
+            if (!own && !steal(*batch, index, job)) {
+                break;
+            }
+            local.steals += own ? 0 : 1;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            analyzeJob(*batch, job, local);
+            local.busySeconds += secondsSince(start);
+        }
+        *stats = local;
+    }
+}
+
+BatchStats analyzeGames(const std::vector<BatchGame>& games, const BatchOptions& options,
+                        std::vector<std::vector<PositionAnalysis> >& results) {
+    BatchOptions settings = options;
+    settings.threads = std::max(1, settings.threads);
+    size_t threads = (size_t)settings.threads;
+
+    Batch batch(threads, games.size());
+    batch.games = &games;
+    batch.options = &settings;
+    batch.results = &results;
+
+    // Whole games go to each thread in order until it holds its share of the
+    // positions; plies are queued last to first
+    results.assign(games.size(), std::vector<PositionAnalysis>());
+    uint64_t totalPositions = 0;
+    for (size_t g = 0; g < games.size(); g++) {
+        totalPositions += games[g].moves.size() + 1;
+    }
+    uint64_t dealt = 0;
+    for (size_t g = 0; g < games.size(); g++) {
+        size_t positions = games[g].moves.size() + 1;
+        size_t owner = std::min<size_t>((size_t)(dealt * threads / std::max<uint64_t>(totalPositions, 1)), threads - 1);
+        results[g].resize(positions);
+        batch.tables[g].pending = (int)positions;
+        for (size_t ply = positions; ply-- > 0; ) {
+            Job job = { (uint32_t)g, (uint32_t)ply };
+            batch.queues[owner].jobs.push_back(job);
+        }
+        dealt += positions;
+    }
+    batch.jobsLeft.store((int64_t)totalPositions);
+
+    batch.start = std::chrono::steady_clock::now();
+    std::vector<ThreadStats> threadStats(threads);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.push_back(std::thread(runThread, &batch, i, &threadStats[i]));
+    }
+    runThread(&batch, 0, &threadStats[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    BatchStats stats;
+    stats.wallSeconds = secondsSince(batch.start);
+    stats.threads = settings.threads;
+    for (size_t i = 0; i < threads; i++) {
+        stats.positions += threadStats[i].positions;
+        stats.nodes += threadStats[i].nodes;
+        stats.steals += threadStats[i].steals;
+        stats.busySeconds += threadStats[i].busySeconds;
+    }
+    return stats;
+}
@@ -0,0 +1,82 @@
+/*
+Description:
+Batch analysis of many games. Every position of every game is one job; jobs
+are dealt to per-thread deques in whole games, balanced by position count,
+and threads that run out steal from the far end of another thread's deque.
+Each thread searches single-threaded, so short games finishing early never
+leave a core idle while others still have work.
+
+Positions of one game share a transposition table, allocated when the first
+of them starts and freed after the last one. Games are analysed from the last
+position back to the first, so each search finds the table filled with the
+lines that follow it.
+
+With a total time budget, each job's search time is recomputed when it
+starts from the time left and the jobs left, so positions analysed early do
+not starve the ones at the end.
+*/
+
+#ifndef BATCHANALYSIS_HPP
+#define BATCHANALYSIS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "position.hpp"
+
+/**
+ * @brief A game to analyse
+ */
+struct BatchGame {
+    Position start;
+    std::vector<Move> moves;
+};
+
+/**
+ * @brief Search result of one position, from the side to move's point of view
+ */
+struct PositionAnalysis {
+    int score;
+    int depth;
+    Move bestMove;      ///< NO_MOVE when the game is over in this position
+    uint64_t nodes;
+    int64_t timeMs;
+
+    PositionAnalysis() : score(0), depth(0), bestMove(NO_MOVE), nodes(0), timeMs(0) {}
+};
+
+struct BatchOptions {
+    int threads;
+    int64_t movetimeMs;     ///< Search time per position without a total budget
+    int64_t totalTimeMs;    ///< Budget for the whole batch, 0 to use movetimeMs
+    int maxDepth;           ///< Depth limit per position, 0 for none
+    size_t hashMbPerGame;   ///< Table shared by the positions of one game
+
+    BatchOptions() : threads(1), movetimeMs(1000), totalTimeMs(0), maxDepth(0), hashMbPerGame(16) {}
+};
+
+struct BatchStats {
+    uint64_t positions;
+    uint64_t nodes;
+    uint64_t steals;
+    double wallSeconds;
+    double busySeconds;     ///< Time spent searching, summed over threads
+    int threads;
+
+    BatchStats() : positions(0), nodes(0), steals(0), wallSeconds(0.0), busySeconds(0.0), threads(0) {}
+    double positionsPerSecond() const { return wallSeconds > 0.0 ? positions / wallSeconds : 0.0; }
+    /// Share of the threads' wall time spent searching
+    double utilization() const { return wallSeconds > 0.0 ? busySeconds / (wallSeconds * threads) : 0.0; }
+};
+
+/**
+ * @brief Analyses every position of every game on a work-stealing thread pool
+ * @param results Resized to one entry per game, each with moves.size() + 1
+ *                positions: before every move and the final one
+ * @return Throughput and utilization of the run
+ */
+BatchStats analyzeGames(const std::vector<BatchGame>& games, const BatchOptions& options,
+                        std::vector<std::vector<PositionAnalysis> >& results);
+
+#endif
@@ -0,0 +1,247 @@
+/*
+Description:
+Attack table construction. Magic multipliers are searched at startup with a
+fixed seed, which takes a few milliseconds and keeps the tables out of the
+source; with BMI2 the same tables are indexed with PEXT instead.
+*/
+
+#include <mutex>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "bitboard.hpp"
+
+namespace {
+    /**
+     * @brief Slider lookup for one square: relevant occupancy mask and table slice
+     */
+    struct SliderEntry {
+        Bitboard mask;
+        Bitboard magic;
+        unsigned shift;
+        Bitboard* attacks;
+
+        size_t index(Bitboard occupied) const {
+#if defined(__BMI2__)
+            return (size_t)_pext_u64(occupied, mask);
+#else
+            return (size_t)(((occupied & mask) * magic) >> shift);
+#endif
+        }
+    };
+
+    Bitboard pawnTable[2][64];
+    Bitboard knightTable[64];
+    Bitboard kingTable[64];
+    Bitboard betweenTable[64][64];
+    Bitboard lineTable[64][64];
+
+    SliderEntry bishopEntries[64];
+    SliderEntry rookEntries[64];
+    Bitboard bishopTable[5248];
+    Bitboard rookTable[102400];
+
+    std::once_flag initFlag;
+
+    const int ROOK_DIRECTIONS[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+    const int BISHOP_DIRECTIONS[4][2] = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+
+    bool onBoard(int file, int rank) {
+        return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+    }
+
+    Bitboard stepAttacks(int square, const int (*steps)[2], int count) {
+        Bitboard attacks = 0;
+        for (int i = 0; i < count; i++) {
+            int file = squareFile(square) + steps[i][0];
+            int rank = squareRank(square) + steps[i][1];
+            if (onBoard(file, rank)) {
+                attacks |= squareBB(makeSquare(file, rank));
+            }
+        }
+        return attacks;
+    }
+
+    /// Ray walk used to fill the tables, stopping at the first blocker
+    Bitboard slidingAttacks(int square, Bitboard occupied, const int (*directions)[2]) {
+        Bitboard attacks = 0;
+        for (int d = 0; d < 4; d++) {
+            int file = squareFile(square) + directions[d][0];
+            int rank = squareRank(square) + directions[d][1];
+            while (onBoard(file, rank)) {
+                Bitboard bb = squareBB(makeSquare(file, rank));
+                attacks |= bb;
+                if (occupied & bb) {
+                    break;
+                }
+                file += directions[d][0];
+                rank += directions[d][1];
+            }
+        }
+        return attacks;
+    }
+
+    /// xorshift64*, deterministic so the magic search always ends the same way
+    struct Random {
+        uint64_t state;
+        explicit Random(uint64_t seed) : state(seed) {}
+        uint64_t next() {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 2685821657736338717ull;
+        }
+        uint64_t sparse() { return next() & next() & next(); }
+    };
+
+    void initSliders(SliderEntry* entries, Bitboard* table, const int (*directions)[2]) {
+        std::vector<Bitboard> occupancies;
+        std::vector<Bitboard> references;
+#if !defined(__BMI2__)
+        // Magic search state: slots filled in the current attempt carry its number
+        std::vector<int> epoch(4096, 0);
+        Random random(0x9E3779B97F4A7C15ull);
+        int attempt = 0;
+#endif
+
+        Bitboard* slice = table;
+        for (int square = 0; square < 64; square++) {
+            SliderEntry& entry = entries[square];
+
+            // Edge squares never change the attack set unless the slider stands on that edge
+            Bitboard edges = ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (8 * squareRank(square)))) |
+                             ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << squareFile(square)));
+            entry.mask = slidingAttacks(square, 0, directions) & ~edges;
+            int bits = popCount(entry.mask);
+            entry.shift = 64 - bits;
+            entry.attacks = slice;
+            size_t size = (size_t)1 << bits;
+            slice += size;
+
+            // Enumerate every subset of the mask with the carry-rippler trick
+            occupancies.clear();
+            references.clear();
+            Bitboard subset = 0;
+            do {
+                occupancies.push_back(subset);
+                references.push_back(slidingAttacks(square, subset, directions));
+                subset = (subset - entry.mask) & entry.mask;
+            } while (subset);
+
+#if defined(__BMI2__)
+            entry.magic = 0;
+            for (size_t i = 0; i < occupancies.size(); i++) {
+                entry.attacks[entry.index(occupancies[i])] = references[i];
+            }
+#else
+            // Try sparse random multipliers until no two occupancies with
+            // different attacks share a slot
+            for (;;) {
+                do {
+                    entry.magic = random.sparse();
+                } while (popCount((entry.mask * entry.magic) >> 56) < 6);
+
+                attempt++;
+                size_t i = 0;
+                for (; i < occupancies.size(); i++) {
+                    size_t index = entry.index(occupancies[i]);
+                    if (epoch[index] < attempt) {
+                        epoch[index] = attempt;
+                        entry.attacks[index] = references[i];
+                    } else if (entry.attacks[index] != references[i]) {
+                        break;
+                    }
+                }
+                if (i == occupancies.size()) {
+                    break;
+                }
+            }
+#endif
+        }
+    }
+
+    void initTables() {
+        const int KNIGHT_STEPS[8][2] = { {1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                         {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2} };
+        const int KING_STEPS[8][2] = { {1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                       {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
+        const int WHITE_PAWN_STEPS[2][2] = { {-1, 1}, {1, 1} };
+        const int BLACK_PAWN_STEPS[2][2] = { {-1, -1}, {1, -1} };
+
+        for (int square = 0; square < 64; square++) {
+            knightTable[square] = stepAttacks(square, KNIGHT_STEPS, 8);
+            kingTable[square] = stepAttacks(square, KING_STEPS, 8);
+            pawnTable[WHITE][square] = stepAttacks(square, WHITE_PAWN_STEPS, 2);
+            pawnTable[BLACK][square] = stepAttacks(square, BLACK_PAWN_STEPS, 2);
+        }
+
+        initSliders(bishopEntries, bishopTable, BISHOP_DIRECTIONS);
+        initSliders(rookEntries, rookTable, ROOK_DIRECTIONS);
+
+        for (int a = 0; a < 64; a++) {
+            for (int b = 0; b < 64; b++) {
+                betweenTable[a][b] = 0;
+                lineTable[a][b] = 0;
+                if (a == b) {
+                    continue;
+                }
+                for (int type = BISHOP; type <= ROOK; type++) {
+                    if (pieceAttacks(type, a, 0) & squareBB(b)) {
+                        betweenTable[a][b] = pieceAttacks(type, a, squareBB(b)) &
+                                             pieceAttacks(type, b, squareBB(a));
+                        lineTable[a][b] = (pieceAttacks(type, a, 0) & pieceAttacks(type, b, 0)) |
+                                          squareBB(a) | squareBB(b);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void initBitboards() {
+    std::call_once(initFlag, initTables);
+}
+
+Bitboard pawnAttacks(int color, int square) {
+    return pawnTable[color][square];
+}
+
+Bitboard knightAttacks(int square) {
+    return knightTable[square];
+}
+
+Bitboard kingAttacks(int square) {
+    return kingTable[square];
+}
+
+Bitboard bishopAttacks(int square, Bitboard occupied) {
+    const SliderEntry& entry = bishopEntries[square];
+    return entry.attacks[entry.index(occupied)];
+}
+
+Bitboard rookAttacks(int square, Bitboard occupied) {
+    const SliderEntry& entry = rookEntries[square];
+    return entry.attacks[entry.index(occupied)];
+}
+
+Bitboard pieceAttacks(int type, int square, Bitboard occupied) {
+    switch (type) {
+    case KNIGHT: return knightAttacks(square);
+    case BISHOP: return bishopAttacks(square, occupied);
+    case ROOK:   return rookAttacks(square, occupied);
+    case QUEEN:  return queenAttacks(square, occupied);
+    case KING:   return kingAttacks(square);
+    default:     return 0;
+    }
+}
+
+Bitboard betweenBB(int from, int to) {
+    return betweenTable[from][to];
+}
+
+Bitboard lineBB(int a, int b) {
+    return lineTable[a][b];
+}
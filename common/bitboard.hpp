@@ -0,0 +1,104 @@
+/*
+Description:
+Bitboard primitives for the chess core. A bitboard is a 64-bit set of squares,
+bit 0 = a1, bit 7 = h1, bit 63 = h8. Leaper attacks come from precomputed tables;
+slider attacks use magic bitboards, or PEXT when the compiler targets BMI2.
+*/
+
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <stdint.h>
+
+typedef uint64_t Bitboard;
+
+enum Color { WHITE, BLACK };
+
+/// Piece types in FEN letter order "PNBRQK"
+enum PieceType { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+/// Piece = color * 6 + type, so the FEN letters "PNBRQKpnbrqk" map to 0..11
+enum Piece { NO_PIECE = 12 };
+
+const int NO_SQUARE = 64;
+
+const Bitboard FILE_A_BB = 0x0101010101010101ull;
+const Bitboard FILE_H_BB = FILE_A_BB << 7;
+const Bitboard RANK_1_BB = 0xFFull;
+const Bitboard RANK_8_BB = RANK_1_BB << 56;
+
+inline int makePiece(int color, int type) { return color * 6 + type; }
+inline int pieceColor(int piece) { return piece / 6; }
+inline int pieceType(int piece) { return piece % 6; }
+
+inline int squareFile(int square) { return square & 7; }
+inline int squareRank(int square) { return square >> 3; }
+inline int makeSquare(int file, int rank) { return rank * 8 + file; }
+
+inline Bitboard squareBB(int square) { return 1ull << square; }
+
+inline int popCount(Bitboard b) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(b);
+#else
+    int count = 0;
+    for (; b; b &= b - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/// Index of the lowest set bit; b must not be empty
+inline int lsb(Bitboard b) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(b);
+#else
+    int square = 0;
+    while (!(b & 1)) {
+        b >>= 1;
+        square++;
+    }
+    return square;
+#endif
+}
+
+/// Removes and returns the lowest set square; b must not be empty
+inline int popLsb(Bitboard& b) {
+    int square = lsb(b);
+    b &= b - 1;
+    return square;
+}
+
+/**
+ * @brief Builds all attack tables. Safe to call more than once; thread-safe.
+ * Every other function here requires it to have run.
+ */
+void initBitboards();
+
+Bitboard pawnAttacks(int color, int square);
+Bitboard knightAttacks(int square);
+Bitboard kingAttacks(int square);
+Bitboard bishopAttacks(int square, Bitboard occupied);
+Bitboard rookAttacks(int square, Bitboard occupied);
+
+inline Bitboard queenAttacks(int square, Bitboard occupied) {
+    return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+}
+
+/**
+ * @brief Attacks of a non-pawn piece type from a square
+ */
+Bitboard pieceAttacks(int type, int square, Bitboard occupied);
+
+/**
+ * @brief Squares strictly between two squares on a shared line, empty otherwise
+ */
+Bitboard betweenBB(int from, int to);
+
+/**
+ * @brief Full board line through two squares, empty if they are not aligned
+ */
+Bitboard lineBB(int a, int b);
+
+#endif
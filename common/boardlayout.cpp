@@ -0,0 +1,112 @@
+/*
+Description:
+Square based piece placement. The home transforms below are the offsets that
+were tuned by hand for the starting position; files run along +X and ranks
+along -Z in world space.
+*/
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "boardlayout.hpp"
+
+namespace {
+    /**
+     * @brief Mesh and hand-tuned transform of a piece on one of its home squares
+     */
+    struct MeshHome {
+        int mesh;
+        int file;
+        int rank;
+        glm::mat4 ModelMatrix;
+    };
+
+    glm::mat4 whiteHome(float x, float z) {
+        return glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+    }
+
+    glm::mat4 blackHome(float x) {
+        // Black meshes are turned around to face the white side
+        glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x + 5.3f, 0.0f, -12.0f));
+        return glm::rotate(ModelMatrix, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    struct HomeTable {
+        MeshHome homes[12];
+
+        HomeTable() {
+            const float s = SQUARE_SIZE;
+            // White, in Piece order (PNBRQK)
+            homes[0]  = MeshHome{ 5,  0, 1, whiteHome(-s - 27.3f, 30.0f) };
+            homes[1]  = MeshHome{ 3,  1, 0, whiteHome(-s * 5 + 22.0f, 25.0f) };
+            homes[2]  = MeshHome{ 1,  2, 0, whiteHome(-s * 3 + 11.5f, 25.0f) };
+            homes[3]  = MeshHome{ 11, 0, 0, whiteHome(-s * 7 + 34.0f, 25.0f) };
+            homes[4]  = MeshHome{ 7,  3, 0, whiteHome(-11.0f, 25.0f) };
+            homes[5]  = MeshHome{ 9,  4, 0, whiteHome(0.0f, 25.0f) };
+            // Black
+            homes[6]  = MeshHome{ 4,  0, 6, whiteHome(5.0f - s - 32.0f, 45.0f) };
+            homes[7]  = MeshHome{ 2,  1, 7, blackHome(-s * 5) };
+            homes[8]  = MeshHome{ 0,  2, 7, blackHome(-s * 3) };
+            homes[9]  = MeshHome{ 10, 0, 7, blackHome(-s * 7) };
+            homes[10] = MeshHome{ 6,  3, 7, blackHome(0.0f) };
+            homes[11] = MeshHome{ 8,  4, 7, blackHome(0.0f) };
+        }
+    };
+
+    const MeshHome* findHome(int piece) {
+        static const HomeTable table;
+        return piece >= 0 && piece < NO_PIECE ? &table.homes[piece] : NULL;
+    }
+}
+
+int pieceMesh(int piece) {
+    const MeshHome* home = findHome(piece);
+    return home ? home->mesh : -1;
+}
+
+glm::mat4 squareModelMatrix(int piece, int file, int rank) {
+    const MeshHome* home = findHome(piece);
+    if (!home) {
+        return glm::mat4(1.0f);
+    }
+    glm::vec3 offset((file - home->file) * SQUARE_SIZE, 0.0f, -(rank - home->rank) * SQUARE_SIZE);
+    return glm::translate(glm::mat4(1.0f), offset) * home->ModelMatrix;
+}
+
+glm::vec3 squareCentre(int square, const glm::vec3& offset) {
+    // The board mesh is centred on its offset, its top face slightly above y = 0
+    float x = (squareFile(square) - 3.5f) * SQUARE_SIZE;
+    float z = (3.5f - squareRank(square)) * SQUARE_SIZE;
+    return offset + glm::vec3(x, 0.5f, z);
+}
+
+glm::mat4 boardModelMatrix(const glm::vec3& offset) {
+    glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0f), offset);
+    ModelMatrix = glm::rotate(ModelMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::translate(ModelMatrix, glm::vec3(0.0f, 0.0f, 0.5f));
+}
+
+glm::vec3 boardGridOffset(int index, int count) {
+    int columns = 1;
+    while (columns * columns < count) {
+        columns++;
+    }
+    int rows = (count + columns - 1) / columns;
+    int row = index / columns;
+    int column = index % columns;
+    return glm::vec3((column - 0.5f * (columns - 1)) * BOARD_PITCH, 0.0f,
+                     (row - 0.5f * (rows - 1)) * BOARD_PITCH);
+}
+
+void buildBoardInstances(const Position& position, std::vector<PieceInstance>& pieces,
+                         const glm::vec3& offset, Bitboard skipped) {
+    glm::mat4 boardOffset = glm::translate(glm::mat4(1.0f), offset);
+    for (Bitboard occupied = position.occupied() & ~skipped; occupied; ) {
+        int square = popLsb(occupied);
+        int piece = position.pieceOn(square);
+        PieceInstance instance;
+        instance.mesh = pieceMesh(piece);
+        instance.square = square;
+        instance.ModelMatrix = boardOffset * squareModelMatrix(piece, squareFile(square), squareRank(square));
+        pieces.push_back(instance);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+Description:
+Maps chess squares to piece model matrices. Each chess piece mesh in chess.obj
+carries its own built-in offset, so every mesh has a hand-measured transform for
+its home square; any other square is reached by a world-space translation of
+whole squares from there.
+*/
+
+#ifndef BOARDLAYOUT_HPP
+#define BOARDLAYOUT_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "framepacket.hpp"
+#include "position.hpp"
+
+/// Distance between neighbouring square centres in world units
+const float SQUARE_SIZE = 5.5f;
+
+/// Distance between neighbouring board centres in a multi-board grid
+const float BOARD_PITCH = 60.0f;
+
+/**
+ * @brief Gets the mesh index in chess.obj for a piece
+ *
+ * @param piece Piece as stored in Position, see makePiece()
+ * @return Mesh index, -1 if the value is not a piece
+ */
+int pieceMesh(int piece);
+
+/**
+ * @brief Computes the model matrix placing a piece on a square
+ *
+ * @param piece Piece as stored in Position
+ * @param file File 0..7 (a..h)
+ * @param rank Rank 0..7 (1..8)
+ * @return Model matrix, identity if the value is not a piece
+ */
+glm::mat4 squareModelMatrix(int piece, int file, int rank);
+
+/**
+ * @brief World-space centre of a square on the board surface
+ *
+ * @param square Square index 0..63 (a1..h8)
+ * @param offset World-space offset of the board
+ * @return Centre of the square
+ */
+glm::vec3 squareCentre(int square, const glm::vec3& offset = glm::vec3(0.0f));
+
+/**
+ * @brief Computes the board model matrix for a board moved by offset
+ *
+ * @param offset World-space offset of the board, zero for the single-board scene
+ * @return Board model matrix
+ */
+glm::mat4 boardModelMatrix(const glm::vec3& offset);
+
+/**
+ * @brief Offset of a board in a square grid centred on the origin
+ *
+ * @param index Board index, row-major
+ * @param count Total number of boards in the grid
+ * @return World-space offset for the board
+ */
+glm::vec3 boardGridOffset(int index, int count);
+
+/**
+ * @brief Appends one piece instance per occupied square
+ *
+ * @param position Position to place
+ * @param pieces Instances to append to
+ * @param offset World-space offset of the board
+ * @param skipped Squares left out, e.g. those of pieces still being animated
+ */
+void buildBoardInstances(const Position& position, std::vector<PieceInstance>& pieces,
+                         const glm::vec3& offset = glm::vec3(0.0f), Bitboard skipped = 0);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+Description:
+Polyglot book keys, entry decoding and the binary search over the mapped file.
+All multi-byte fields in the file are big-endian.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "book.hpp"
+#include "movegen.hpp"
+
+namespace {
+    const size_t ENTRY_SIZE = 16;
+    const int RANDOM_CASTLE = 768;
+    const int RANDOM_EN_PASSANT = 772;
+    const int RANDOM_TURN = 780;
+
+    uint64_t readBigEndian(const uint8_t* bytes, int count) {
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    bool weightGreater(const BookMove& a, const BookMove& b) {
+        return a.weight > b.weight;
+    }
+}
+
+PolyglotBook::PolyglotBook() {}
+
+bool PolyglotBook::loadRandoms(const char* path) {
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+
+    randoms.clear();
+    for (size_t i = 0; i + 2 < text.size(); i++) {
+        if (text[i] != '0' || (text[i + 1] != 'x' && text[i + 1] != 'X')) {
+            continue;
+        }
+        size_t digits = i + 2;
+        while (digits < text.size() && isxdigit((unsigned char)text[digits])) {
+            digits++;
+        }
+        if (digits - (i + 2) == 16) {
+            randoms.push_back(strtoull(text.substr(i + 2, 16).c_str(), NULL, 16));
+        }
+        i = digits - 1;
+    }
+    if (randoms.size() != (size_t)POLYGLOT_RANDOM_COUNT) {
+        fprintf(stderr, "%s holds %zu Random64 constants, expected %d\n", path, randoms.size(),
+                POLYGLOT_RANDOM_COUNT);
+        randoms.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PolyglotBook::open(const char* path) {
+    // Probes jump around the file, read-ahead would only waste page cache
+    if (!file.open(path, MappedFile::ACCESS_RANDOM)) {
+        fprintf(stderr, "Could not open book %s\n", path);
+        return false;
+    }
+    if (file.size() % ENTRY_SIZE != 0) {
+        fprintf(stderr, "%s is not a Polyglot book\n", path);
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+uint64_t PolyglotBook::key(const Position& position) const {
+    uint64_t result = 0;
+    for (Bitboard occupied = position.occupied(); occupied; ) {
+        int square = popLsb(occupied);
+        int piece = position.pieceOn(square);
+        // Polyglot orders pieces black pawn, white pawn, black knight, ...
+        int kind = 2 * pieceType(piece) + (pieceColor(piece) == WHITE ? 1 : 0);
+        result ^= randoms[64 * kind + square];
+    }
+
+    int castling = position.castlingRights();
+    static const int RIGHTS[4] = { WHITE_OO, WHITE_OOO, BLACK_OO, BLACK_OOO };
+    for (int i = 0; i < 4; i++) {
+        if (castling & RIGHTS[i]) {
+            result ^= randoms[RANDOM_CASTLE + i];
+        }
+    }
+
+    // The en passant file counts only if a pawn stands ready to capture, legal or not
+    int us = position.sideToMove();
+    int epSquare = position.epSquare();
+    if (epSquare != NO_SQUARE && (pawnAttacks(us ^ 1, epSquare) & position.pieces(us, PAWN))) {
+        result ^= randoms[RANDOM_EN_PASSANT + squareFile(epSquare)];
+    }
+    if (us == WHITE) {
+        result ^= randoms[RANDOM_TURN];
+    }
+    return result;
+}
+
+uint64_t PolyglotBook::entryKey(size_t index) const {
+    return readBigEndian(file.data() + index * ENTRY_SIZE, 8);
+}
+
+size_t PolyglotBook::lowerBound(uint64_t target) const {
+    size_t low = 0;
+    size_t high = size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (entryKey(middle) < target) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+Move PolyglotBook::toMove(const Position& position, uint16_t bookMove) const {
+    int to = bookMove & 63;
+    int from = (bookMove >> 6) & 63;
+    int promotion = (bookMove >> 12) & 7;
+
+    // Castling is stored as the king taking its own rook
+    int piece = position.pieceOn(from);
+    if (piece != NO_PIECE && pieceType(piece) == KING && position.pieceOn(to) == makePiece(pieceColor(piece), ROOK)) {
+        to = to > from ? from + 2 : from - 2;
+    }
+
+    MoveList list;
+    generateLegalMoves(position, list);
+    for (int i = 0; i < list.size(); i++) {
+        Move move = list[i];
+        if (moveFrom(move) != from || moveTo(move) != to) {
+            continue;
+        }
+        // Polyglot numbers promotions knight 1 .. queen 4
+        if (isPromotion(move) ? promotionType(move) - KNIGHT + 1 == promotion : promotion == 0) {
+            return move;
+        }
+    }
+    return NO_MOVE;
+}
+
+int PolyglotBook::probe(const Position& position, std::vector<BookMove>& moves) const {
+    moves.clear();
+    if (!isOpen()) {
+        return 0;
+    }
+    uint64_t target = key(position);
+    for (size_t index = lowerBound(target); index < size() && entryKey(index) == target; index++) {
+        const uint8_t* entry = file.data() + index * ENTRY_SIZE;
+        BookMove bookMove;
+        bookMove.move = toMove(position, (uint16_t)readBigEndian(entry + 8, 2));
+        bookMove.weight = (int)readBigEndian(entry + 10, 2);
+        bookMove.learn = (uint32_t)readBigEndian(entry + 12, 4);
+        if (bookMove.move != NO_MOVE) {
+            moves.push_back(bookMove);
+        }
+    }
+    std::stable_sort(moves.begin(), moves.end(), weightGreater);
+    return (int)moves.size();
+}
+
+Move PolyglotBook::pickMove(const Position& position, uint64_t random) const {
+    std::vector<BookMove> moves;
+    if (probe(position, moves) == 0) {
+        return NO_MOVE;
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i < moves.size(); i++) {
+        total += moves[i].weight;
+    }
+    if (total == 0) {
+        return moves[0].move;
+    }
+    uint64_t pick = random % total;
+    for (size_t i = 0; i < moves.size(); i++) {
+        if (pick < (uint64_t)moves[i].weight) {
+            return moves[i].move;
+        }
+        pick -= moves[i].weight;
+    }
+    return moves[0].move;
+}
@@ -0,0 +1,98 @@
+/*
+Description:
+Polyglot opening book lookup. The .bin file is memory-mapped and searched in
+place: entries are 16 bytes sorted by position key, so a probe is a binary
+search touching a few pages, whatever the size of the book, and the pages are
+shared with every other process using the same book.
+
+Polyglot keys use the 781 Random64 constants published with the format. They
+are read from a text file (any listing of the 781 values as 0x... hex
+literals, in order, such as the one in the format description) instead of
+being compiled in.
+*/
+
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "position.hpp"
+
+const int POLYGLOT_RANDOM_COUNT = 781;
+
+/**
+ * @brief One book move for a position
+ */
+struct BookMove {
+    Move move;       ///< Legal move in the probed position
+    int weight;      ///< Relative frequency or quality
+    uint32_t learn;  ///< Learning data, unused by lookups
+};
+
+/**
+ * @brief Read-only Polyglot book
+ */
+class PolyglotBook {
+public:
+    PolyglotBook();
+
+    PolyglotBook(const PolyglotBook&) = delete;
+    PolyglotBook& operator=(const PolyglotBook&) = delete;
+
+    /**
+     * @brief Reads the Random64 constants used for book keys
+     * @param path Text file with the 781 constants as 0x hex literals
+     * @return true if exactly 781 constants were found
+     */
+    bool loadRandoms(const char* path);
+
+    /**
+     * @brief Maps a book file; nothing is read until the first probe
+     * @return true if the file could be mapped and has whole entries
+     */
+    bool open(const char* path);
+
+    bool isOpen() const { return file.isOpen() && randoms.size() == (size_t)POLYGLOT_RANDOM_COUNT; }
+
+    /// Number of entries in the book
+    size_t size() const { return file.size() / 16; }
+
+    /**
+     * @brief Polyglot key of a position
+     * Requires the constants from loadRandoms().
+     */
+    uint64_t key(const Position& position) const;
+
+    /**
+     * @brief Finds all book moves for a position
+     * Moves that are not legal in the position (key collisions) are dropped.
+     *
+     * @param moves Cleared, then filled in book order (highest weight first)
+     * @return Number of moves found
+     */
+    int probe(const Position& position, std::vector<BookMove>& moves) const;
+
+    /**
+     * @brief Picks a book move, weighted by the entry weights
+     * @param random Any value; the same value picks the same move
+     * @return Chosen move, NO_MOVE if the position is not in the book
+     */
+    Move pickMove(const Position& position, uint64_t random) const;
+
+    /**
+     * @brief Index of the first entry whose key is not less than key
+     * Exposed for latency measurements.
+     */
+    size_t lowerBound(uint64_t key) const;
+
+private:
+    uint64_t entryKey(size_t index) const;
+    Move toMove(const Position& position, uint16_t bookMove) const;
+
+    MappedFile file;
+    std::vector<uint64_t> randoms;
+};
+
+#endif
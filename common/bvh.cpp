@@ -0,0 +1,202 @@
+/*
+Description:
+Binned SAH construction and any-hit traversal of the triangle BVH.
+*/
+
+#include <math.h>
+#include <algorithm>
+
+#include "bvh.hpp"
+
+namespace {
+    const int SAH_BINS = 12;
+    const uint32_t MAX_LEAF_TRIANGLES = 4;
+
+    struct Bounds {
+        glm::vec3 low;
+        glm::vec3 high;
+        Bounds() : low(1e30f), high(-1e30f) {}
+        void grow(const glm::vec3& point) {
+            low = glm::min(low, point);
+            high = glm::max(high, point);
+        }
+        void grow(const Bounds& other) {
+            low = glm::min(low, other.low);
+            high = glm::max(high, other.high);
+        }
+        float area() const {
+            glm::vec3 size = high - low;
+            if (size.x < 0.0f) {
+                return 0.0f;
+            }
+            return size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+    };
+
+    struct Bin {
+        Bounds bounds;
+        uint32_t count;
+        Bin() : count(0) {}
+    };
+
+    bool hitsBox(const glm::vec3& origin, const glm::vec3& inverse, float maxDistance,
+                 const glm::vec3& low, const glm::vec3& high) {
+        glm::vec3 t0 = (low - origin) * inverse;
+        glm::vec3 t1 = (high - origin) * inverse;
+        glm::vec3 entries = glm::min(t0, t1);
+        glm::vec3 exits = glm::max(t0, t1);
+        float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+        float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+        return enter <= exit;
+    }
+}
+
+void TriangleBvh::build(const std::vector<glm::vec3>& triangles) {
+    uint32_t count = (uint32_t)(triangles.size() / 3);
+    nodes.clear();
+    v0.clear();
+    e1.clear();
+    e2.clear();
+    if (count == 0) {
+        return;
+    }
+    std::vector<uint32_t> order(count);
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+        centroids[i] = (triangles[3 * i] + triangles[3 * i + 1] + triangles[3 * i + 2]) / 3.0f;
+    }
+    nodes.reserve(2 * count / MAX_LEAF_TRIANGLES + 1);
+    buildNode(order, centroids, triangles, 0, count);
+
+    v0.resize(count);
+    e1.resize(count);
+    e2.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const glm::vec3* triangle = &triangles[3 * order[i]];
+        v0[i] = triangle[0];
+        e1[i] = triangle[1] - triangle[0];
+        e2[i] = triangle[2] - triangle[0];
+    }
+}
+
+uint32_t TriangleBvh::buildNode(std::vector<uint32_t>& order, std::vector<glm::vec3>& centroids,
+                                const std::vector<glm::vec3>& triangles, uint32_t first, uint32_t count) {
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(Node());
+
+    Bounds bounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; i++) {
+        const glm::vec3* triangle = &triangles[3 * order[i]];
+        bounds.grow(triangle[0]);
+        bounds.grow(triangle[1]);
+        bounds.grow(triangle[2]);
+        centroidBounds.grow(centroids[order[i]]);
+    }
+    nodes[index].low = bounds.low;
+    nodes[index].high = bounds.high;
+
+    // Pick the cheapest of the bin boundaries on the widest centroid axis
+    glm::vec3 extent = centroidBounds.high - centroidBounds.low;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int split = -1;
+    if (count > MAX_LEAF_TRIANGLES && extent[axis] > 0.0f) {
+        Bin bins[SAH_BINS];
+        float scale = SAH_BINS / extent[axis];
+        for (uint32_t i = first; i < first + count; i++) {
+            const glm::vec3* triangle = &triangles[3 * order[i]];
+            int bin = std::min(SAH_BINS - 1, (int)((centroids[order[i]][axis] - centroidBounds.low[axis]) * scale));
+            bins[bin].count++;
+            bins[bin].bounds.grow(triangle[0]);
+            bins[bin].bounds.grow(triangle[1]);
+            bins[bin].bounds.grow(triangle[2]);
+        }
+        // Costs of everything left of each boundary, then sweep from the right
+        float leftCost[SAH_BINS - 1];
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (int i = 0; i < SAH_BINS - 1; i++) {
+            left.grow(bins[i].bounds);
+            leftCount += bins[i].count;
+            leftCost[i] = left.area() * leftCount;
+        }
+        Bounds right;
+        uint32_t rightCount = 0;
+        float best = bounds.area() * count;
+        for (int i = SAH_BINS - 1; i > 0; i--) {
+            right.grow(bins[i].bounds);
+            rightCount += bins[i].count;
+            float cost = leftCost[i - 1] + right.area() * rightCount;
+            if (cost < best) {
+                best = cost;
+                split = i;
+            }
+        }
+        if (split >= 0) {
+            uint32_t* middle = std::partition(&order[first], &order[first] + count, [&](uint32_t triangle) {
+                int bin = std::min(SAH_BINS - 1, (int)((centroids[triangle][axis] - centroidBounds.low[axis]) * scale));
+                return bin < split;
+            });
+            uint32_t leftTriangles = (uint32_t)(middle - &order[first]);
+            if (leftTriangles == 0 || leftTriangles == count) {
+                split = -1;
+            } else {
+                buildNode(order, centroids, triangles, first, leftTriangles);
+                uint32_t rightChild = buildNode(order, centroids, triangles, first + leftTriangles, count - leftTriangles);
+                nodes[index].first = rightChild;
+                nodes[index].count = 0;
+                return index;
+            }
+        }
+    }
+    // A leaf when small enough or when no split beats keeping the triangles together
+    nodes[index].first = first;
+    nodes[index].count = count;
+    return index;
+}
+
+bool TriangleBvh::occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    uint32_t stack[128];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Node& node = nodes[stack[--depth]];
+        if (!hitsBox(origin, inverse, maxDistance, node.low, node.high)) {
+            continue;
+        }
+        if (node.count == 0) {
+            uint32_t self = (uint32_t)(&node - &nodes[0]);
+            stack[depth++] = node.first;
+            stack[depth++] = self + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            // Moller-Trumbore
+            glm::vec3 p = glm::cross(direction, e2[i]);
+            float determinant = glm::dot(e1[i], p);
+            if (fabsf(determinant) < 1e-12f) {
+                continue;
+            }
+            float inverseDeterminant = 1.0f / determinant;
+            glm::vec3 s = origin - v0[i];
+            float u = glm::dot(s, p) * inverseDeterminant;
+            if (u < 0.0f || u > 1.0f) {
+                continue;
+            }
+            glm::vec3 q = glm::cross(s, e1[i]);
+            float v = glm::dot(direction, q) * inverseDeterminant;
+            if (v < 0.0f || u + v > 1.0f) {
+                continue;
+            }
+            float t = glm::dot(e2[i], q) * inverseDeterminant;
+            if (t > 0.0f && t < maxDistance) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
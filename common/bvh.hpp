@@ -0,0 +1,61 @@
+/*
+Description:
+Bounding volume hierarchy over a static triangle soup, for shadow and
+occlusion rays. Built once with binned SAH splits into a flat node array, then
+traversed read-only, so any number of threads can query it at once.
+*/
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief BVH answering whether a ray segment hits any triangle
+ */
+class TriangleBvh {
+public:
+    /**
+     * @brief Builds the hierarchy, replacing any previous one
+     *
+     * @param triangles Three vertices per triangle
+     */
+    void build(const std::vector<glm::vec3>& triangles);
+
+    /**
+     * @brief Tests a ray segment against the triangles, stopping at the first hit
+     * Both sides of every triangle block the ray.
+     *
+     * @param origin Start of the segment
+     * @param direction Unit direction
+     * @param maxDistance Length of the segment
+     * @return true if a triangle lies between origin and origin + direction * maxDistance
+     */
+    bool occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+    size_t triangleCount() const { return v0.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    /// Leaves hold count > 0 triangles from first; inner nodes have count 0,
+    /// their left child right after them and the right child at first
+    struct Node {
+        glm::vec3 low;
+        uint32_t first;
+        glm::vec3 high;
+        uint32_t count;
+    };
+
+    uint32_t buildNode(std::vector<uint32_t>& order, std::vector<glm::vec3>& centroids,
+                       const std::vector<glm::vec3>& triangles, uint32_t first, uint32_t count);
+
+    std::vector<Node> nodes;
+    // Triangles in leaf order, as a vertex and two edges for the intersection test
+    std::vector<glm::vec3> v0;
+    std::vector<glm::vec3> e1;
+    std::vector<glm::vec3> e2;
+};
+
+#endif
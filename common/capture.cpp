@@ -0,0 +1,223 @@
+/*
+Description:
+Video capture implementation: PBO ring on the render thread, colour conversion
+and file output on the encoder thread.
+*/
+
+#include <string.h>
+
+#include "capture.hpp"
+
+namespace {
+    /// Frames waiting for the encoder before new ones are dropped
+    const size_t MAX_QUEUED_FRAMES = 8;
+
+    unsigned char clampByte(int value) {
+        return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    bool endsWith(const std::string& text, const char* suffix) {
+        size_t length = strlen(suffix);
+        return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+    }
+}
+
+VideoCapture::VideoCapture()
+    : file(NULL), y4m(false), frameWidth(0), frameHeight(0),
+      frameCounter(0), written(0), dropped(0), stopping(false) {}
+
+VideoCapture::~VideoCapture() {
+    stop();
+}
+
+bool VideoCapture::start(const char* path, int width, int height, int fps) {
+    stop();
+    if (!ring.init(width, height, 4)) {
+        fprintf(stderr, "Error: Could not create capture buffers\n");
+        return false;
+    }
+    file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s for writing\n", path);
+        ring.release();
+        return false;
+    }
+
+    y4m = endsWith(path, ".y4m");
+    frameWidth = width;
+    frameHeight = height;
+    frameCounter = 0;
+    written = 0;
+    dropped = 0;
+    if (y4m) {
+        // C420jpeg only gives the chroma siting; without XCOLORRANGE readers assume limited range
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, fps);
+    }
+
+    stopping = false;
+    encoder = std::thread(&VideoCapture::runEncoder, this);
+    printf("Recording %dx%d to %s\n", width, height, path);
+    return true;
+}
+
+void VideoCapture::captureFrame() {
+    if (!file) {
+        return;
+    }
+    // Take whatever the GPU has finished first, so a slot is usually free
+    forwardFinished(false);
+    if (!ring.enqueue(frameCounter++)) {
+        dropped++;
+    }
+}
+
+void VideoCapture::stop() {
+    if (!file) {
+        return;
+    }
+    // Each attempt waits up to a second on the oldest frame. Failed frames free
+    // their slot, so only a GPU that never finishes runs out of attempts.
+    const int MAX_ATTEMPTS = 8;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS && !ring.empty(); attempt++) {
+        forwardFinished(true);
+    }
+    if (!ring.empty()) {
+        fprintf(stderr, "Error: Gave up waiting for %d captured frames\n", ring.inFlight());
+        dropped += ring.inFlight();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    frameAvailable.notify_one();
+    encoder.join();
+    ring.release();
+
+    fclose(file);
+    file = NULL;
+    printf("Recording stopped: %lld frames written, %lld dropped\n", written.load(), dropped);
+}
+
+void VideoCapture::forwardFinished(bool wait) {
+    while (!ring.empty()) {
+        std::vector<unsigned char> pixels;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeFrames.empty()) {
+                pixels.swap(freeFrames.back());
+                freeFrames.pop_back();
+            }
+        }
+
+        long long tag;
+        PboRing::Status status = ring.dequeue(pixels, tag, wait);
+        if (status != PboRing::READY) {
+            // Keep the buffer for the next frame rather than dropping it
+            if (pixels.capacity() > 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                freeFrames.push_back(std::vector<unsigned char>());
+                freeFrames.back().swap(pixels);
+            }
+            if (status == PboRing::PENDING) {
+                return;
+            }
+            dropped++;
+            continue;
+        }
+        wait = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (frames.size() >= MAX_QUEUED_FRAMES) {
+            // The encoder is behind; dropping keeps the render loop unaffected
+            dropped++;
+            freeFrames.push_back(std::vector<unsigned char>());
+            freeFrames.back().swap(pixels);
+            continue;
+        }
+        frames.push_back(std::vector<unsigned char>());
+        frames.back().swap(pixels);
+        lock.unlock();
+        frameAvailable.notify_one();
+    }
+}
+
+void VideoCapture::runEncoder() {
+    for (;;) {
+        std::vector<unsigned char> rgba;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameAvailable.wait(lock, [this] { return stopping || !frames.empty(); });
+            if (frames.empty()) {
+                return;
+            }
+            rgba.swap(frames.front());
+            frames.pop_front();
+        }
+
+        if (writeFrame(rgba)) {
+            written++;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeFrames.push_back(std::vector<unsigned char>());
+        freeFrames.back().swap(rgba);
+    }
+}
+
+bool VideoCapture::writeFrame(const std::vector<unsigned char>& rgba) {
+    const int w = frameWidth;
+    const int h = frameHeight;
+
+    if (!y4m) {
+        // Raw RGB24, top row first
+        planes.resize((size_t)w * h * 3);
+        for (int y = 0; y < h; y++) {
+            const unsigned char* src = &rgba[(size_t)(h - 1 - y) * w * 4];
+            unsigned char* dst = &planes[(size_t)y * w * 3];
+            for (int x = 0; x < w; x++, src += 4, dst += 3) {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+        return fwrite(&planes[0], 1, planes.size(), file) == planes.size();
+    }
+
+    // Full range BT.601 (XCOLORRANGE=FULL in the header), chroma centred between samples
+    // as C420jpeg says, integer coefficients scaled by 256
+    const int cw = (w + 1) / 2;
+    const int ch = (h + 1) / 2;
+    planes.resize((size_t)w * h + 2 * (size_t)cw * ch);
+    unsigned char* yPlane = &planes[0];
+    unsigned char* uPlane = yPlane + (size_t)w * h;
+    unsigned char* vPlane = uPlane + (size_t)cw * ch;
+
+    for (int y = 0; y < h; y++) {
+        const unsigned char* src = &rgba[(size_t)(h - 1 - y) * w * 4];
+        unsigned char* dst = yPlane + (size_t)y * w;
+        for (int x = 0; x < w; x++, src += 4) {
+            dst[x] = clampByte((77 * src[0] + 150 * src[1] + 29 * src[2] + 128) >> 8);
+        }
+    }
+
+    // Chroma from the average of each 2x2 block
+    for (int cy = 0; cy < ch; cy++) {
+        int y0 = 2 * cy;
+        int y1 = y0 + 1 < h ? y0 + 1 : y0;
+        const unsigned char* row0 = &rgba[(size_t)(h - 1 - y0) * w * 4];
+        const unsigned char* row1 = &rgba[(size_t)(h - 1 - y1) * w * 4];
+        for (int cx = 0; cx < cw; cx++) {
+            int x0 = 2 * cx;
+            int x1 = x0 + 1 < w ? x0 + 1 : x0;
+            int r = row0[x0 * 4] + row0[x1 * 4] + row1[x0 * 4] + row1[x1 * 4];
+            int g = row0[x0 * 4 + 1] + row0[x1 * 4 + 1] + row1[x0 * 4 + 1] + row1[x1 * 4 + 1];
+            int b = row0[x0 * 4 + 2] + row0[x1 * 4 + 2] + row1[x0 * 4 + 2] + row1[x1 * 4 + 2];
+            uPlane[(size_t)cy * cw + cx] = clampByte(((-43 * r - 85 * g + 128 * b) >> 10) + 128);
+            vPlane[(size_t)cy * cw + cx] = clampByte(((128 * r - 107 * g - 21 * b) >> 10) + 128);
+        }
+    }
+
+    static const char frameHeader[] = "FRAME\n";
+    return fwrite(frameHeader, 1, sizeof(frameHeader) - 1, file) == sizeof(frameHeader) - 1 &&
+           fwrite(&planes[0], 1, planes.size(), file) == planes.size();
+}
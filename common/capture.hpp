@@ -0,0 +1,86 @@
+/*
+Description:
+Video capture of the rendered frames. Frames are read back through a PBO ring so
+the render thread never waits for the GPU, and a separate encoder thread converts
+them and writes an uncompressed YUV4MPEG2 (.y4m) or raw RGB24 stream. When the
+encoder or the GPU falls behind, frames are dropped instead of stalling rendering.
+*/
+
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "readback.hpp"
+
+/**
+ * @brief Records the bound read framebuffer to a video file
+ */
+class VideoCapture {
+public:
+    VideoCapture();
+    ~VideoCapture();
+
+    VideoCapture(const VideoCapture&) = delete;
+    VideoCapture& operator=(const VideoCapture&) = delete;
+
+    /**
+     * @brief Opens the output file and starts the encoder thread
+     * Requires a current GL context. Paths ending in ".y4m" produce YUV4MPEG2
+     * 4:2:0, anything else a headerless top-down RGB24 stream.
+     *
+     * @param path Output file path
+     * @param width Capture width in pixels, normally the framebuffer width
+     * @param height Capture height in pixels
+     * @param fps Frame rate written to the stream header
+     * @return true if recording started
+     */
+    bool start(const char* path, int width, int height, int fps = 60);
+
+    /**
+     * @brief Queues a readback of the current frame and forwards finished ones
+     * Call after drawing and before swapping buffers.
+     */
+    void captureFrame();
+
+    /**
+     * @brief Flushes pending frames, stops the encoder and closes the file
+     */
+    void stop();
+
+    bool recording() const { return file != NULL; }
+    long long framesWritten() const { return written.load(); }
+    long long framesDropped() const { return dropped; }
+
+private:
+    void forwardFinished(bool wait);
+    void runEncoder();
+    bool writeFrame(const std::vector<unsigned char>& rgba);
+
+    PboRing ring;
+    FILE* file;
+    bool y4m;
+    int frameWidth;
+    int frameHeight;
+    long long frameCounter;
+    std::atomic<long long> written; ///< Incremented by the encoder thread
+    long long dropped;
+
+    // Encoder thread hand-off
+    std::thread encoder;
+    std::deque<std::vector<unsigned char> > frames;
+    std::vector<std::vector<unsigned char> > freeFrames;
+    std::mutex mutex;
+    std::condition_variable frameAvailable;
+    bool stopping;
+    std::vector<unsigned char> planes; ///< Encoder-side conversion buffer
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "controls.hpp"
+#include "input.hpp"
 
 // View and projection matrices
 namespace {
@@ -16,9 +17,8 @@ namespace {
     const float SPEED = 6.0f;         // 3 units per second
     const float MOUSE_SPEED = 0.005f;
 
-    // Window dimensions
-    const int WINDOW_WIDTH = 1024;
-    const int WINDOW_HEIGHT = 768;
+    // Timestamp of the oldest input folded into the current matrices
+    double cameraInputTime = -1.0;
 }
 bool lightEnabled = true;         // Initial light state
 
@@ -30,48 +30,49 @@ glm::mat4 getProjectionMatrix() {
     return ProjectionMatrix;
 }
 
+double getCameraInputTime() {
+    return cameraInputTime;
+}
+
+void setCameraDistance(float distance) {
+    radialDistance = std::fmax(0.1f, distance);
+}
+
 /**
- * @brief Handles keyboard input for camera movement
+ * @brief Applies held keys and toggles gathered by the input callbacks
  * @param deltaTime Time elapsed since last frame
+ * @param input Input accumulated since the last frame
  */
-void handleKeyboardInput(float deltaTime) {
+void handleKeyboardInput(float deltaTime, const InputState& input) {
     // Radial movement (W/S)
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_W)) {
         radialDistance -= deltaTime * SPEED;
         radialDistance = std::fmax(0.1f, radialDistance); // Prevent getting too close
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_S)) {
         radialDistance += deltaTime * SPEED;
     }
 
     // Horizontal rotation (A/D)
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_A)) {
         horizontalAngle -= deltaTime * SPEED;
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_D)) {
         horizontalAngle += deltaTime * SPEED;
     }
 
     // Vertical rotation (Up/Down)
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_UP)) {
         verticalAngle += deltaTime * SPEED;
     }
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+    if (isKeyDown(GLFW_KEY_DOWN)) {
         verticalAngle -= deltaTime * SPEED;
     }
 
-    // Light toggle (L)
-    static bool lastLState = false;
-    bool currentLState = (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS);
-    if (currentLState && !lastLState) {
+    // Light toggle (L), an even number of presses cancels out
+    if (input.lightToggles % 2 != 0) {
         lightEnabled = !lightEnabled;
     }
-    lastLState = currentLState;
-
-    // Exit application (ESC)
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, GL_TRUE);
-    }
 }
 
 /**
@@ -84,17 +85,16 @@ void computeMatricesFromInputs() {
     double currentTime = glfwGetTime();
     float deltaTime = float(currentTime - lastTime);
 
-    // Mouse position handling
-    double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
-    glfwSetCursorPos(window, WINDOW_WIDTH/2, WINDOW_HEIGHT/2);
+    // Take everything the callbacks gathered since the last frame
+    InputState input = consumeInput();
+    cameraInputTime = input.eventTime;
 
     // Update angles based on mouse movement
-    horizontalAngle += MOUSE_SPEED * float(WINDOW_WIDTH/2 - xpos);
-    verticalAngle   += MOUSE_SPEED * float(WINDOW_HEIGHT/2 - ypos);
+    horizontalAngle -= MOUSE_SPEED * float(input.mouseDeltaX);
+    verticalAngle   -= MOUSE_SPEED * float(input.mouseDeltaY);
 
     // Handle keyboard input
-    handleKeyboardInput(deltaTime);
+    handleKeyboardInput(deltaTime, input);
 
     // Convert spherical coordinates to Cartesian
     glm::vec3 direction(
@@ -116,7 +116,9 @@ void computeMatricesFromInputs() {
 
     // Update matrices
     float FoV = initialFoV;
-    ProjectionMatrix = glm::perspective(glm::radians(FoV), 4.0f/3.0f, 0.1f, 100.0f);
+    // Far plane follows the camera out so large board grids stay visible
+    float farPlane = std::fmax(100.0f, radialDistance * 3.0f);
+    ProjectionMatrix = glm::perspective(glm::radians(FoV), 4.0f/3.0f, 0.1f, farPlane);
     ViewMatrix = glm::lookAt(
         position,           // Camera position
         glm::vec3(0,0,0),  // Look at origin
@@ -31,9 +31,23 @@ glm::mat4 getViewMatrix();
  */
 glm::mat4 getProjectionMatrix();
 
+/**
+ * @brief Gets the timestamp of the oldest input event used by the current matrices
+ * @return glfwGetTime() of the event, negative if the last update had no input
+ */
+double getCameraInputTime();
+
+/**
+ * @brief Sets the distance of the orbiting camera from the origin
+ * Call before the simulation starts, e.g. to frame a grid of boards
+ * @param distance Radial distance in world units
+ */
+void setCameraDistance(float distance);
+
 /**
  * @brief Updates camera matrices based on user input
- * Handles keyboard and mouse input to control camera position and orientation
+ * Consumes the events gathered by the input callbacks since the previous call,
+ * so it should run as late as possible before the frame is submitted
  */
 void computeMatricesFromInputs();
 extern bool lightEnabled;
@@ -0,0 +1,190 @@
+/*
+Description:
+Material and piece-square evaluation. The default piece-square tables are
+generated from a few simple terms (centralisation, pawn advancement, king
+shelter) rather than listed square by square.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "evaluate.hpp"
+
+namespace {
+    const int PHASE_WEIGHT[6] = { 0, 1, 1, 2, 4, 0 };
+    const char* const PHASE_NAMES[2] = { "mg", "eg" };
+    const char* const TYPE_NAMES[6] = { "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+    /**
+     * @brief Reads a line label followed by count integers
+     */
+    bool readLine(FILE* in, const char* label, const char* phase, const char* type, int* values, int count) {
+        char word[3][16];
+        if (fscanf(in, "%15s %15s", word[0], word[1]) != 2 || strcmp(word[0], label) != 0 ||
+            strcmp(word[1], phase) != 0) {
+            return false;
+        }
+        if (type && (fscanf(in, "%15s", word[2]) != 1 || strcmp(word[2], type) != 0)) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (fscanf(in, "%d", &values[i]) != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Distance from the centre: 0 on d4/e4/d5/e5, 3 in the corners
+    int centreDistance(int square) {
+        int file = squareFile(square);
+        int rank = squareRank(square);
+        int fileDistance = file < 4 ? 3 - file : file - 4;
+        int rankDistance = rank < 4 ? 3 - rank : rank - 4;
+        return fileDistance > rankDistance ? fileDistance : rankDistance;
+    }
+
+    void fillDefaultTables(EvalWeights& weights) {
+        static const int MATERIAL[2][6] = { { 82, 337, 365, 477, 1025, 0 },
+                                            { 94, 281, 297, 512, 936, 0 } };
+        for (int phase = 0; phase < 2; phase++) {
+            for (int type = 0; type < 6; type++) {
+                weights.material[phase][type] = MATERIAL[phase][type];
+            }
+        }
+
+        for (int square = 0; square < 64; square++) {
+            int file = squareFile(square);
+            int rank = squareRank(square);
+            int centre = centreDistance(square);
+            bool centreFile = file == 3 || file == 4;
+
+            weights.pst[MIDGAME][PAWN][square] = (rank >= 1 && rank <= 6) ? (rank - 1) * 5 + (centreFile ? rank * 4 : 0) : 0;
+            weights.pst[ENDGAME][PAWN][square] = (rank >= 1 && rank <= 6) ? (rank - 1) * 12 : 0;
+
+            weights.pst[MIDGAME][KNIGHT][square] = 20 - centre * 14;
+            weights.pst[ENDGAME][KNIGHT][square] = 15 - centre * 12;
+
+            weights.pst[MIDGAME][BISHOP][square] = 10 - centre * 6;
+            weights.pst[ENDGAME][BISHOP][square] = 8 - centre * 5;
+
+            weights.pst[MIDGAME][ROOK][square] = (rank == 6 ? 15 : 0) + (centreFile ? 5 : 0);
+            weights.pst[ENDGAME][ROOK][square] = rank == 6 ? 10 : 0;
+
+            weights.pst[MIDGAME][QUEEN][square] = 5 - centre * 3;
+            weights.pst[ENDGAME][QUEEN][square] = 10 - centre * 6;
+
+            // Castled kings stay behind their pawns; in the endgame the king joins in
+            bool shelter = rank == 0 && (file <= 2 || file >= 6);
+            weights.pst[MIDGAME][KING][square] = (shelter ? 25 : 0) - rank * 20 - (centreFile ? 10 : 0);
+            weights.pst[ENDGAME][KING][square] = 20 - centre * 15;
+        }
+
+        weights.bishopPair[MIDGAME] = 30;
+        weights.bishopPair[ENDGAME] = 50;
+        weights.tempo = 10;
+    }
+}
+
+EvalWeights defaultEvalWeights() {
+    EvalWeights weights;
+    fillDefaultTables(weights);
+    return weights;
+}
+
+bool saveEvalWeights(const char* path, const EvalWeights& weights) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return false;
+    }
+    for (int phase = 0; phase < 2; phase++) {
+        fprintf(out, "material %s", PHASE_NAMES[phase]);
+        for (int type = 0; type < 6; type++) {
+            fprintf(out, " %d", weights.material[phase][type]);
+        }
+        fprintf(out, "\n");
+    }
+    for (int phase = 0; phase < 2; phase++) {
+        for (int type = 0; type < 6; type++) {
+            fprintf(out, "pst %s %s", PHASE_NAMES[phase], TYPE_NAMES[type]);
+            for (int square = 0; square < 64; square++) {
+                fprintf(out, " %d", weights.pst[phase][type][square]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    fprintf(out, "bishopPair all %d %d\ntempo all %d\n", weights.bishopPair[MIDGAME], weights.bishopPair[ENDGAME],
+            weights.tempo);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool loadEvalWeights(const char* path, EvalWeights& weights) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    EvalWeights loaded;
+    bool ok = true;
+    for (int phase = 0; phase < 2 && ok; phase++) {
+        ok = readLine(in, "material", PHASE_NAMES[phase], NULL, loaded.material[phase], 6);
+    }
+    for (int phase = 0; phase < 2 && ok; phase++) {
+        for (int type = 0; type < 6 && ok; type++) {
+            ok = readLine(in, "pst", PHASE_NAMES[phase], TYPE_NAMES[type], loaded.pst[phase][type], 64);
+        }
+    }
+    ok = ok && readLine(in, "bishopPair", "all", NULL, loaded.bishopPair, 2);
+    ok = ok && readLine(in, "tempo", "all", NULL, &loaded.tempo, 1);
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not an evaluation weights file\n", path);
+        return false;
+    }
+    weights = loaded;
+    return true;
+}
+
+EvalWeights& evalWeights() {
+    static EvalWeights weights = defaultEvalWeights();
+    return weights;
+}
+
+int gamePhase(const Position& position) {
+    int phase = 0;
+    for (int type = KNIGHT; type <= QUEEN; type++) {
+        phase += PHASE_WEIGHT[type] * popCount(position.pieces(WHITE, type) | position.pieces(BLACK, type));
+    }
+    return phase < PHASE_TOTAL ? phase : PHASE_TOTAL;
+}
+
+int evaluate(const Position& position) {
+    const EvalWeights& weights = evalWeights();
+    int score[2] = { 0, 0 };
+
+    for (int color = WHITE; color <= BLACK; color++) {
+        int sign = color == WHITE ? 1 : -1;
+        int mirror = color == WHITE ? 0 : 56;
+        for (int type = PAWN; type <= KING; type++) {
+            for (Bitboard b = position.pieces(color, type); b; ) {
+                int square = popLsb(b) ^ mirror;
+                score[MIDGAME] += sign * (weights.material[MIDGAME][type] + weights.pst[MIDGAME][type][square]);
+                score[ENDGAME] += sign * (weights.material[ENDGAME][type] + weights.pst[ENDGAME][type][square]);
+            }
+        }
+        if (popCount(position.pieces(color, BISHOP)) >= 2) {
+            score[MIDGAME] += sign * weights.bishopPair[MIDGAME];
+            score[ENDGAME] += sign * weights.bishopPair[ENDGAME];
+        }
+    }
+
+    int phase = gamePhase(position);
+    int blended = (score[MIDGAME] * phase + score[ENDGAME] * (PHASE_TOTAL - phase)) / PHASE_TOTAL;
+    int relative = position.sideToMove() == WHITE ? blended : -blended;
+    return relative + weights.tempo;
+}
@@ -0,0 +1,65 @@
+/*
+Description:
+Hand-written static evaluation: material and piece-square tables, tapered
+between middlegame and endgame by the remaining non-pawn material. All weights
+live in one table so they can be inspected or replaced at run time.
+*/
+
+#ifndef EVALUATE_HPP
+#define EVALUATE_HPP
+
+#include "position.hpp"
+
+/// Middlegame / endgame index into the weight tables
+enum GamePhase { MIDGAME, ENDGAME };
+
+/// Phase weight of a full set of non-pawn pieces (4 minors x1, 2 rooks x2, 1 queen x4, per side)
+const int PHASE_TOTAL = 24;
+
+/**
+ * @brief Evaluation weights in centipawns, from white's point of view
+ * Piece-square values are indexed by the square as seen from the piece's own
+ * side, so black pieces use the vertically mirrored square.
+ */
+struct EvalWeights {
+    int material[2][6];
+    int pst[2][6][64];
+    int bishopPair[2];
+    int tempo;
+};
+
+/**
+ * @brief Weights used by evaluate(); starts out with the built-in defaults
+ */
+EvalWeights& evalWeights();
+
+/**
+ * @brief Built-in default weights
+ */
+EvalWeights defaultEvalWeights();
+
+/**
+ * @brief Writes weights as text, one table per line, e.g. for tuned weights
+ * @return true on success
+ */
+bool saveEvalWeights(const char* path, const EvalWeights& weights);
+
+/**
+ * @brief Reads weights written by saveEvalWeights()
+ * @return true on success; the weights are left unchanged otherwise
+ */
+bool loadEvalWeights(const char* path, EvalWeights& weights);
+
+/**
+ * @brief Game phase of a position
+ * @return PHASE_TOTAL for the opening material, 0 for bare kings and pawns
+ */
+int gamePhase(const Position& position);
+
+/**
+ * @brief Static evaluation of a position
+ * @return Score in centipawns from the side to move's point of view
+ */
+int evaluate(const Position& position);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+Description:
+Offscreen render target implementation.
+*/
+
+#include <stdio.h>
+
+#include "framebuffer.hpp"
+
+namespace {
+    bool createFramebuffer(int width, int height, int samples,
+                           GLuint& framebuffer, GLuint& color, GLuint& depth) {
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Error: Incomplete framebuffer (0x%x)\n", status);
+            return false;
+        }
+        return true;
+    }
+}
+
+OffscreenTarget::OffscreenTarget()
+    : renderFramebuffer(0), resolveFramebuffer(0), renderColor(0), renderDepth(0),
+      resolveColor(0), resolveDepth(0), targetWidth(0), targetHeight(0), multisampled(false) {}
+
+OffscreenTarget::~OffscreenTarget() {
+    release();
+}
+
+bool OffscreenTarget::init(int width, int height, int samples) {
+    release();
+    targetWidth = width;
+    targetHeight = height;
+    multisampled = samples > 1;
+
+    bool complete = createFramebuffer(width, height, 0, resolveFramebuffer, resolveColor, resolveDepth);
+    if (multisampled) {
+        complete = createFramebuffer(width, height, samples, renderFramebuffer, renderColor, renderDepth) && complete;
+    } else {
+        renderFramebuffer = resolveFramebuffer;
+    }
+    return complete;
+}
+
+void OffscreenTarget::release() {
+    if (multisampled) {
+        glDeleteFramebuffers(1, &renderFramebuffer);
+        glDeleteRenderbuffers(1, &renderColor);
+        glDeleteRenderbuffers(1, &renderDepth);
+    }
+    if (resolveFramebuffer) {
+        glDeleteFramebuffers(1, &resolveFramebuffer);
+        glDeleteRenderbuffers(1, &resolveColor);
+        glDeleteRenderbuffers(1, &resolveDepth);
+    }
+    renderFramebuffer = resolveFramebuffer = 0;
+    renderColor = renderDepth = resolveColor = resolveDepth = 0;
+    multisampled = false;
+}
+
+void OffscreenTarget::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, renderFramebuffer);
+    glViewport(0, 0, targetWidth, targetHeight);
+}
+
+void OffscreenTarget::resolve() {
+    if (multisampled) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, renderFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer);
+        glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, targetWidth, targetHeight,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer);
+}
@@ -0,0 +1,64 @@
+/*
+Description:
+Offscreen render target for rendering without a visible window. Renders into a
+multisampled framebuffer and resolves into a single-sample one that can be read
+back with glReadPixels.
+*/
+
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include <GL/glew.h>
+
+/**
+ * @brief Multisampled colour/depth framebuffer with a single-sample resolve target
+ */
+class OffscreenTarget {
+public:
+    OffscreenTarget();
+    ~OffscreenTarget();
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    /**
+     * @brief Creates the framebuffers
+     *
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param samples MSAA sample count, 0 or 1 to render directly into the resolve target
+     * @return true if both framebuffers are complete
+     */
+    bool init(int width, int height, int samples = 4);
+
+    /**
+     * @brief Deletes framebuffers and renderbuffers
+     */
+    void release();
+
+    /**
+     * @brief Binds the render framebuffer for drawing and sets the viewport
+     */
+    void bind();
+
+    /**
+     * @brief Resolves multisampling and binds the result as GL_READ_FRAMEBUFFER
+     */
+    void resolve();
+
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+private:
+    GLuint renderFramebuffer;
+    GLuint resolveFramebuffer;
+    GLuint renderColor;
+    GLuint renderDepth;
+    GLuint resolveColor;
+    GLuint resolveDepth;
+    int targetWidth;
+    int targetHeight;
+    bool multisampled;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+Description:
+Frame packet produced by the simulation thread and consumed by the render
+thread. A packet holds everything needed to submit one frame, so the render
+thread never touches camera, input or game state directly.
+*/
+
+#ifndef FRAMEPACKET_HPP
+#define FRAMEPACKET_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief One chess piece to draw: which mesh and where
+ */
+struct PieceInstance {
+    int mesh;              ///< Index into the loaded chess piece meshes
+    int board;             ///< Board the piece belongs to
+    int square;            ///< Square it stands or lands on, -1 if it cannot be picked
+    glm::mat4 ModelMatrix; ///< Model transformation matrix
+
+    PieceInstance() : mesh(-1), board(0), square(-1) {}
+};
+
+/**
+ * @brief Point lights sorted into the clusters of the camera frustum, see lighting.hpp
+ */
+struct ClusteredLights {
+    std::vector<glm::vec4> lights;   ///< Two per light: view-space position and radius, colour and power
+    std::vector<uint32_t> ranges;    ///< Two per cluster: first entry in indices and light count; empty if no lights
+    std::vector<uint16_t> indices;   ///< Light numbers, cluster after cluster
+    float zNear;                     ///< Camera depth range the clusters were built for
+    float zFar;
+
+    ClusteredLights() : zNear(0.1f), zFar(100.0f) {}
+};
+
+/**
+ * @brief Complete, immutable description of a frame once published
+ */
+struct FramePacket {
+    glm::mat4 ViewMatrix;       ///< Camera view matrix
+    glm::mat4 ProjectionMatrix; ///< Camera projection matrix
+    glm::vec3 lightPosition;    ///< Light position in world space
+    bool lightEnabled;          ///< Diffuse/specular lighting toggle
+    double inputTime;           ///< Oldest input event in this packet, negative if none
+    unsigned long frameNumber;  ///< Increasing packet counter
+    unsigned long layoutVersion; ///< Changes whenever boards or pieces change
+    unsigned long staticVersion; ///< Changes whenever boards or pieces at rest change
+
+    std::vector<glm::mat4> boards;     ///< Model matrix of every board to draw
+    std::vector<PieceInstance> pieces; ///< Piece instances to draw: pieces at rest, then moving ones
+    size_t restingPieces;              ///< Number of pieces at rest at the front of pieces
+    ClusteredLights pointLights;       ///< Lamps besides the scene light, rebuilt every packet
+
+    FramePacket()
+        : lightPosition(0.0f), lightEnabled(true), inputTime(-1.0), frameNumber(0),
+          layoutVersion(0), staticVersion(0), restingPieces(0) {}
+};
+
+#endif
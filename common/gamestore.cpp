@@ -0,0 +1,426 @@
+/*
+Description:
+Binary game store: encoding games into batches, writing the store file and
+random access to the mapped file.
+*/
+
+#include <string.h>
+
+#include "gamestore.hpp"
+#include "movegen.hpp"
+
+namespace {
+    const size_t HEADER_SIZE = 64;
+    const size_t RECORD_SIZE = 32;
+    const uint32_t FORMAT_VERSION = 1;
+    const uint8_t FLAG_STANDARD_START = 1;
+
+    /// Piece letters indexed by piece, white then black
+    const char* const PIECE_LETTERS = "PNBRQKpnbrqk";
+
+    // The format is little endian, like every platform the project builds on
+    void writeU32(uint8_t* out, uint32_t value) { memcpy(out, &value, 4); }
+    void writeU64(uint8_t* out, uint64_t value) { memcpy(out, &value, 8); }
+    uint32_t readU32(const uint8_t* data) { uint32_t value; memcpy(&value, data, 4); return value; }
+    uint64_t readU64(const uint8_t* data) { uint64_t value; memcpy(&value, data, 8); return value; }
+
+    uint64_t alignUp(uint64_t offset) {
+        return (offset + 7) & ~(uint64_t)7;
+    }
+
+    bool writePadding(FILE* out, uint64_t size) {
+        static const uint8_t ZEROS[8] = { 0 };
+        uint64_t padding = alignUp(size) - size;
+        return padding == 0 || fwrite(ZEROS, (size_t)padding, 1, out) == 1;
+    }
+
+    bool isStandardStart(const Position& position) {
+        static const uint64_t standardKey = [] {
+            Position start;
+            start.setFromFen(START_FEN);
+            return start.key();
+        }();
+        return position.key() == standardKey && position.halfmoveClock() == 0 && position.fullmoveNumber() == 1;
+    }
+
+    /**
+     * @brief Index of a move in the generated legal move list, -1 if it is not legal
+     */
+    int moveIndex(const Position& position, Move move) {
+        MoveList list;
+        generateLegalMoves(position, list);
+        for (int i = 0; i < list.size(); i++) {
+            if (list[i] == move) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
+
+void packPosition(const Position& position, uint8_t* out) {
+    memset(out, 0, GAMESTORE_KEYFRAME_SIZE);
+    Bitboard occupancy = position.occupied();
+    writeU64(out, occupancy);
+    int nibble = 0;
+    for (Bitboard b = occupancy; b; nibble++) {
+        int piece = position.pieceOn(popLsb(b));
+        out[8 + nibble / 2] |= (uint8_t)(piece << (nibble % 2 * 4));
+    }
+    out[24] = (uint8_t)position.sideToMove();
+    out[25] = (uint8_t)position.castlingRights();
+    out[26] = (uint8_t)position.epSquare();
+    out[27] = (uint8_t)(position.halfmoveClock() < 255 ? position.halfmoveClock() : 255);
+    out[28] = (uint8_t)(position.fullmoveNumber() & 0xFF);
+    out[29] = (uint8_t)((position.fullmoveNumber() >> 8) & 0xFF);
+}
+
+bool unpackPosition(const uint8_t* data, Position& position) {
+    Bitboard occupancy = readU64(data);
+    if (popCount(occupancy) > 32) {
+        return false;
+    }
+    int pieces[64];
+    int nibble = 0;
+    for (int square = 0; square < 64; square++) {
+        pieces[square] = NO_PIECE;
+        if (occupancy & (1ULL << square)) {
+            pieces[square] = (data[8 + nibble / 2] >> (nibble % 2 * 4)) & 15;
+            nibble++;
+            if (pieces[square] >= NO_PIECE) {
+                return false;
+            }
+        }
+    }
+
+    // Rebuilding a FEN keeps all the validation in one place
+    char fen[100];
+    int length = 0;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int piece = pieces[rank * 8 + file];
+            if (piece == NO_PIECE) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) {
+                fen[length++] = (char)('0' + empty);
+                empty = 0;
+            }
+            fen[length++] = PIECE_LETTERS[piece];
+        }
+        if (empty > 0) {
+            fen[length++] = (char)('0' + empty);
+        }
+        fen[length++] = rank > 0 ? '/' : ' ';
+    }
+    fen[length++] = data[24] == WHITE ? 'w' : 'b';
+    fen[length++] = ' ';
+    int castling = data[25];
+    if (castling == 0) {
+        fen[length++] = '-';
+    }
+    static const char CASTLING_LETTERS[4] = { 'K', 'Q', 'k', 'q' };
+    for (int i = 0; i < 4; i++) {
+        if (castling & (1 << i)) {
+            fen[length++] = CASTLING_LETTERS[i];
+        }
+    }
+    fen[length++] = ' ';
+    int ep = data[26];
+    if (ep < 64) {
+        fen[length++] = (char)('a' + ep % 8);
+        fen[length++] = (char)('1' + ep / 8);
+    } else {
+        fen[length++] = '-';
+    }
+    snprintf(fen + length, sizeof(fen) - length, " %d %d", data[27], data[28] | (data[29] << 8));
+    return position.setFromFen(fen);
+}
+
+void GameBatch::add(const PgnGame& game, int keyframeInterval) {
+    Record record;
+    record.moveOffset = moves.size();
+    record.tagOffset = tags.size();
+    record.keyframeFirst = (uint32_t)(keyframes.size() / GAMESTORE_KEYFRAME_SIZE);
+    record.plyCount = 0;
+    record.standardStart = isStandardStart(game.start);
+
+    for (size_t i = 0; i < game.tags.size(); i++) {
+        tags.insert(tags.end(), game.tags[i].name.begin, game.tags[i].name.end);
+        tags.push_back('\0');
+        tags.insert(tags.end(), game.tags[i].value.begin, game.tags[i].value.end);
+        tags.push_back('\0');
+    }
+    record.tagSize = (uint32_t)(tags.size() - record.tagOffset);
+
+    Position position = game.start;
+    for (size_t ply = 0; ply < game.moves.size(); ply++) {
+        if (ply % keyframeInterval == 0 && (ply > 0 || !record.standardStart)) {
+            size_t offset = keyframes.size();
+            keyframes.resize(offset + GAMESTORE_KEYFRAME_SIZE);
+            packPosition(position, &keyframes[offset]);
+        }
+        int index = moveIndex(position, game.moves[ply]);
+        if (index < 0) {
+            break;
+        }
+        moves.push_back((uint8_t)index);
+        position.makeMove(game.moves[ply]);
+        record.plyCount++;
+    }
+    if (game.moves.empty() && !record.standardStart) {
+        size_t offset = keyframes.size();
+        keyframes.resize(offset + GAMESTORE_KEYFRAME_SIZE);
+        packPosition(position, &keyframes[offset]);
+    }
+    records.push_back(record);
+}
+
+GameStoreWriter::GameStoreWriter()
+    : out(NULL), interval(GAMESTORE_DEFAULT_KEYFRAME_INTERVAL), moveBytes(0) {}
+
+GameStoreWriter::~GameStoreWriter() {
+    if (out) {
+        fclose(out);
+    }
+}
+
+bool GameStoreWriter::open(const char* path, int keyframeInterval) {
+    if (out) {
+        fclose(out);
+    }
+    out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Could not create game store %s\n", path);
+        return false;
+    }
+    interval = keyframeInterval > 0 ? keyframeInterval : GAMESTORE_DEFAULT_KEYFRAME_INTERVAL;
+    moveBytes = 0;
+    keyframes.clear();
+    tags.clear();
+    records.clear();
+
+    // Placeholder, rewritten by finish() once the section sizes are known
+    uint8_t header[HEADER_SIZE] = { 0 };
+    if (fwrite(header, sizeof(header), 1, out) != 1) {
+        fprintf(stderr, "Error: Could not write game store %s\n", path);
+        fclose(out);
+        out = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool GameStoreWriter::append(const GameBatch& batch) {
+    if (!out) {
+        return false;
+    }
+    if (!batch.moves.empty() && fwrite(&batch.moves[0], batch.moves.size(), 1, out) != 1) {
+        fprintf(stderr, "Error: Could not write game store moves\n");
+        return false;
+    }
+    uint32_t keyframeBase = (uint32_t)(keyframes.size() / GAMESTORE_KEYFRAME_SIZE);
+    uint64_t tagBase = tags.size();
+    for (size_t i = 0; i < batch.records.size(); i++) {
+        const GameBatch::Record& source = batch.records[i];
+        uint8_t record[RECORD_SIZE] = { 0 };
+        writeU64(record, moveBytes + source.moveOffset);
+        writeU64(record + 8, tagBase + source.tagOffset);
+        writeU32(record + 16, keyframeBase + source.keyframeFirst);
+        writeU32(record + 20, source.plyCount);
+        writeU32(record + 24, source.tagSize);
+        record[28] = source.standardStart ? FLAG_STANDARD_START : 0;
+        records.insert(records.end(), record, record + RECORD_SIZE);
+    }
+    keyframes.insert(keyframes.end(), batch.keyframes.begin(), batch.keyframes.end());
+    tags.insert(tags.end(), batch.tags.begin(), batch.tags.end());
+    moveBytes += batch.moves.size();
+    return true;
+}
+
+bool GameStoreWriter::finish() {
+    if (!out) {
+        return false;
+    }
+    bool ok = writePadding(out, HEADER_SIZE + moveBytes);
+    ok = ok && (keyframes.empty() || fwrite(&keyframes[0], keyframes.size(), 1, out) == 1);
+    ok = ok && (tags.empty() || fwrite(&tags[0], tags.size(), 1, out) == 1);
+    ok = ok && writePadding(out, tags.size());
+    ok = ok && (records.empty() || fwrite(&records[0], records.size(), 1, out) == 1);
+
+    uint8_t header[HEADER_SIZE] = { 0 };
+    memcpy(header, "CGDB", 4);
+    writeU32(header + 4, FORMAT_VERSION);
+    writeU32(header + 8, (uint32_t)interval);
+    writeU64(header + 16, records.size() / RECORD_SIZE);
+    writeU64(header + 24, moveBytes);
+    writeU64(header + 32, keyframes.size() / GAMESTORE_KEYFRAME_SIZE);
+    writeU64(header + 40, tags.size());
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, out) == 1;
+    ok = (fclose(out) == 0) && ok;
+    out = NULL;
+    if (!ok) {
+        fprintf(stderr, "Error: Could not write game store\n");
+    }
+    return ok;
+}
+
+GameStore::GameStore()
+    : games(0), interval(GAMESTORE_DEFAULT_KEYFRAME_INTERVAL), moveSection(NULL), moveSize(0),
+      keyframeSection(NULL), keyframeCount(0), tagSection(NULL), tagSize(0), gameSection(NULL) {
+    standardStart.setFromFen(START_FEN);
+}
+
+bool GameStore::open(const char* path) {
+    games = 0;
+    // Jumping to a ply touches one record, one keyframe and a few move bytes
+    if (!file.open(path, MappedFile::ACCESS_RANDOM)) {
+        return false;
+    }
+    const uint8_t* data = file.data();
+    uint64_t size = file.size();
+    if (size < HEADER_SIZE || memcmp(data, "CGDB", 4) != 0 || readU32(data + 4) != FORMAT_VERSION) {
+        fprintf(stderr, "Error: %s is not a game store\n", path);
+        file.close();
+        return false;
+    }
+    uint64_t gameTotal = readU64(data + 16);
+    moveSize = readU64(data + 24);
+    keyframeCount = readU64(data + 32);
+    tagSize = readU64(data + 40);
+    interval = (int)readU32(data + 8);
+
+    // Each size is checked against the file before it is added to an offset
+    uint64_t keyframeOffset = alignUp(HEADER_SIZE + moveSize);
+    uint64_t tagOffset = keyframeOffset + keyframeCount * GAMESTORE_KEYFRAME_SIZE;
+    uint64_t gameOffset = alignUp(tagOffset + tagSize);
+    if (interval <= 0 || moveSize > size || keyframeCount > size / GAMESTORE_KEYFRAME_SIZE ||
+        tagSize > size || gameTotal > size / RECORD_SIZE || gameOffset + gameTotal * RECORD_SIZE > size) {
+        fprintf(stderr, "Error: Game store %s is truncated or corrupt\n", path);
+        file.close();
+        return false;
+    }
+    moveSection = data + HEADER_SIZE;
+    keyframeSection = data + keyframeOffset;
+    tagSection = (const char*)data + tagOffset;
+    gameSection = data + gameOffset;
+    games = gameTotal;
+    return true;
+}
+
+const uint8_t* GameStore::record(uint64_t game) const {
+    if (game >= games) {
+        return NULL;
+    }
+    const uint8_t* gameRecord = gameSection + game * RECORD_SIZE;
+    uint64_t moveOffset = readU64(gameRecord);
+    uint64_t plies = readU32(gameRecord + 20);
+    uint64_t tagOffset = readU64(gameRecord + 8);
+    uint64_t tagLength = readU32(gameRecord + 24);
+    if (moveOffset > moveSize || plies > moveSize - moveOffset || tagOffset > tagSize || tagLength > tagSize - tagOffset) {
+        return NULL;
+    }
+    return gameRecord;
+}
+
+int GameStore::plyCount(uint64_t game) const {
+    const uint8_t* gameRecord = record(game);
+    return gameRecord ? (int)readU32(gameRecord + 20) : 0;
+}
+
+void GameStore::tags(uint64_t game, std::vector<PgnTag>& out) const {
+    out.clear();
+    const uint8_t* gameRecord = record(game);
+    if (!gameRecord) {
+        return;
+    }
+    const char* c = tagSection + readU64(gameRecord + 8);
+    const char* end = c + readU32(gameRecord + 24);
+    while (c < end) {
+        PgnTag tag;
+        tag.name.begin = c;
+        while (c < end && *c) c++;
+        tag.name.end = c;
+        if (c < end) c++;
+        tag.value.begin = c;
+        while (c < end && *c) c++;
+        tag.value.end = c;
+        if (c < end) c++;
+        out.push_back(tag);
+    }
+}
+
+TextSpan GameStore::tag(uint64_t game, const char* name) const {
+    std::vector<PgnTag> all;
+    tags(game, all);
+    for (size_t i = 0; i < all.size(); i++) {
+        if (all[i].name.equals(name)) {
+            return all[i].value;
+        }
+    }
+    return TextSpan();
+}
+
+bool GameStore::keyframePosition(const uint8_t* gameRecord, int keyframe, Position& position) const {
+    bool standard = (gameRecord[28] & FLAG_STANDARD_START) != 0;
+    if (standard && keyframe == 0) {
+        position = standardStart;
+        return true;
+    }
+    // Standard starts have no keyframe for ply 0
+    uint64_t index = (uint64_t)readU32(gameRecord + 16) + (uint64_t)keyframe - (standard ? 1 : 0);
+    if (index >= keyframeCount) {
+        return false;
+    }
+    return unpackPosition(keyframeSection + index * GAMESTORE_KEYFRAME_SIZE, position);
+}
+
+bool GameStore::replay(Position& position, const uint8_t* moveBytes, int count, std::vector<Move>* out) const {
+    for (int i = 0; i < count; i++) {
+        MoveList list;
+        generateLegalMoves(position, list);
+        if (moveBytes[i] >= list.size()) {
+            return false;
+        }
+        Move move = list[moveBytes[i]];
+        if (out) {
+            out->push_back(move);
+        }
+        position.makeMove(move);
+    }
+    return true;
+}
+
+bool GameStore::positionAt(uint64_t game, int ply, Position& position) const {
+    const uint8_t* gameRecord = record(game);
+    if (!gameRecord) {
+        return false;
+    }
+    int plies = (int)readU32(gameRecord + 20);
+    if (ply < 0 || ply > plies) {
+        return false;
+    }
+    // Keyframes exist for plies before the last move only, so the final
+    // position of a game whose length is a multiple of the interval comes
+    // from the previous one
+    int keyframe = (ply < plies ? ply : (plies > 0 ? plies - 1 : 0)) / interval;
+    if (!keyframePosition(gameRecord, keyframe, position)) {
+        return false;
+    }
+    int first = keyframe * interval;
+    return replay(position, moveSection + readU64(gameRecord) + first, ply - first, NULL);
+}
+
+bool GameStore::moves(uint64_t game, Position& start, std::vector<Move>& out) const {
+    out.clear();
+    const uint8_t* gameRecord = record(game);
+    if (!gameRecord || !keyframePosition(gameRecord, 0, start)) {
+        return false;
+    }
+    int plies = (int)readU32(gameRecord + 20);
+    out.reserve(plies);
+    Position position = start;
+    return replay(position, moveSection + readU64(gameRecord), plies, &out);
+}
@@ -0,0 +1,173 @@
+/*
+Description:
+Binary game store. Games converted from PGN once open instantly afterwards:
+the file is memory-mapped and any ply of any game is reached by one index
+lookup, one keyframe and a bounded replay.
+
+File layout (little endian, in this order, sections 8-byte aligned):
+  header      64 bytes: "CGDB", version, keyframe interval, then the game
+              count and the sizes of the move, keyframe and tag sections
+  moves       one byte per move: its index in the generated legal move list
+              of the position it is played in (never more than 218 moves)
+  keyframes   32-byte packed positions every interval plies (ply 0 only for
+              games not starting from the standard position)
+  tags        per game, name and value pairs as zero-terminated strings
+  games       32-byte records: offsets into the sections, ply count, flags
+
+Decoding a move means generating the legal moves of its position, so replay
+is sequential; the keyframes bound it to interval - 1 moves.
+*/
+
+#ifndef GAMESTORE_HPP
+#define GAMESTORE_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+
+const int GAMESTORE_DEFAULT_KEYFRAME_INTERVAL = 64;
+const int GAMESTORE_KEYFRAME_SIZE = 32;
+
+/**
+ * @brief Games encoded in memory, ready to be appended to a store
+ * Batches are built independently, e.g. one per thread, then written in order.
+ */
+struct GameBatch {
+    struct Record {
+        uint64_t moveOffset;     ///< Relative to the batch's moves
+        uint64_t tagOffset;
+        uint32_t keyframeFirst;
+        uint32_t plyCount;
+        uint32_t tagSize;
+        bool standardStart;
+    };
+
+    std::vector<uint8_t> moves;
+    std::vector<uint8_t> keyframes;
+    std::vector<char> tags;
+    std::vector<Record> records;
+
+    /**
+     * @brief Encodes a parsed game; games that did not parse completely keep their valid prefix
+     * @param keyframeInterval Plies between keyframes, the same for every batch of a store
+     */
+    void add(const PgnGame& game, int keyframeInterval);
+};
+
+/**
+ * @brief Writes a store from batches of games
+ */
+class GameStoreWriter {
+public:
+    GameStoreWriter();
+    ~GameStoreWriter();
+
+    GameStoreWriter(const GameStoreWriter&) = delete;
+    GameStoreWriter& operator=(const GameStoreWriter&) = delete;
+
+    /**
+     * @brief Creates the file; moves are streamed to it, the other sections kept until finish()
+     */
+    bool open(const char* path, int keyframeInterval = GAMESTORE_DEFAULT_KEYFRAME_INTERVAL);
+
+    /**
+     * @brief Appends a batch built with the same keyframe interval
+     */
+    bool append(const GameBatch& batch);
+
+    /**
+     * @brief Writes the remaining sections and the header, and closes the file
+     */
+    bool finish();
+
+    int keyframeInterval() const { return interval; }
+
+private:
+    FILE* out;
+    int interval;
+    uint64_t moveBytes;
+    std::vector<uint8_t> keyframes;
+    std::vector<char> tags;
+    std::vector<uint8_t> records;
+};
+
+/**
+ * @brief Read-only view of a store file
+ */
+class GameStore {
+public:
+    GameStore();
+
+    GameStore(const GameStore&) = delete;
+    GameStore& operator=(const GameStore&) = delete;
+
+    /**
+     * @brief Maps a store file and checks its header and section bounds
+     */
+    bool open(const char* path);
+    bool isOpen() const { return file.isOpen(); }
+
+    uint64_t gameCount() const { return games; }
+    int keyframeInterval() const { return interval; }
+    size_t fileSize() const { return file.size(); }
+    int plyCount(uint64_t game) const;
+
+    /**
+     * @brief Reads the tags of a game; the spans point into the mapped file
+     */
+    void tags(uint64_t game, std::vector<PgnTag>& out) const;
+
+    /**
+     * @brief Looks up one tag value, empty if the game does not have it
+     */
+    TextSpan tag(uint64_t game, const char* name) const;
+
+    /**
+     * @brief Sets up the position before the given ply: nearest keyframe, then replay
+     * @param ply 0..plyCount(game)
+     * @return false if the game or ply is out of range or the data is corrupt
+     */
+    bool positionAt(uint64_t game, int ply, Position& position) const;
+
+    /**
+     * @brief Decodes every move of a game
+     * @param start Set to the position before the first move
+     * @return false if the data is corrupt
+     */
+    bool moves(uint64_t game, Position& start, std::vector<Move>& out) const;
+
+private:
+    const uint8_t* record(uint64_t game) const;
+    bool keyframePosition(const uint8_t* gameRecord, int keyframe, Position& position) const;
+    bool replay(Position& position, const uint8_t* moveBytes, int count, std::vector<Move>* out) const;
+
+    MappedFile file;
+    uint64_t games;
+    int interval;
+    const uint8_t* moveSection;
+    uint64_t moveSize;
+    const uint8_t* keyframeSection;
+    uint64_t keyframeCount;
+    const char* tagSection;
+    uint64_t tagSize;
+    const uint8_t* gameSection;
+    Position standardStart;
+};
+
+/**
+ * @brief Packs a position without history into GAMESTORE_KEYFRAME_SIZE bytes
+ */
+void packPosition(const Position& position, uint8_t* out);
+
+/**
+ * @brief Restores a packed position
+ * @return false if the data does not describe a valid position
+ */
+bool unpackPosition(const uint8_t* data, Position& position);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+Description:
+GL resource handles and the per-category memory accounting behind the report.
+*/
+
+#include <stdio.h>
+#include <atomic>
+
+#include "gpuresource.hpp"
+
+namespace {
+    // Atomic because CPU charges can come from loader threads; the GL handles
+    // only ever change them on the context's thread
+    struct Counters {
+        std::atomic<long> count;
+        std::atomic<long long> cpuBytes;
+        std::atomic<long long> vramBytes;
+    };
+    Counters counters[GPU_CATEGORY_COUNT];
+
+    void track(GpuCategory category, long count, long long cpuBytes, long long vramBytes) {
+        counters[category].count += count;
+        counters[category].cpuBytes += cpuBytes;
+        counters[category].vramBytes += vramBytes;
+    }
+
+    /// Bytes per texel of the sized formats the scene uses; 3-byte formats are padded to 4
+    size_t texelBytes(GLint format) {
+        switch (format) {
+        case GL_R8:
+        case GL_STENCIL_INDEX8:
+            return 1;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:
+            return 2;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+        }
+    }
+
+    /// Storage of every defined level of a 2D texture
+    size_t measureTexture(GLuint texture) {
+        GLint previous = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        size_t bytes = 0;
+        for (int level = 0; level < 16; level++) {
+            GLint width = 0, height = 0, compressed = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            if (width == 0) {
+                break;
+            }
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+            if (compressed) {
+                GLint size = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                bytes += size;
+            } else {
+                GLint format = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+                bytes += (size_t)width * height * texelBytes(format);
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D, previous);
+        return bytes;
+    }
+}
+
+GpuUsage gpuUsage(GpuCategory category) {
+    GpuUsage usage;
+    usage.count = counters[category].count;
+    usage.cpuBytes = (size_t)counters[category].cpuBytes;
+    usage.vramBytes = (size_t)counters[category].vramBytes;
+    return usage;
+}
+
+GpuUsage gpuUsageTotal() {
+    GpuUsage total;
+    for (int i = 0; i < GPU_CATEGORY_COUNT; i++) {
+        GpuUsage usage = gpuUsage((GpuCategory)i);
+        total.count += usage.count;
+        total.cpuBytes += usage.cpuBytes;
+        total.vramBytes += usage.vramBytes;
+    }
+    return total;
+}
+
+const char* gpuCategoryName(GpuCategory category) {
+    static const char* names[GPU_CATEGORY_COUNT] = { "scene", "board", "pieces", "instances", "lighting", "shadows",
+                                                          "readback", "picking", "overlay" };
+    return names[category];
+}
+
+void printGpuMemoryReport() {
+    printf("%-10s %8s %12s %12s\n", "resources", "count", "CPU KiB", "VRAM KiB");
+    for (int i = 0; i < GPU_CATEGORY_COUNT; i++) {
+        GpuUsage usage = gpuUsage((GpuCategory)i);
+        printf("%-10s %8ld %12.1f %12.1f\n", gpuCategoryName((GpuCategory)i), usage.count,
+               usage.cpuBytes / 1024.0, usage.vramBytes / 1024.0);
+    }
+    GpuUsage total = gpuUsageTotal();
+    printf("%-10s %8ld %12.1f %12.1f\n", "total", total.count, total.cpuBytes / 1024.0, total.vramBytes / 1024.0);
+}
+
+GpuBuffer::GpuBuffer(GpuBuffer&& other) : name(other.name), bytes(other.bytes), category(other.category) {
+    other.name = 0;
+    other.bytes = 0;
+}
+
+GpuBuffer& GpuBuffer::operator=(GpuBuffer&& other) {
+    if (this != &other) {
+        reset();
+        name = other.name;
+        bytes = other.bytes;
+        category = other.category;
+        other.name = 0;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+void GpuBuffer::upload(GpuCategory category, GLenum target, size_t size, const void* data, GLenum usage) {
+    if (name == 0) {
+        glGenBuffers(1, &name);
+        track(category, 1, 0, 0);
+    } else {
+        track(this->category, -1, 0, -(long long)bytes);
+        track(category, 1, 0, 0);
+    }
+    this->category = category;
+    glBindBuffer(target, name);
+    glBufferData(target, size, data, usage);
+    bytes = size;
+    track(category, 0, 0, (long long)bytes);
+}
+
+void GpuBuffer::reset() {
+    if (name != 0) {
+        glDeleteBuffers(1, &name);
+        track(category, -1, 0, -(long long)bytes);
+        name = 0;
+        bytes = 0;
+    }
+}
+
+GpuTexture::GpuTexture(GpuTexture&& other) : name(other.name), bytes(other.bytes), category(other.category) {
+    other.name = 0;
+    other.bytes = 0;
+}
+
+GpuTexture& GpuTexture::operator=(GpuTexture&& other) {
+    if (this != &other) {
+        reset();
+        name = other.name;
+        bytes = other.bytes;
+        category = other.category;
+        other.name = 0;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+GLuint GpuTexture::create(GpuCategory category) {
+    if (name == 0) {
+        glGenTextures(1, &name);
+        this->category = category;
+        track(category, 1, 0, 0);
+    }
+    return name;
+}
+
+void GpuTexture::adopt(GpuCategory category, GLuint texture) {
+    reset();
+    if (texture != 0) {
+        name = texture;
+        this->category = category;
+        track(category, 1, 0, 0);
+        updateSize();
+    }
+}
+
+void GpuTexture::updateSize() {
+    if (name == 0) {
+        return;
+    }
+    size_t measured = measureTexture(name);
+    track(category, 0, 0, (long long)measured - (long long)bytes);
+    bytes = measured;
+}
+
+void GpuTexture::reset() {
+    if (name != 0) {
+        glDeleteTextures(1, &name);
+        track(category, -1, 0, -(long long)bytes);
+        name = 0;
+        bytes = 0;
+    }
+}
+
+GpuVertexArray::GpuVertexArray(GpuVertexArray&& other) : name(other.name), category(other.category) {
+    other.name = 0;
+}
+
+GpuVertexArray& GpuVertexArray::operator=(GpuVertexArray&& other) {
+    if (this != &other) {
+        reset();
+        name = other.name;
+        category = other.category;
+        other.name = 0;
+    }
+    return *this;
+}
+
+GLuint GpuVertexArray::create(GpuCategory category) {
+    if (name == 0) {
+        glGenVertexArrays(1, &name);
+        this->category = category;
+        track(category, 1, 0, 0);
+    }
+    return name;
+}
+
+void GpuVertexArray::reset() {
+    if (name != 0) {
+        glDeleteVertexArrays(1, &name);
+        track(category, -1, 0, 0);
+        name = 0;
+    }
+}
+
+CpuCharge::CpuCharge(CpuCharge&& other) : bytes(other.bytes), category(other.category) {
+    other.bytes = 0;
+}
+
+CpuCharge& CpuCharge::operator=(CpuCharge&& other) {
+    if (this != &other) {
+        reset();
+        bytes = other.bytes;
+        category = other.category;
+        other.bytes = 0;
+    }
+    return *this;
+}
+
+void CpuCharge::set(GpuCategory category, size_t size) {
+    track(this->category, 0, -(long long)bytes, 0);
+    track(category, 0, (long long)size, 0);
+    this->category = category;
+    bytes = size;
+}
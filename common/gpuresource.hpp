@@ -0,0 +1,212 @@
+/*
+Description:
+Owning handles for GL buffers, textures and vertex arrays. Each handle deletes
+its object when it is destroyed or reset, can be moved but not copied, and
+charges what it holds to a category of the scene. CPU-side copies that are
+kept for upload are charged the same way, so a memory report can tell where
+the resident set of a scene goes and that it stays bounded as boards are
+added.
+
+The GL handles must be reset on the thread owning the context, before it is
+destroyed. A handle that never created anything makes no GL call.
+*/
+
+#ifndef GPURESOURCE_HPP
+#define GPURESOURCE_HPP
+
+#include <stddef.h>
+#include <GL/glew.h>
+
+/**
+ * @brief What a resource is used for, one line of the memory report each
+ */
+enum GpuCategory {
+    GPU_SCENE,      ///< Vertex array state shared by every draw
+    GPU_BOARD,      ///< Board mesh, textures and lightmap
+    GPU_PIECES,     ///< Piece meshes and textures
+    GPU_INSTANCES,  ///< Per-instance matrices and pick IDs
+    GPU_LIGHTING,   ///< Clustered point light lists
+    GPU_SHADOWS,    ///< Shadow map layers
+    GPU_READBACK,   ///< Pixel pack buffer rings of batch rendering and video capture
+    GPU_PICKING,    ///< Pick ID target and its one-pixel readback buffers
+    GPU_OVERLAY,    ///< Move arrow vertices
+    GPU_CATEGORY_COUNT
+};
+
+/**
+ * @brief Resources currently charged to one category
+ */
+struct GpuUsage {
+    long count;         ///< Live GL objects
+    size_t cpuBytes;    ///< CPU-side copies kept alongside them
+    size_t vramBytes;   ///< Buffer and texture storage, mipmaps included
+
+    GpuUsage() : count(0), cpuBytes(0), vramBytes(0) {}
+};
+
+/**
+ * @brief Current charge of a category
+ */
+GpuUsage gpuUsage(GpuCategory category);
+
+/**
+ * @brief Sum over every category
+ */
+GpuUsage gpuUsageTotal();
+
+/**
+ * @brief Name of a category as printed in the report
+ */
+const char* gpuCategoryName(GpuCategory category);
+
+/**
+ * @brief Prints one line per category and the total to stdout
+ */
+void printGpuMemoryReport();
+
+/**
+ * @brief Buffer object and the size of its data store
+ */
+class GpuBuffer {
+public:
+    GpuBuffer() : name(0), bytes(0), category(GPU_SCENE) {}
+    ~GpuBuffer() { reset(); }
+
+    GpuBuffer(GpuBuffer&& other);
+    GpuBuffer& operator=(GpuBuffer&& other);
+    GpuBuffer(const GpuBuffer&) = delete;
+    GpuBuffer& operator=(const GpuBuffer&) = delete;
+
+    /**
+     * @brief Creates the buffer on first use and (re)allocates its store with glBufferData
+     * The buffer is left bound to target, for glBufferSubData or attribute setup.
+     *
+     * @param category Category charged with the store
+     * @param target Binding point, e.g. GL_ARRAY_BUFFER
+     * @param size Size of the new store in bytes
+     * @param data Initial contents, NULL to leave them undefined
+     * @param usage Usage hint, e.g. GL_STATIC_DRAW
+     */
+    void upload(GpuCategory category, GLenum target, size_t size, const void* data, GLenum usage);
+
+    /**
+     * @brief Deletes the buffer, if any
+     */
+    void reset();
+
+    GLuint id() const { return name; }
+    size_t size() const { return bytes; }
+
+private:
+    GLuint name;
+    size_t bytes;
+    GpuCategory category;
+};
+
+/**
+ * @brief Texture object, its storage measured from the GL after it is defined
+ */
+class GpuTexture {
+public:
+    GpuTexture() : name(0), bytes(0), category(GPU_SCENE) {}
+    ~GpuTexture() { reset(); }
+
+    GpuTexture(GpuTexture&& other);
+    GpuTexture& operator=(GpuTexture&& other);
+    GpuTexture(const GpuTexture&) = delete;
+    GpuTexture& operator=(const GpuTexture&) = delete;
+
+    /**
+     * @brief Creates the texture on first use
+     * Call updateSize() once its images are defined.
+     *
+     * @return The texture name
+     */
+    GLuint create(GpuCategory category);
+
+    /**
+     * @brief Takes ownership of a texture made elsewhere, e.g. by the texture loaders
+     * The texture is measured right away. 0 only resets the handle.
+     */
+    void adopt(GpuCategory category, GLuint texture);
+
+    /**
+     * @brief Measures the levels of a GL_TEXTURE_2D again after they changed
+     * Buffer textures have no storage of their own and stay at 0 bytes.
+     */
+    void updateSize();
+
+    /**
+     * @brief Deletes the texture, if any
+     */
+    void reset();
+
+    GLuint id() const { return name; }
+    size_t size() const { return bytes; }
+
+private:
+    GLuint name;
+    size_t bytes;
+    GpuCategory category;
+};
+
+/**
+ * @brief Vertex array object
+ */
+class GpuVertexArray {
+public:
+    GpuVertexArray() : name(0), category(GPU_SCENE) {}
+    ~GpuVertexArray() { reset(); }
+
+    GpuVertexArray(GpuVertexArray&& other);
+    GpuVertexArray& operator=(GpuVertexArray&& other);
+    GpuVertexArray(const GpuVertexArray&) = delete;
+    GpuVertexArray& operator=(const GpuVertexArray&) = delete;
+
+    /**
+     * @brief Creates the vertex array on first use
+     * @return The vertex array name
+     */
+    GLuint create(GpuCategory category);
+
+    /**
+     * @brief Deletes the vertex array, if any
+     */
+    void reset();
+
+    GLuint id() const { return name; }
+
+private:
+    GLuint name;
+    GpuCategory category;
+};
+
+/**
+ * @brief CPU memory charged to a category, e.g. geometry waiting for upload
+ * Needs no GL context.
+ */
+class CpuCharge {
+public:
+    CpuCharge() : bytes(0), category(GPU_SCENE) {}
+    ~CpuCharge() { reset(); }
+
+    CpuCharge(CpuCharge&& other);
+    CpuCharge& operator=(CpuCharge&& other);
+    CpuCharge(const CpuCharge&) = delete;
+    CpuCharge& operator=(const CpuCharge&) = delete;
+
+    /**
+     * @brief Replaces the charge
+     */
+    void set(GpuCategory category, size_t size);
+
+    void reset() { set(category, 0); }
+
+    size_t size() const { return bytes; }
+
+private:
+    size_t bytes;
+    GpuCategory category;
+};
+
+#endif
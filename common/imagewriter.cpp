@@ -0,0 +1,248 @@
+/*
+Description:
+PPM and PNG encoders plus the writer thread pool used by batch rendering.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "imagewriter.hpp"
+
+namespace {
+    uint32_t crcTable[256];
+
+    struct CrcTableInit {
+        CrcTableInit() {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                crcTable[n] = c;
+            }
+        }
+    } crcTableInit;
+
+    uint32_t updateCrc(uint32_t crc, const unsigned char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    void putBigEndian(unsigned char* out, uint32_t value) {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+
+    bool writeChunk(FILE* file, const char* type, const unsigned char* data, uint32_t length) {
+        unsigned char header[8];
+        putBigEndian(header, length);
+        header[4] = type[0]; header[5] = type[1]; header[6] = type[2]; header[7] = type[3];
+
+        uint32_t crc = updateCrc(0xFFFFFFFFu, header + 4, 4);
+        crc = updateCrc(crc, data, length) ^ 0xFFFFFFFFu;
+        unsigned char footer[4];
+        putBigEndian(footer, crc);
+
+        return fwrite(header, 1, 8, file) == 8 &&
+               (length == 0 || fwrite(data, 1, length, file) == length) &&
+               fwrite(footer, 1, 4, file) == 4;
+    }
+
+    /**
+     * @brief Converts bottom-up RGBA rows to top-down RGB rows
+     * @param stride Bytes per output row; rows start at rowOffset within each stride
+     */
+    void packRows(const unsigned char* rgba, int width, int height,
+                  unsigned char* out, size_t stride, size_t rowOffset) {
+        for (int y = 0; y < height; y++) {
+            const unsigned char* src = rgba + (size_t)(height - 1 - y) * width * 4;
+            unsigned char* dst = out + y * stride + rowOffset;
+            for (int x = 0; x < width; x++) {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                src += 4;
+                dst += 3;
+            }
+        }
+    }
+}
+
+bool writePPM(const char* path, int width, int height, const unsigned char* rgba) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s for writing\n", path);
+        return false;
+    }
+
+    std::vector<unsigned char> rgb((size_t)width * height * 3);
+    packRows(rgba, width, height, &rgb[0], (size_t)width * 3, 0);
+
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0 &&
+              fwrite(&rgb[0], 1, rgb.size(), file) == rgb.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool writePNG(const char* path, int width, int height, const unsigned char* rgba) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s for writing\n", path);
+        return false;
+    }
+
+    // Raw scanlines: one filter byte (0 = none) followed by RGB samples
+    size_t stride = (size_t)width * 3 + 1;
+    size_t rawSize = stride * height;
+    std::vector<unsigned char> raw(rawSize, 0);
+    packRows(rgba, width, height, &raw[0], stride, 1);
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    const size_t BLOCK = 65535;
+    size_t blocks = rawSize / BLOCK + 1;
+    std::vector<unsigned char> zlib;
+    zlib.reserve(2 + rawSize + blocks * 5 + 4);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t offset = 0;
+    do {
+        size_t length = rawSize - offset < BLOCK ? rawSize - offset : BLOCK;
+        bool last = offset + length == rawSize;
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)(length & 0xFF));
+        zlib.push_back((unsigned char)(length >> 8));
+        zlib.push_back((unsigned char)(~length & 0xFF));
+        zlib.push_back((unsigned char)((~length >> 8) & 0xFF));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+
+        for (size_t i = offset; i < offset + length; i++) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        offset += length;
+    } while (offset < rawSize);
+
+    unsigned char adler[4];
+    putBigEndian(adler, (adlerB << 16) | adlerA);
+    zlib.insert(zlib.end(), adler, adler + 4);
+
+    unsigned char ihdr[13];
+    putBigEndian(ihdr, (uint32_t)width);
+    putBigEndian(ihdr + 4, (uint32_t)height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // colour type RGB
+    ihdr[10] = 0; // compression
+    ihdr[11] = 0; // filter
+    ihdr[12] = 0; // interlace
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    bool ok = fwrite(signature, 1, 8, file) == 8 &&
+              writeChunk(file, "IHDR", ihdr, 13) &&
+              writeChunk(file, "IDAT", &zlib[0], (uint32_t)zlib.size()) &&
+              writeChunk(file, "IEND", NULL, 0);
+    return fclose(file) == 0 && ok;
+}
+
+ImageWriterPool::ImageWriterPool(int threads, int maxQueued)
+    : maxQueued(maxQueued > 0 ? maxQueued : 1), busy(0), failures(0), stopping(false) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&ImageWriterPool::run, this));
+    }
+}
+
+ImageWriterPool::~ImageWriterPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+std::vector<unsigned char> ImageWriterPool::acquireBuffer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeBuffers.empty()) {
+        return std::vector<unsigned char>();
+    }
+    std::vector<unsigned char> buffer;
+    buffer.swap(freeBuffers.back());
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void ImageWriterPool::releaseBuffer(std::vector<unsigned char>& buffer) {
+    if (buffer.capacity() == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    freeBuffers.push_back(std::vector<unsigned char>());
+    freeBuffers.back().swap(buffer);
+}
+
+void ImageWriterPool::submit(const std::string& path, int width, int height,
+                             std::vector<unsigned char>& pixels, ImageFormat format) {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return jobs.size() < maxQueued; });
+
+    jobs.push_back(Job());
+    Job& job = jobs.back();
+    job.path = path;
+    job.width = width;
+    job.height = height;
+    job.format = format;
+    job.pixels.swap(pixels);
+    lock.unlock();
+    jobAvailable.notify_one();
+}
+
+int ImageWriterPool::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return jobs.empty() && busy == 0; });
+    return failures;
+}
+
+void ImageWriterPool::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job.path.swap(jobs.front().path);
+            job.pixels.swap(jobs.front().pixels);
+            job.width = jobs.front().width;
+            job.height = jobs.front().height;
+            job.format = jobs.front().format;
+            jobs.pop_front();
+            busy++;
+        }
+        jobDone.notify_all();
+
+        bool ok = job.format == IMAGE_PNG
+            ? writePNG(job.path.c_str(), job.width, job.height, &job.pixels[0])
+            : writePPM(job.path.c_str(), job.width, job.height, &job.pixels[0]);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok) {
+                failures++;
+            }
+            freeBuffers.push_back(std::vector<unsigned char>());
+            freeBuffers.back().swap(job.pixels);
+            busy--;
+        }
+        jobDone.notify_all();
+    }
+}
@@ -0,0 +1,119 @@
+/*
+Description:
+Image file output for rendered frames. Pixels come straight from a GL readback
+(RGBA, bottom row first) and are written as binary PPM or PNG. Encoding runs on
+a pool of writer threads so the render thread only hands buffers over.
+*/
+
+#ifndef IMAGEWRITER_HPP
+#define IMAGEWRITER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Supported output file formats
+ */
+enum ImageFormat {
+    IMAGE_PPM, ///< Binary P6 PPM
+    IMAGE_PNG  ///< PNG with stored (uncompressed) deflate blocks
+};
+
+/**
+ * @brief Writes an RGBA frame as a binary PPM file
+ *
+ * @param path Output file path
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param rgba Pixels as read by glReadPixels, bottom row first
+ * @return true if the file was written
+ */
+bool writePPM(const char* path, int width, int height, const unsigned char* rgba);
+
+/**
+ * @brief Writes an RGBA frame as an RGB PNG file
+ * Uses stored deflate blocks: encoding is a copy plus checksums, which keeps
+ * bulk output bound by disk speed rather than compression.
+ *
+ * @param path Output file path
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param rgba Pixels as read by glReadPixels, bottom row first
+ * @return true if the file was written
+ */
+bool writePNG(const char* path, int width, int height, const unsigned char* rgba);
+
+/**
+ * @brief Pool of threads encoding frames to image files
+ * Pixel buffers are recycled between jobs, so steady-state output does not allocate.
+ */
+class ImageWriterPool {
+public:
+    /**
+     * @brief Starts the writer threads
+     * @param threads Number of writer threads, at least one
+     * @param maxQueued Number of queued jobs after which submit() blocks
+     */
+    explicit ImageWriterPool(int threads, int maxQueued = 16);
+    ~ImageWriterPool();
+
+    ImageWriterPool(const ImageWriterPool&) = delete;
+    ImageWriterPool& operator=(const ImageWriterPool&) = delete;
+
+    /**
+     * @brief Gets an empty pixel buffer, reusing one from a finished job when possible
+     * @return Buffer to fill and pass to submit()
+     */
+    std::vector<unsigned char> acquireBuffer();
+
+    /**
+     * @brief Returns a buffer from acquireBuffer() that was not submitted
+     */
+    void releaseBuffer(std::vector<unsigned char>& buffer);
+
+    /**
+     * @brief Queues a frame for writing, blocking while the queue is full
+     *
+     * @param path Output file path
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param pixels RGBA pixels, bottom row first; ownership moves to the pool
+     * @param format Output file format
+     */
+    void submit(const std::string& path, int width, int height,
+                std::vector<unsigned char>& pixels, ImageFormat format);
+
+    /**
+     * @brief Waits until every queued frame has been written
+     * @return Number of frames that failed to write since the pool started
+     */
+    int finish();
+
+private:
+    struct Job {
+        std::string path;
+        int width;
+        int height;
+        ImageFormat format;
+        std::vector<unsigned char> pixels;
+    };
+
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::vector<std::vector<unsigned char> > freeBuffers;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobDone;
+    size_t maxQueued;
+    int busy;
+    int failures;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,172 @@
+/*
+Description:
+GLFW callback based input handling. Events are accumulated as they arrive during
+glfwPollEvents() and handed to the camera in one batch by consumeInput().
+Callbacks run on the main thread while consumeInput() runs on the simulation
+thread, so the shared accumulators are atomics and neither side blocks.
+*/
+
+#include <algorithm>
+#include <atomic>
+
+#include "input.hpp"
+
+namespace {
+    // Written by the callbacks. The cursor position is absolute and press counts
+    // only grow, consumers turn both into deltas against what they last saw.
+    std::atomic<bool> keyDown[GLFW_KEY_LAST + 1];
+    std::atomic<int> keyPresses[GLFW_KEY_LAST + 1];
+    std::atomic<double> cursorX(0.0);
+    std::atomic<double> cursorY(0.0);
+    std::atomic<double> pendingEventTime(-1.0);
+    std::atomic<bool> mouseLook(true);
+
+    // Mouse buttons, only touched on the thread polling events
+    int buttonPresses[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    double buttonX[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    double buttonY[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+
+    // Consumer side, each value only touched by the thread consuming it
+    int consumedKeyPresses[GLFW_KEY_LAST + 1] = {};
+    double consumedCursorX = 0.0;
+    double consumedCursorY = 0.0;
+
+    // Latency accumulators, reset by takeLatencyStats()
+    double latencySum = 0.0;
+    double latencyMax = 0.0;
+    int latencySamples = 0;
+
+    void markEvent() {
+        // Keep the oldest unconsumed event, only fill the slot if it is empty
+        double empty = -1.0;
+        pendingEventTime.compare_exchange_strong(empty, glfwGetTime());
+    }
+
+    void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        if (key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT) {
+            return;
+        }
+        keyDown[key].store(action == GLFW_PRESS, std::memory_order_relaxed);
+        if (action == GLFW_PRESS) {
+            keyPresses[key].fetch_add(1, std::memory_order_relaxed);
+        }
+        markEvent();
+
+        if (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE) {
+            glfwSetWindowShouldClose(window, GL_TRUE);
+        }
+    }
+
+    void cursorPosCallback(GLFWwindow* window, double xpos, double ypos) {
+        // With a disabled cursor GLFW reports unbounded virtual positions,
+        // so there is no need to recenter the cursor every frame
+        cursorX.store(xpos, std::memory_order_relaxed);
+        cursorY.store(ypos, std::memory_order_relaxed);
+        markEvent();
+    }
+
+    void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+        if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST || action != GLFW_PRESS) {
+            return;
+        }
+        buttonPresses[button]++;
+        glfwGetCursorPos(window, &buttonX[button], &buttonY[button]);
+    }
+}
+
+void initInput(GLFWwindow* window) {
+    for (int key = 0; key <= GLFW_KEY_LAST; key++) {
+        keyDown[key].store(false);
+        keyPresses[key].store(0);
+        consumedKeyPresses[key] = 0;
+    }
+
+    // Start deltas from wherever the cursor is now
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    cursorX.store(xpos);
+    cursorY.store(ypos);
+    consumedCursorX = xpos;
+    consumedCursorY = ypos;
+
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+
+#ifdef GLFW_RAW_MOUSE_MOTION
+    // Unaccelerated motion is only available from GLFW 3.3 onwards
+    if (glfwRawMouseMotionSupported()) {
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+#endif
+}
+
+InputState consumeInput() {
+    InputState state;
+    // Claim the timestamp first: an event racing with us is then counted in
+    // this frame's deltas but timed from the next frame, never the other way
+    state.eventTime = pendingEventTime.exchange(-1.0);
+
+    double xpos = cursorX.load(std::memory_order_relaxed);
+    double ypos = cursorY.load(std::memory_order_relaxed);
+
+    bool look = mouseLook.load(std::memory_order_relaxed);
+    state.mouseDeltaX = look ? xpos - consumedCursorX : 0.0;
+    state.mouseDeltaY = look ? ypos - consumedCursorY : 0.0;
+    state.lightToggles = takeKeyPresses(GLFW_KEY_L);
+
+    consumedCursorX = xpos;
+    consumedCursorY = ypos;
+    return state;
+}
+
+bool isKeyDown(int key) {
+    return key >= 0 && key <= GLFW_KEY_LAST && keyDown[key].load(std::memory_order_relaxed);
+}
+
+int takeKeyPresses(int key) {
+    if (key < 0 || key > GLFW_KEY_LAST) {
+        return 0;
+    }
+    int presses = keyPresses[key].load(std::memory_order_relaxed);
+    int taken = presses - consumedKeyPresses[key];
+    consumedKeyPresses[key] = presses;
+    return taken;
+}
+
+int takeButtonPresses(int button, double* x, double* y) {
+    if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST) {
+        return 0;
+    }
+    int presses = buttonPresses[button];
+    buttonPresses[button] = 0;
+    *x = buttonX[button];
+    *y = buttonY[button];
+    return presses;
+}
+
+void setMouseLook(bool enabled) {
+    mouseLook.store(enabled, std::memory_order_relaxed);
+}
+
+void recordPresent(double eventTime) {
+    if (eventTime < 0.0) {
+        return;
+    }
+    double latency = glfwGetTime() - eventTime;
+    latencySum += latency;
+    latencyMax = std::max(latencyMax, latency);
+    latencySamples++;
+}
+
+LatencyStats takeLatencyStats() {
+    LatencyStats stats;
+    stats.samples = latencySamples;
+    stats.avgMs = latencySamples > 0 ? 1000.0 * latencySum / latencySamples : 0.0;
+    stats.maxMs = 1000.0 * latencyMax;
+
+    latencySum = 0.0;
+    latencyMax = 0.0;
+    latencySamples = 0;
+    return stats;
+}
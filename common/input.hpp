@@ -0,0 +1,97 @@
+/*
+Description:
+Event-driven input subsystem. GLFW key and cursor callbacks fold events into
+accumulators between frames instead of polling every key once per frame, so the
+camera can consume all motion that arrived since the last frame in one sample
+taken right before draw submission. Also tracks input-to-present latency.
+*/
+
+#ifndef INPUT_HPP
+#define INPUT_HPP
+
+#include <GLFW/glfw3.h>
+
+/**
+ * @brief Input accumulated since the previous call to consumeInput()
+ */
+struct InputState {
+    double mouseDeltaX;   ///< Horizontal cursor motion in pixels
+    double mouseDeltaY;   ///< Vertical cursor motion in pixels
+    int lightToggles;     ///< Number of L presses
+    double eventTime;     ///< glfwGetTime() of the oldest folded event, negative if none
+};
+
+/**
+ * @brief Input-to-present latency statistics over a reporting interval
+ */
+struct LatencyStats {
+    double avgMs;  ///< Mean latency in milliseconds
+    double maxMs;  ///< Worst latency in milliseconds
+    int samples;   ///< Number of presented frames that carried input
+};
+
+/**
+ * @brief Installs key and cursor callbacks on the window
+ * Enables raw mouse motion when the GLFW version and platform support it.
+ *
+ * @param window Window whose events should be tracked
+ */
+void initInput(GLFWwindow* window);
+
+/**
+ * @brief Returns and resets the input accumulated since the last call
+ * Safe to call from one thread other than the one running glfwPollEvents().
+ *
+ * @return Accumulated mouse motion, toggles and oldest event timestamp
+ */
+InputState consumeInput();
+
+/**
+ * @brief Checks whether a key is currently held, as reported by key callbacks
+ *
+ * @param key GLFW key code
+ * @return true if the key is down
+ */
+bool isKeyDown(int key);
+
+/**
+ * @brief Returns how often a key was pressed since the last call for that key
+ * Each key should be consumed by a single thread.
+ *
+ * @param key GLFW key code
+ * @return Number of presses
+ */
+int takeKeyPresses(int key);
+
+/**
+ * @brief Returns how often a mouse button was pressed since the last call for it
+ * Should be called from the thread running glfwPollEvents().
+ *
+ * @param button GLFW mouse button
+ * @param x Receives the cursor column of the latest press, in window coordinates
+ * @param y Receives the cursor row of the latest press
+ * @return Number of presses
+ */
+int takeButtonPresses(int button, double* x, double* y);
+
+/**
+ * @brief Turns camera mouse-look on or off
+ * While off, consumeInput() reports no cursor motion, so a free cursor can be
+ * moved over the scene without turning the camera.
+ */
+void setMouseLook(bool enabled);
+
+/**
+ * @brief Records that a frame carrying input from eventTime has been presented
+ *
+ * @param eventTime Timestamp returned in InputState::eventTime, ignored if negative
+ */
+void recordPresent(double eventTime);
+
+/**
+ * @brief Returns and resets the latency statistics gathered since the last call
+ * @return Latency statistics
+ */
+LatencyStats takeLatencyStats();
+
+#endif
@@ -0,0 +1,272 @@
+/*
+Description:
+Light assignment for clustered forward shading.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include "lighting.hpp"
+
+namespace {
+    /// Depth of the near side of a slice; slice CLUSTER_SLICES is the far plane
+    float sliceDepth(int slice, float zNear, float zFar) {
+        if (slice == 0) {
+            return zNear;
+        }
+        float start = std::min(CLUSTER_NEAR, zFar);
+        return start * powf(zFar / start, (float)slice / CLUSTER_SLICES);
+    }
+
+    int depthSlice(float depth, float zFar) {
+        float start = std::min(CLUSTER_NEAR, zFar);
+        if (depth <= start) {
+            return 0;
+        }
+        int slice = (int)(logf(depth / start) * CLUSTER_SLICES / logf(zFar / start));
+        return std::min(slice, CLUSTER_SLICES - 1);
+    }
+}
+
+std::vector<PointLight> hallLamps(int count, float extent) {
+    std::vector<PointLight> lamps;
+    int columns = 1;
+    while (columns * columns < count) {
+        columns++;
+    }
+    float spacing = extent / columns;
+    for (int i = 0; i < count; i++) {
+        float x = ((i % columns) + 0.5f) * spacing - 0.5f * extent;
+        float z = ((i / columns) + 0.5f) * spacing - 0.5f * extent;
+        // Warm and cool lamps alternate, a little above the tallest piece
+        glm::vec3 color = i % 2 == 0 ? glm::vec3(1.0f, 0.85f, 0.6f) : glm::vec3(0.7f, 0.8f, 1.0f);
+        lamps.push_back(PointLight(glm::vec3(x, 14.0f, z), std::max(20.0f, 1.2f * spacing), color, 150.0f));
+    }
+    return lamps;
+}
+
+LightClusterer::LightClusterer(int threads)
+    : boundsProjection(0.0f), projectionX(1.0f), projectionY(1.0f), generation(0), pending(0), quitting(false) {
+    int count = std::max(1, std::min(threads, CLUSTER_SLICES));
+    parts.resize(count);
+    for (int i = 0; i < count; i++) {
+        parts[i].firstSlice = CLUSTER_SLICES * i / count;
+        parts[i].endSlice = CLUSTER_SLICES * (i + 1) / count;
+    }
+    // Part 0 always runs on the calling thread
+    for (int i = 1; i < count; i++) {
+        workers.push_back(std::thread(&LightClusterer::workerLoop, this, (size_t)i));
+    }
+}
+
+LightClusterer::~LightClusterer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    workReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void LightClusterer::assign(const std::vector<PointLight>& lights, const glm::mat4& view,
+                            const glm::mat4& projection, ClusteredLights& clusters) {
+    // Near and far planes back out of the projection's depth terms
+    float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+    clusters.zNear = zNear;
+    clusters.zFar = zFar;
+    if (projection != boundsProjection) {
+        updateBounds(projection, zNear, zFar);
+    }
+
+    size_t count = std::min(lights.size(), (size_t)MAX_POINT_LIGHTS);
+    clusters.lights.resize(2 * count);
+    viewLights.resize(count);
+    firstSlice.resize(count);
+    lastSlice.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const PointLight& light = lights[i];
+        glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        viewLights[i] = glm::vec4(position, light.radius);
+        clusters.lights[2 * i] = viewLights[i];
+        clusters.lights[2 * i + 1] = glm::vec4(light.color, light.power);
+        // Lights entirely behind the camera or past the far plane get an empty slice range
+        float depth = -position.z;
+        if (depth + light.radius < zNear || depth - light.radius > zFar) {
+            firstSlice[i] = 1;
+            lastSlice[i] = 0;
+        } else {
+            firstSlice[i] = depthSlice(depth - light.radius, zFar);
+            lastSlice[i] = depthSlice(depth + light.radius, zFar);
+        }
+    }
+
+    if (count > 0 && parts.size() > 1) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            pending = (int)parts.size() - 1;
+        }
+        workReady.notify_all();
+        assignPart(parts[0]);
+        std::unique_lock<std::mutex> lock(mutex);
+        workDone.wait(lock, [this] { return pending == 0; });
+    } else {
+        for (Part& part : parts) {
+            assignPart(part);
+        }
+    }
+
+    // Parts cover consecutive clusters, so joining them only shifts their offsets
+    clusters.ranges.resize(2 * CLUSTER_COUNT);
+    size_t total = 0;
+    for (const Part& part : parts) {
+        total += part.indices.size();
+    }
+    clusters.indices.resize(total);
+    size_t offset = 0;
+    for (const Part& part : parts) {
+        size_t firstCluster = (size_t)part.firstSlice * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+        for (size_t i = 0; i < part.ranges.size(); i += 2) {
+            clusters.ranges[2 * firstCluster + i] = part.ranges[i] + (uint32_t)offset;
+            clusters.ranges[2 * firstCluster + i + 1] = part.ranges[i + 1];
+        }
+        if (!part.indices.empty()) {
+            memcpy(&clusters.indices[offset], &part.indices[0], part.indices.size() * sizeof(uint16_t));
+        }
+        offset += part.indices.size();
+    }
+}
+
+void LightClusterer::updateBounds(const glm::mat4& projection, float zNear, float zFar) {
+    boundsProjection = projection;
+    projectionX = projection[0][0];
+    projectionY = projection[1][1];
+    boundsMin.resize(CLUSTER_COUNT);
+    boundsMax.resize(CLUSTER_COUNT);
+    sliceNear.resize(CLUSTER_SLICES + 1);
+    for (int slice = 0; slice <= CLUSTER_SLICES; slice++) {
+        sliceNear[slice] = sliceDepth(slice, zNear, zFar);
+    }
+    // A point at NDC (x, y) and view depth d is at (x d / P00, y d / P11, -d)
+    float scaleX = 1.0f / projectionX;
+    float scaleY = 1.0f / projectionY;
+    for (int slice = 0; slice < CLUSTER_SLICES; slice++) {
+        float nearDepth = sliceNear[slice];
+        float farDepth = sliceNear[slice + 1];
+        for (int y = 0; y < CLUSTER_TILES_Y; y++) {
+            float y0 = -1.0f + 2.0f * y / CLUSTER_TILES_Y;
+            float y1 = -1.0f + 2.0f * (y + 1) / CLUSTER_TILES_Y;
+            for (int x = 0; x < CLUSTER_TILES_X; x++) {
+                float x0 = -1.0f + 2.0f * x / CLUSTER_TILES_X;
+                float x1 = -1.0f + 2.0f * (x + 1) / CLUSTER_TILES_X;
+                glm::vec3 low(1e30f), high(-1e30f);
+                const float depths[2] = { nearDepth, farDepth };
+                for (float d : depths) {
+                    const float xs[2] = { x0 * d * scaleX, x1 * d * scaleX };
+                    const float ys[2] = { y0 * d * scaleY, y1 * d * scaleY };
+                    for (float cx : xs) {
+                        for (float cy : ys) {
+                            low = glm::min(low, glm::vec3(cx, cy, -d));
+                            high = glm::max(high, glm::vec3(cx, cy, -d));
+                        }
+                    }
+                }
+                int cluster = (slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x;
+                boundsMin[cluster] = low;
+                boundsMax[cluster] = high;
+            }
+        }
+    }
+}
+
+void LightClusterer::assignPart(Part& part) {
+    const int tiles = CLUSTER_TILES_X * CLUSTER_TILES_Y;
+    part.ranges.resize(2 * (size_t)(part.endSlice - part.firstSlice) * tiles);
+    part.indices.clear();
+    // Lights reaching each tile of the slice, gathered light by light then
+    // written tile by tile so each cluster's list is contiguous
+    std::vector<uint32_t> tileCounts(tiles);
+    std::vector<uint32_t> tileFirst(tiles + 1);
+    std::vector<uint32_t> marks;
+    for (int slice = part.firstSlice; slice < part.endSlice; slice++) {
+        std::fill(tileCounts.begin(), tileCounts.end(), 0);
+        marks.clear();
+        for (size_t i = 0; i < viewLights.size(); i++) {
+            if (slice < firstSlice[i] || slice > lastSlice[i]) {
+                continue;
+            }
+            const glm::vec4& sphere = viewLights[i];
+            // Screen rectangle of the light's box within this slice's depth range,
+            // from the corners nearest and furthest from the camera
+            float depth = -sphere.z;
+            float nearDepth = std::max(depth - sphere.w, sliceNear[slice]);
+            float farDepth = std::min(depth + sphere.w, sliceNear[slice + 1]);
+            float xLow = 1e30f, xHigh = -1e30f, yLow = 1e30f, yHigh = -1e30f;
+            const float depths[2] = { nearDepth, farDepth };
+            for (float d : depths) {
+                float inverse = 1.0f / d;
+                xLow = std::min(xLow, (sphere.x - sphere.w) * projectionX * inverse);
+                xHigh = std::max(xHigh, (sphere.x + sphere.w) * projectionX * inverse);
+                yLow = std::min(yLow, (sphere.y - sphere.w) * projectionY * inverse);
+                yHigh = std::max(yHigh, (sphere.y + sphere.w) * projectionY * inverse);
+            }
+            if (xHigh < -1.0f || xLow > 1.0f || yHigh < -1.0f || yLow > 1.0f) {
+                continue;
+            }
+            int x0 = std::max(0, (int)((xLow + 1.0f) * 0.5f * CLUSTER_TILES_X));
+            int x1 = std::min(CLUSTER_TILES_X - 1, (int)((xHigh + 1.0f) * 0.5f * CLUSTER_TILES_X));
+            int y0 = std::max(0, (int)((yLow + 1.0f) * 0.5f * CLUSTER_TILES_Y));
+            int y1 = std::min(CLUSTER_TILES_Y - 1, (int)((yHigh + 1.0f) * 0.5f * CLUSTER_TILES_Y));
+            glm::vec3 centre(sphere.x, sphere.y, sphere.z);
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    // Sphere against box: distance from the centre to the nearest point of the box
+                    int tile = y * CLUSTER_TILES_X + x;
+                    int cluster = slice * tiles + tile;
+                    glm::vec3 delta = glm::max(boundsMin[cluster] - centre, glm::vec3(0.0f)) +
+                                      glm::max(centre - boundsMax[cluster], glm::vec3(0.0f));
+                    if (glm::dot(delta, delta) <= sphere.w * sphere.w) {
+                        marks.push_back((uint32_t)tile << 16 | (uint32_t)i);
+                        tileCounts[tile]++;
+                    }
+                }
+            }
+        }
+        // Counting sort of the hits by tile, lights stay in increasing order
+        tileFirst[0] = (uint32_t)part.indices.size();
+        for (int tile = 0; tile < tiles; tile++) {
+            tileFirst[tile + 1] = tileFirst[tile] + tileCounts[tile];
+            size_t local = 2 * (size_t)((slice - part.firstSlice) * tiles + tile);
+            part.ranges[local] = tileFirst[tile];
+            part.ranges[local + 1] = tileCounts[tile];
+        }
+        part.indices.resize(tileFirst[tiles]);
+        for (uint32_t mark : marks) {
+            part.indices[tileFirst[mark >> 16]++] = (uint16_t)(mark & 0xffff);
+        }
+    }
+}
+
+void LightClusterer::workerLoop(size_t part) {
+    unsigned long seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workReady.wait(lock, [this, seen] { return quitting || generation != seen; });
+            if (quitting) {
+                return;
+            }
+            seen = generation;
+        }
+        assignPart(parts[part]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        workDone.notify_one();
+    }
+}
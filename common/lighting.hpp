@@ -0,0 +1,127 @@
+/*
+Description:
+Clustered forward lighting for many point lights. The view frustum is cut
+into a grid of clusters: tiles on screen, and slices in depth spaced
+exponentially so near clusters are as deep as they are wide. Each frame every
+light is assigned to the clusters its sphere of influence touches. The
+fragment shader finds its cluster from the pixel and the view depth, then
+loops only over that cluster's lights. Shading cost therefore follows the
+number of lights near a surface, not the number in the scene.
+
+Assignment runs on the simulation thread plus helper threads, each taking an
+equal share of the depth slices and writing its own contiguous part of the
+light lists.
+*/
+
+#ifndef LIGHTING_HPP
+#define LIGHTING_HPP
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "framepacket.hpp"
+
+/// Cluster grid, mirrored in StandardShading.fragmentshader
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 12;
+const int CLUSTER_SLICES = 24;
+const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+/// Depth where the exponential slices start; everything nearer is in slice 0
+const float CLUSTER_NEAR = 5.0f;
+
+/// Light numbers are stored in 16 bits
+const int MAX_POINT_LIGHTS = 4096;
+
+/**
+ * @brief Point light with a finite range
+ */
+struct PointLight {
+    glm::vec3 position;  ///< World space
+    float radius;        ///< Distance at which the light has faded to nothing
+    glm::vec3 color;
+    float power;         ///< Same scale as the scene light's power of 500
+
+    PointLight() : position(0.0f), radius(1.0f), color(1.0f), power(0.0f) {}
+    PointLight(const glm::vec3& position, float radius, const glm::vec3& color, float power)
+        : position(position), radius(radius), color(color), power(power) {}
+};
+
+/**
+ * @brief Lamps hung in a square grid over an area centred on the origin
+ * The more lamps, the closer together and the shorter their reach, so any
+ * point of the area stays lit by a handful of them.
+ *
+ * @param count Number of lamps
+ * @param extent Width of the area in world units
+ */
+std::vector<PointLight> hallLamps(int count, float extent);
+
+/**
+ * @brief Assigns point lights to the clusters of a camera frustum
+ */
+class LightClusterer {
+public:
+    /**
+     * @param threads Threads taking part in an assignment, the caller included
+     */
+    explicit LightClusterer(int threads = 1);
+    ~LightClusterer();
+
+    LightClusterer(const LightClusterer&) = delete;
+    LightClusterer& operator=(const LightClusterer&) = delete;
+
+    /**
+     * @brief Builds the cluster light lists for one frame
+     * Lights past MAX_POINT_LIGHTS are ignored.
+     *
+     * @param lights Lights in world space
+     * @param view Camera view matrix
+     * @param projection Symmetric perspective projection of the camera
+     * @param clusters Receives view-space lights and per cluster light lists
+     */
+    void assign(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+                ClusteredLights& clusters);
+
+    int threadCount() const { return (int)parts.size(); }
+
+private:
+    /// Output of one thread: its slices' clusters, with offsets local to indices
+    struct Part {
+        int firstSlice;
+        int endSlice;
+        std::vector<uint32_t> ranges;
+        std::vector<uint16_t> indices;
+    };
+
+    void updateBounds(const glm::mat4& projection, float zNear, float zFar);
+    void assignPart(Part& part);
+    void workerLoop(size_t part);
+
+    std::vector<Part> parts;
+    // Cluster bounds in view space, rebuilt when the projection changes
+    glm::mat4 boundsProjection;
+    float projectionX;      ///< P[0][0] and P[1][1]: NDC x = view x * projectionX / depth
+    float projectionY;
+    std::vector<float> sliceNear;   ///< Depth of each slice boundary, CLUSTER_SLICES + 1 values
+    std::vector<glm::vec3> boundsMin;
+    std::vector<glm::vec3> boundsMax;
+    // Per light for the current assignment
+    std::vector<glm::vec4> viewLights;      ///< View-space position and radius
+    std::vector<int> firstSlice;
+    std::vector<int> lastSlice;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workReady;
+    std::condition_variable workDone;
+    unsigned long generation;   ///< Guarded by mutex, bumped for every assignment
+    int pending;                ///< Parts still running, guarded by mutex
+    bool quitting;
+};
+
+#endif
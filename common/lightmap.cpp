@@ -0,0 +1,264 @@
+/*
+Description:
+Lightmap baking, dilation and file I/O.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "bvh.hpp"
+#include "lightmap.hpp"
+
+namespace {
+    const uint32_t LIGHTMAP_MAGIC = 0x504d4c43;     // "CLMP"
+    const uint32_t LIGHTMAP_VERSION = 1;
+
+    /// Rays start this far off the surface so it does not shadow itself
+    const float RAY_OFFSET = 0.02f;
+
+    /// Board surface point lit by one lightmap texel
+    struct TexelSample {
+        uint32_t texel;
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    /// Small per texel random generator, so a bake does not depend on the thread count
+    struct Random {
+        uint32_t state;
+        explicit Random(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+        float next() {
+            state = state * 747796405u + 2891336453u;
+            uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+            return ((word >> 22) ^ word) * (1.0f / 4294967296.0f);
+        }
+    };
+
+    /// Signed area test of p against the edge a -> b, doubled
+    float edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p) {
+        return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    }
+
+    /**
+     * @brief Finds the texels whose centres lie inside each board triangle in UV space
+     * A texel covered by two triangles keeps the first.
+     */
+    void rasterize(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec2>& uvs,
+                   const std::vector<glm::vec3>& normals, const glm::mat4& boardMatrix, int size,
+                   std::vector<TexelSample>& samples, std::vector<uint8_t>& covered) {
+        glm::mat3 normalMatrix(boardMatrix);
+        covered.assign((size_t)size * size, 0);
+        for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+            // UVs wrap like the texture sampler, loadOBJ leaves them in [-1, 0]
+            glm::vec2 cell = glm::floor(glm::min(uvs[i], glm::min(uvs[i + 1], uvs[i + 2])));
+            glm::vec2 corner[3];
+            for (int k = 0; k < 3; k++) {
+                corner[k] = (uvs[i + k] - cell) * (float)size;
+            }
+            float area = edge(corner[0], corner[1], corner[2]);
+            if (fabsf(area) < 1e-8f) {
+                continue;
+            }
+            glm::vec2 low = glm::min(corner[0], glm::min(corner[1], corner[2]));
+            glm::vec2 high = glm::max(corner[0], glm::max(corner[1], corner[2]));
+            int x0 = std::max(0, (int)floorf(low.x)), x1 = std::min(size - 1, (int)ceilf(high.x));
+            int y0 = std::max(0, (int)floorf(low.y)), y1 = std::min(size - 1, (int)ceilf(high.y));
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    uint32_t texel = (uint32_t)(y * size + x);
+                    if (covered[texel]) {
+                        continue;
+                    }
+                    glm::vec2 centre(x + 0.5f, y + 0.5f);
+                    float w0 = edge(corner[1], corner[2], centre) / area;
+                    float w1 = edge(corner[2], corner[0], centre) / area;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                        continue;
+                    }
+                    TexelSample sample;
+                    sample.texel = texel;
+                    glm::vec3 position = vertices[i] * w0 + vertices[i + 1] * w1 + vertices[i + 2] * w2;
+                    glm::vec3 normal = normals[i] * w0 + normals[i + 1] * w1 + normals[i + 2] * w2;
+                    sample.position = glm::vec3(boardMatrix * glm::vec4(position, 1.0f));
+                    sample.normal = glm::normalize(normalMatrix * normal);
+                    samples.push_back(sample);
+                    covered[texel] = 1;
+                }
+            }
+        }
+    }
+
+    glm::vec2 shade(const TexelSample& sample, const TriangleBvh& bvh, const BakeSettings& settings) {
+        Random random(sample.texel);
+        glm::vec3 origin = sample.position + sample.normal * RAY_OFFSET;
+
+        // Direct light, averaged over points of the light sphere for soft shadows
+        float direct = 0.0f;
+        for (int i = 0; i < settings.lightSamples; i++) {
+            float z = 2.0f * random.next() - 1.0f;
+            float angle = 6.2831853f * random.next();
+            float ring = sqrtf(std::max(0.0f, 1.0f - z * z));
+            glm::vec3 point = settings.lightPosition +
+                              settings.lightRadius * glm::vec3(ring * cosf(angle), ring * sinf(angle), z);
+            glm::vec3 toLight = point - origin;
+            float distance = glm::length(toLight);
+            glm::vec3 direction = toLight / distance;
+            float cosTheta = glm::dot(sample.normal, direction);
+            if (cosTheta > 0.0f && !bvh.occluded(origin, direction, distance)) {
+                direct += settings.lightPower * cosTheta / (distance * distance);
+            }
+        }
+        direct /= std::max(1, settings.lightSamples);
+
+        // Ambient occlusion, cosine weighted over the hemisphere
+        glm::vec3 tangent = glm::normalize(glm::cross(sample.normal, fabsf(sample.normal.y) < 0.9f ?
+                                                      glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+        glm::vec3 bitangent = glm::cross(sample.normal, tangent);
+        int open = 0;
+        for (int i = 0; i < settings.aoSamples; i++) {
+            float radius = sqrtf(random.next());
+            float angle = 6.2831853f * random.next();
+            float x = radius * cosf(angle), y = radius * sinf(angle);
+            float z = sqrtf(std::max(0.0f, 1.0f - x * x - y * y));
+            glm::vec3 direction = tangent * x + bitangent * y + sample.normal * z;
+            if (!bvh.occluded(origin, direction, settings.aoDistance)) {
+                open++;
+            }
+        }
+        float ambient = settings.aoSamples > 0 ? (float)open / settings.aoSamples : 1.0f;
+        return glm::vec2(direct, ambient);
+    }
+
+    /**
+     * @brief Grows the baked texels into their empty neighbours
+     * Bilinear filtering and mipmaps at the edges of UV islands then pick up
+     * the island's own lighting rather than black.
+     */
+    void dilate(Lightmap& lightmap, std::vector<uint8_t>& covered, int passes) {
+        int size = lightmap.width;
+        for (int pass = 0; pass < passes; pass++) {
+            std::vector<uint8_t> next = covered;
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                    size_t texel = (size_t)y * size + x;
+                    if (covered[texel]) {
+                        continue;
+                    }
+                    glm::vec2 sum(0.0f);
+                    int count = 0;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || ny < 0 || nx >= size || ny >= size || !covered[(size_t)ny * size + nx]) {
+                                continue;
+                            }
+                            sum += lightmap.texels[(size_t)ny * size + nx];
+                            count++;
+                        }
+                    }
+                    if (count > 0) {
+                        lightmap.texels[texel] = sum / (float)count;
+                        next[texel] = 1;
+                    }
+                }
+            }
+            covered.swap(next);
+        }
+    }
+}
+
+size_t bakeLightmap(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec2>& uvs,
+                  const std::vector<glm::vec3>& normals, const glm::mat4& boardMatrix,
+                  const std::vector<glm::vec3>& occluders, const BakeSettings& settings, Lightmap& lightmap) {
+    TriangleBvh bvh;
+    bvh.build(occluders);
+
+    std::vector<TexelSample> samples;
+    std::vector<uint8_t> covered;
+    rasterize(vertices, uvs, normals, boardMatrix, settings.size, samples, covered);
+
+    lightmap.width = settings.size;
+    lightmap.height = settings.size;
+    lightmap.boardMatrix = boardMatrix;
+    lightmap.lightPosition = settings.lightPosition;
+    lightmap.texels.assign((size_t)settings.size * settings.size, glm::vec2(0.0f, 1.0f));
+
+    // Threads take blocks of texels from a shared counter, as texels near
+    // pieces or edges cost more rays than open ones
+    const size_t BLOCK = 256;
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (;;) {
+            size_t first = next.fetch_add(BLOCK);
+            if (first >= samples.size()) {
+                return;
+            }
+            size_t end = std::min(samples.size(), first + BLOCK);
+            for (size_t i = first; i < end; i++) {
+                lightmap.texels[samples[i].texel] = shade(samples[i], bvh, settings);
+            }
+        }
+    };
+    int threads = settings.threads > 0 ? settings.threads : (int)std::thread::hardware_concurrency();
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    dilate(lightmap, covered, 4);
+    return samples.size();
+}
+
+bool saveLightmap(const char* path, const Lightmap& lightmap) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not create %s\n", path);
+        return false;
+    }
+    uint32_t header[4] = { LIGHTMAP_MAGIC, LIGHTMAP_VERSION, (uint32_t)lightmap.width, (uint32_t)lightmap.height };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+              fwrite(&lightmap.boardMatrix[0][0], sizeof(float), 16, file) == 16 &&
+              fwrite(&lightmap.lightPosition[0], sizeof(float), 3, file) == 3 &&
+              fwrite(&lightmap.texels[0], sizeof(glm::vec2), lightmap.texels.size(), file) == lightmap.texels.size();
+    if (fclose(file) != 0 || !ok) {
+        fprintf(stderr, "Error: Could not write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool loadLightmap(const char* path, Lightmap& lightmap) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    uint32_t header[4];
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == LIGHTMAP_MAGIC &&
+              header[1] == LIGHTMAP_VERSION && header[2] > 0 && header[2] <= 8192 &&
+              header[3] > 0 && header[3] <= 8192;
+    if (ok) {
+        lightmap.width = (int)header[2];
+        lightmap.height = (int)header[3];
+        lightmap.texels.resize((size_t)lightmap.width * lightmap.height);
+        ok = fread(&lightmap.boardMatrix[0][0], sizeof(float), 16, file) == 16 &&
+             fread(&lightmap.lightPosition[0], sizeof(float), 3, file) == 3 &&
+             fread(&lightmap.texels[0], sizeof(glm::vec2), lightmap.texels.size(), file) == lightmap.texels.size();
+    }
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not a lightmap\n", path);
+        lightmap = Lightmap();
+    }
+    return ok;
+}
@@ -0,0 +1,81 @@
+/*
+Description:
+Baked lighting for the static board. The baker ray-traces, for every texel of
+the board's texture atlas, the direct light of the scene light with soft
+shadows and the ambient occlusion. It uses a BVH over the board and any pieces
+baked with it, and all cores. The scene samples the result instead of
+computing the board's diffuse term per fragment. The board's UVs never
+overlap, so the lightmap reuses them.
+*/
+
+#ifndef LIGHTMAP_HPP
+#define LIGHTMAP_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+/// Where the viewer looks for a bake of the board, relative to Lab3/
+#define DEFAULT_LIGHTMAP_PATH "Stone_Chess_Board/12951_Stone_Chess_Board.lightmap"
+
+/**
+ * @brief Baked lighting of one board mesh
+ */
+struct Lightmap {
+    int width;
+    int height;
+    glm::mat4 boardMatrix;      ///< Model matrix of the board that was baked
+    glm::vec3 lightPosition;    ///< Scene light the direct term was baked for
+    /// Per texel: x is the direct irradiance, power * cos / distance^2 times
+    /// the visible fraction of the light; y is the unoccluded fraction of the hemisphere
+    std::vector<glm::vec2> texels;
+
+    Lightmap() : width(0), height(0), boardMatrix(1.0f), lightPosition(0.0f) {}
+};
+
+/**
+ * @brief Quality and scene settings of a bake
+ */
+struct BakeSettings {
+    int size;               ///< Width and height of the lightmap in texels
+    glm::vec3 lightPosition;
+    float lightPower;       ///< Same scale as LightPower in StandardShading.fragmentshader
+    float lightRadius;      ///< Radius of the light sphere, sets the width of the penumbrae
+    int lightSamples;       ///< Shadow rays per texel
+    int aoSamples;          ///< Occlusion rays per texel
+    float aoDistance;       ///< Geometry further away than this does not occlude
+    int threads;            ///< 0 for every hardware thread
+
+    BakeSettings()
+        : size(512), lightPosition(0.0f, 25.0f, 0.0f), lightPower(500.0f), lightRadius(1.0f),
+          lightSamples(16), aoSamples(64), aoDistance(6.0f), threads(0) {}
+};
+
+/**
+ * @brief Bakes direct light and ambient occlusion into the board's lightmap
+ *
+ * @param vertices Board mesh in model space, three vertices per triangle
+ * @param uvs Texture coordinates of the vertices, also used for the lightmap
+ * @param normals Vertex normals in model space
+ * @param boardMatrix Model matrix of the baked board
+ * @param occluders World-space triangles casting shadows, the board's included
+ * @param settings Bake settings
+ * @param lightmap Receives the bake
+ * @return Number of texels covered by the board, each traced with every ray
+ */
+size_t bakeLightmap(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec2>& uvs,
+                  const std::vector<glm::vec3>& normals, const glm::mat4& boardMatrix,
+                  const std::vector<glm::vec3>& occluders, const BakeSettings& settings, Lightmap& lightmap);
+
+/**
+ * @brief Writes a lightmap in the baker's binary format
+ * @return true on success
+ */
+bool saveLightmap(const char* path, const Lightmap& lightmap);
+
+/**
+ * @brief Reads a lightmap written by saveLightmap()
+ * @return true on success
+ */
+bool loadLightmap(const char* path, Lightmap& lightmap);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+Description:
+MappedFile on POSIX (mmap) and Windows (file mapping objects).
+*/
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.hpp"
+
+#if defined(_WIN32)
+MappedFile::MappedFile() : bytes(NULL), length(0), fileHandle(NULL), mappingHandle(NULL) {}
+#else
+MappedFile::MappedFile() : bytes(NULL), length(0) {}
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const char* path, Access access) {
+    close();
+    DWORD flags = access == ACCESS_RANDOM ? FILE_FLAG_RANDOM_ACCESS :
+                  access == ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = (const uint8_t*)view;
+    length = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+        CloseHandle((HANDLE)mappingHandle);
+        CloseHandle((HANDLE)fileHandle);
+    }
+    bytes = NULL;
+    length = 0;
+    fileHandle = mappingHandle = NULL;
+}
+
+#else
+
+bool MappedFile::open(const char* path, Access access) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file alive on its own
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    if (access != ACCESS_NORMAL) {
+        madvise(view, (size_t)info.st_size, access == ACCESS_RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+    }
+    bytes = (const uint8_t*)view;
+    length = (size_t)info.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes) {
+        munmap((void*)bytes, length);
+    }
+    bytes = NULL;
+    length = 0;
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+Description:
+Read-only memory-mapped file. Data is paged in on first touch and shared with
+every other process mapping the same file, so large weight files, books and
+tables open instantly and cost no private memory.
+*/
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Owns one read-only mapping of a whole file
+ */
+class MappedFile {
+public:
+    /// Expected access pattern, passed on to the kernel where supported
+    enum Access { ACCESS_NORMAL, ACCESS_RANDOM, ACCESS_SEQUENTIAL };
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Maps a file, closing any previous mapping first
+     *
+     * @param path File to map
+     * @param access Expected access pattern
+     * @return true on success; empty files fail
+     */
+    bool open(const char* path, Access access = ACCESS_NORMAL);
+
+    /**
+     * @brief Unmaps the file
+     */
+    void close();
+
+    bool isOpen() const { return bytes != NULL; }
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes;
+    size_t length;
+#if defined(_WIN32)
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+Description:
+Legal move generator. The king's escape squares are tested against an attack
+map built with the king removed, checks restrict the other pieces to blocking
+or capturing squares, and pinned pieces may only move along their pin line.
+En passant is the one case verified by occupancy, since it removes two pieces
+from the same rank.
+*/
+
+#include "movegen.hpp"
+
+namespace {
+    /**
+     * @brief Per-position data shared by all piece generators
+     */
+    struct GenContext {
+        int us;
+        int them;
+        int king;
+        Bitboard own;
+        Bitboard enemy;
+        Bitboard occupied;
+        Bitboard checkMask; ///< Squares that resolve a single check, everything otherwise
+        Bitboard pinned;
+        Bitboard targets;   ///< Squares pieces may move to: not own, or only enemy for captures
+        bool capturesOnly;  ///< Captures and queen promotions only
+    };
+
+    Bitboard attackedBy(const Position& position, int color, Bitboard occupied) {
+        Bitboard attacks = 0;
+        Bitboard pawns = position.pieces(color, PAWN);
+        if (color == WHITE) {
+            attacks |= ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9);
+        } else {
+            attacks |= ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+        }
+        for (Bitboard b = position.pieces(color, KNIGHT); b; ) {
+            attacks |= knightAttacks(popLsb(b));
+        }
+        Bitboard diagonal = position.pieces(color, BISHOP) | position.pieces(color, QUEEN);
+        for (Bitboard b = diagonal; b; ) {
+            attacks |= bishopAttacks(popLsb(b), occupied);
+        }
+        Bitboard straight = position.pieces(color, ROOK) | position.pieces(color, QUEEN);
+        for (Bitboard b = straight; b; ) {
+            attacks |= rookAttacks(popLsb(b), occupied);
+        }
+        return attacks | kingAttacks(position.kingSquare(color));
+    }
+
+    Bitboard pinnedPieces(const Position& position, const GenContext& ctx) {
+        Bitboard pinned = 0;
+        Bitboard snipers =
+            (rookAttacks(ctx.king, 0) & (position.pieces(ctx.them, ROOK) | position.pieces(ctx.them, QUEEN))) |
+            (bishopAttacks(ctx.king, 0) & (position.pieces(ctx.them, BISHOP) | position.pieces(ctx.them, QUEEN)));
+        while (snipers) {
+            Bitboard blockers = betweenBB(ctx.king, popLsb(snipers)) & ctx.occupied;
+            if (blockers && !(blockers & (blockers - 1)) && (blockers & ctx.own)) {
+                pinned |= blockers;
+            }
+        }
+        return pinned;
+    }
+
+    void addTargets(MoveList& list, int from, Bitboard targets, Bitboard enemy) {
+        while (targets) {
+            int to = popLsb(targets);
+            list.add(makeMove(from, to, (squareBB(to) & enemy) ? CAPTURE : QUIET_MOVE));
+        }
+    }
+
+    void addPawnMove(MoveList& list, int from, int to, bool capture, bool queenOnly) {
+        int rank = squareRank(to);
+        if (rank == 0 || rank == 7) {
+            int flags = capture ? PROMOTION_CAPTURE : PROMOTION;
+            for (int piece = 3; piece >= (queenOnly ? 3 : 0); piece--) {
+                list.add(makeMove(from, to, flags | piece));
+            }
+        } else {
+            list.add(makeMove(from, to, capture ? CAPTURE : QUIET_MOVE));
+        }
+    }
+
+    void generatePawnMoves(const Position& position, const GenContext& ctx, MoveList& list) {
+        const int up = ctx.us == WHITE ? 8 : -8;
+        const int startRank = ctx.us == WHITE ? 1 : 6;
+        const int ep = position.epSquare();
+
+        for (Bitboard pawns = position.pieces(ctx.us, PAWN); pawns; ) {
+            int from = popLsb(pawns);
+            Bitboard allowed = ctx.checkMask;
+            if (ctx.pinned & squareBB(from)) {
+                allowed &= lineBB(ctx.king, from);
+            }
+
+            int push = from + up;
+            bool promotion = squareRank(push) == 0 || squareRank(push) == 7;
+            if (!(ctx.occupied & squareBB(push)) && (promotion || !ctx.capturesOnly)) {
+                if (allowed & squareBB(push)) {
+                    addPawnMove(list, from, push, false, ctx.capturesOnly);
+                }
+                int doublePush = push + up;
+                if (!ctx.capturesOnly && squareRank(from) == startRank && !(ctx.occupied & squareBB(doublePush)) &&
+                    (allowed & squareBB(doublePush))) {
+                    list.add(makeMove(from, doublePush, DOUBLE_PAWN_PUSH));
+                }
+            }
+
+            Bitboard attacks = pawnAttacks(ctx.us, from);
+            for (Bitboard captures = attacks & ctx.enemy & allowed; captures; ) {
+                addPawnMove(list, from, popLsb(captures), true, ctx.capturesOnly);
+            }
+
+            if (ep != NO_SQUARE && (attacks & squareBB(ep))) {
+                // Both pawns leave their squares at once, so replay the capture
+                // on the occupancy and look for sliders hitting the king
+                int captured = ep - up;
+                Bitboard after = (ctx.occupied ^ squareBB(from) ^ squareBB(captured)) | squareBB(ep);
+                Bitboard diagonal = position.pieces(ctx.them, BISHOP) | position.pieces(ctx.them, QUEEN);
+                Bitboard straight = position.pieces(ctx.them, ROOK) | position.pieces(ctx.them, QUEEN);
+                bool resolvesCheck = (ctx.checkMask & (squareBB(ep) | squareBB(captured))) != 0;
+                if (resolvesCheck &&
+                    !(bishopAttacks(ctx.king, after) & diagonal) &&
+                    !(rookAttacks(ctx.king, after) & straight)) {
+                    list.add(makeMove(from, ep, EN_PASSANT));
+                }
+            }
+        }
+    }
+
+    void generateCastling(const Position& position, const GenContext& ctx, Bitboard attacked, MoveList& list) {
+        int rights = position.castlingRights() >> (2 * ctx.us);
+        int base = ctx.us == WHITE ? 0 : 56;
+
+        // Squares between king and rook must be empty, squares the king crosses unattacked
+        if ((rights & 1) &&
+            !(ctx.occupied & (squareBB(base + 5) | squareBB(base + 6))) &&
+            !(attacked & (squareBB(base + 5) | squareBB(base + 6)))) {
+            list.add(makeMove(base + 4, base + 6, KING_CASTLE));
+        }
+        if ((rights & 2) &&
+            !(ctx.occupied & (squareBB(base + 1) | squareBB(base + 2) | squareBB(base + 3))) &&
+            !(attacked & (squareBB(base + 2) | squareBB(base + 3)))) {
+            list.add(makeMove(base + 4, base + 2, QUEEN_CASTLE));
+        }
+    }
+
+    /**
+     * @brief Shared body of the public generators
+     * @param capturesOnly Only captures and queen promotions; the caller makes sure it is not in check
+     */
+    void generateMoves(const Position& position, MoveList& list, bool capturesOnly) {
+        list.count = 0;
+
+        GenContext ctx;
+        ctx.us = position.sideToMove();
+        ctx.them = ctx.us ^ 1;
+        ctx.king = position.kingSquare(ctx.us);
+        ctx.own = position.colorPieces(ctx.us);
+        ctx.enemy = position.colorPieces(ctx.them);
+        ctx.occupied = ctx.own | ctx.enemy;
+        ctx.capturesOnly = capturesOnly;
+        ctx.targets = capturesOnly ? ctx.enemy : ~ctx.own;
+
+        // Sliders must see through the king, or it could step back along a checking ray
+        Bitboard attacked = attackedBy(position, ctx.them, ctx.occupied ^ squareBB(ctx.king));
+        addTargets(list, ctx.king, kingAttacks(ctx.king) & ctx.targets & ~attacked, ctx.enemy);
+
+        Bitboard checkers = position.checkers();
+        if (checkers & (checkers - 1)) {
+            return; // Double check, only the king can move
+        }
+        ctx.checkMask = checkers ? betweenBB(ctx.king, lsb(checkers)) | checkers : ~0ull;
+        ctx.pinned = pinnedPieces(position, ctx);
+
+        generatePawnMoves(position, ctx, list);
+
+        for (int type = KNIGHT; type <= QUEEN; type++) {
+            for (Bitboard pieces = position.pieces(ctx.us, type); pieces; ) {
+                int from = popLsb(pieces);
+                Bitboard targets = pieceAttacks(type, from, ctx.occupied) & ctx.targets & ctx.checkMask;
+                if (ctx.pinned & squareBB(from)) {
+                    targets &= lineBB(ctx.king, from);
+                }
+                addTargets(list, from, targets, ctx.enemy);
+            }
+        }
+
+        if (!checkers && !capturesOnly) {
+            generateCastling(position, ctx, attacked, list);
+        }
+    }
+}
+
+void generateLegalMoves(const Position& position, MoveList& list) {
+    generateMoves(position, list, false);
+}
+
+void generateLegalCaptures(const Position& position, MoveList& list) {
+    generateMoves(position, list, !position.inCheck());
+}
+
+unsigned long long perft(Position& position, int depth) {
+    MoveList list;
+    generateLegalMoves(position, list);
+    // Bulk counting: the moves at the last ply never need to be made
+    if (depth <= 1) {
+        return depth == 1 ? (unsigned long long)list.size() : 1ull;
+    }
+    unsigned long long nodes = 0;
+    for (int i = 0; i < list.size(); i++) {
+        position.makeMove(list[i]);
+        nodes += perft(position, depth - 1);
+        position.unmakeMove();
+    }
+    return nodes;
+}
+
+std::string moveToUci(Move move) {
+    if (move == NO_MOVE) {
+        return "0000";
+    }
+    std::string text;
+    text += char('a' + squareFile(moveFrom(move)));
+    text += char('1' + squareRank(moveFrom(move)));
+    text += char('a' + squareFile(moveTo(move)));
+    text += char('1' + squareRank(moveTo(move)));
+    if (isPromotion(move)) {
+        text += "nbrq"[promotionType(move) - KNIGHT];
+    }
+    return text;
+}
+
+Move parseUciMove(const Position& position, const std::string& text) {
+    MoveList list;
+    generateLegalMoves(position, list);
+    for (int i = 0; i < list.size(); i++) {
+        if (moveToUci(list[i]) == text) {
+            return list[i];
+        }
+    }
+    return NO_MOVE;
+}
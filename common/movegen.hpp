@@ -0,0 +1,65 @@
+/*
+Description:
+Legal move generation. Checks and pins are worked out once per position, so
+every generated move is legal without making it first.
+*/
+
+#ifndef MOVEGEN_HPP
+#define MOVEGEN_HPP
+
+#include <string>
+
+#include "position.hpp"
+
+/**
+ * @brief Fixed capacity move list; no legal position has more than 218 moves
+ */
+struct MoveList {
+    Move moves[256];
+    int count;
+
+    MoveList() : count(0) {}
+    void add(Move move) { moves[count++] = move; }
+    int size() const { return count; }
+    Move operator[](int i) const { return moves[i]; }
+};
+
+/**
+ * @brief Generates every legal move of the side to move
+ *
+ * @param position Position to generate for
+ * @param list Output, cleared first
+ */
+void generateLegalMoves(const Position& position, MoveList& list);
+
+/**
+ * @brief Generates the legal captures and queen promotions, for quiescence search
+ * Underpromotions are left out, captures included. In check every evasion is
+ * generated instead, so an empty list still means mate.
+ *
+ * @param position Position to generate for
+ * @param list Output, cleared first
+ */
+void generateLegalCaptures(const Position& position, MoveList& list);
+
+/**
+ * @brief Counts leaf nodes of the legal move tree
+ *
+ * @param position Position to start from, restored on return
+ * @param depth Depth in plies
+ * @return Number of leaf nodes at the given depth
+ */
+unsigned long long perft(Position& position, int depth);
+
+/**
+ * @brief Formats a move in UCI long algebraic notation, e.g. "e2e4" or "e7e8q"
+ */
+std::string moveToUci(Move move);
+
+/**
+ * @brief Finds the legal move matching a UCI string
+ * @return The move, NO_MOVE if it is not legal in the position
+ */
+Move parseUciMove(const Position& position, const std::string& text);
+
+#endif
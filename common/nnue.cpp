@@ -0,0 +1,365 @@
+/*
+Description:
+NNUE weights loading, accumulator updates and the integer kernels. The kernel
+set is picked at compile time: AVX2, SSSE3 (SSE2 for the accumulator) or plain
+C++.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "nnue.hpp"
+
+namespace {
+    const char NETWORK_MAGIC[4] = { 'C', 'N', 'N', 'U' };
+    const uint32_t NETWORK_VERSION = 1;
+    const size_t HEADER_SIZE = 32;
+    const size_t FEATURE_WEIGHTS_SIZE = NNUE_INPUTS * NNUE_HIDDEN * sizeof(int16_t);
+    const size_t FEATURE_BIAS_SIZE = NNUE_HIDDEN * sizeof(int16_t);
+    const size_t DENSE_WEIGHTS_SIZE = NNUE_DENSE * 2 * NNUE_HIDDEN;
+    const size_t DENSE_BIAS_SIZE = NNUE_DENSE * sizeof(int32_t);
+    const size_t OUTPUT_WEIGHTS_SIZE = NNUE_DENSE;
+    const size_t NETWORK_SIZE = HEADER_SIZE + FEATURE_WEIGHTS_SIZE + FEATURE_BIAS_SIZE +
+                                DENSE_WEIGHTS_SIZE + DENSE_BIAS_SIZE + OUTPUT_WEIGHTS_SIZE + sizeof(int32_t);
+
+    /// Clipped activations are 0..127; dense sums are scaled back by 2^6
+    const int ACTIVATION_MAX = 127;
+    const int DENSE_SHIFT = 6;
+    const int OUTPUT_SCALE = 16;
+
+    /// Catching up over more moves than this is slower than a refresh
+    const int MAX_CATCH_UP = 8;
+
+    int featureIndex(int perspective, int piece, int square) {
+        int relativeColor = pieceColor(piece) == perspective ? 0 : 1;
+        int relativeSquare = perspective == WHITE ? square : square ^ 56;
+        return (relativeColor * 6 + pieceType(piece)) * 64 + relativeSquare;
+    }
+
+    /**
+     * @brief child = parent + sum(added rows) - sum(removed rows), one pass over NNUE_HIDDEN values
+     */
+    void applyRows(const int16_t* parent, int16_t* child, const int16_t* const* added, int addedCount,
+                   const int16_t* const* removed, int removedCount) {
+#if defined(__AVX2__)
+        for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+            __m256i sum = _mm256_loadu_si256((const __m256i*)(parent + i));
+            for (int r = 0; r < addedCount; r++) {
+                sum = _mm256_add_epi16(sum, _mm256_loadu_si256((const __m256i*)(added[r] + i)));
+            }
+            for (int r = 0; r < removedCount; r++) {
+                sum = _mm256_sub_epi16(sum, _mm256_loadu_si256((const __m256i*)(removed[r] + i)));
+            }
+            _mm256_storeu_si256((__m256i*)(child + i), sum);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+            __m128i sum = _mm_loadu_si128((const __m128i*)(parent + i));
+            for (int r = 0; r < addedCount; r++) {
+                sum = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i*)(added[r] + i)));
+            }
+            for (int r = 0; r < removedCount; r++) {
+                sum = _mm_sub_epi16(sum, _mm_loadu_si128((const __m128i*)(removed[r] + i)));
+            }
+            _mm_storeu_si128((__m128i*)(child + i), sum);
+        }
+#else
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            int sum = parent[i];
+            for (int r = 0; r < addedCount; r++) {
+                sum += added[r][i];
+            }
+            for (int r = 0; r < removedCount; r++) {
+                sum -= removed[r][i];
+            }
+            child[i] = (int16_t)sum;
+        }
+#endif
+    }
+
+    /**
+     * @brief Clips NNUE_HIDDEN accumulator values to 0..127 bytes
+     */
+    void clipActivations(const int16_t* input, uint8_t* output) {
+#if defined(__AVX2__)
+        const __m256i limit = _mm256_set1_epi8(ACTIVATION_MAX);
+        for (int i = 0; i < NNUE_HIDDEN; i += 32) {
+            __m256i low = _mm256_loadu_si256((const __m256i*)(input + i));
+            __m256i high = _mm256_loadu_si256((const __m256i*)(input + i + 16));
+            // Packing works per 128-bit lane, the permute puts the quarters back in order
+            __m256i packed = _mm256_min_epu8(_mm256_packus_epi16(low, high), limit);
+            _mm256_storeu_si256((__m256i*)(output + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        const __m128i limit = _mm_set1_epi8(ACTIVATION_MAX);
+        for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+            __m128i low = _mm_loadu_si128((const __m128i*)(input + i));
+            __m128i high = _mm_loadu_si128((const __m128i*)(input + i + 8));
+            _mm_storeu_si128((__m128i*)(output + i), _mm_min_epu8(_mm_packus_epi16(low, high), limit));
+        }
+#else
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            int value = input[i];
+            output[i] = (uint8_t)(value < 0 ? 0 : value > ACTIVATION_MAX ? ACTIVATION_MAX : value);
+        }
+#endif
+    }
+
+    /**
+     * @brief Dot product of unsigned activations and signed weights; count is a multiple of 32
+     */
+    int32_t dotProduct(const uint8_t* input, const int8_t* weights, int count) {
+#if defined(__AVX2__)
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < count; i += 32) {
+            __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(input + i)),
+                                                    _mm256_loadu_si256((const __m256i*)(weights + i)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        return _mm_cvtsi128_si32(half);
+#elif defined(__SSSE3__)
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < count; i += 16) {
+            __m128i products = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(input + i)),
+                                                 _mm_loadu_si128((const __m128i*)(weights + i)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+#else
+        int32_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            sum += input[i] * weights[i];
+        }
+        return sum;
+#endif
+    }
+
+    uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    int randomBetween(uint64_t& state, int low, int high) {
+        return low + (int)(splitmix64(state) % (uint64_t)(high - low + 1));
+    }
+}
+
+NnueNetwork::NnueNetwork()
+    : featureWeights(NULL), featureBias(NULL), denseWeights(NULL), denseBias(NULL),
+      outputWeights(NULL), outputBias(0) {}
+
+bool NnueNetwork::load(const char* path) {
+    featureWeights = NULL;
+    if (!file.open(path)) {
+        fprintf(stderr, "Could not open network %s\n", path);
+        return false;
+    }
+
+    const uint8_t* data = file.data();
+    uint32_t header[8] = { 0 };
+    if (file.size() == NETWORK_SIZE) {
+        memcpy(header, data, sizeof(header));
+    }
+    if (file.size() != NETWORK_SIZE || memcmp(header, NETWORK_MAGIC, 4) != 0 ||
+        header[1] != NETWORK_VERSION || header[2] != (uint32_t)NNUE_INPUTS ||
+        header[3] != (uint32_t)NNUE_HIDDEN || header[4] != (uint32_t)NNUE_DENSE) {
+        fprintf(stderr, "%s is not a %dx%dx%d network\n", path, NNUE_INPUTS, NNUE_HIDDEN, NNUE_DENSE);
+        file.close();
+        return false;
+    }
+
+    // Every section starts at a multiple of its element size, so the weights are used in place
+    const uint8_t* section = data + HEADER_SIZE;
+    featureWeights = (const int16_t*)section;
+    section += FEATURE_WEIGHTS_SIZE;
+    featureBias = (const int16_t*)section;
+    section += FEATURE_BIAS_SIZE;
+    denseWeights = (const int8_t*)section;
+    section += DENSE_WEIGHTS_SIZE;
+    denseBias = (const int32_t*)section;
+    section += DENSE_BIAS_SIZE;
+    outputWeights = (const int8_t*)section;
+    section += OUTPUT_WEIGHTS_SIZE;
+    memcpy(&outputBias, section, sizeof(outputBias));
+    return true;
+}
+
+void NnueNetwork::refresh(const Position& position, NnueAccumulator& accumulator) const {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        const int16_t* rows[32];
+        int rowCount = 0;
+        int16_t* values = accumulator.values[perspective];
+        memcpy(values, featureBias, FEATURE_BIAS_SIZE);
+        for (Bitboard occupied = position.occupied(); occupied; ) {
+            int square = popLsb(occupied);
+            rows[rowCount++] = featureWeights +
+                featureIndex(perspective, position.pieceOn(square), square) * NNUE_HIDDEN;
+            if (rowCount == 32) {
+                applyRows(values, values, rows, rowCount, NULL, 0);
+                rowCount = 0;
+            }
+        }
+        applyRows(values, values, rows, rowCount, NULL, 0);
+    }
+    accumulator.key = position.key();
+    accumulator.computed = true;
+}
+
+void NnueNetwork::update(const NnueAccumulator& parent, const DirtyPieces& dirty,
+                         NnueAccumulator& child) const {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        const int16_t* added[3];
+        const int16_t* removed[3];
+        int addedCount = 0;
+        int removedCount = 0;
+        for (int i = 0; i < dirty.count; i++) {
+            if (dirty.from[i] != NO_SQUARE) {
+                removed[removedCount++] = featureWeights +
+                    featureIndex(perspective, dirty.piece[i], dirty.from[i]) * NNUE_HIDDEN;
+            }
+            if (dirty.to[i] != NO_SQUARE) {
+                added[addedCount++] = featureWeights +
+                    featureIndex(perspective, dirty.piece[i], dirty.to[i]) * NNUE_HIDDEN;
+            }
+        }
+        applyRows(parent.values[perspective], child.values[perspective],
+                  added, addedCount, removed, removedCount);
+    }
+    child.computed = true;
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator& accumulator, int sideToMove) const {
+    uint8_t input[2 * NNUE_HIDDEN];
+    clipActivations(accumulator.values[sideToMove], input);
+    clipActivations(accumulator.values[sideToMove ^ 1], input + NNUE_HIDDEN);
+
+    uint8_t hidden[NNUE_DENSE];
+    for (int i = 0; i < NNUE_DENSE; i++) {
+        int32_t sum = denseBias[i] + dotProduct(input, denseWeights + i * 2 * NNUE_HIDDEN, 2 * NNUE_HIDDEN);
+        int value = sum > 0 ? sum >> DENSE_SHIFT : 0;
+        hidden[i] = (uint8_t)(value > ACTIVATION_MAX ? ACTIVATION_MAX : value);
+    }
+    return (outputBias + dotProduct(hidden, outputWeights, NNUE_DENSE)) / OUTPUT_SCALE;
+}
+
+int NnueNetwork::evaluateFull(const Position& position) const {
+    NnueAccumulator accumulator;
+    refresh(position, accumulator);
+    return evaluate(accumulator, position.sideToMove());
+}
+
+NnueAccumulatorStack::NnueAccumulatorStack() : refreshes(0), updates(0) {}
+
+void NnueAccumulatorStack::reset() {
+    stack.clear();
+    refreshes = updates = 0;
+}
+
+int NnueAccumulatorStack::evaluate(const NnueNetwork& network, const Position& position) {
+    int ply = position.gamePly();
+    if ((int)stack.size() <= ply) {
+        NnueAccumulator empty;
+        empty.key = 0;
+        empty.computed = false;
+        stack.resize(ply + 1, empty);
+    }
+
+    // Newest accumulator on the current line; entries past a taken-back move fail the key check
+    int base = ply;
+    while (base >= 0 && ply - base <= MAX_CATCH_UP &&
+           !(stack[base].computed && stack[base].key == position.keyAtPly(base))) {
+        base--;
+    }
+
+    if (base < 0 || ply - base > MAX_CATCH_UP) {
+        network.refresh(position, stack[ply]);
+        refreshes++;
+    } else {
+        for (int p = base + 1; p <= ply; p++) {
+            network.update(stack[p - 1], position.dirtyPieces(p), stack[p]);
+            stack[p].key = position.keyAtPly(p);
+            updates++;
+        }
+    }
+    return network.evaluate(stack[ply], position.sideToMove());
+}
+
+const char* nnueKernelName() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSSE3__)
+    return "SSSE3";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+bool writeRandomNetwork(const char* path, uint64_t seed) {
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        return false;
+    }
+    uint64_t state = seed;
+
+    uint32_t header[8] = { 0, NETWORK_VERSION, (uint32_t)NNUE_INPUTS, (uint32_t)NNUE_HIDDEN,
+                           (uint32_t)NNUE_DENSE, 0, 0, 0 };
+    memcpy(header, NETWORK_MAGIC, 4);
+    fwrite(header, sizeof(header), 1, out);
+
+    // Pure noise leaves the search without stand-pat cutoffs, so the noise rides on a
+    // material count: own pieces raise every first layer value, the opponent's lower it,
+    // and the dense layers weigh the side to move's half against the other half
+    static const int MATERIAL_UNITS[6] = { 4, 12, 13, 20, 36, 0 };
+    std::vector<int16_t> features(NNUE_INPUTS * NNUE_HIDDEN + NNUE_HIDDEN);
+    for (int feature = 0; feature < NNUE_INPUTS; feature++) {
+        int type = (feature / 64) % 6;
+        int material = feature < 6 * 64 ? MATERIAL_UNITS[type] : -MATERIAL_UNITS[type];
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            features[feature * NNUE_HIDDEN + i] = (int16_t)(material + randomBetween(state, -4, 4));
+        }
+    }
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        features[NNUE_INPUTS * NNUE_HIDDEN + i] = (int16_t)randomBetween(state, 48, 80);
+    }
+    fwrite(&features[0], sizeof(int16_t), features.size(), out);
+
+    std::vector<int8_t> dense(DENSE_WEIGHTS_SIZE);
+    for (size_t i = 0; i < dense.size(); i++) {
+        int input = (int)(i % (2 * NNUE_HIDDEN));
+        int material = input % 8 != 0 ? 0 : input < NNUE_HIDDEN ? 1 : -1;
+        dense[i] = (int8_t)(material + randomBetween(state, -1, 1));
+    }
+    fwrite(&dense[0], 1, dense.size(), out);
+
+    int32_t denseBiases[NNUE_DENSE];
+    int8_t outputs[NNUE_DENSE];
+    for (int i = 0; i < NNUE_DENSE; i++) {
+        denseBiases[i] = 64 << DENSE_SHIFT;
+        outputs[i] = (int8_t)randomBetween(state, 10, 14);
+    }
+    // Centres an even position around zero
+    int32_t bias = -64 * 12 * NNUE_DENSE;
+    fwrite(denseBiases, sizeof(denseBiases), 1, out);
+    fwrite(outputs, sizeof(outputs), 1, out);
+    fwrite(&bias, sizeof(bias), 1, out);
+    return fclose(out) == 0;
+}
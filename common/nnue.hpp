@@ -0,0 +1,132 @@
+/*
+Description:
+Quantized NNUE-style evaluation. 768 piece-square inputs per perspective feed
+a 256-wide int16 first layer whose sums (the accumulator) are updated
+incrementally as pieces move; both perspectives are clipped to int8, passed
+through a 512x32 int8 dense layer and a 32x1 output layer. The dense layers run
+on AVX2 or SSSE3 when the build enables them, with a scalar fallback.
+
+Network file layout (little endian): a 32-byte header ("CNNU", version,
+input, hidden and dense sizes as uint32), then int16 feature weights
+[768][256], int16 feature biases [256], int8 dense weights [32][512], int32
+dense biases [32], int8 output weights [32] and one int32 output bias.
+*/
+
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "position.hpp"
+
+const int NNUE_INPUTS = 768;
+const int NNUE_HIDDEN = 256;
+const int NNUE_DENSE = 32;
+
+/**
+ * @brief First layer sums of one position, from white's and black's point of view
+ */
+struct NnueAccumulator {
+    int16_t values[2][NNUE_HIDDEN];
+    uint64_t key;   ///< Position the sums belong to
+    bool computed;
+};
+
+/**
+ * @brief Network weights, used in place from a memory-mapped file
+ */
+class NnueNetwork {
+public:
+    NnueNetwork();
+
+    NnueNetwork(const NnueNetwork&) = delete;
+    NnueNetwork& operator=(const NnueNetwork&) = delete;
+
+    /**
+     * @brief Maps a network file
+     * @param path Network file in the layout described above
+     * @return true if the file exists and its header and size match
+     */
+    bool load(const char* path);
+    bool isLoaded() const { return featureWeights != NULL; }
+
+    /**
+     * @brief Computes an accumulator from scratch
+     */
+    void refresh(const Position& position, NnueAccumulator& accumulator) const;
+
+    /**
+     * @brief Derives a child accumulator from its parent and the pieces the move changed
+     */
+    void update(const NnueAccumulator& parent, const DirtyPieces& dirty,
+                NnueAccumulator& child) const;
+
+    /**
+     * @brief Runs the dense layers on an up-to-date accumulator
+     * @return Centipawns from sideToMove's point of view
+     */
+    int evaluate(const NnueAccumulator& accumulator, int sideToMove) const;
+
+    /**
+     * @brief Evaluates a position with a full accumulator refresh
+     * @return Centipawns from the side to move's point of view
+     */
+    int evaluateFull(const Position& position) const;
+
+private:
+    MappedFile file;
+    const int16_t* featureWeights;
+    const int16_t* featureBias;
+    const int8_t* denseWeights;
+    const int32_t* denseBias;
+    const int8_t* outputWeights;
+    int32_t outputBias;
+};
+
+/**
+ * @brief Accumulators along the current line of play, one per game ply
+ * Each search thread owns one. evaluate() reuses the newest accumulator on the
+ * line that is still valid and applies the moves made since, so unmaking a
+ * move costs nothing and most evaluations touch a few weight rows only.
+ */
+class NnueAccumulatorStack {
+public:
+    NnueAccumulatorStack();
+
+    /**
+     * @brief Incrementally evaluates a position
+     * @return Centipawns from the side to move's point of view
+     */
+    int evaluate(const NnueNetwork& network, const Position& position);
+
+    /**
+     * @brief Forgets all accumulators, e.g. after loading another network
+     */
+    void reset();
+
+    uint64_t refreshCount() const { return refreshes; }
+    uint64_t updateCount() const { return updates; }
+
+private:
+    std::vector<NnueAccumulator> stack;
+    uint64_t refreshes;
+    uint64_t updates;
+};
+
+/**
+ * @brief Name of the kernel set compiled in: "AVX2", "SSSE3", "SSE2" or "scalar"
+ */
+const char* nnueKernelName();
+
+/**
+ * @brief Writes a network with small random weights
+ * It plays nonsense, but has the shape and cost of a real network for
+ * benchmarks and for checking incremental updates against full refreshes.
+ *
+ * @return true if the file was written
+ */
+bool writeRandomNetwork(const char* path, uint64_t seed);
+
+#endif
@@ -132,9 +132,10 @@ bool loadOBJ(
  * @brief Loads a 3D chess model and creates chess pieces
  * @param path Path to the model file
  * @param chessPieces Vector to store the loaded chess pieces
+ * @param loadTextures Load the piece textures as well, needs a GL context
  * @return Success status
  */
-bool loadAssImp(const char* path, std::vector<ChessPiece>& chessPieces) {
+bool loadAssImp(const char* path, std::vector<ChessPiece>& chessPieces, bool loadTextures) {
     // Initialize Assimp importer
     Assimp::Importer importer;
 
@@ -206,12 +207,16 @@ bool loadAssImp(const char* path, std::vector<ChessPiece>& chessPieces) {
             }
         }
 
-        // Load and assign texture
-        if (meshIndex < textureFiles.size()) {
-            piece.textureID = loadChessTexture(textureFiles[meshIndex]);
-        } else {
+        piece.geometryMemory.set(GPU_PIECES, piece.vertices.capacity() * sizeof(glm::vec3) +
+                                             piece.uvs.capacity() * sizeof(glm::vec2) +
+                                             piece.normals.capacity() * sizeof(glm::vec3) +
+                                             piece.indices.capacity() * sizeof(unsigned short));
+
+        // Load and assign texture, without one the piece keeps texture 0
+        if (loadTextures && meshIndex < textureFiles.size()) {
+            piece.texture.adopt(GPU_PIECES, loadChessTexture(textureFiles[meshIndex]));
+        } else if (loadTextures) {
             fprintf(stderr, "Warning: No texture file defined for mesh %d\n", meshIndex);
-            piece.textureID = 0; // Use default texture ID
         }
 
         // Add the piece to the collection
@@ -222,45 +227,35 @@ bool loadAssImp(const char* path, std::vector<ChessPiece>& chessPieces) {
 }
 
 /**
- * @brief Renders the chess piece using OpenGL.
+ * @brief Renders instances of the chess piece using OpenGL.
  * 
- * @param programID ID of the shader program.
- * @param MatrixID ID of the MVP matrix uniform.
- * @param ViewMatrixID ID of the View matrix uniform.
- * @param ModelMatrixID ID of the Model matrix uniform.
- * @param ProjectionMatrix Projection matrix.
- * @param ViewMatrix View matrix.
+ * @param instanceCount Number of instances to draw.
  * @return void
  * 
- * This function renders the chess piece by setting the MVP matrix, binding the texture, 
- * sending vertex, UV, and normal data to the GPU, and drawing the indexed elements. 
- * After rendering, it disables the vertex attributes.
+ * This function binds the texture, sends vertex, UV, and normal data to the GPU, and draws
+ * the indexed elements once per instance. Model matrices come from the per-instance
+ * attributes set up by the caller. After rendering, it disables the vertex attributes.
  */
-void ChessPiece::render(GLuint programID, GLuint MatrixID, GLuint ViewMatrixID, GLuint ModelMatrixID, 
-                const glm::mat4& ProjectionMatrix, const glm::mat4& ViewMatrix)
+void ChessPiece::render(GLsizei instanceCount)
 {
-	glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-    glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
     // Bind texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glUniform1i(glGetUniformLocation(programID, "myTextureSampler"), 0);
+    glBindTexture(GL_TEXTURE_2D, texture.id());
     // Bind vertices
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer.id());
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
     // Bind UVs
     glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer.id());
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
     // Bind normals
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer.id());
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
     // Bind index buffer and draw
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT, (void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer.id());
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (void*)0, instanceCount);
     // Disable attributes
     glDisableVertexAttribArray(0);
     glDisableVertexAttribArray(1);
@@ -272,23 +267,26 @@ void ChessPiece::render(GLuint programID, GLuint MatrixID, GLuint ViewMatrixID,
  * 
  * @return void
  * 
- * This function generates and binds vertex buffer objects (VBOs) for the vertices, UVs, normals, 
- * and element indices of the chess piece, and uploads the data to the GPU using `glBufferData`.
+ * This function creates vertex buffer objects (VBOs) for the vertices, UVs, normals, 
+ * and element indices of the chess piece and uploads the data to the GPU. Nothing reads the
+ * geometry on the CPU afterwards, so the vectors are released.
  */
 void ChessPiece::setBuffers()
 {
 	// Setup VBO and Element buffer
-    glGenBuffers(1, &vertexbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-    glGenBuffers(1, &uvbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
-    glGenBuffers(1, &normalbuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-    glGenBuffers(1, &elementbuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+    vertexbuffer.upload(GPU_PIECES, GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(),
+                        GL_STATIC_DRAW);
+    uvbuffer.upload(GPU_PIECES, GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), uvs.data(), GL_STATIC_DRAW);
+    normalbuffer.upload(GPU_PIECES, GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), normals.data(),
+                        GL_STATIC_DRAW);
+    elementbuffer.upload(GPU_PIECES, GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short),
+                         indices.data(), GL_STATIC_DRAW);
+    indexCount = (GLsizei)indices.size();
 
+    // clear() keeps the capacity, swapping with an empty vector frees it
+    std::vector<glm::vec3>().swap(vertices);
+    std::vector<glm::vec2>().swap(uvs);
+    std::vector<glm::vec3>().swap(normals);
+    std::vector<unsigned short>().swap(indices);
+    geometryMemory.reset();
 }
@@ -21,27 +21,32 @@ Key changes include:
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "gpuresource.hpp"
+
 /**
  * @brief ChessPiece class represents a 3D chess piece in a scene.
  *
  * This class encapsulates the geometry, texture, and transformation data for a chess piece,
- * providing methods for rendering and manipulation in 3D space. Each piece maintains its own
- * vertex data, texture coordinates, and OpenGL buffers.
+ * providing methods for rendering and manipulation in 3D space. Each piece owns its
+ * OpenGL buffers and texture, so it can be moved but not copied. The CPU copy of the
+ * geometry only lives until setBuffers() has uploaded it.
  */
 class ChessPiece {
 public:
-    // Geometry data
+    // Geometry data, empty once uploaded
     std::vector<glm::vec3> vertices;  ///< Vertex positions
     std::vector<glm::vec2> uvs;       ///< Texture coordinates
     std::vector<glm::vec3> normals;   ///< Normal vectors
     std::vector<unsigned short> indices; ///< Face indices
+    CpuCharge geometryMemory;         ///< Size of the vectors above, in the memory report
 
     // OpenGL handles
-    GLuint textureID;     ///< OpenGL texture identifier
-    GLuint vertexbuffer;  ///< Vertex buffer object
-    GLuint uvbuffer;      ///< UV coordinates buffer
-    GLuint normalbuffer;  ///< Normal vectors buffer
-    GLuint elementbuffer; ///< Element/Index buffer
+    GpuTexture texture;     ///< Piece texture, empty when loaded without textures
+    GpuBuffer vertexbuffer; ///< Vertex buffer object
+    GpuBuffer uvbuffer;     ///< UV coordinates buffer
+    GpuBuffer normalbuffer; ///< Normal vectors buffer
+    GpuBuffer elementbuffer; ///< Element/Index buffer
+    GLsizei indexCount;     ///< Indices in elementbuffer
 
     // Transform data
     glm::mat4 ModelMatrix; ///< Model transformation matrix
@@ -52,50 +57,23 @@ public:
     /**
      * @brief Default constructor initializing the model matrix
      */
-    ChessPiece() : ModelMatrix(glm::mat4(1.0f)) {}
-
-    /**
-     * @brief Copy constructor for deep copying of chess piece data
-     */
-    ChessPiece(const ChessPiece& other)
-        : vertices(other.vertices)
-        , uvs(other.uvs)
-        , normals(other.normals)
-        , indices(other.indices)
-        , textureID(other.textureID)
-        , ModelMatrix(other.ModelMatrix) {}
+    ChessPiece() : indexCount(0), ModelMatrix(glm::mat4(1.0f)) {}
 
-    /**
-     * @brief Assignment operator for deep copying of chess piece data
-     */
-    ChessPiece& operator=(const ChessPiece& other) {
-        if (this != &other) {
-            vertices = other.vertices;
-            uvs = other.uvs;
-            normals = other.normals;
-            indices = other.indices;
-            textureID = other.textureID;
-            ModelMatrix = other.ModelMatrix;
-        }
-        return *this;
-    }
+    ChessPiece(ChessPiece&&) = default;
+    ChessPiece& operator=(ChessPiece&&) = default;
+    ChessPiece(const ChessPiece&) = delete;
+    ChessPiece& operator=(const ChessPiece&) = delete;
 
     /**
-     * @brief Renders the chess piece using OpenGL
+     * @brief Renders instances of the chess piece using OpenGL
+     * Per-instance model matrices must already be bound to attributes 3 to 6.
      *
-     * @param programID Shader program ID
-     * @param MatrixID MVP matrix uniform location
-     * @param ViewMatrixID View matrix uniform location
-     * @param ModelMatrixID Model matrix uniform location
-     * @param ProjectionMatrix Camera projection matrix
-     * @param ViewMatrix Camera view matrix
+     * @param instanceCount Number of instances to draw
      */
-    void render(GLuint programID, GLuint MatrixID, GLuint ViewMatrixID,
-                GLuint ModelMatrixID, const glm::mat4& ProjectionMatrix,
-                const glm::mat4& ViewMatrix);
+    void render(GLsizei instanceCount);
 
     /**
-     * @brief Sets up OpenGL buffers for the chess piece
+     * @brief Uploads the geometry into OpenGL buffers, then frees the CPU copy
      */
     void setBuffers();
 
@@ -140,11 +118,14 @@ bool loadOBJ(
  *
  * @param path Path to the model file
  * @param chessPieces Vector to store the loaded chess pieces
+ * @param loadTextures Load the piece textures, which needs a GL context; tools
+ *                     that only want the geometry pass false
  * @return bool Success status of the loading operation
  */
 bool loadAssImp(
     const char* path,
-    std::vector<ChessPiece>& chessPieces
+    std::vector<ChessPiece>& chessPieces,
+    bool loadTextures = true
 );
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+/*
+Description:
+Splits a loop over an index range into equal blocks, one per hardware thread.
+Meant for one-off work at load time, such as mesh preprocessing, where a
+persistent pool is not worth keeping around.
+*/
+
+#ifndef PARALLELFOR_HPP
+#define PARALLELFOR_HPP
+
+#include <stddef.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Calls body(first, end) on disjoint blocks covering [0, count)
+ * Blocks run on new threads plus the calling one and the call returns when all
+ * are done. Ranges smaller than two blocks of minBlock items run inline.
+ *
+ * @param count Number of items
+ * @param minBlock Fewest items worth handing to a thread
+ * @param body Callable taking (size_t first, size_t end)
+ */
+template <typename Body>
+void parallelFor(size_t count, size_t minBlock, Body body) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, count / std::max((size_t)1, minBlock));
+    if (threads <= 1) {
+        body((size_t)0, count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.push_back(std::thread(body, count * i / threads, count * (i + 1) / threads));
+    }
+    body((size_t)0, count / threads);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+#endif
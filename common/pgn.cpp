@@ -0,0 +1,406 @@
+/*
+Description:
+PGN tokenizer, SAN reading and writing, and splitting files into parts that
+can be parsed in parallel.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pgn.hpp"
+#include "movegen.hpp"
+
+namespace {
+    const char* const PIECE_LETTERS_SAN = "PNBRQK";
+
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    bool endsToken(char c) {
+        return isSpace(c) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '[' || c == ']';
+    }
+
+    bool atLineStart(const char* text, const char* begin) {
+        return text == begin || text[-1] == '\n';
+    }
+
+    const char* skipLine(const char* text, const char* end) {
+        const char* newline = (const char*)memchr(text, '\n', (size_t)(end - text));
+        return newline ? newline + 1 : end;
+    }
+
+    const char* skipComment(const char* text, const char* end) {
+        const char* close = (const char*)memchr(text, '}', (size_t)(end - text));
+        return close ? close + 1 : end;
+    }
+
+    bool isResult(const TextSpan& token) {
+        return token.equals("1-0") || token.equals("0-1") || token.equals("1/2-1/2") || token.equals("*");
+    }
+
+    int pieceTypeFromLetter(char letter) {
+        const char* found = letter ? strchr(PIECE_LETTERS_SAN, letter) : NULL;
+        return found ? (int)(found - PIECE_LETTERS_SAN) : -1;
+    }
+
+    bool isCastle(const char* begin, const char* end, int length) {
+        if (end - begin < length) {
+            return false;
+        }
+        for (int i = 0; i < length; i++) {
+            char expected = i % 2 ? '-' : 'O';
+            if (begin[i] != expected && !(expected == 'O' && begin[i] == '0')) {
+                return false;
+            }
+        }
+        return end - begin == length || begin[length] != '-';
+    }
+}
+
+bool TextSpan::equals(const char* text) const {
+    size_t length = strlen(text);
+    return size() == length && memcmp(begin, text, length) == 0;
+}
+
+const TextSpan* PgnGame::tag(const char* name) const {
+    for (size_t i = 0; i < tags.size(); i++) {
+        if (tags[i].name.equals(name)) {
+            return &tags[i].value;
+        }
+    }
+    return NULL;
+}
+
+PgnReader::PgnReader() : position(NULL), end(NULL) {
+    standardStart.setFromFen(START_FEN);
+}
+
+PgnReader::PgnReader(const char* begin, const char* last) : position(NULL), end(NULL) {
+    standardStart.setFromFen(START_FEN);
+    reset(begin, last);
+}
+
+void PgnReader::reset(const char* begin, const char* last) {
+    position = begin;
+    end = last;
+    // UTF-8 byte order mark
+    if (end - position >= 3 && memcmp(position, "\xEF\xBB\xBF", 3) == 0) {
+        position += 3;
+    }
+}
+
+bool PgnReader::next(PgnGame& game, bool resolveMoves) {
+    while (position < end && isSpace(*position)) {
+        position++;
+    }
+    if (position >= end) {
+        return false;
+    }
+
+    game.tags.clear();
+    game.moves.clear();
+    game.sanCount = 0;
+    game.result = TextSpan();
+    game.error = TextSpan();
+    game.valid = true;
+    const char* gameStart = position;
+    game.text = TextSpan(gameStart, gameStart);
+
+    for (;;) {
+        while (position < end && isSpace(*position)) {
+            position++;
+        }
+        if (position < end && *position == '[') {
+            readTag(game);
+        } else if (position < end && *position == '%' && atLineStart(position, gameStart)) {
+            position = skipLine(position, end);
+        } else {
+            break;
+        }
+    }
+
+    if (resolveMoves) {
+        const TextSpan* fen = game.tag("FEN");
+        if (!fen) {
+            // Assigning keeps the board's capacity, so no allocation per game
+            board = standardStart;
+        } else if (!board.setFromFen(fen->str().c_str())) {
+            board = standardStart;
+            game.valid = false;
+            game.error = *fen;
+        }
+        game.start = board;
+    }
+    readMoveText(game, resolveMoves);
+    game.text = TextSpan(gameStart, position);
+    return true;
+}
+
+void PgnReader::readTag(PgnGame& game) {
+    const char* lineEnd = skipLine(position, end);
+    const char* c = position + 1;
+    while (c < lineEnd && isSpace(*c)) c++;
+    const char* nameBegin = c;
+    while (c < lineEnd && !isSpace(*c) && *c != '"' && *c != ']') c++;
+    PgnTag tag;
+    tag.name = TextSpan(nameBegin, c);
+
+    while (c < lineEnd && *c != '"' && *c != ']') c++;
+    if (c < lineEnd && *c == '"') {
+        const char* valueBegin = ++c;
+        while (c < lineEnd && *c != '"') {
+            c += *c == '\\' && c + 1 < lineEnd ? 2 : 1;
+        }
+        tag.value = TextSpan(valueBegin, c < lineEnd ? c : valueBegin);
+    }
+    if (!tag.name.empty()) {
+        game.tags.push_back(tag);
+    }
+    position = lineEnd;
+}
+
+void PgnReader::readMoveText(PgnGame& game, bool resolveMoves) {
+    while (position < end) {
+        char c = *position;
+        if (isSpace(c)) {
+            position++;
+        } else if (c == '{') {
+            position = skipComment(position + 1, end);
+        } else if (c == ';' || (c == '%' && atLineStart(position, game.text.begin))) {
+            position = skipLine(position, end);
+        } else if (c == '(') {
+            // Variations nest and may hold comments with parentheses in them
+            int depth = 0;
+            while (position < end) {
+                if (*position == '{') {
+                    position = skipComment(position + 1, end);
+                    continue;
+                }
+                depth += *position == '(' ? 1 : *position == ')' ? -1 : 0;
+                position++;
+                if (depth == 0) {
+                    break;
+                }
+            }
+        } else if (c == '[' && position > game.text.begin && position[-1] == '\n') {
+            // Tags of the next game: this one had no result
+            return;
+        } else if (c == '$') {
+            position++;
+            while (position < end && *position >= '0' && *position <= '9') position++;
+        } else if (endsToken(c)) {
+            position++;
+        } else {
+            const char* tokenBegin = position;
+            while (position < end && !endsToken(*position)) position++;
+            TextSpan token(tokenBegin, position);
+            if (isResult(token)) {
+                game.result = token;
+                return;
+            }
+            // Move numbers, possibly glued to the move as in "12.e4" or "12...Nf6";
+            // digits without a dot may be castling written with zeros
+            const char* san = tokenBegin;
+            const char* digits = tokenBegin;
+            while (digits < position && *digits >= '0' && *digits <= '9') digits++;
+            if (digits == position || *digits == '.') {
+                san = digits;
+            }
+            while (san < position && *san == '.') san++;
+            if (san == position) {
+                continue;
+            }
+            game.sanCount++;
+            if (!resolveMoves || !game.valid) {
+                continue;
+            }
+            Move move = parseSan(board, san, position);
+            if (move == NO_MOVE) {
+                game.valid = false;
+                game.error = TextSpan(san, position);
+                continue;
+            }
+            game.moves.push_back(move);
+            board.makeMove(move);
+        }
+    }
+}
+
+bool PgnFile::open(const char* path) {
+    if (!file.open(path, MappedFile::ACCESS_SEQUENTIAL)) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+TextSpan PgnFile::text() const {
+    const char* begin = (const char*)file.data();
+    return TextSpan(begin, begin + file.size());
+}
+
+std::vector<TextSpan> PgnFile::split(int parts) const {
+    static const char GAME_START[] = "\n[Event ";
+    TextSpan all = text();
+    std::vector<TextSpan> result;
+    const char* partBegin = all.begin;
+    for (int i = 1; i < parts && partBegin < all.end; i++) {
+        const char* target = all.begin + all.size() / parts * i;
+        if (target <= partBegin) {
+            continue;
+        }
+        // First game start at or after the even split point
+        const char* boundary = all.end;
+        for (const char* c = target - 1; c + sizeof(GAME_START) - 1 <= all.end; c++) {
+            c = (const char*)memchr(c, '\n', (size_t)(all.end - c));
+            if (!c || c + sizeof(GAME_START) - 1 > all.end) {
+                break;
+            }
+            if (memcmp(c, GAME_START, sizeof(GAME_START) - 1) == 0) {
+                boundary = c + 1;
+                break;
+            }
+        }
+        if (boundary >= all.end) {
+            break;
+        }
+        result.push_back(TextSpan(partBegin, boundary));
+        partBegin = boundary;
+    }
+    if (partBegin < all.end) {
+        result.push_back(TextSpan(partBegin, all.end));
+    }
+    return result;
+}
+
+Move parseSan(const Position& position, const char* begin, const char* end) {
+    // Annotations and check marks are not part of the move
+    while (end > begin && strchr("+#!?", end[-1])) {
+        end--;
+    }
+    MoveList list;
+    generateLegalMoves(position, list);
+
+    if (isCastle(begin, end, 5) || isCastle(begin, end, 3)) {
+        int flag = end - begin == 5 ? QUEEN_CASTLE : KING_CASTLE;
+        for (int i = 0; i < list.size(); i++) {
+            if (moveFlags(list[i]) == flag) {
+                return list[i];
+            }
+        }
+        return NO_MOVE;
+    }
+
+    int type = PAWN;
+    if (begin < end && pieceTypeFromLetter(*begin) > PAWN) {
+        type = pieceTypeFromLetter(*begin++);
+    }
+    int promotion = -1;
+    if (end - begin >= 3 && pieceTypeFromLetter(end[-1]) > PAWN && pieceTypeFromLetter(end[-1]) < KING) {
+        promotion = pieceTypeFromLetter(end[-1]);
+        end -= end[-2] == '=' ? 2 : 1;
+    }
+    if (end - begin < 2 || end[-2] < 'a' || end[-2] > 'h' || end[-1] < '1' || end[-1] > '8') {
+        return NO_MOVE;
+    }
+    int to = makeSquare(end[-2] - 'a', end[-1] - '1');
+
+    // Whatever is left between piece and destination disambiguates
+    int fromFile = -1;
+    int fromRank = -1;
+    for (const char* c = begin; c < end - 2; c++) {
+        if (*c >= 'a' && *c <= 'h') {
+            fromFile = *c - 'a';
+        } else if (*c >= '1' && *c <= '8') {
+            fromRank = *c - '1';
+        } else if (*c != 'x' && *c != '-' && *c != ':') {
+            return NO_MOVE;
+        }
+    }
+
+    Move found = NO_MOVE;
+    for (int i = 0; i < list.size(); i++) {
+        Move move = list[i];
+        int from = moveFrom(move);
+        if (moveTo(move) != to || pieceType(position.pieceOn(from)) != type ||
+            (fromFile >= 0 && squareFile(from) != fromFile) || (fromRank >= 0 && squareRank(from) != fromRank) ||
+            (isPromotion(move) ? promotionType(move) != promotion : promotion >= 0) ||
+            moveFlags(move) == KING_CASTLE || moveFlags(move) == QUEEN_CASTLE) {
+            continue;
+        }
+        if (found != NO_MOVE) {
+            return NO_MOVE;
+        }
+        found = move;
+    }
+    return found;
+}
+
+std::string moveToSan(Position& position, Move move) {
+    std::string san;
+    int from = moveFrom(move);
+    int to = moveTo(move);
+    int type = pieceType(position.pieceOn(from));
+
+    if (moveFlags(move) == KING_CASTLE) {
+        san = "O-O";
+    } else if (moveFlags(move) == QUEEN_CASTLE) {
+        san = "O-O-O";
+    } else {
+        if (type != PAWN) {
+            san += PIECE_LETTERS_SAN[type];
+            // Name the file, the rank or both, whichever tells the candidates apart
+            MoveList list;
+            generateLegalMoves(position, list);
+            bool ambiguous = false;
+            bool sameFile = false;
+            bool sameRank = false;
+            for (int i = 0; i < list.size(); i++) {
+                int other = moveFrom(list[i]);
+                if (other == from || moveTo(list[i]) != to || pieceType(position.pieceOn(other)) != type) {
+                    continue;
+                }
+                ambiguous = true;
+                sameFile = sameFile || squareFile(other) == squareFile(from);
+                sameRank = sameRank || squareRank(other) == squareRank(from);
+            }
+            if (ambiguous && (!sameFile || sameRank)) {
+                san += (char)('a' + squareFile(from));
+            }
+            if (ambiguous && sameFile) {
+                san += (char)('1' + squareRank(from));
+            }
+        } else if (isCapture(move)) {
+            san += (char)('a' + squareFile(from));
+        }
+        if (isCapture(move)) {
+            san += 'x';
+        }
+        san += (char)('a' + squareFile(to));
+        san += (char)('1' + squareRank(to));
+        if (isPromotion(move)) {
+            san += '=';
+            san += PIECE_LETTERS_SAN[promotionType(move)];
+        }
+    }
+
+    position.makeMove(move);
+    if (position.inCheck()) {
+        MoveList replies;
+        generateLegalMoves(position, replies);
+        san += replies.size() == 0 ? '#' : '+';
+    }
+    position.unmakeMove();
+    return san;
+}
+
+void appendMovetext(std::string& text, size_t& lineStart, const std::string& word) {
+    if (text.size() > lineStart && text.size() - lineStart + 1 + word.size() > 80) {
+        text += '\n';
+        lineStart = text.size();
+    } else if (text.size() > lineStart) {
+        text += ' ';
+    }
+    text += word;
+}
@@ -0,0 +1,145 @@
+/*
+Description:
+PGN reading. Files are memory-mapped and games are parsed in place: tags and
+the raw game text are spans into the mapping, and the only per-game storage is
+the caller's PgnGame, whose vectors keep their capacity from game to game.
+SAN moves are resolved against the legal move generator as they are read.
+
+Large files are parsed in parallel by splitting them at game boundaries
+(lines starting with "[Event "), one PgnReader per part.
+*/
+
+#ifndef PGN_HPP
+#define PGN_HPP
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "mappedfile.hpp"
+#include "position.hpp"
+
+/**
+ * @brief Unowned range of characters, usually inside a mapped file
+ */
+struct TextSpan {
+    const char* begin;
+    const char* end;
+
+    TextSpan() : begin(NULL), end(NULL) {}
+    TextSpan(const char* first, const char* last) : begin(first), end(last) {}
+    size_t size() const { return (size_t)(end - begin); }
+    bool empty() const { return begin == end; }
+    bool equals(const char* text) const;
+    std::string str() const { return std::string(begin, end); }
+};
+
+/**
+ * @brief Tag pair such as [White "Carlsen"]; escapes in the value are left as they are
+ */
+struct PgnTag {
+    TextSpan name;
+    TextSpan value;
+};
+
+/**
+ * @brief One parsed game, meant to be reused for the next one
+ */
+struct PgnGame {
+    std::vector<PgnTag> tags;
+    std::vector<Move> moves;   ///< Resolved moves, up to the first one that failed
+    int sanCount;              ///< SAN tokens in the main line
+    TextSpan result;           ///< "1-0", "0-1", "1/2-1/2" or "*", empty if missing
+    TextSpan text;             ///< The whole game, tags included
+    Position start;            ///< Position before the first move
+    bool valid;                ///< Every move resolved and the FEN tag, if any, was valid
+    TextSpan error;            ///< First SAN token that did not resolve
+
+    PgnGame() : sanCount(0), valid(true) {}
+
+    /**
+     * @brief Finds a tag by name
+     * @return The tag's value, NULL if the game has no such tag
+     */
+    const TextSpan* tag(const char* name) const;
+};
+
+/**
+ * @brief Parses consecutive games from a range of PGN text
+ * Comments, variations, NAGs and move numbers are skipped; only the main line is kept.
+ */
+class PgnReader {
+public:
+    PgnReader();
+    PgnReader(const char* begin, const char* end);
+
+    void reset(const char* begin, const char* end);
+
+    /**
+     * @brief Parses the next game
+     * @param game Overwritten; reusing one object avoids allocations
+     * @param resolveMoves false to only split tags and count SAN tokens
+     * @return false when no game is left
+     */
+    bool next(PgnGame& game, bool resolveMoves = true);
+
+    /// Where the next game starts
+    const char* cursor() const { return position; }
+
+private:
+    void readTag(PgnGame& game);
+    void readMoveText(PgnGame& game, bool resolveMoves);
+
+    const char* position;
+    const char* end;
+    Position board;
+    Position standardStart;
+};
+
+/**
+ * @brief Memory-mapped PGN file
+ */
+class PgnFile {
+public:
+    /**
+     * @brief Maps a file for sequential reading
+     * @return true on success
+     */
+    bool open(const char* path);
+    void close() { file.close(); }
+
+    TextSpan text() const;
+
+    /**
+     * @brief Splits the text into about equal parts that begin at game starts
+     * @param parts Wanted number of parts; fewer are returned for small files
+     */
+    std::vector<TextSpan> split(int parts) const;
+
+private:
+    MappedFile file;
+};
+
+/**
+ * @brief Resolves a SAN move such as "Nbd7", "exd6", "e8=Q+" or "O-O"
+ * @return The legal move it names, NO_MOVE if none or several match
+ */
+Move parseSan(const Position& position, const char* begin, const char* end);
+
+/**
+ * @brief Writes a legal move in SAN, with check and mate marks
+ * @param position Position before the move, restored on return
+ */
+std::string moveToSan(Position& position, Move move);
+
+/**
+ * @brief Appends a movetext token, wrapping lines at 80 columns as the PGN export format asks
+ * A token is a move number, a SAN move, a NAG, a comment or a whole variation.
+ *
+ * @param text Movetext written so far
+ * @param lineStart Offset of the current line in text, 0 for new movetext
+ * @param word Token to append
+ */
+void appendMovetext(std::string& text, size_t& lineStart, const std::string& word);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+Description:
+ID render target and single-pixel readback ring for GPU picking.
+*/
+
+#include <stdio.h>
+
+#include "picking.hpp"
+
+PickResult decodePickId(uint32_t id) {
+    PickResult result;
+    if (id == PICK_NONE) {
+        return result;
+    }
+    result.piece = (id & PICK_PIECE) != 0;
+    result.square = (id & PICK_SQUARE) != 0;
+    result.board = (int)((id & PICK_INDEX_MASK) >> 6);
+    result.square64 = (int)(id & 63);
+    return result;
+}
+
+PickBuffer::PickBuffer()
+    : framebuffer(0), depthBuffer(0), targetWidth(0), targetHeight(0), windowWidth(0),
+      windowHeight(0), resolutionDivisor(1), pixelX(0), pixelY(0), head(0), inFlight(0) {}
+
+PickBuffer::~PickBuffer() {
+    release();
+}
+
+bool PickBuffer::init(int width, int height, int divisor, int slots) {
+    release();
+    if (width <= 0 || height <= 0 || divisor <= 0 || slots <= 0) {
+        return false;
+    }
+    windowWidth = width;
+    windowHeight = height;
+    resolutionDivisor = divisor;
+    targetWidth = (width + divisor - 1) / divisor;
+    targetHeight = (height + divisor - 1) / divisor;
+
+    glBindTexture(GL_TEXTURE_2D, idTexture.create(GPU_PICKING));
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, targetWidth, targetHeight, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    idTexture.updateSize();
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, targetWidth, targetHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, idTexture.id(), 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Error: Incomplete picking framebuffer (0x%x)\n", status);
+        release();
+        return false;
+    }
+
+    buffers.resize(slots);
+    fences.assign(slots, (GLsync)0);
+    requests.assign(slots, 0);
+    for (int i = 0; i < slots; i++) {
+        buffers[i].upload(GPU_PICKING, GL_PIXEL_PACK_BUFFER, sizeof(uint32_t), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void PickBuffer::release() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+    idTexture.reset();
+    buffers.clear();
+    fences.clear();
+    requests.clear();
+    framebuffer = depthBuffer = 0;
+    targetWidth = targetHeight = windowWidth = windowHeight = 0;
+    head = 0;
+    inFlight = 0;
+}
+
+bool PickBuffer::begin(int width, int height, int x, int y) {
+    if (width != windowWidth || height != windowHeight) {
+        if (!init(width, height, resolutionDivisor, buffers.empty() ? 4 : (int)buffers.size())) {
+            return false;
+        }
+    }
+    if (inFlight == (int)buffers.size()) {
+        return false;
+    }
+    // GL rows count from the bottom
+    pixelX = x / resolutionDivisor;
+    pixelY = (windowHeight - 1 - y) / resolutionDivisor;
+    pixelX = pixelX < 0 ? 0 : pixelX >= targetWidth ? targetWidth - 1 : pixelX;
+    pixelY = pixelY < 0 ? 0 : pixelY >= targetHeight ? targetHeight - 1 : pixelY;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, targetWidth, targetHeight);
+    // Only the picked pixel is rasterised and shaded
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(pixelX, pixelY, 1, 1);
+    const GLuint none[4] = { PICK_NONE, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, none);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+void PickBuffer::end(long long request) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[head].id());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(pixelX, pixelY, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    requests[head] = request;
+    head = (head + 1) % (int)buffers.size();
+    inFlight++;
+
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+bool PickBuffer::poll(PickResult& result) {
+    if (inFlight == 0) {
+        return false;
+    }
+    int slots = (int)buffers.size();
+    int tail = (head - inFlight + slots) % slots;
+    GLenum status = glClientWaitSync(fences[tail], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(fences[tail]);
+    fences[tail] = 0;
+    if (status == GL_WAIT_FAILED) {
+        // The slot would never finish and would block picking for good, so it
+        // is retired as a pick that hit nothing
+        fprintf(stderr, "Error: Pick fence wait failed (0x%x)\n", glGetError());
+        result = PickResult();
+        result.request = requests[tail];
+        inFlight--;
+        return true;
+    }
+
+    uint32_t id = PICK_NONE;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[tail].id());
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(uint32_t), GL_MAP_READ_BIT);
+    if (mapped) {
+        id = *(const uint32_t*)mapped;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    result = decodePickId(id);
+    result.request = requests[tail];
+    inFlight--;
+    return true;
+}
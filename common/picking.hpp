@@ -0,0 +1,118 @@
+/*
+Description:
+GPU picking. On request, the scene is drawn a second time into an unsigned
+integer render target, writing for each pixel the ID of the piece or board
+square it shows instead of a colour. The pass is scissored to the one pixel
+under the cursor and can run at a fraction of the window resolution; that
+pixel is copied into a pixel pack buffer behind a fence and mapped a frame
+or more later, once the GPU has finished, so picking never stalls the
+pipeline the way a direct glReadPixels would.
+*/
+
+#ifndef PICKING_HPP
+#define PICKING_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpuresource.hpp"
+
+/// Pick IDs: 0 for nothing, else a kind bit plus board * 64 + square
+const uint32_t PICK_NONE = 0;
+const uint32_t PICK_PIECE = 1u << 30;
+const uint32_t PICK_SQUARE = 1u << 31;
+const uint32_t PICK_INDEX_MASK = (1u << 30) - 1;
+
+/**
+ * @brief Decoded pick ID
+ */
+struct PickResult {
+    bool piece;         ///< A piece was hit; square is the one it stands on
+    bool square;        ///< An empty part of a square was hit
+    int board;
+    int square64;       ///< 0..63, a1..h8
+    long long request;  ///< Value passed to end()
+
+    PickResult() : piece(false), square(false), board(-1), square64(-1), request(0) {}
+    bool hit() const { return piece || square; }
+};
+
+/**
+ * @brief Decodes the ID written by the picking shaders
+ */
+PickResult decodePickId(uint32_t id);
+
+/**
+ * @brief Integer ID render target and the asynchronous readback of one pixel
+ */
+class PickBuffer {
+public:
+    PickBuffer();
+    ~PickBuffer();
+
+    PickBuffer(const PickBuffer&) = delete;
+    PickBuffer& operator=(const PickBuffer&) = delete;
+
+    /**
+     * @brief Creates the target for a window size; requires a current GL context
+     *
+     * @param width Window framebuffer width in pixels
+     * @param height Window framebuffer height in pixels
+     * @param divisor Target resolution divisor, 1 for full resolution
+     * @param slots Number of readbacks that can be in flight at once
+     * @return true if the framebuffer is complete
+     */
+    bool init(int width, int height, int divisor = 2, int slots = 4);
+
+    /**
+     * @brief Deletes the target, buffers and fences, discarding pending picks
+     */
+    void release();
+
+    /**
+     * @brief Binds the target for an ID pass around one window pixel
+     * The target is recreated if the window size changed. Draw the IDs, then
+     * call end().
+     *
+     * @param x Pixel column, from the left of the window framebuffer
+     * @param y Pixel row, from the top of the window framebuffer
+     * @return false if every readback slot is in flight; nothing is bound then
+     */
+    bool begin(int windowWidth, int windowHeight, int x, int y);
+
+    /**
+     * @brief Starts reading the picked pixel and restores the default framebuffer
+     * @param request Value returned with the result
+     */
+    void end(long long request);
+
+    /**
+     * @brief Takes the oldest pick if the GPU has finished it; never waits
+     * A pick whose fence wait failed is returned as a miss, freeing its slot.
+     * @return true if result was written
+     */
+    bool poll(PickResult& result);
+
+    bool pending() const { return inFlight > 0; }
+
+private:
+    GLuint framebuffer;
+    GpuTexture idTexture;  ///< Charged to GPU_PICKING, as are the buffers
+    GLuint depthBuffer;
+    int targetWidth;
+    int targetHeight;
+    int windowWidth;
+    int windowHeight;
+    int resolutionDivisor;
+    int pixelX;      ///< Target pixel of the pass in progress
+    int pixelY;
+
+    std::vector<GpuBuffer> buffers; ///< One 4-byte pixel pack buffer per slot
+    std::vector<GLsync> fences;
+    std::vector<long long> requests;
+    int head;        ///< Next slot to fill
+    int inFlight;    ///< Picks pending, oldest at (head - inFlight)
+};
+
+#endif
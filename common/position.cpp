@@ -0,0 +1,553 @@
+/*
+Description:
+Position setup, FEN output and make/unmake.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "position.hpp"
+
+const char* const START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+namespace {
+    const char PIECE_LETTERS[] = "PNBRQKpnbrqk";
+
+    /// Castling rights kept when a piece moves from or to a square
+    struct CastlingMasks {
+        int mask[64];
+        CastlingMasks() {
+            for (int square = 0; square < 64; square++) {
+                mask[square] = WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO;
+            }
+            mask[0]  &= ~WHITE_OOO;
+            mask[7]  &= ~WHITE_OO;
+            mask[4]  &= ~(WHITE_OO | WHITE_OOO);
+            mask[56] &= ~BLACK_OOO;
+            mask[63] &= ~BLACK_OO;
+            mask[60] &= ~(BLACK_OO | BLACK_OOO);
+        }
+    };
+    const CastlingMasks CASTLING_MASKS;
+
+    /// Random keys for every piece on every square, castling state, en passant file and side
+    struct ZobristKeys {
+        uint64_t pieceSquare[12][64];
+        uint64_t castling[16];
+        uint64_t epFile[8];
+        uint64_t side;
+
+        ZobristKeys() {
+            // splitmix64 with a fixed seed, so keys are the same on every run
+            uint64_t state = 0x2545F4914F6CDD1Dull;
+            for (int piece = 0; piece < 12; piece++) {
+                for (int square = 0; square < 64; square++) {
+                    pieceSquare[piece][square] = next(state);
+                }
+            }
+            for (int i = 0; i < 16; i++) {
+                castling[i] = next(state);
+            }
+            for (int i = 0; i < 8; i++) {
+                epFile[i] = next(state);
+            }
+            side = next(state);
+        }
+
+        static uint64_t next(uint64_t& state) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+    };
+    const ZobristKeys ZOBRIST;
+
+    int pieceFromLetter(char letter) {
+        const char* found = strchr(PIECE_LETTERS, letter);
+        return found && letter ? (int)(found - PIECE_LETTERS) : NO_PIECE;
+    }
+}
+
+Position::Position() {
+    clear();
+    setFromFen(START_FEN);
+}
+
+void Position::clear() {
+    memset(pieceBB, 0, sizeof(pieceBB));
+    memset(colorBB, 0, sizeof(colorBB));
+    memset(board, NO_PIECE, sizeof(board));
+    side = WHITE;
+    fullmove = 1;
+    states.clear();
+}
+
+bool Position::setFromFen(const char* fen) {
+    initBitboards();
+    Position parsed(*this);
+    parsed.clear();
+
+    StateInfo root;
+    root.move = NO_MOVE;
+    root.moved = NO_PIECE;
+    root.captured = NO_PIECE;
+    root.castling = 0;
+    root.epSquare = NO_SQUARE;
+    root.halfmoveClock = 0;
+    root.pliesFromNull = 0;
+    root.checkers = 0;
+    root.key = 0;
+
+    // Piece placement, rank 8 first
+    const char* c = fen;
+    int rank = 7;
+    int file = 0;
+    for (; *c && *c != ' '; c++) {
+        if (*c == '/') {
+            if (file != 8 || rank == 0) {
+                return false;
+            }
+            rank--;
+            file = 0;
+        } else if (*c >= '1' && *c <= '8') {
+            file += *c - '0';
+            if (file > 8) {
+                return false;
+            }
+        } else {
+            int piece = pieceFromLetter(*c);
+            if (piece == NO_PIECE || file >= 8) {
+                return false;
+            }
+            parsed.putPiece(makeSquare(file, rank), piece);
+            file++;
+        }
+    }
+    if (rank != 0 || file != 8 ||
+        popCount(parsed.pieces(WHITE, KING)) != 1 || popCount(parsed.pieces(BLACK, KING)) != 1) {
+        return false;
+    }
+
+    // Optional fields
+    while (*c == ' ') c++;
+    if (*c) {
+        if (*c != 'w' && *c != 'b') {
+            return false;
+        }
+        parsed.side = *c == 'w' ? WHITE : BLACK;
+        c++;
+    }
+    while (*c == ' ') c++;
+    for (; *c && *c != ' '; c++) {
+        switch (*c) {
+        case 'K': root.castling |= WHITE_OO; break;
+        case 'Q': root.castling |= WHITE_OOO; break;
+        case 'k': root.castling |= BLACK_OO; break;
+        case 'q': root.castling |= BLACK_OOO; break;
+        case '-': break;
+        default: return false;
+        }
+    }
+    while (*c == ' ') c++;
+    if (*c && *c != '-') {
+        if (c[0] < 'a' || c[0] > 'h' || c[1] < '1' || c[1] > '8') {
+            return false;
+        }
+        root.epSquare = makeSquare(c[0] - 'a', c[1] - '1');
+        c += 2;
+    } else if (*c) {
+        c++;
+    }
+    while (*c == ' ') c++;
+    if (*c) {
+        root.halfmoveClock = atoi(c);
+        while (*c && *c != ' ') c++;
+        while (*c == ' ') c++;
+        if (*c) {
+            parsed.fullmove = atoi(c) > 0 ? atoi(c) : 1;
+        }
+    }
+
+    // Drop rights that the placement contradicts, so make/unmake never sees them
+    static const int castleKing[4] = { 4, 4, 60, 60 };
+    static const int castleRook[4] = { 7, 0, 63, 56 };
+    for (int i = 0; i < 4; i++) {
+        int color = i / 2;
+        if (parsed.board[castleKing[i]] != makePiece(color, KING) ||
+            parsed.board[castleRook[i]] != makePiece(color, ROOK)) {
+            root.castling &= ~(1 << i);
+        }
+    }
+
+    // Likewise an en-passant square no double step could have left: the pawn
+    // that made it must stand in front of it, with the two squares it crossed empty
+    if (root.epSquare != NO_SQUARE) {
+        int ep = root.epSquare;
+        int them = parsed.side ^ 1;
+        int origin = parsed.side == WHITE ? ep + 8 : ep - 8;
+        if (squareRank(ep) != (parsed.side == WHITE ? 5 : 2) || parsed.board[ep] != NO_PIECE ||
+            parsed.board[origin] != NO_PIECE || parsed.board[ep ^ 8] != makePiece(them, PAWN)) {
+            root.epSquare = NO_SQUARE;
+        }
+    }
+
+    parsed.states.push_back(root);
+    int us = parsed.side;
+    // The side that just moved cannot have left its king in check
+    if (parsed.isAttacked(parsed.kingSquare(us ^ 1), us)) {
+        return false;
+    }
+    parsed.states.back().checkers =
+        parsed.attackersTo(parsed.kingSquare(us), parsed.occupied()) & parsed.colorPieces(us ^ 1);
+    parsed.states.back().key = parsed.computeKey();
+
+    *this = parsed;
+    return true;
+}
+
+bool Position::setFromPieces(const int* pieceList, const int* squares, int count, int sideToMove) {
+    initBitboards();
+    clear();
+    for (int i = 0; i < count; i++) {
+        if (board[squares[i]] != NO_PIECE) {
+            return false;
+        }
+        putPiece(squares[i], pieceList[i]);
+    }
+    side = sideToMove;
+    if (popCount(pieces(WHITE, KING)) != 1 || popCount(pieces(BLACK, KING)) != 1 ||
+        isAttacked(kingSquare(side ^ 1), side)) {
+        return false;
+    }
+
+    StateInfo root;
+    root.move = NO_MOVE;
+    root.moved = NO_PIECE;
+    root.captured = NO_PIECE;
+    root.castling = 0;
+    root.epSquare = NO_SQUARE;
+    root.halfmoveClock = 0;
+    root.pliesFromNull = 0;
+    root.checkers = attackersTo(kingSquare(side), occupied()) & colorPieces(side ^ 1);
+    root.key = 0;
+    states.push_back(root);
+    states.back().key = computeKey();
+    return true;
+}
+
+bool readFenFile(const char* path, std::vector<std::string>& fens) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", path);
+        return false;
+    }
+    std::string line;
+    char chunk[256];
+    while (fgets(chunk, sizeof(chunk), file)) {
+        // Lines longer than the chunk arrive in pieces
+        line += chunk;
+        size_t end = line.find_first_of("\r\n");
+        if (end == std::string::npos && !feof(file)) {
+            continue;
+        }
+        line.resize(end == std::string::npos ? line.size() : end);
+        if (!line.empty() && line[0] != '#') {
+            fens.push_back(line);
+        }
+        line.clear();
+    }
+    fclose(file);
+    return true;
+}
+
+std::string Position::fen() const {
+    std::string result;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            int piece = board[makeSquare(file, rank)];
+            if (piece == NO_PIECE) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                result += char('0' + empty);
+                empty = 0;
+            }
+            result += PIECE_LETTERS[piece];
+        }
+        if (empty) {
+            result += char('0' + empty);
+        }
+        if (rank > 0) {
+            result += '/';
+        }
+    }
+
+    result += side == WHITE ? " w " : " b ";
+    int castling = castlingRights();
+    if (castling & WHITE_OO) result += 'K';
+    if (castling & WHITE_OOO) result += 'Q';
+    if (castling & BLACK_OO) result += 'k';
+    if (castling & BLACK_OOO) result += 'q';
+    if (!castling) result += '-';
+
+    int ep = epSquare();
+    if (ep == NO_SQUARE) {
+        result += " -";
+    } else {
+        result += ' ';
+        result += char('a' + squareFile(ep));
+        result += char('1' + squareRank(ep));
+    }
+
+    char counters[32];
+    snprintf(counters, sizeof(counters), " %d %d", halfmoveClock(), fullmove);
+    return result + counters;
+}
+
+void Position::putPiece(int square, int piece) {
+    Bitboard bb = squareBB(square);
+    pieceBB[piece] |= bb;
+    colorBB[pieceColor(piece)] |= bb;
+    board[square] = (uint8_t)piece;
+}
+
+void Position::removePiece(int square) {
+    int piece = board[square];
+    Bitboard bb = squareBB(square);
+    pieceBB[piece] ^= bb;
+    colorBB[pieceColor(piece)] ^= bb;
+    board[square] = NO_PIECE;
+}
+
+void Position::movePiece(int from, int to) {
+    int piece = board[from];
+    Bitboard fromTo = squareBB(from) | squareBB(to);
+    pieceBB[piece] ^= fromTo;
+    colorBB[pieceColor(piece)] ^= fromTo;
+    board[from] = NO_PIECE;
+    board[to] = (uint8_t)piece;
+}
+
+void Position::castlingRookSquares(int kingTo, int& rookFrom, int& rookTo) const {
+    // The king lands on the g or c file; the rook jumps over it
+    bool kingSide = squareFile(kingTo) == 6;
+    rookFrom = kingSide ? kingTo + 1 : kingTo - 2;
+    rookTo = kingSide ? kingTo - 1 : kingTo + 1;
+}
+
+bool Position::epCapturable(int epSquare) const {
+    // A pawn of the side to move stands where a pawn of the other side would attack from
+    return epSquare != NO_SQUARE && (pawnAttacks(side ^ 1, epSquare) & pieces(side, PAWN)) != 0;
+}
+
+uint64_t Position::computeKey() const {
+    uint64_t key = 0;
+    for (Bitboard b = occupied(); b; ) {
+        int square = popLsb(b);
+        key ^= ZOBRIST.pieceSquare[board[square]][square];
+    }
+    key ^= ZOBRIST.castling[castlingRights()];
+    if (epCapturable(epSquare())) {
+        key ^= ZOBRIST.epFile[squareFile(epSquare())];
+    }
+    if (side == BLACK) {
+        key ^= ZOBRIST.side;
+    }
+    return key;
+}
+
+bool Position::isRepetition() const {
+    // Only positions with the same side to move, back to the last irreversible
+    // move; a null move breaks the chain as well
+    int last = (int)states.size() - 1;
+    int limit = states[last].halfmoveClock < states[last].pliesFromNull ?
+                states[last].halfmoveClock : states[last].pliesFromNull;
+    limit = limit < last ? limit : last;
+    for (int back = 4; back <= limit; back += 2) {
+        if (states[last - back].key == states[last].key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Bitboard Position::attackersTo(int square, Bitboard occupancy) const {
+    Bitboard bishops = pieceBB[makePiece(WHITE, BISHOP)] | pieceBB[makePiece(BLACK, BISHOP)] |
+                       pieceBB[makePiece(WHITE, QUEEN)] | pieceBB[makePiece(BLACK, QUEEN)];
+    Bitboard rooks = pieceBB[makePiece(WHITE, ROOK)] | pieceBB[makePiece(BLACK, ROOK)] |
+                     pieceBB[makePiece(WHITE, QUEEN)] | pieceBB[makePiece(BLACK, QUEEN)];
+    return (pawnAttacks(BLACK, square) & pieceBB[makePiece(WHITE, PAWN)]) |
+           (pawnAttacks(WHITE, square) & pieceBB[makePiece(BLACK, PAWN)]) |
+           (knightAttacks(square) & (pieceBB[makePiece(WHITE, KNIGHT)] | pieceBB[makePiece(BLACK, KNIGHT)])) |
+           (kingAttacks(square) & (pieceBB[makePiece(WHITE, KING)] | pieceBB[makePiece(BLACK, KING)])) |
+           (bishopAttacks(square, occupancy) & bishops) |
+           (rookAttacks(square, occupancy) & rooks);
+}
+
+bool Position::isAttacked(int square, int byColor) const {
+    return (attackersTo(square, occupied()) & colorBB[byColor]) != 0;
+}
+
+DirtyPieces Position::dirtyPieces(int ply) const {
+    const StateInfo& state = states[ply];
+    DirtyPieces dirty;
+    dirty.count = 0;
+    if (state.move == NO_MOVE) {
+        return dirty;
+    }
+    int from = moveFrom(state.move);
+    int to = moveTo(state.move);
+    int flags = moveFlags(state.move);
+
+    dirty.piece[0] = state.moved;
+    dirty.from[0] = from;
+    dirty.to[0] = flags & PROMOTION ? NO_SQUARE : to;
+    dirty.count = 1;
+    if (state.captured != NO_PIECE) {
+        dirty.piece[dirty.count] = state.captured;
+        dirty.from[dirty.count] = flags == EN_PASSANT ? to ^ 8 : to;
+        dirty.to[dirty.count] = NO_SQUARE;
+        dirty.count++;
+    }
+    if (flags & PROMOTION) {
+        dirty.piece[dirty.count] = makePiece(pieceColor(state.moved), promotionType(state.move));
+        dirty.from[dirty.count] = NO_SQUARE;
+        dirty.to[dirty.count] = to;
+        dirty.count++;
+    } else if (flags == KING_CASTLE || flags == QUEEN_CASTLE) {
+        int rookFrom, rookTo;
+        castlingRookSquares(to, rookFrom, rookTo);
+        dirty.piece[dirty.count] = makePiece(pieceColor(state.moved), ROOK);
+        dirty.from[dirty.count] = rookFrom;
+        dirty.to[dirty.count] = rookTo;
+        dirty.count++;
+    }
+    return dirty;
+}
+
+void Position::makeMove(Move move) {
+    StateInfo next = states.back();
+    next.move = move;
+    next.captured = NO_PIECE;
+    next.epSquare = NO_SQUARE;
+    next.halfmoveClock++;
+    next.pliesFromNull++;
+
+    int us = side;
+    int from = moveFrom(move);
+    int to = moveTo(move);
+    int flags = moveFlags(move);
+    int piece = board[from];
+    next.moved = piece;
+
+    // Take out the old castling and en passant contributions, add them back at the end
+    uint64_t key = next.key ^ ZOBRIST.side ^ ZOBRIST.castling[next.castling];
+    if (epCapturable(states.back().epSquare)) {
+        key ^= ZOBRIST.epFile[squareFile(states.back().epSquare)];
+    }
+
+    if (flags == EN_PASSANT) {
+        int captureSquare = to ^ 8;
+        next.captured = board[captureSquare];
+        key ^= ZOBRIST.pieceSquare[next.captured][captureSquare];
+        removePiece(captureSquare);
+    } else if (flags & CAPTURE) {
+        next.captured = board[to];
+        key ^= ZOBRIST.pieceSquare[next.captured][to];
+        removePiece(to);
+    }
+    movePiece(from, to);
+    key ^= ZOBRIST.pieceSquare[piece][from] ^ ZOBRIST.pieceSquare[piece][to];
+
+    if (flags & PROMOTION) {
+        int promoted = makePiece(us, promotionType(move));
+        removePiece(to);
+        putPiece(to, promoted);
+        key ^= ZOBRIST.pieceSquare[piece][to] ^ ZOBRIST.pieceSquare[promoted][to];
+    } else if (flags == KING_CASTLE || flags == QUEEN_CASTLE) {
+        int rookFrom, rookTo;
+        castlingRookSquares(to, rookFrom, rookTo);
+        int rook = board[rookFrom];
+        movePiece(rookFrom, rookTo);
+        key ^= ZOBRIST.pieceSquare[rook][rookFrom] ^ ZOBRIST.pieceSquare[rook][rookTo];
+    } else if (flags == DOUBLE_PAWN_PUSH) {
+        next.epSquare = (from + to) / 2;
+    }
+
+    if (pieceType(piece) == PAWN || next.captured != NO_PIECE) {
+        next.halfmoveClock = 0;
+    }
+    next.castling &= CASTLING_MASKS.mask[from] & CASTLING_MASKS.mask[to];
+
+    side = us ^ 1;
+    if (side == WHITE) {
+        fullmove++;
+    }
+    key ^= ZOBRIST.castling[next.castling];
+    if (epCapturable(next.epSquare)) {
+        key ^= ZOBRIST.epFile[squareFile(next.epSquare)];
+    }
+    next.key = key;
+    next.checkers = attackersTo(kingSquare(side), occupied()) & colorBB[us];
+    states.push_back(next);
+}
+
+void Position::makeNullMove() {
+    StateInfo next = states.back();
+    next.move = NO_MOVE;
+    next.moved = NO_PIECE;
+    next.captured = NO_PIECE;
+    next.halfmoveClock++;
+    next.pliesFromNull = 0;
+
+    next.key ^= ZOBRIST.side;
+    if (epCapturable(next.epSquare)) {
+        next.key ^= ZOBRIST.epFile[squareFile(next.epSquare)];
+    }
+    next.epSquare = NO_SQUARE;
+
+    side ^= 1;
+    next.checkers = 0;
+    states.push_back(next);
+}
+
+void Position::unmakeNullMove() {
+    states.pop_back();
+    side ^= 1;
+}
+
+void Position::unmakeMove() {
+    StateInfo state = states.back();
+    states.pop_back();
+
+    Move move = state.move;
+    int from = moveFrom(move);
+    int to = moveTo(move);
+    int flags = moveFlags(move);
+
+    if (side == WHITE) {
+        fullmove--;
+    }
+    side ^= 1;
+    int us = side;
+
+    if (flags & PROMOTION) {
+        removePiece(to);
+        putPiece(to, makePiece(us, PAWN));
+    } else if (flags == KING_CASTLE || flags == QUEEN_CASTLE) {
+        int rookFrom, rookTo;
+        castlingRookSquares(to, rookFrom, rookTo);
+        movePiece(rookTo, rookFrom);
+    }
+    movePiece(to, from);
+
+    if (flags == EN_PASSANT) {
+        putPiece(to ^ 8, state.captured);
+    } else if (state.captured != NO_PIECE) {
+        putPiece(to, state.captured);
+    }
+}
@@ -0,0 +1,251 @@
+/*
+Description:
+Chess position stored as one bitboard per piece plus a square-indexed mailbox.
+Moves are applied and taken back in place; the irreversible part of the state
+(castling rights, en passant square, halfmove clock, captured piece, hash key)
+is kept on a stack so unmakeMove() restores it exactly. The Zobrist key is
+updated incrementally by makeMove().
+*/
+
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+
+/// FEN of the standard starting position
+extern const char* const START_FEN;
+
+/**
+ * Move packed into 16 bits: from square (bits 0-5), to square (bits 6-11)
+ * and flags (bits 12-15). Bit 2 of the flags marks captures, bit 3 promotions,
+ * the low two bits of a promotion select the piece (knight, bishop, rook, queen).
+ */
+typedef uint16_t Move;
+
+const Move NO_MOVE = 0;
+
+enum MoveFlag {
+    QUIET_MOVE        = 0,
+    DOUBLE_PAWN_PUSH  = 1,
+    KING_CASTLE       = 2,
+    QUEEN_CASTLE      = 3,
+    CAPTURE           = 4,
+    EN_PASSANT        = 5,
+    PROMOTION         = 8,
+    PROMOTION_CAPTURE = 12
+};
+
+inline Move makeMove(int from, int to, int flags) {
+    return (Move)(from | (to << 6) | (flags << 12));
+}
+inline int moveFrom(Move move) { return move & 63; }
+inline int moveTo(Move move) { return (move >> 6) & 63; }
+inline int moveFlags(Move move) { return move >> 12; }
+inline bool isCapture(Move move) { return (moveFlags(move) & CAPTURE) != 0; }
+inline bool isPromotion(Move move) { return (moveFlags(move) & PROMOTION) != 0; }
+inline int promotionType(Move move) { return KNIGHT + (moveFlags(move) & 3); }
+
+enum CastlingRight {
+    WHITE_OO  = 1,
+    WHITE_OOO = 2,
+    BLACK_OO  = 4,
+    BLACK_OOO = 8
+};
+
+/**
+ * @brief Pieces put on, taken off or moved by one move
+ * from is NO_SQUARE for a piece put on the board, to is NO_SQUARE for one
+ * taken off. A move changes at most three pieces (a capturing promotion).
+ */
+struct DirtyPieces {
+    int count;
+    int piece[3];
+    int from[3];
+    int to[3];
+};
+
+/**
+ * @brief Board state with make/unmake support
+ */
+class Position {
+public:
+    /**
+     * @brief Creates the starting position
+     */
+    Position();
+
+    /**
+     * @brief Sets up a position from FEN
+     * Fields after the piece placement are optional and default to
+     * "w - - 0 1". Each side needs exactly one king, and the side that just
+     * moved must not be in check. Castling rights and an en-passant square
+     * that the placement contradicts are dropped.
+     *
+     * @param fen FEN string
+     * @return true on success; the position is unchanged on failure
+     */
+    bool setFromFen(const char* fen);
+
+    /**
+     * @brief Sets up a position from a piece list, without castling or en passant
+     * Meant for enumerating positions quickly, e.g. when generating tablebases.
+     *
+     * @param pieceList Pieces to place
+     * @param squares Square of each piece
+     * @param count Number of pieces
+     * @param sideToMove Side to move
+     * @return true if the squares are distinct, each side has one king and the
+     *         side not to move is not in check; on failure the position is
+     *         left empty and must be set up again before use
+     */
+    bool setFromPieces(const int* pieceList, const int* squares, int count, int sideToMove);
+
+    /**
+     * @brief Writes the position as FEN
+     * @return Six-field FEN string
+     */
+    std::string fen() const;
+
+    /**
+     * @brief Applies a legal move
+     * @param move Move from generateLegalMoves() for this position
+     */
+    void makeMove(Move move);
+
+    /**
+     * @brief Takes back the last move made with makeMove()
+     */
+    void unmakeMove();
+
+    /**
+     * @brief Passes the turn without moving, for null move pruning
+     * Must not be called while in check.
+     */
+    void makeNullMove();
+
+    /**
+     * @brief Takes back makeNullMove()
+     */
+    void unmakeNullMove();
+
+    /**
+     * @brief Whether a side has any piece besides pawns and king
+     */
+    bool hasNonPawnMaterial(int color) const {
+        return (colorBB[color] & ~pieces(color, PAWN) & ~pieces(color, KING)) != 0;
+    }
+
+    /// Number of moves made since the position was set up
+    int gamePly() const { return (int)states.size() - 1; }
+
+    Bitboard pieces(int piece) const { return pieceBB[piece]; }
+    Bitboard pieces(int color, int type) const { return pieceBB[makePiece(color, type)]; }
+    Bitboard colorPieces(int color) const { return colorBB[color]; }
+    Bitboard occupied() const { return colorBB[WHITE] | colorBB[BLACK]; }
+
+    /// Piece on a square, NO_PIECE if empty
+    int pieceOn(int square) const { return board[square]; }
+    int kingSquare(int color) const { return lsb(pieceBB[makePiece(color, KING)]); }
+
+    int sideToMove() const { return side; }
+    int castlingRights() const { return states.back().castling; }
+    /// Square a pawn may capture onto en passant, NO_SQUARE if none
+    int epSquare() const { return states.back().epSquare; }
+    int halfmoveClock() const { return states.back().halfmoveClock; }
+    /// Piece the last move took, NO_PIECE after quiet and null moves
+    int capturedPiece() const { return states.back().captured; }
+    int fullmoveNumber() const { return fullmove; }
+
+    /**
+     * @brief Zobrist hash of the position
+     * The en passant file only contributes when a pawn can actually capture,
+     * so transpositions that differ only in a dead en passant square match.
+     */
+    uint64_t key() const { return states.back().key; }
+
+    /**
+     * @brief Key of the position after the given number of moves from the root
+     * @param ply 0..gamePly()
+     */
+    uint64_t keyAtPly(int ply) const { return states[ply].key; }
+
+    /**
+     * @brief Pieces changed by the move that led from ply - 1 to ply
+     * Lets incremental evaluators catch up over several moves at once.
+     *
+     * @param ply 1..gamePly()
+     */
+    DirtyPieces dirtyPieces(int ply) const;
+
+    /**
+     * @brief Recomputes the Zobrist key from scratch, for verification
+     */
+    uint64_t computeKey() const;
+
+    /**
+     * @brief Whether the position occurred before since the last capture or pawn move
+     */
+    bool isRepetition() const;
+
+    /// Pieces of the side to move's opponent giving check
+    Bitboard checkers() const { return states.back().checkers; }
+    bool inCheck() const { return states.back().checkers != 0; }
+
+    /**
+     * @brief Pieces of both colours attacking a square
+     * @param square Target square
+     * @param occupancy Occupancy used for slider attacks
+     */
+    Bitboard attackersTo(int square, Bitboard occupancy) const;
+
+    /**
+     * @brief Whether a square is attacked by the given side
+     */
+    bool isAttacked(int square, int byColor) const;
+
+private:
+    /**
+     * @brief State that cannot be recomputed when a move is taken back
+     */
+    struct StateInfo {
+        Move move;
+        int moved;      ///< Piece that made the move, NO_PIECE for null moves
+        int captured;
+        int castling;
+        int epSquare;
+        int halfmoveClock;
+        int pliesFromNull;
+        Bitboard checkers;
+        uint64_t key;
+    };
+
+    void clear();
+    void putPiece(int square, int piece);
+    void removePiece(int square);
+    void movePiece(int from, int to);
+    void castlingRookSquares(int kingTo, int& rookFrom, int& rookTo) const;
+    bool epCapturable(int epSquare) const;
+
+    Bitboard pieceBB[12];
+    Bitboard colorBB[2];
+    uint8_t board[64];
+    int side;
+    int fullmove;
+    std::vector<StateInfo> states; ///< One entry per move made, plus the root
+};
+
+/**
+ * @brief Reads one FEN per line, skipping blank lines and # comments
+ * The lines are not validated here; setFromFen() does that when they are used.
+ *
+ * @param path Text file to read
+ * @param fens Output, appended to
+ * @return false if the file could not be opened
+ */
+bool readFenFile(const char* path, std::vector<std::string>& fens);
+
+#endif
@@ -0,0 +1,318 @@
+/*
+Description:
+Position index building (parallel scan, external merge sort) and lookups.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+
+#include "positionindex.hpp"
+
+namespace {
+    const size_t PAGE_SIZE = 4096;
+    const uint32_t FORMAT_VERSION = 1;
+
+    struct Entry {
+        uint64_t key;
+        uint32_t game;
+        uint32_t ply;
+
+        bool operator<(const Entry& other) const {
+            if (key != other.key) return key < other.key;
+            if (game != other.game) return game < other.game;
+            return ply < other.ply;
+        }
+        bool operator>(const Entry& other) const { return other < *this; }
+    };
+    static_assert(sizeof(Entry) == 16, "index entries are 16 bytes");
+
+    const size_t ENTRIES_PER_PAGE = PAGE_SIZE / sizeof(Entry);
+
+    /// Smallest sort buffer per thread and read buffer per run during the merge
+    const size_t MIN_BUFFER_ENTRIES = 4096;
+
+    /**
+     * @brief Run files written by the scan threads
+     */
+    struct RunList {
+        std::mutex mutex;
+        std::vector<std::string> names;
+        bool failed;
+
+        RunList() : failed(false) {}
+    };
+
+    bool writeRun(std::vector<Entry>& buffer, const std::string& basePath, RunList* runs) {
+        std::sort(buffer.begin(), buffer.end());
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(runs->mutex);
+            name = basePath + ".run" + std::to_string(runs->names.size());
+            runs->names.push_back(name);
+        }
+        FILE* out = fopen(name.c_str(), "wb");
+        bool ok = out && fwrite(&buffer[0], sizeof(Entry), buffer.size(), out) == buffer.size();
+        ok = out && fclose(out) == 0 && ok;
+        if (!ok) {
+            fprintf(stderr, "Error: Could not write sort run %s\n", name.c_str());
+        }
+        buffer.clear();
+        return ok;
+    }
+
+    /**
+     * @brief Replays games [first, last) and spills their positions as sorted runs
+     */
+    void scanGames(const GameStore* store, uint64_t first, uint64_t last, size_t bufferEntries,
+                   std::string basePath, RunList* runs, uint64_t* corrupt) {
+        std::vector<Entry> buffer;
+        buffer.reserve(bufferEntries);
+        Position start;
+        std::vector<Move> moves;
+        bool ok = true;
+        for (uint64_t game = first; game < last && ok; game++) {
+            if (!store->moves(game, start, moves)) {
+                (*corrupt)++;
+                continue;
+            }
+            Position position = start;
+            for (size_t ply = 0; ply <= moves.size(); ply++) {
+                if (ply > 0) {
+                    position.makeMove(moves[ply - 1]);
+                }
+                Entry entry = { position.key(), (uint32_t)game, (uint32_t)ply };
+                buffer.push_back(entry);
+                if (buffer.size() == bufferEntries) {
+                    ok = writeRun(buffer, basePath, runs);
+                }
+            }
+        }
+        if (ok && !buffer.empty()) {
+            ok = writeRun(buffer, basePath, runs);
+        }
+        if (!ok) {
+            std::lock_guard<std::mutex> lock(runs->mutex);
+            runs->failed = true;
+        }
+    }
+
+    /**
+     * @brief Buffered sequential reader of one run
+     */
+    struct RunReader {
+        FILE* in;
+        std::vector<Entry> buffer;
+        size_t position;
+        size_t count;
+
+        bool refill() {
+            count = fread(&buffer[0], sizeof(Entry), buffer.size(), in);
+            position = 0;
+            return count > 0;
+        }
+    };
+
+    struct MergeItem {
+        Entry entry;
+        size_t run;
+
+        bool operator>(const MergeItem& other) const { return entry > other.entry; }
+    };
+
+    void writeU32(uint8_t* out, uint32_t value) { memcpy(out, &value, 4); }
+    void writeU64(uint8_t* out, uint64_t value) { memcpy(out, &value, 8); }
+    uint32_t readU32(const uint8_t* data) { uint32_t value; memcpy(&value, data, 4); return value; }
+    uint64_t readU64(const uint8_t* data) { uint64_t value; memcpy(&value, data, 8); return value; }
+
+    /**
+     * @brief Merges sorted runs into the index file, collecting the page fences
+     */
+    bool mergeRuns(const std::vector<std::string>& names, const char* path, size_t memoryBytes,
+                   uint64_t games, uint64_t& entries) {
+        FILE* out = fopen(path, "wb");
+        if (!out) {
+            fprintf(stderr, "Error: Could not create position index %s\n", path);
+            return false;
+        }
+        std::vector<uint8_t> header(PAGE_SIZE, 0);
+        bool ok = fwrite(&header[0], PAGE_SIZE, 1, out) == 1;
+
+        size_t readEntries = std::max(MIN_BUFFER_ENTRIES, memoryBytes / sizeof(Entry) / std::max<size_t>(names.size(), 1));
+        std::vector<RunReader> readers(names.size());
+        std::priority_queue<MergeItem, std::vector<MergeItem>, std::greater<MergeItem> > heap;
+        for (size_t i = 0; i < names.size(); i++) {
+            readers[i].in = fopen(names[i].c_str(), "rb");
+            readers[i].buffer.resize(readEntries);
+            if (!readers[i].in) {
+                fprintf(stderr, "Error: Could not read sort run %s\n", names[i].c_str());
+                ok = false;
+            } else if (readers[i].refill()) {
+                MergeItem item = { readers[i].buffer[0], i };
+                heap.push(item);
+                readers[i].position = 1;
+            }
+        }
+
+        std::vector<Entry> output;
+        output.reserve(ENTRIES_PER_PAGE * 64);
+        std::vector<uint64_t> fences;
+        entries = 0;
+        while (ok && !heap.empty()) {
+            MergeItem item = heap.top();
+            heap.pop();
+            if (entries % ENTRIES_PER_PAGE == 0) {
+                fences.push_back(item.entry.key);
+            }
+            output.push_back(item.entry);
+            entries++;
+            if (output.size() == output.capacity()) {
+                ok = fwrite(&output[0], sizeof(Entry), output.size(), out) == output.size();
+                output.clear();
+            }
+            RunReader& reader = readers[item.run];
+            if (reader.position < reader.count || reader.refill()) {
+                item.entry = reader.buffer[reader.position++];
+                heap.push(item);
+            }
+        }
+        if (ok && !output.empty()) {
+            ok = fwrite(&output[0], sizeof(Entry), output.size(), out) == output.size();
+        }
+        if (ok && !fences.empty()) {
+            ok = fwrite(&fences[0], sizeof(uint64_t), fences.size(), out) == fences.size();
+        }
+        for (size_t i = 0; i < readers.size(); i++) {
+            if (readers[i].in) {
+                fclose(readers[i].in);
+            }
+        }
+
+        memcpy(&header[0], "CPIX", 4);
+        writeU32(&header[4], FORMAT_VERSION);
+        writeU64(&header[8], entries);
+        writeU64(&header[16], games);
+        writeU32(&header[24], (uint32_t)PAGE_SIZE);
+        writeU64(&header[32], PAGE_SIZE + entries * sizeof(Entry));
+        ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header[0], PAGE_SIZE, 1, out) == 1;
+        ok = (fclose(out) == 0) && ok;
+        if (!ok) {
+            fprintf(stderr, "Error: Could not write position index %s\n", path);
+        }
+        return ok;
+    }
+}
+
+bool buildPositionIndex(const GameStore& store, const char* path, int threads, size_t memoryBytes,
+                        PositionIndexStats* stats) {
+    if (store.gameCount() > 0xFFFFFFFFull) {
+        fprintf(stderr, "Error: Too many games for a position index\n");
+        return false;
+    }
+    threads = std::max(1, threads);
+    if ((uint64_t)threads > store.gameCount()) {
+        threads = (int)std::max<uint64_t>(store.gameCount(), 1);
+    }
+    size_t bufferEntries = std::max(MIN_BUFFER_ENTRIES, memoryBytes / sizeof(Entry) / threads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    RunList runs;
+    std::vector<uint64_t> corrupt(threads, 0);
+    std::vector<std::thread> workers;
+    uint64_t games = store.gameCount();
+    for (int i = 1; i < threads; i++) {
+        workers.push_back(std::thread(scanGames, &store, games * i / threads, games * (i + 1) / threads,
+                                      bufferEntries, std::string(path), &runs, &corrupt[i]));
+    }
+    scanGames(&store, 0, games / threads, bufferEntries, path, &runs, &corrupt[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::chrono::steady_clock::time_point scanned = std::chrono::steady_clock::now();
+
+    // The scan buffers are gone, so the merge may use the whole budget for reading
+    uint64_t entries = 0;
+    bool ok = !runs.failed && mergeRuns(runs.names, path, memoryBytes, games, entries);
+    for (size_t i = 0; i < runs.names.size(); i++) {
+        remove(runs.names[i].c_str());
+    }
+    if (stats) {
+        stats->entries = entries;
+        stats->runs = runs.names.size();
+        stats->corruptGames = 0;
+        for (int i = 0; i < threads; i++) {
+            stats->corruptGames += corrupt[i];
+        }
+        stats->scanSeconds = std::chrono::duration<double>(scanned - start).count();
+        stats->mergeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - scanned).count();
+    }
+    return ok;
+}
+
+PositionIndex::PositionIndex() : entryData(NULL), entries(0), games(0) {}
+
+bool PositionIndex::open(const char* path) {
+    entries = 0;
+    fences.clear();
+    if (!file.open(path, MappedFile::ACCESS_RANDOM)) {
+        return false;
+    }
+    const uint8_t* data = file.data();
+    uint64_t size = file.size();
+    if (size < PAGE_SIZE || memcmp(data, "CPIX", 4) != 0 || readU32(data + 4) != FORMAT_VERSION ||
+        readU32(data + 24) != PAGE_SIZE) {
+        fprintf(stderr, "Error: %s is not a position index\n", path);
+        file.close();
+        return false;
+    }
+    uint64_t count = readU64(data + 8);
+    uint64_t fenceOffset = readU64(data + 32);
+    uint64_t pages = (count + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
+    if (count > size / sizeof(Entry) || fenceOffset != PAGE_SIZE + count * sizeof(Entry) ||
+        fenceOffset + pages * sizeof(uint64_t) > size) {
+        fprintf(stderr, "Error: Position index %s is truncated or corrupt\n", path);
+        file.close();
+        return false;
+    }
+    entries = count;
+    games = readU64(data + 16);
+    entryData = data + PAGE_SIZE;
+    fences.resize((size_t)pages);
+    if (pages > 0) {
+        memcpy(&fences[0], data + fenceOffset, (size_t)pages * sizeof(uint64_t));
+    }
+    return true;
+}
+
+size_t PositionIndex::find(uint64_t key, std::vector<PositionHit>& out, size_t limit) const {
+    out.clear();
+    if (fences.empty()) {
+        return 0;
+    }
+    // The first page whose fence is not below the key may be preceded by a
+    // page ending with the same key, so the search starts one page earlier
+    size_t page = (size_t)(std::lower_bound(fences.begin(), fences.end(), key) - fences.begin());
+    if (page > 0) {
+        page--;
+    }
+    const Entry* all = (const Entry*)entryData;
+    const Entry* first = all + page * ENTRIES_PER_PAGE;
+    const Entry* pageEnd = all + std::min<uint64_t>((uint64_t)(page + 1) * ENTRIES_PER_PAGE, entries);
+    const Entry* end = all + entries;
+    Entry probe = { key, 0, 0 };
+    const Entry* entry = std::lower_bound(first, pageEnd, probe);
+
+    size_t count = 0;
+    for (; entry < end && entry->key == key; entry++, count++) {
+        if (out.size() < limit) {
+            PositionHit hit = { entry->game, entry->ply };
+            out.push_back(hit);
+        }
+    }
+    return count;
+}
@@ -0,0 +1,95 @@
+/*
+Description:
+Position index of a game store: every (Zobrist key, game, ply) of every game,
+sorted by key in a memory-mapped file, answering "which games reached this
+position" with one or two page reads.
+
+File layout (little endian):
+  page 0      header: "CPIX", version, entry count, game count, page size and
+              the offset of the fence section
+  entries     16 bytes each (key, game, ply), sorted, from offset 4096 on so
+              that every page holds exactly 256 of them
+  fences      the key of the first entry of every page, loaded into memory on
+              open; a binary search over them picks the page to read
+
+Building walks the store on several threads, each sorting its tuples in a
+buffer of bounded size and spilling it to a temporary run file when full,
+then merges the runs into the index.
+*/
+
+#ifndef POSITIONINDEX_HPP
+#define POSITIONINDEX_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "gamestore.hpp"
+#include "mappedfile.hpp"
+
+/**
+ * @brief One occurrence of a position
+ */
+struct PositionHit {
+    uint32_t game;
+    uint32_t ply;   ///< Plies played before the position was reached
+};
+
+/**
+ * @brief Read-only view of a position index file
+ */
+class PositionIndex {
+public:
+    PositionIndex();
+
+    PositionIndex(const PositionIndex&) = delete;
+    PositionIndex& operator=(const PositionIndex&) = delete;
+
+    /**
+     * @brief Maps an index file and loads its fences
+     */
+    bool open(const char* path);
+    bool isOpen() const { return file.isOpen(); }
+
+    uint64_t entryCount() const { return entries; }
+    uint64_t gameCount() const { return games; }
+    size_t pageCount() const { return fences.size(); }
+
+    /**
+     * @brief Lists the games and plies where a position occurred, ordered by game
+     * @param limit Hits stored in out at most; the rest are only counted
+     * @return Number of occurrences
+     */
+    size_t find(uint64_t key, std::vector<PositionHit>& out, size_t limit = (size_t)-1) const;
+
+private:
+    MappedFile file;
+    const uint8_t* entryData;
+    uint64_t entries;
+    uint64_t games;
+    std::vector<uint64_t> fences;
+};
+
+/**
+ * @brief Figures reported by buildPositionIndex()
+ */
+struct PositionIndexStats {
+    uint64_t entries;
+    uint64_t runs;           ///< Sorted runs spilled to disk before the merge
+    uint64_t corruptGames;   ///< Games the store could not decode, left out
+    double scanSeconds;      ///< Replaying games, sorting and writing runs
+    double mergeSeconds;
+};
+
+/**
+ * @brief Writes the position index of a game store
+ * Run files are written next to the index, as path.runN, and removed afterwards.
+ *
+ * @param threads Games are split into this many ranges, one thread each
+ * @param memoryBytes Bound for the sort buffers of all threads together
+ * @return true on success
+ */
+bool buildPositionIndex(const GameStore& store, const char* path, int threads, size_t memoryBytes,
+                        PositionIndexStats* stats = NULL);
+
+#endif
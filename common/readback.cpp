@@ -0,0 +1,102 @@
+/*
+Description:
+Pixel pack buffer ring used for screenshots, batch rendering and video capture.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "readback.hpp"
+
+PboRing::PboRing() : head(0), pending(0), frameWidth(0), frameHeight(0) {}
+
+PboRing::~PboRing() {
+    release();
+}
+
+bool PboRing::init(int width, int height, int slots) {
+    release();
+    if (width <= 0 || height <= 0 || slots <= 0) {
+        return false;
+    }
+    frameWidth = width;
+    frameHeight = height;
+
+    buffers.resize(slots);
+    fences.assign(slots, (GLsync)0);
+    tags.assign(slots, 0);
+    for (int i = 0; i < slots; i++) {
+        buffers[i].upload(GPU_READBACK, GL_PIXEL_PACK_BUFFER, frameBytes(), NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void PboRing::release() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    buffers.clear();
+    fences.clear();
+    tags.clear();
+    head = 0;
+    pending = 0;
+}
+
+bool PboRing::enqueue(long long tag) {
+    if (buffers.empty() || full()) {
+        return false;
+    }
+
+    // RGBA rows are always 4-byte aligned, so the default pack alignment is fine
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[head].id());
+    glReadPixels(0, 0, frameWidth, frameHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    tags[head] = tag;
+    head = (head + 1) % (int)buffers.size();
+    pending++;
+    return true;
+}
+
+PboRing::Status PboRing::dequeue(std::vector<unsigned char>& pixels, long long& tag, bool wait) {
+    if (pending == 0) {
+        return PENDING;
+    }
+    int slots = (int)buffers.size();
+    int tail = (head - pending + slots) % slots;
+
+    GLuint64 timeout = wait ? 1000000000ull : 0; // one second when blocking
+    GLenum status = glClientWaitSync(fences[tail], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return PENDING;
+    }
+    glDeleteSync(fences[tail]);
+    fences[tail] = 0;
+    tag = tags[tail];
+    if (status == GL_WAIT_FAILED) {
+        // Retrying the same fence would fail forever, so the frame is given up
+        fprintf(stderr, "Error: Readback fence wait failed (0x%x)\n", glGetError());
+        pending--;
+        return FAILED;
+    }
+
+    pixels.resize(frameBytes());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[tail].id());
+    void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+    if (mapped) {
+        memcpy(&pixels[0], mapped, frameBytes());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pending--;
+    if (!mapped) {
+        fprintf(stderr, "Error: Could not map a readback buffer\n");
+        return FAILED;
+    }
+    return READY;
+}
@@ -0,0 +1,88 @@
+/*
+Description:
+Asynchronous framebuffer readback through a ring of pixel pack buffers. Each
+glReadPixels goes into its own PBO and is followed by a fence, so the CPU only
+maps a buffer once the GPU has finished writing it and never stalls the
+pipeline waiting for the frame it just submitted.
+*/
+
+#ifndef READBACK_HPP
+#define READBACK_HPP
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "gpuresource.hpp"
+
+/**
+ * @brief Ring of pixel pack buffers with one fence per in-flight readback
+ */
+class PboRing {
+public:
+    /// Outcome of dequeue()
+    enum Status {
+        PENDING,    ///< The oldest readback is still running, nothing was taken
+        READY,      ///< Pixels were written
+        FAILED      ///< The oldest readback was lost and its slot freed
+    };
+
+    PboRing();
+    ~PboRing();
+
+    PboRing(const PboRing&) = delete;
+    PboRing& operator=(const PboRing&) = delete;
+
+    /**
+     * @brief Allocates the pixel pack buffers
+     * Requires a current GL context.
+     *
+     * @param width Width of the region to read in pixels
+     * @param height Height of the region to read in pixels
+     * @param slots Number of readbacks that can be in flight at once
+     * @return true if the buffers were created
+     */
+    bool init(int width, int height, int slots = 3);
+
+    /**
+     * @brief Deletes buffers and fences, discarding pending readbacks
+     */
+    void release();
+
+    /**
+     * @brief Starts reading the bound read framebuffer into the next free slot
+     *
+     * @param tag Caller value returned with the pixels, e.g. a frame number
+     * @return false if every slot is still in flight
+     */
+    bool enqueue(long long tag);
+
+    /**
+     * @brief Copies out the oldest readback if the GPU has finished it
+     * A failed fence wait or mapping frees the slot, so callers looping until
+     * the ring is empty always get there.
+     *
+     * @param pixels Output RGBA pixels, bottom row first, resized as needed
+     * @param tag Output tag passed to enqueue(), also set on FAILED
+     * @param wait Block, up to a second, until the oldest readback completes instead of polling
+     * @return READY if pixels were written
+     */
+    Status dequeue(std::vector<unsigned char>& pixels, long long& tag, bool wait);
+
+    bool empty() const { return pending == 0; }
+    int inFlight() const { return pending; }
+    bool full() const { return pending == (int)buffers.size(); }
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+    size_t frameBytes() const { return (size_t)frameWidth * frameHeight * 4; }
+
+private:
+    std::vector<GpuBuffer> buffers; ///< Charged to GPU_READBACK
+    std::vector<GLsync> fences;
+    std::vector<long long> tags;
+    int head;    ///< Next slot to fill
+    int pending; ///< Readbacks in flight, oldest at (head - pending)
+    int frameWidth;
+    int frameHeight;
+};
+
+#endif
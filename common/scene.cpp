@@ -0,0 +1,574 @@
+/*
+Description:
+Scene loading and drawing moved out of main.cpp so that both the interactive
+render loop and other front ends can share it.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "lighting.hpp"
+#include "lightmap.hpp"
+#include "picking.hpp"
+#include "scene.hpp"
+#include "shader.hpp"
+#include "tangentspace.hpp"
+#include "texture.hpp"
+#include "vboindexer.hpp"
+
+ChessScene::ChessScene()
+    : programID(0), ViewMatrixID(0), ProjectionMatrixID(0), TextureID(0),
+      LightID(0), lightEnableID(0), LightMatrixID(0), ShadowMapID(0), shadowEnableID(0),
+      NormalMapID(0), normalMapEnableID(0), LightmapID(0), lightmapModeID(0), lightmapOriginID(0),
+      pointLightCountID(0), pointLightsID(0), clusterRangesID(0), clusterIndicesID(0),
+      viewportSizeID(0), clusterStartID(0), clusterScaleID(0),
+      pickProgramID(0), pickViewMatrixID(0),
+      pickProjectionMatrixID(0), boardIndexCount(0), normalMapping(true),
+      lightmapOrigin(0.0f), lightmapLight(0.0f), bakedLighting(true), uploadedLayout(0),
+      uploadedIdLayout(0), shadowsEnabled(true), shadowCaching(true), shadowValid(false),
+      shadowLight(0.0f), shadowStaticVersion(0), shadowLayoutVersion(0),
+      sampledLayer(ShadowMap::RESTING), lastShadowLayers(0), uploadedLightFrame(0), lastDrawCalls(0) {
+}
+
+bool ChessScene::load() {
+    glBindVertexArray(vertexArray.create(GPU_SCENE));
+
+    // Create and compile shaders
+    programID = LoadShaders("shaders/StandardShading.vertexshader", "shaders/StandardShading.fragmentshader");
+    if (programID == 0) {
+        return false;
+    }
+
+    ViewMatrixID = glGetUniformLocation(programID, "V");
+    ProjectionMatrixID = glGetUniformLocation(programID, "P");
+    TextureID = glGetUniformLocation(programID, "myTextureSampler");
+    LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
+    lightEnableID = glGetUniformLocation(programID, "enableLight");
+    LightMatrixID = glGetUniformLocation(programID, "LightVP");
+    ShadowMapID = glGetUniformLocation(programID, "shadowMap");
+    shadowEnableID = glGetUniformLocation(programID, "enableShadows");
+    NormalMapID = glGetUniformLocation(programID, "normalMap");
+    normalMapEnableID = glGetUniformLocation(programID, "enableNormalMap");
+    LightmapID = glGetUniformLocation(programID, "lightmap");
+    lightmapModeID = glGetUniformLocation(programID, "lightmapMode");
+    lightmapOriginID = glGetUniformLocation(programID, "lightmapOrigin");
+    pointLightCountID = glGetUniformLocation(programID, "pointLightCount");
+    pointLightsID = glGetUniformLocation(programID, "pointLights");
+    clusterRangesID = glGetUniformLocation(programID, "clusterRanges");
+    clusterIndicesID = glGetUniformLocation(programID, "clusterIndices");
+    viewportSizeID = glGetUniformLocation(programID, "viewportSize");
+    clusterStartID = glGetUniformLocation(programID, "clusterStart");
+    clusterScaleID = glGetUniformLocation(programID, "clusterScale");
+
+    // Buffer textures for the clustered point lights, filled per packet
+    const GLenum lightFormats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+    for (int i = 0; i < 3; i++) {
+        lightBuffers[i].upload(GPU_LIGHTING, GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTextures[i].create(GPU_LIGHTING));
+        glTexBuffer(GL_TEXTURE_BUFFER, lightFormats[i], lightBuffers[i].id());
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // Shadows are optional as well
+    if (!shadowMap.init()) {
+        fprintf(stderr, "Failed to create the shadow map, shadows are disabled.\n");
+    }
+
+    // Picking is optional, the scene still draws without it
+    pickProgramID = LoadShaders("shaders/Pick.vertexshader", "shaders/Pick.fragmentshader");
+    if (pickProgramID == 0) {
+        fprintf(stderr, "Failed to load the picking shader, picking is disabled.\n");
+    }
+    pickViewMatrixID = glGetUniformLocation(pickProgramID, "V");
+    pickProjectionMatrixID = glGetUniformLocation(pickProgramID, "P");
+
+    // Load textures
+    boardTexture.adopt(GPU_BOARD, loadBMP_custom("Stone_Chess_Board/12951_Stone_Chess_Board_diff.bmp"));
+    boardNormalMap.adopt(GPU_BOARD, loadBumpAsNormalMap("Stone_Chess_Board/12951_Stone_Chess_Board_bump.bmp", 4.0f));
+    if (boardNormalMap.id() == 0) {
+        fprintf(stderr, "Failed to load the board's bump map, normal mapping is disabled.\n");
+    }
+
+    // Load board model
+    std::vector<glm::vec3> boardVertices;
+    std::vector<glm::vec2> boardUvs;
+    std::vector<glm::vec3> boardNormals;
+    if (!loadOBJ("Stone_Chess_Board/12951_Stone_Chess_Board_v1_L3.obj",
+                 boardVertices, boardUvs, boardNormals)) {
+        fprintf(stderr, "Failed to load chess board.\n");
+        return false;
+    }
+
+    // Tangent basis for the normal map, merged along with the vertices
+    std::vector<glm::vec3> boardTangents;
+    std::vector<glm::vec3> boardBitangents;
+    computeTangentBasis(boardVertices, boardUvs, boardNormals, boardTangents, boardBitangents);
+
+    std::vector<unsigned short> boardIndices;
+    std::vector<glm::vec3> indexedBoardvertices;
+    std::vector<glm::vec2> indexedBoarduvs;
+    std::vector<glm::vec3> indexedBoardnormals;
+    std::vector<glm::vec3> indexedBoardtangents;
+    std::vector<glm::vec3> indexedBoardbitangents;
+    indexVBO_TBN(boardVertices, boardUvs, boardNormals, boardTangents, boardBitangents,
+                 boardIndices, indexedBoardvertices, indexedBoarduvs, indexedBoardnormals,
+                 indexedBoardtangents, indexedBoardbitangents);
+    boardIndexCount = (GLsizei)boardIndices.size();
+
+    // Setup board buffers; the CPU copies go out of scope with load()
+    boardVertexbuffer.upload(GPU_BOARD, GL_ARRAY_BUFFER, indexedBoardvertices.size() * sizeof(glm::vec3),
+                             &indexedBoardvertices[0], GL_STATIC_DRAW);
+    boardUvbuffer.upload(GPU_BOARD, GL_ARRAY_BUFFER, indexedBoarduvs.size() * sizeof(glm::vec2),
+                         &indexedBoarduvs[0], GL_STATIC_DRAW);
+    boardNormalbuffer.upload(GPU_BOARD, GL_ARRAY_BUFFER, indexedBoardnormals.size() * sizeof(glm::vec3),
+                             &indexedBoardnormals[0], GL_STATIC_DRAW);
+    boardTangentbuffer.upload(GPU_BOARD, GL_ARRAY_BUFFER, indexedBoardtangents.size() * sizeof(glm::vec3),
+                              &indexedBoardtangents[0], GL_STATIC_DRAW);
+    boardBitangentbuffer.upload(GPU_BOARD, GL_ARRAY_BUFFER, indexedBoardbitangents.size() * sizeof(glm::vec3),
+                                &indexedBoardbitangents[0], GL_STATIC_DRAW);
+    boardElementbuffer.upload(GPU_BOARD, GL_ELEMENT_ARRAY_BUFFER, boardIndices.size() * sizeof(unsigned short),
+                              &boardIndices[0], GL_STATIC_DRAW);
+
+    // Baked lighting is optional, the board is lit per fragment without it
+    if (FILE* bake = fopen(DEFAULT_LIGHTMAP_PATH, "rb")) {
+        fclose(bake);
+        loadBakedLighting(DEFAULT_LIGHTMAP_PATH);
+    }
+
+    // Load chess pieces
+    if (!loadAssImp("Chess/chess.obj", chessPieces)) {
+        fprintf(stderr, "Failed to load chess pieces.\n");
+        return false;
+    }
+
+    // Setup chess piece buffers
+    for (ChessPiece& piece : chessPieces) {
+        piece.setBuffers();
+    }
+
+    // Empty until the first packet, they grow with the number of boards
+    instanceBuffer.upload(GPU_INSTANCES, GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+    idBuffer.upload(GPU_INSTANCES, GL_ARRAY_BUFFER, 0, NULL, GL_STREAM_DRAW);
+    meshFirstInstance.assign(chessPieces.size() + 1, 0);
+    return true;
+}
+
+void ChessScene::draw(const FramePacket& packet) {
+    // Camera-only changes leave the instance buffer untouched
+    if (packet.layoutVersion != uploadedLayout) {
+        uploadInstances(packet);
+        uploadedLayout = packet.layoutVersion;
+    }
+    lastDrawCalls = 0;
+    lastShadowLayers = 0;
+
+    bool shadows = shadowsEnabled && packet.lightEnabled && shadowMap.ready();
+    glm::mat4 lightViewProjection = ShadowMap::lightMatrix(packet.lightPosition);
+    if (shadows) {
+        updateShadows(packet, lightViewProjection);
+    }
+
+    glUseProgram(programID);
+
+    glUniform3f(LightID, packet.lightPosition.x, packet.lightPosition.y, packet.lightPosition.z);
+    glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &packet.ViewMatrix[0][0]);
+    glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &packet.ProjectionMatrix[0][0]);
+    glUniform1i(lightEnableID, packet.lightEnabled);
+    glUniform1i(TextureID, 0);
+    glUniformMatrix4fv(LightMatrixID, 1, GL_FALSE, &lightViewProjection[0][0]);
+    glUniform1i(shadowEnableID, shadows);
+    glUniform1i(ShadowMapID, 1);
+    if (shadowMap.ready()) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, shadowMap.texture(sampledLayer));
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // Lamps move and the camera turns, so their clusters change with every packet
+    const ClusteredLights& pointLights = packet.pointLights;
+    int pointLightCount = pointLights.ranges.empty() ? 0 : (int)pointLights.lights.size() / 2;
+    glUniform1i(pointLightCountID, pointLightCount);
+    if (pointLightCount > 0) {
+        if (packet.frameNumber != uploadedLightFrame) {
+            uploadPointLights(pointLights);
+            uploadedLightFrame = packet.frameNumber;
+        }
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        float start = std::min(CLUSTER_NEAR, pointLights.zFar);
+        glUniform2f(viewportSizeID, (float)viewport[2], (float)viewport[3]);
+        glUniform1f(clusterStartID, start);
+        glUniform1f(clusterScaleID, CLUSTER_SLICES / logf(pointLights.zFar / start));
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE2 + i);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTextures[i].id());
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(pointLightsID, 2);
+        glUniform1i(clusterRangesID, 3);
+        glUniform1i(clusterIndicesID, 4);
+    }
+
+    // Only the boards are normal mapped and baked
+    bool normalMap = normalMapping && boardNormalMap.id() != 0;
+    glUniform1i(NormalMapID, 5);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, boardNormalMap.id());
+    // The baked direct light is only valid for the light it was baked with,
+    // the occlusion holds for any light
+    int lightmapMode = 0;
+    if (bakedLighting && lightmapTexture.id() != 0) {
+        lightmapMode = packet.lightPosition == lightmapLight ? 2 : 1;
+    }
+    glUniform1i(LightmapID, 6);
+    glUniform3f(lightmapOriginID, lightmapOrigin.x, lightmapOrigin.y, lightmapOrigin.z);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, lightmapTexture.id());
+    glActiveTexture(GL_TEXTURE0);
+
+    GLsizei boardCount = (GLsizei)packet.boards.size();
+    if (boardCount > 0) {
+        glUniform1i(normalMapEnableID, normalMap);
+        glUniform1i(lightmapModeID, lightmapMode);
+        drawBoards(boardCount, normalMap);
+        glUniform1i(normalMapEnableID, 0);
+        glUniform1i(lightmapModeID, 0);
+        lastDrawCalls++;
+    }
+
+    for (size_t mesh = 0; mesh < chessPieces.size(); mesh++) {
+        GLsizei count = (GLsizei)(meshFirstInstance[mesh + 1] - meshFirstInstance[mesh]);
+        if (count == 0) {
+            continue;
+        }
+        bindInstanceAttributes(instanceBuffer.id(), boardCount + meshFirstInstance[mesh]);
+        chessPieces[mesh].render(count);
+        lastDrawCalls++;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        glDisableVertexAttribArray(3 + i);
+    }
+}
+
+bool ChessScene::loadBakedLighting(const char* path) {
+    Lightmap lightmap;
+    if (!loadLightmap(path, lightmap)) {
+        return false;
+    }
+    glBindTexture(GL_TEXTURE_2D, lightmapTexture.create(GPU_BOARD));
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, lightmap.width, lightmap.height, 0, GL_RG, GL_FLOAT,
+                 &lightmap.texels[0]);
+    // Board UVs come out of loadOBJ in [-1, 0], so the lightmap wraps like the diffuse texture
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    lightmapTexture.updateSize();
+    lightmapOrigin = glm::vec3(lightmap.boardMatrix[3]);
+    lightmapLight = lightmap.lightPosition;
+    printf("Using baked board lighting from %s\n", path);
+    return true;
+}
+
+void ChessScene::uploadPointLights(const ClusteredLights& pointLights) {
+    const void* data[3] = { &pointLights.lights[0], &pointLights.ranges[0],
+                            pointLights.indices.empty() ? NULL : &pointLights.indices[0] };
+    size_t bytes[3] = { pointLights.lights.size() * sizeof(glm::vec4), pointLights.ranges.size() * sizeof(uint32_t),
+                        pointLights.indices.size() * sizeof(uint16_t) };
+    for (int i = 0; i < 3; i++) {
+        // Never empty, a zero-sized buffer texture is not valid everywhere
+        lightBuffers[i].upload(GPU_LIGHTING, GL_TEXTURE_BUFFER, std::max(bytes[i], (size_t)16), NULL, GL_STREAM_DRAW);
+        if (bytes[i] > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes[i], data[i]);
+        }
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ChessScene::setShadows(bool enabled, bool cached) {
+    shadowsEnabled = enabled;
+    shadowCaching = cached;
+    shadowValid = false;
+}
+
+void ChessScene::updateShadows(const FramePacket& packet, const glm::mat4& lightViewProjection) {
+    // Each layer is redrawn when its own content changed or the one below was redrawn
+    size_t resting = std::min(packet.restingPieces, packet.pieces.size());
+    bool moving = resting < packet.pieces.size();
+    bool boardsChanged = !shadowCaching || !shadowValid || packet.lightPosition != shadowLight ||
+                         packet.boards != shadowBoards;
+    bool restingChanged = boardsChanged || packet.staticVersion != shadowStaticVersion;
+    bool movingChanged = moving && (restingChanged || packet.layoutVersion != shadowLayoutVersion);
+
+    if (boardsChanged) {
+        shadowMap.beginLayer(ShadowMap::BOARDS, lightViewProjection);
+        if (!packet.boards.empty()) {
+            drawBoards((GLsizei)packet.boards.size());
+            lastDrawCalls++;
+        }
+        shadowMap.endLayer();
+        shadowBoards = packet.boards;
+        shadowLight = packet.lightPosition;
+        shadowValid = true;
+        lastShadowLayers++;
+    }
+    if (restingChanged) {
+        fillBatch(restingBatch, packet.pieces.data(), packet.pieces.data() + resting);
+        shadowMap.beginLayer(ShadowMap::RESTING, lightViewProjection);
+        drawBatch(restingBatch);
+        shadowMap.endLayer();
+        shadowStaticVersion = packet.staticVersion;
+        lastShadowLayers++;
+    }
+    if (movingChanged) {
+        fillBatch(movingBatch, packet.pieces.data() + resting, packet.pieces.data() + packet.pieces.size());
+        shadowMap.beginLayer(ShadowMap::MOVING, lightViewProjection);
+        drawBatch(movingBatch);
+        shadowMap.endLayer();
+        shadowLayoutVersion = packet.layoutVersion;
+        lastShadowLayers++;
+    }
+    sampledLayer = moving ? ShadowMap::MOVING : ShadowMap::RESTING;
+}
+
+void ChessScene::fillBatch(PieceBatch& batch, const PieceInstance* first, const PieceInstance* last) {
+    size_t meshCount = chessPieces.size();
+    batch.meshFirst.assign(meshCount + 1, 0);
+    for (const PieceInstance* instance = first; instance != last; instance++) {
+        if (instance->mesh >= 0 && instance->mesh < (int)meshCount) {
+            batch.meshFirst[instance->mesh + 1]++;
+        }
+    }
+    for (size_t mesh = 0; mesh < meshCount; mesh++) {
+        batch.meshFirst[mesh + 1] += batch.meshFirst[mesh];
+    }
+    batch.matrices.resize(batch.meshFirst[meshCount]);
+    meshCursor.assign(batch.meshFirst.begin(), batch.meshFirst.end() - 1);
+    for (const PieceInstance* instance = first; instance != last; instance++) {
+        if (instance->mesh >= 0 && instance->mesh < (int)meshCount) {
+            batch.matrices[meshCursor[instance->mesh]++] = instance->ModelMatrix;
+        }
+    }
+
+    size_t bytes = batch.matrices.size() * sizeof(glm::mat4);
+    size_t capacity = bytes > batch.buffer.size() ? bytes * 2 : batch.buffer.size();
+    batch.buffer.upload(GPU_INSTANCES, GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    if (bytes > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &batch.matrices[0]);
+    }
+    chargeInstanceMemory();
+}
+
+void ChessScene::drawBatch(const PieceBatch& batch) {
+    for (size_t mesh = 0; mesh + 1 < batch.meshFirst.size(); mesh++) {
+        GLsizei count = (GLsizei)(batch.meshFirst[mesh + 1] - batch.meshFirst[mesh]);
+        if (count == 0) {
+            continue;
+        }
+        bindInstanceAttributes(batch.buffer.id(), batch.meshFirst[mesh]);
+        chessPieces[mesh].render(count);
+        lastDrawCalls++;
+    }
+    for (int i = 0; i < 4; i++) {
+        glDisableVertexAttribArray(3 + i);
+    }
+}
+
+void ChessScene::drawIds(const FramePacket& packet) {
+    if (pickProgramID == 0) {
+        return;
+    }
+    glUseProgram(pickProgramID);
+    glUniformMatrix4fv(pickViewMatrixID, 1, GL_FALSE, &packet.ViewMatrix[0][0]);
+    glUniformMatrix4fv(pickProjectionMatrixID, 1, GL_FALSE, &packet.ProjectionMatrix[0][0]);
+
+    if (packet.layoutVersion != uploadedLayout) {
+        uploadInstances(packet);
+        uploadedLayout = packet.layoutVersion;
+    }
+    // Most layouts are never picked, so the IDs are only sent when one is
+    if (uploadedIdLayout != uploadedLayout) {
+        size_t bytes = instanceIds.size() * sizeof(GLuint);
+        size_t capacity = bytes > idBuffer.size() ? bytes * 2 : idBuffer.size();
+        idBuffer.upload(GPU_INSTANCES, GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        if (bytes > 0) {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &instanceIds[0]);
+        }
+        uploadedIdLayout = uploadedLayout;
+    }
+
+    GLsizei boardCount = (GLsizei)packet.boards.size();
+    if (boardCount > 0) {
+        bindIdAttribute(0);
+        drawBoards(boardCount);
+    }
+    for (size_t mesh = 0; mesh < chessPieces.size(); mesh++) {
+        GLsizei count = (GLsizei)(meshFirstInstance[mesh + 1] - meshFirstInstance[mesh]);
+        if (count == 0) {
+            continue;
+        }
+        bindInstanceAttributes(instanceBuffer.id(), boardCount + meshFirstInstance[mesh]);
+        bindIdAttribute(boardCount + meshFirstInstance[mesh]);
+        chessPieces[mesh].render(count);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        glDisableVertexAttribArray(3 + i);
+    }
+    glDisableVertexAttribArray(7);
+}
+
+void ChessScene::uploadInstances(const FramePacket& packet) {
+    // Counting sort of the piece instances by mesh
+    size_t meshCount = chessPieces.size();
+    meshFirstInstance.assign(meshCount + 1, 0);
+    for (const PieceInstance& instance : packet.pieces) {
+        if (instance.mesh >= 0 && instance.mesh < (int)meshCount) {
+            meshFirstInstance[instance.mesh + 1]++;
+        }
+    }
+    for (size_t mesh = 0; mesh < meshCount; mesh++) {
+        meshFirstInstance[mesh + 1] += meshFirstInstance[mesh];
+    }
+
+    size_t boardCount = packet.boards.size();
+    instanceMatrices.resize(boardCount + meshFirstInstance[meshCount]);
+    std::copy(packet.boards.begin(), packet.boards.end(), instanceMatrices.begin());
+    instanceIds.resize(instanceMatrices.size());
+    for (size_t board = 0; board < boardCount; board++) {
+        // The picking shader adds the square under the pixel
+        instanceIds[board] = PICK_SQUARE | (GLuint)(board << 6);
+    }
+
+    meshCursor.assign(meshFirstInstance.begin(), meshFirstInstance.end() - 1);
+    for (const PieceInstance& instance : packet.pieces) {
+        if (instance.mesh >= 0 && instance.mesh < (int)meshCount) {
+            size_t index = boardCount + meshCursor[instance.mesh]++;
+            instanceMatrices[index] = instance.ModelMatrix;
+            instanceIds[index] = instance.square < 0 ? PICK_NONE
+                : PICK_PIECE | (GLuint)(instance.board << 6 | instance.square);
+        }
+    }
+
+    // Orphan the old storage so the driver never waits on draws still using it
+    size_t bytes = instanceMatrices.size() * sizeof(glm::mat4);
+    size_t capacity = bytes > instanceBuffer.size() ? bytes * 2 : instanceBuffer.size();
+    instanceBuffer.upload(GPU_INSTANCES, GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    if (bytes > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &instanceMatrices[0]);
+    }
+    chargeInstanceMemory();
+}
+
+void ChessScene::chargeInstanceMemory() {
+    // Capacities, not sizes: the vectors keep their largest layout until release()
+    size_t bytes = (instanceMatrices.capacity() + restingBatch.matrices.capacity() +
+                    movingBatch.matrices.capacity()) * sizeof(glm::mat4) +
+                   instanceIds.capacity() * sizeof(GLuint) +
+                   (meshFirstInstance.capacity() + meshCursor.capacity() + restingBatch.meshFirst.capacity() +
+                    movingBatch.meshFirst.capacity()) * sizeof(size_t);
+    instanceMemory.set(GPU_INSTANCES, bytes);
+}
+
+void ChessScene::bindInstanceAttributes(GLuint buffer, size_t firstInstance) {
+    // A mat4 attribute takes four consecutive locations, one per column
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int i = 0; i < 4; i++) {
+        size_t offset = firstInstance * sizeof(glm::mat4) + i * sizeof(glm::vec4);
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)offset);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+}
+
+void ChessScene::bindIdAttribute(size_t firstInstance) {
+    // Integer attribute, so the ID reaches the shader without a float conversion
+    glBindBuffer(GL_ARRAY_BUFFER, idBuffer.id());
+    glEnableVertexAttribArray(7);
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)(firstInstance * sizeof(GLuint)));
+    glVertexAttribDivisor(7, 1);
+}
+
+void ChessScene::drawBoards(GLsizei boardCount, bool tangents) {
+    bindInstanceAttributes(instanceBuffer.id(), 0);
+
+    // Bind texture
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, boardTexture.id());
+
+    // Set up vertex attributes
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, boardVertexbuffer.id());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, boardUvbuffer.id());
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, boardNormalbuffer.id());
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    if (tangents) {
+        glEnableVertexAttribArray(8);
+        glBindBuffer(GL_ARRAY_BUFFER, boardTangentbuffer.id());
+        glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+        glEnableVertexAttribArray(9);
+        glBindBuffer(GL_ARRAY_BUFFER, boardBitangentbuffer.id());
+        glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    }
+
+    // Draw every board with one call
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boardElementbuffer.id());
+    glDrawElementsInstanced(GL_TRIANGLES, boardIndexCount, GL_UNSIGNED_SHORT, (void*)0, boardCount);
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(2);
+    if (tangents) {
+        glDisableVertexAttribArray(8);
+        glDisableVertexAttribArray(9);
+    }
+}
+
+void ChessScene::release() {
+    boardVertexbuffer.reset();
+    boardUvbuffer.reset();
+    boardNormalbuffer.reset();
+    boardTangentbuffer.reset();
+    boardBitangentbuffer.reset();
+    boardElementbuffer.reset();
+    boardTexture.reset();
+    boardNormalMap.reset();
+    lightmapTexture.reset();
+    chessPieces.clear();
+    instanceBuffer.reset();
+    uploadedLayout = 0;
+    idBuffer.reset();
+    uploadedIdLayout = 0;
+    // Swapped out rather than cleared so their memory goes as well
+    std::vector<glm::mat4>().swap(instanceMatrices);
+    std::vector<GLuint>().swap(instanceIds);
+    restingBatch = PieceBatch();
+    movingBatch = PieceBatch();
+    instanceMemory.reset();
+    shadowMap.release();
+    shadowValid = false;
+    for (int i = 0; i < 3; i++) {
+        lightBuffers[i].reset();
+        lightTextures[i].reset();
+    }
+    uploadedLightFrame = 0;
+    glDeleteProgram(programID);
+    glDeleteProgram(pickProgramID);
+    programID = 0;
+    pickProgramID = 0;
+    vertexArray.reset();
+}
@@ -0,0 +1,196 @@
+/*
+Description:
+GL side of the chess scene: shader program, board buffers and chess piece
+meshes. Loaded once on the thread owning the GL context and drawn from frame
+packets, so it holds no camera or game state of its own. Board and piece
+geometry is shared by every board in the packet: each mesh is drawn once per
+frame with instancing, whatever the number of boards.
+*/
+
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "framepacket.hpp"
+#include "gpuresource.hpp"
+#include "objloader.hpp"
+#include "shadowmap.hpp"
+
+/**
+ * @brief Board and chess piece GPU resources plus the shader that draws them
+ */
+class ChessScene {
+public:
+    ChessScene();
+
+    /**
+     * @brief Compiles shaders and uploads board and piece geometry and textures
+     * Requires a current GL context.
+     *
+     * @return true if the shader, board and pieces loaded
+     */
+    bool load();
+
+    /**
+     * @brief Submits draw calls for one frame
+     * @param packet Camera, light and piece instances to draw
+     */
+    void draw(const FramePacket& packet);
+
+    /**
+     * @brief Draws the pick IDs of boards and pieces into the bound integer target
+     * Call after draw() with the same packet, between PickBuffer::begin() and end().
+     *
+     * @param packet Camera and instances as passed to draw()
+     */
+    void drawIds(const FramePacket& packet);
+
+    /**
+     * @brief Deletes all GL objects created by load()
+     * Must run before the GL context is destroyed.
+     */
+    void release();
+
+    /**
+     * @brief Number of draw calls issued by the last draw()
+     * @return Draw call count
+     */
+    int drawCalls() const { return lastDrawCalls; }
+
+    /**
+     * @brief Turns shadows on or off, and the caching of their depth layers
+     * Without caching every layer is redrawn in every frame, for comparison.
+     */
+    void setShadows(bool enabled, bool cached = true);
+
+    /**
+     * @brief Number of shadow map layers redrawn by the last draw()
+     * @return 0 while nothing moves, up to 3
+     */
+    int shadowLayersDrawn() const { return lastShadowLayers; }
+
+    /**
+     * @brief Turns the board's normal map on or off
+     */
+    void setNormalMapping(bool enabled) { normalMapping = enabled; }
+
+    /**
+     * @brief Loads a lightmap written by the bake tool for the board
+     * load() already picks up DEFAULT_LIGHTMAP_PATH when it exists.
+     *
+     * @param path Lightmap file
+     * @return true if it loaded, otherwise the previous bake stays in use
+     */
+    bool loadBakedLighting(const char* path);
+
+    /**
+     * @brief Turns the use of the baked board lighting on or off
+     */
+    void setBakedLighting(bool enabled) { bakedLighting = enabled; }
+
+private:
+    /**
+     * @brief Piece matrices of one shadow layer, sorted by mesh like the scene instances
+     */
+    struct PieceBatch {
+        GpuBuffer buffer;
+        std::vector<glm::mat4> matrices;
+        std::vector<size_t> meshFirst;
+    };
+
+    void uploadInstances(const FramePacket& packet);
+    void updateShadows(const FramePacket& packet, const glm::mat4& lightViewProjection);
+    void uploadPointLights(const ClusteredLights& pointLights);
+    void fillBatch(PieceBatch& batch, const PieceInstance* first, const PieceInstance* last);
+    void drawBatch(const PieceBatch& batch);
+    void bindInstanceAttributes(GLuint buffer, size_t firstInstance);
+    void bindIdAttribute(size_t firstInstance);
+    void drawBoards(GLsizei boardCount, bool tangents = false);
+    void chargeInstanceMemory();
+
+    // Shader program and uniform locations
+    GLuint programID;
+    GLuint ViewMatrixID;
+    GLuint ProjectionMatrixID;
+    GLuint TextureID;
+    GLuint LightID;
+    GLuint lightEnableID;
+    GLuint LightMatrixID;
+    GLuint ShadowMapID;
+    GLuint shadowEnableID;
+    GLuint NormalMapID;
+    GLuint normalMapEnableID;
+    GLuint LightmapID;
+    GLuint lightmapModeID;
+    GLuint lightmapOriginID;
+    GLuint pointLightCountID;
+    GLuint pointLightsID;
+    GLuint clusterRangesID;
+    GLuint clusterIndicesID;
+    GLuint viewportSizeID;
+    GLuint clusterStartID;
+    GLuint clusterScaleID;
+
+    // Pick ID program, 0 if it failed to load
+    GLuint pickProgramID;
+    GLuint pickViewMatrixID;
+    GLuint pickProjectionMatrixID;
+
+    // Board resources
+    GpuVertexArray vertexArray;
+    GpuTexture boardTexture;
+    GpuBuffer boardVertexbuffer;
+    GpuBuffer boardUvbuffer;
+    GpuBuffer boardNormalbuffer;
+    GpuBuffer boardTangentbuffer;
+    GpuBuffer boardBitangentbuffer;
+    GpuTexture boardNormalMap;  ///< From the bump map, empty if it failed to load
+    GpuBuffer boardElementbuffer;
+    GLsizei boardIndexCount;
+    bool normalMapping;
+
+    // Baked board lighting, empty when there is no bake
+    GpuTexture lightmapTexture;
+    glm::vec3 lightmapOrigin;   ///< Translation of the baked board
+    glm::vec3 lightmapLight;    ///< Light position of the bake
+    bool bakedLighting;
+
+    std::vector<ChessPiece> chessPieces;
+
+    // Per-instance model matrices: boards first, then pieces grouped by mesh
+    GpuBuffer instanceBuffer;
+    unsigned long uploadedLayout; ///< layoutVersion of the buffer contents
+    std::vector<glm::mat4> instanceMatrices;
+    std::vector<size_t> meshFirstInstance; ///< Size chessPieces.size() + 1
+    std::vector<size_t> meshCursor;
+
+    // Pick ID per instance in the same order, uploaded on the first pick after a change
+    GpuBuffer idBuffer;
+    unsigned long uploadedIdLayout;
+    std::vector<GLuint> instanceIds;
+    CpuCharge instanceMemory;   ///< The instance vectors here and in the batches
+
+    // Shadow layers and what they were last drawn for
+    ShadowMap shadowMap;
+    bool shadowsEnabled;
+    bool shadowCaching;
+    bool shadowValid;
+    glm::vec3 shadowLight;
+    std::vector<glm::mat4> shadowBoards;
+    unsigned long shadowStaticVersion;
+    unsigned long shadowLayoutVersion;
+    ShadowMap::Layer sampledLayer;
+    PieceBatch restingBatch;
+    PieceBatch movingBatch;
+    int lastShadowLayers;
+
+    // Clustered point lights as buffer textures: lights, cluster ranges, light lists
+    GpuBuffer lightBuffers[3];
+    GpuTexture lightTextures[3];
+    unsigned long uploadedLightFrame; ///< frameNumber of the packet uploaded last
+    int lastDrawCalls;
+};
+
+#endif
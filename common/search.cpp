@@ -0,0 +1,614 @@
+/*
+Description:
+Search implementation. The main thread runs iterative deepening with
+aspiration windows and owns the time and node limits; helper threads search
+the same root, odd ones one ply deeper, so they fill the shared transposition
+table with results the main thread picks up.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#include "search.hpp"
+#include "evaluate.hpp"
+#include "movegen.hpp"
+
+namespace {
+    /// Victim values for MVV-LVA ordering and delta pruning
+    const int PIECE_VALUE[6] = { 100, 320, 330, 500, 900, 20000 };
+
+    const int TT_MOVE_SCORE = 2000000;
+    const int CAPTURE_SCORE = 1000000;
+    const int KILLER_SCORE[2] = { 900000, 800000 };
+    const int HISTORY_LIMIT = 16384;
+
+    /// Late move reductions by depth and move number
+    struct ReductionTable {
+        int value[64][64];
+        ReductionTable() {
+            for (int depth = 0; depth < 64; depth++) {
+                for (int moves = 0; moves < 64; moves++) {
+                    value[depth][moves] = depth && moves ?
+                        (int)(0.75 + log((double)depth) * log((double)moves) / 2.25) : 0;
+                }
+            }
+        }
+    };
+    const ReductionTable REDUCTIONS;
+
+    int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Mate and tablebase scores are stored relative to the node, not the root
+    int scoreToTT(int score, int ply) {
+        if (score >= SCORE_TB_WIN_IN_MAX_PLY) return score + ply;
+        if (score <= -SCORE_TB_WIN_IN_MAX_PLY) return score - ply;
+        return score;
+    }
+
+    int scoreFromTT(int score, int ply) {
+        if (score >= SCORE_TB_WIN_IN_MAX_PLY) return score - ply;
+        if (score <= -SCORE_TB_WIN_IN_MAX_PLY) return score + ply;
+        return score;
+    }
+
+    int capturedType(const Position& position, Move move) {
+        if (moveFlags(move) == EN_PASSANT) {
+            return PAWN;
+        }
+        int piece = position.pieceOn(moveTo(move));
+        return piece == NO_PIECE ? -1 : pieceType(piece);
+    }
+
+    /**
+     * @brief Static exchange evaluation: material won by a capture once all
+     * recaptures on the target square are played out, least valuable attacker first
+     */
+    int staticExchange(const Position& position, Move move) {
+        int from = moveFrom(move);
+        int to = moveTo(move);
+        int victim = capturedType(position, move);
+        int gain[32];
+        int depth = 0;
+        gain[0] = victim >= 0 ? PIECE_VALUE[victim] : 0;
+
+        Bitboard occupancy = position.occupied() ^ squareBB(from);
+        if (moveFlags(move) == EN_PASSANT) {
+            occupancy ^= squareBB(to ^ 8);
+        }
+        int onSquare = PIECE_VALUE[pieceType(position.pieceOn(from))];
+        int side = position.sideToMove() ^ 1;
+
+        for (;;) {
+            // Recomputing attackers with the updated occupancy picks up x-rays
+            Bitboard attackers = position.attackersTo(to, occupancy) & occupancy & position.colorPieces(side);
+            if (!attackers) {
+                break;
+            }
+            int type = PAWN;
+            while (!(attackers & position.pieces(side, type))) {
+                type++;
+            }
+            depth++;
+            gain[depth] = onSquare - gain[depth - 1];
+            if ((-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]) < 0 || depth == 31) {
+                break;
+            }
+            occupancy ^= squareBB(lsb(attackers & position.pieces(side, type)));
+            onSquare = PIECE_VALUE[type];
+            side ^= 1;
+        }
+        while (--depth > 0) {
+            gain[depth - 1] = -(-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]);
+        }
+        return gain[0];
+    }
+
+    /// Moves the best scored move still unsearched into slot index
+    Move pickMove(MoveList& list, int* scores, int index) {
+        int best = index;
+        for (int i = index + 1; i < list.size(); i++) {
+            if (scores[i] > scores[best]) {
+                best = i;
+            }
+        }
+        Move move = list.moves[best];
+        int score = scores[best];
+        list.moves[best] = list.moves[index];
+        scores[best] = scores[index];
+        list.moves[index] = move;
+        scores[index] = score;
+        return move;
+    }
+}
+
+/**
+ * @brief Per-thread search state
+ */
+struct SearchEngine::Worker {
+    int id;
+    Position position;
+    std::atomic<uint64_t> nodes;
+    std::atomic<uint64_t> tbHits;
+    int seldepth;
+    Move killers[MAX_PLY + 1][2];
+    int history[2][64][64];
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pvLength[MAX_PLY + 1];
+    NnueAccumulatorStack accumulators;
+
+    explicit Worker(int index) : id(index), nodes(0), tbHits(0), seldepth(0) {
+        clearHistory();
+    }
+
+    void clearHistory() {
+        memset(killers, 0, sizeof(killers));
+        memset(history, 0, sizeof(history));
+    }
+
+    int staticEval(const NnueNetwork* network) {
+        return network ? accumulators.evaluate(*network, position) : evaluate(position);
+    }
+
+    void countNode() {
+        // Only this thread writes the counter, others just read it
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void scoreMoves(const MoveList& list, int* scores, Move ttMove, int ply) const {
+        int side = position.sideToMove();
+        for (int i = 0; i < list.size(); i++) {
+            Move move = list[i];
+            if (move == ttMove) {
+                scores[i] = TT_MOVE_SCORE;
+            } else if (isCapture(move) || isPromotion(move)) {
+                int victim = capturedType(position, move);
+                int value = victim >= 0 ? PIECE_VALUE[victim] : 0;
+                if (isPromotion(move)) {
+                    value += PIECE_VALUE[promotionType(move)];
+                }
+                int attacker = pieceType(position.pieceOn(moveFrom(move)));
+                scores[i] = CAPTURE_SCORE + value * 16 - attacker;
+            } else if (move == killers[ply][0]) {
+                scores[i] = KILLER_SCORE[0];
+            } else if (move == killers[ply][1]) {
+                scores[i] = KILLER_SCORE[1];
+            } else {
+                scores[i] = history[side][moveFrom(move)][moveTo(move)];
+            }
+        }
+    }
+
+    void updateHistory(int side, Move move, int bonus) {
+        int& entry = history[side][moveFrom(move)][moveTo(move)];
+        // Gravity keeps the entry within +-HISTORY_LIMIT
+        entry += bonus - entry * (bonus < 0 ? -bonus : bonus) / HISTORY_LIMIT;
+    }
+
+    void updateQuietStats(Move best, int ply, int depth, const Move* tried, int triedCount) {
+        if (killers[ply][0] != best) {
+            killers[ply][1] = killers[ply][0];
+            killers[ply][0] = best;
+        }
+        int side = position.sideToMove();
+        int bonus = depth * depth < 1200 ? depth * depth : 1200;
+        updateHistory(side, best, bonus);
+        for (int i = 0; i < triedCount; i++) {
+            updateHistory(side, tried[i], -bonus);
+        }
+    }
+
+    void updatePv(int ply, Move move) {
+        pv[ply][ply] = move;
+        for (int i = ply + 1; i < pvLength[ply + 1]; i++) {
+            pv[ply][i] = pv[ply + 1][i];
+        }
+        pvLength[ply] = pvLength[ply + 1] > ply + 1 ? pvLength[ply + 1] : ply + 1;
+    }
+};
+
+SearchEngine::SearchEngine(TranspositionTable& table)
+    : table(table), network(NULL), tablebases(NULL), stopFlag(false), startTime(0) {
+    setThreads(1);
+}
+
+SearchEngine::~SearchEngine() {}
+
+void SearchEngine::setThreads(int count) {
+    if (count < 1) {
+        count = 1;
+    }
+    workers.clear();
+    for (int i = 0; i < count; i++) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker(i)));
+    }
+}
+
+void SearchEngine::clearHistory() {
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->clearHistory();
+    }
+}
+
+void SearchEngine::setNetwork(const NnueNetwork* nextNetwork) {
+    network = nextNetwork;
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->accumulators.reset();
+    }
+}
+
+void SearchEngine::setTablebases(Tablebases* nextTablebases) {
+    tablebases = nextTablebases;
+}
+
+uint64_t SearchEngine::totalTbHits() const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < workers.size(); i++) {
+        count += workers[i]->tbHits.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+uint64_t SearchEngine::totalNodes() const {
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < workers.size(); i++) {
+        nodes += workers[i]->nodes.load(std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+int64_t SearchEngine::elapsedMs() const {
+    return nowMs() - startTime;
+}
+
+SearchInfo SearchEngine::search(const Position& root, const SearchLimits& searchLimits,
+                                const IterationCallback& onIteration) {
+    limits = searchLimits;
+    startTime = nowMs();
+    stopFlag.store(false);
+    result = SearchInfo();
+    table.newSearch();
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        Worker& worker = *workers[i];
+        worker.position = root;
+        worker.nodes.store(0);
+        worker.tbHits.store(0);
+        worker.seldepth = 0;
+        memset(worker.killers, 0, sizeof(worker.killers));
+    }
+
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < workers.size(); i++) {
+        helpers.push_back(std::thread(&SearchEngine::runWorker, this, std::ref(*workers[i]),
+                                      (const IterationCallback*)NULL));
+    }
+    runWorker(*workers[0], &onIteration);
+
+    stopFlag.store(true);
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+
+    result.nodes = totalNodes();
+    result.timeMs = elapsedMs();
+    result.tbHits = totalTbHits();
+    if (result.pv.empty()) {
+        // Stopped before the first iteration finished: any legal move beats none
+        MoveList list;
+        generateLegalMoves(root, list);
+        if (list.size() > 0) {
+            result.pv.push_back(list[0]);
+        }
+    }
+    return result;
+}
+
+void SearchEngine::runWorker(Worker& worker, const IterationCallback* onIteration) {
+    bool mainThread = worker.id == 0;
+    int score = 0;
+
+    for (int depth = 1 + (mainThread ? 0 : worker.id % 2); depth < MAX_PLY; depth++) {
+        if (mainThread && limits.depth > 0 && depth > limits.depth) {
+            break;
+        }
+        worker.seldepth = 0;
+
+        // Aspiration window around the previous score once it is stable enough
+        int delta = 25;
+        int alpha = -SCORE_INFINITE;
+        int beta = SCORE_INFINITE;
+        if (depth >= 5) {
+            alpha = score - delta > -SCORE_INFINITE ? score - delta : -SCORE_INFINITE;
+            beta = score + delta < SCORE_INFINITE ? score + delta : SCORE_INFINITE;
+        }
+
+        int iterationScore;
+        for (;;) {
+            iterationScore = searchNode(worker, alpha, beta, depth, 0, false);
+            if (stopFlag.load(std::memory_order_relaxed)) {
+                break;
+            }
+            if (iterationScore <= alpha) {
+                beta = (alpha + beta) / 2;
+                alpha = iterationScore - delta > -SCORE_INFINITE ? iterationScore - delta : -SCORE_INFINITE;
+            } else if (iterationScore >= beta) {
+                beta = iterationScore + delta < SCORE_INFINITE ? iterationScore + delta : SCORE_INFINITE;
+            } else {
+                break;
+            }
+            delta += delta / 2;
+        }
+        if (stopFlag.load(std::memory_order_relaxed)) {
+            break;
+        }
+        score = iterationScore;
+
+        if (mainThread) {
+            result.depth = depth;
+            result.seldepth = worker.seldepth;
+            result.score = score;
+            result.nodes = totalNodes();
+            result.timeMs = elapsedMs();
+            result.hashfull = table.hashfull();
+            result.tbHits = totalTbHits();
+            result.pv.assign(worker.pv[0], worker.pv[0] + worker.pvLength[0]);
+            if (onIteration && *onIteration) {
+                (*onIteration)(result);
+            }
+        }
+    }
+}
+
+void SearchEngine::checkLimits(Worker& worker) {
+    if (worker.id != 0) {
+        return;
+    }
+    if ((limits.movetimeMs > 0 && elapsedMs() >= limits.movetimeMs) ||
+        (limits.nodes > 0 && totalNodes() >= limits.nodes)) {
+        stop();
+    }
+}
+
+int SearchEngine::searchNode(Worker& worker, int alpha, int beta, int depth, int ply, bool nullAllowed) {
+    Position& position = worker.position;
+    worker.pvLength[ply] = ply;
+    if (depth <= 0) {
+        return quiescence(worker, alpha, beta, ply);
+    }
+
+    worker.countNode();
+    if ((worker.nodes.load(std::memory_order_relaxed) & 1023) == 0) {
+        checkLimits(worker);
+    }
+    if (stopFlag.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (ply > worker.seldepth) {
+        worker.seldepth = ply;
+    }
+
+    bool pvNode = beta - alpha > 1;
+    if (ply > 0) {
+        if (position.isRepetition() || position.halfmoveClock() >= 100) {
+            return 0;
+        }
+        if (ply >= MAX_PLY - 1) {
+            return worker.staticEval(network);
+        }
+        // No line from here can beat a mate already found closer to the root
+        alpha = alpha > -SCORE_MATE + ply ? alpha : -SCORE_MATE + ply;
+        beta = beta < SCORE_MATE - ply - 1 ? beta : SCORE_MATE - ply - 1;
+        if (alpha >= beta) {
+            return alpha;
+        }
+    }
+
+    TTData entry;
+    bool ttHit = table.probe(position.key(), entry);
+    Move ttMove = ttHit ? entry.move : NO_MOVE;
+    if (ttHit && !pvNode && entry.depth >= depth) {
+        int ttScore = scoreFromTT(entry.score, ply);
+        if (entry.bound == BOUND_EXACT ||
+            (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+            (entry.bound == BOUND_UPPER && ttScore <= alpha)) {
+            return ttScore;
+        }
+    }
+
+    // Tablebases are exact: probe when a capture just entered a covered position.
+    // Pawn pushes in pawn endings reset the fifty-move counter too but never reach a table,
+    // so only captures pay for the lookup.
+    if (tablebases && ply > 0 && position.capturedPiece() != NO_PIECE && tablebases->canProbe(position)) {
+        int wdl;
+        if (tablebases->probeWdl(position, wdl)) {
+            worker.tbHits.store(worker.tbHits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            int tbScore = wdl == WDL_WIN ? SCORE_TB_WIN - ply : wdl == WDL_LOSS ? -SCORE_TB_WIN + ply : 0;
+            table.store(position.key(), NO_MOVE, scoreToTT(tbScore, ply), 0,
+                        depth + 6 < MAX_PLY ? depth + 6 : MAX_PLY - 1, BOUND_EXACT);
+            return tbScore;
+        }
+    }
+
+    bool inCheck = position.inCheck();
+    int staticEval = inCheck ? -SCORE_INFINITE : (ttHit ? entry.eval : worker.staticEval(network));
+
+    if (!pvNode && !inCheck && beta < SCORE_MATE_IN_MAX_PLY && beta > -SCORE_MATE_IN_MAX_PLY) {
+        // Reverse futility: far enough above beta that a shallow search will not fall back
+        if (depth <= 6 && staticEval - 80 * depth >= beta) {
+            return staticEval;
+        }
+
+        // Null move: if passing still fails high, a real move will too
+        if (nullAllowed && depth >= 3 && staticEval >= beta &&
+            position.hasNonPawnMaterial(position.sideToMove())) {
+            int reduction = 3 + depth / 4;
+            position.makeNullMove();
+            table.prefetch(position.key());
+            int nullScore = -searchNode(worker, -beta, -beta + 1, depth - 1 - reduction, ply + 1, false);
+            position.unmakeNullMove();
+            if (stopFlag.load(std::memory_order_relaxed)) {
+                return 0;
+            }
+            if (nullScore >= beta) {
+                return nullScore >= SCORE_MATE_IN_MAX_PLY ? beta : nullScore;
+            }
+        }
+    }
+
+    MoveList list;
+    generateLegalMoves(position, list);
+    if (list.size() == 0) {
+        return inCheck ? -SCORE_MATE + ply : 0;
+    }
+    int scores[256];
+    worker.scoreMoves(list, scores, ttMove, ply);
+
+    int bestScore = -SCORE_INFINITE;
+    Move bestMove = NO_MOVE;
+    Move quietsTried[64];
+    int quietCount = 0;
+
+    for (int i = 0; i < list.size(); i++) {
+        Move move = pickMove(list, scores, i);
+        bool quiet = !isCapture(move) && !isPromotion(move);
+
+        position.makeMove(move);
+        table.prefetch(position.key());
+        bool givesCheck = position.inCheck();
+        int newDepth = depth - 1 + (givesCheck ? 1 : 0);
+
+        int score;
+        if (i == 0) {
+            score = -searchNode(worker, -beta, -alpha, newDepth, ply + 1, true);
+        } else {
+            // Late quiet moves are searched shallower first, then verified if they surprise
+            int reduction = 0;
+            if (depth >= 3 && i >= 3 && quiet && !inCheck && !givesCheck) {
+                reduction = REDUCTIONS.value[depth < 64 ? depth : 63][i < 64 ? i : 63];
+                if (pvNode && reduction > 0) {
+                    reduction--;
+                }
+                if (reduction > newDepth - 1) {
+                    reduction = newDepth - 1 > 0 ? newDepth - 1 : 0;
+                }
+            }
+            score = -searchNode(worker, -alpha - 1, -alpha, newDepth - reduction, ply + 1, true);
+            if (score > alpha && reduction > 0) {
+                score = -searchNode(worker, -alpha - 1, -alpha, newDepth, ply + 1, true);
+            }
+            if (score > alpha && score < beta) {
+                score = -searchNode(worker, -beta, -alpha, newDepth, ply + 1, true);
+            }
+        }
+        position.unmakeMove();
+
+        if (stopFlag.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                bestMove = move;
+                alpha = score;
+                worker.updatePv(ply, move);
+                if (alpha >= beta) {
+                    if (quiet) {
+                        worker.updateQuietStats(move, ply, depth, quietsTried, quietCount);
+                    }
+                    break;
+                }
+            }
+        }
+        if (quiet && quietCount < 64) {
+            quietsTried[quietCount++] = move;
+        }
+    }
+
+    int bound = bestScore >= beta ? BOUND_LOWER : (bestMove != NO_MOVE ? BOUND_EXACT : BOUND_UPPER);
+    table.store(position.key(), bestMove != NO_MOVE ? bestMove : ttMove,
+                scoreToTT(bestScore, ply), staticEval, depth, bound);
+    return bestScore;
+}
+
+int SearchEngine::quiescence(Worker& worker, int alpha, int beta, int ply) {
+    Position& position = worker.position;
+    worker.pvLength[ply] = ply;
+
+    worker.countNode();
+    if ((worker.nodes.load(std::memory_order_relaxed) & 1023) == 0) {
+        checkLimits(worker);
+    }
+    if (stopFlag.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (ply > worker.seldepth) {
+        worker.seldepth = ply;
+    }
+    if (ply >= MAX_PLY - 1) {
+        return worker.staticEval(network);
+    }
+
+    bool inCheck = position.inCheck();
+    int bestScore = -SCORE_INFINITE;
+    if (!inCheck) {
+        // Stand pat: the side to move is not forced to capture
+        bestScore = worker.staticEval(network);
+        if (bestScore >= beta) {
+            return bestScore;
+        }
+        if (bestScore > alpha) {
+            alpha = bestScore;
+        }
+    }
+
+    // Outside check only captures and queen promotions, ordered by MVV-LVA; an
+    // empty list there is left to stand pat, as stalemates are too rare to look for
+    MoveList list;
+    generateLegalCaptures(position, list);
+    if (inCheck && list.size() == 0) {
+        return -SCORE_MATE + ply;
+    }
+    int scores[256];
+    worker.scoreMoves(list, scores, NO_MOVE, ply);
+
+    for (int i = 0; i < list.size(); i++) {
+        Move move = pickMove(list, scores, i);
+        if (!inCheck) {
+            bool queenPromotion = isPromotion(move);
+            // Delta pruning: even winning the piece for free would not reach alpha
+            int victim = capturedType(position, move);
+            if (!queenPromotion && victim >= 0 && bestScore + PIECE_VALUE[victim] + 200 < alpha) {
+                continue;
+            }
+            // Captures that lose material are left to the main search
+            if (!queenPromotion && staticExchange(position, move) < 0) {
+                continue;
+            }
+        }
+
+        position.makeMove(move);
+        int score = -quiescence(worker, -beta, -alpha, ply + 1);
+        position.unmakeMove();
+
+        if (stopFlag.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            if (score > alpha) {
+                alpha = score;
+                worker.updatePv(ply, move);
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+    return bestScore;
+}
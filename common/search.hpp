@@ -0,0 +1,144 @@
+/*
+Description:
+Alpha-beta search. Iterative deepening principal variation search with a
+quiescence search at the leaves, ordering moves by transposition table move,
+MVV-LVA, killer moves and history. Extra threads run the same search on their
+own copy of the position (Lazy SMP) and share work only through the
+transposition table.
+*/
+
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "nnue.hpp"
+#include "position.hpp"
+#include "tablebase.hpp"
+#include "tt.hpp"
+
+const int MAX_PLY = 128;
+const int SCORE_INFINITE = 32001;
+const int SCORE_MATE = 32000;
+/// Scores beyond this are mates, the distance is SCORE_MATE - |score| plies
+const int SCORE_MATE_IN_MAX_PLY = SCORE_MATE - MAX_PLY;
+/// Tablebase wins score SCORE_TB_WIN minus the ply they were found at, below any mate
+const int SCORE_TB_WIN = SCORE_MATE_IN_MAX_PLY - 1;
+const int SCORE_TB_WIN_IN_MAX_PLY = SCORE_TB_WIN - MAX_PLY;
+
+/**
+ * @brief When to stop searching; zero fields mean no limit
+ */
+struct SearchLimits {
+    int depth;
+    int64_t movetimeMs;
+    uint64_t nodes;
+
+    SearchLimits() : depth(0), movetimeMs(0), nodes(0) {}
+};
+
+/**
+ * @brief Result of the deepest completed iteration
+ */
+struct SearchInfo {
+    int depth;
+    int seldepth;
+    int score;          ///< Centipawns from the side to move's point of view
+    uint64_t nodes;     ///< Nodes searched by all threads
+    int64_t timeMs;
+    int hashfull;       ///< Permille of the table used by this search
+    uint64_t tbHits;    ///< Positions resolved by tablebase probes
+    std::vector<Move> pv;
+
+    SearchInfo() : depth(0), seldepth(0), score(0), nodes(0), timeMs(0), hashfull(0), tbHits(0) {}
+    Move bestMove() const { return pv.empty() ? NO_MOVE : pv[0]; }
+};
+
+/**
+ * @brief Multi-threaded search over a shared transposition table
+ */
+class SearchEngine {
+public:
+    typedef std::function<void(const SearchInfo&)> IterationCallback;
+
+    /**
+     * @param table Transposition table shared by every thread; must outlive the engine
+     */
+    explicit SearchEngine(TranspositionTable& table);
+    ~SearchEngine();
+
+    SearchEngine(const SearchEngine&) = delete;
+    SearchEngine& operator=(const SearchEngine&) = delete;
+
+    /**
+     * @brief Sets the number of search threads, including the calling one
+     */
+    void setThreads(int count);
+    int threads() const { return (int)workers.size(); }
+
+    /**
+     * @brief Searches a position, blocking until a limit is hit or stop() is called
+     * The calling thread takes part as the main search thread.
+     *
+     * @param root Position to search; must have at least one legal move for a best move
+     * @param limits Depth, time and node limits
+     * @param onIteration Called on the calling thread after every completed depth
+     * @return Result of the deepest completed iteration
+     */
+    SearchInfo search(const Position& root, const SearchLimits& limits,
+                      const IterationCallback& onIteration = IterationCallback());
+
+    /**
+     * @brief Asks a running search to finish; callable from any thread
+     * The search returns within a few thousand nodes.
+     */
+    void stop() { stopFlag.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Forgets killers and history, e.g. when a new game starts
+     */
+    void clearHistory();
+
+    /**
+     * @brief Evaluates with a network instead of the hand-written evaluation
+     * Must not be called during a search.
+     *
+     * @param network Loaded network that outlives the engine, NULL for the hand-written evaluation
+     */
+    void setNetwork(const NnueNetwork* network);
+
+    /**
+     * @brief Probes endgame tablebases inside the tree
+     * Positions are probed right after a capture, when they are small enough.
+     * Must not be called during a search.
+     *
+     * @param tablebases Tables that outlive the engine, NULL to stop probing
+     */
+    void setTablebases(Tablebases* tablebases);
+
+private:
+    struct Worker;
+
+    void runWorker(Worker& worker, const IterationCallback* onIteration);
+    int searchNode(Worker& worker, int alpha, int beta, int depth, int ply, bool nullAllowed);
+    int quiescence(Worker& worker, int alpha, int beta, int ply);
+    void checkLimits(Worker& worker);
+    uint64_t totalNodes() const;
+    uint64_t totalTbHits() const;
+    int64_t elapsedMs() const;
+
+    TranspositionTable& table;
+    const NnueNetwork* network;
+    Tablebases* tablebases;
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::atomic<bool> stopFlag;
+    SearchLimits limits;
+    int64_t startTime;
+    SearchInfo result;
+};
+
+#endif
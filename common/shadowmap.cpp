@@ -0,0 +1,110 @@
+/*
+Description:
+Shadow map layers and the depth-only pass that fills them.
+*/
+
+#include <stdio.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shadowmap.hpp"
+#include "shader.hpp"
+
+ShadowMap::ShadowMap() : programID(0), LightMatrixID(0), mapSize(0), previousFramebuffer(0) {
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        framebuffers[i] = 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        previousViewport[i] = 0;
+    }
+}
+
+ShadowMap::~ShadowMap() {
+    release();
+}
+
+bool ShadowMap::init(int size) {
+    release();
+    programID = LoadShaders("shaders/Shadow.vertexshader", "shaders/Shadow.fragmentshader");
+    if (programID == 0) {
+        return false;
+    }
+    LightMatrixID = glGetUniformLocation(programID, "LightVP");
+    mapSize = size;
+
+    glGenFramebuffers(LAYER_COUNT, framebuffers);
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        glBindTexture(GL_TEXTURE_2D, depthTextures[i].create(GPU_SHADOWS));
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        depthTextures[i].updateSize();
+        // Linear filtering of a comparison sampler gives a 2x2 PCF per tap for free
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextures[i].id(), 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Error: Incomplete shadow map framebuffer (0x%x)\n", status);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            release();
+            return false;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void ShadowMap::release() {
+    if (framebuffers[0]) {
+        glDeleteFramebuffers(LAYER_COUNT, framebuffers);
+    }
+    glDeleteProgram(programID);
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        framebuffers[i] = 0;
+        depthTextures[i].reset();
+    }
+    programID = 0;
+    mapSize = 0;
+}
+
+glm::mat4 ShadowMap::lightMatrix(const glm::vec3& lightPosition) {
+    // Looking down -Y, with ranks running up the map like on screen
+    glm::mat4 view = glm::lookAt(lightPosition, lightPosition - glm::vec3(0.0f, 1.0f, 0.0f),
+                                 glm::vec3(0.0f, 0.0f, -1.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(115.0f), 1.0f, 1.0f, 100.0f);
+    return projection * view;
+}
+
+void ShadowMap::beginLayer(Layer layer, const glm::mat4& lightViewProjection) {
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    if (layer == BOARDS) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[layer]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[layer - 1]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[layer]);
+        glBlitFramebuffer(0, 0, mapSize, mapSize, 0, 0, mapSize, mapSize, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[layer]);
+    }
+    glViewport(0, 0, mapSize, mapSize);
+    // Only back faces go into the map, so lit front faces never shadow themselves
+    glCullFace(GL_FRONT);
+
+    glUseProgram(programID);
+    glUniformMatrix4fv(LightMatrixID, 1, GL_FALSE, &lightViewProjection[0][0]);
+}
+
+void ShadowMap::endLayer() {
+    glCullFace(GL_BACK);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
@@ -0,0 +1,88 @@
+/*
+Description:
+Shadow map of the scene light, kept as three cached depth layers that build
+on each other: the boards, then the pieces at rest, then the pieces moving.
+A layer starts as a copy of the one below and only its own geometry is drawn
+on top, so a piece sliding across the board costs a depth copy and the draw
+of that one piece, and nothing is redrawn while nothing moves. The scene
+samples the highest layer that has content.
+*/
+
+#ifndef SHADOWMAP_HPP
+#define SHADOWMAP_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "gpuresource.hpp"
+
+/// Default width and height of every shadow map layer in texels
+const int SHADOW_MAP_SIZE = 2048;
+
+/**
+ * @brief Cached depth layers rendered from the light
+ */
+class ShadowMap {
+public:
+    enum Layer { BOARDS, RESTING, MOVING, LAYER_COUNT };
+
+    ShadowMap();
+    ~ShadowMap();
+
+    ShadowMap(const ShadowMap&) = delete;
+    ShadowMap& operator=(const ShadowMap&) = delete;
+
+    /**
+     * @brief Creates the layers and compiles the depth-only shader
+     * Requires a current GL context.
+     *
+     * @param size Width and height of each layer in texels
+     * @return true if the shader loaded and every layer is complete
+     */
+    bool init(int size = SHADOW_MAP_SIZE);
+
+    /**
+     * @brief Deletes the layers and the shader
+     */
+    void release();
+
+    /**
+     * @brief View projection matrix of a point light looking straight down
+     * Covers about 40 units around the point below the light, the centre board.
+     */
+    static glm::mat4 lightMatrix(const glm::vec3& lightPosition);
+
+    /**
+     * @brief Binds a layer for drawing depth, starting from a copy of the layer below
+     * The BOARDS layer starts cleared. Draw with the instance attributes bound,
+     * then call endLayer().
+     *
+     * @param layer Layer to render
+     * @param lightViewProjection Matrix from lightMatrix()
+     */
+    void beginLayer(Layer layer, const glm::mat4& lightViewProjection);
+
+    /**
+     * @brief Restores the framebuffer, viewport and culling in place before beginLayer()
+     */
+    void endLayer();
+
+    /**
+     * @brief Depth texture of a layer, set up for hardware depth comparison
+     */
+    GLuint texture(Layer layer) const { return depthTextures[layer].id(); }
+
+    bool ready() const { return programID != 0; }
+
+private:
+    GLuint programID;
+    GLuint LightMatrixID;
+    GLuint framebuffers[LAYER_COUNT];
+    GpuTexture depthTextures[LAYER_COUNT];
+    int mapSize;
+    // State restored by endLayer()
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+Description:
+Simulation thread loop and piece placement. Each tick consumes input, updates
+the camera, makes the moves asked for since the last tick, advances their
+animations and writes a complete frame packet into the producer slot of the
+triple buffer before publishing it to the render thread.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include "simulation.hpp"
+#include "controls.hpp"
+#include "boardlayout.hpp"
+#include "movegen.hpp"
+
+namespace {
+    int lampThreads() {
+        // Leave the other cores to rendering and analysis
+        int threads = (int)std::thread::hardware_concurrency() / 2;
+        return std::max(1, std::min(threads, 4));
+    }
+}
+
+Simulation::Simulation(double tickRate)
+    : running(false), tickInterval(1.0 / tickRate), frameCounter(0), layoutVersion(0), staticVersion(0),
+      startTime(std::chrono::steady_clock::now()), moveDuration(MOVE_ANIMATION_SECONDS), staticDirty(false),
+      clusterer(lampThreads()) {
+    setBoards(std::vector<std::string>(1, START_FEN));
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::setBoards(const std::vector<std::string>& fens) {
+    boards.assign(fens.size(), Position());
+    for (size_t i = 0; i < fens.size(); i++) {
+        if (!boards[i].setFromFen(fens[i].c_str())) {
+            fprintf(stderr, "Invalid FEN for board %zu, using the start position\n", i);
+        }
+    }
+    layoutBoards();
+}
+
+void Simulation::playMove(int board, Move move) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    BoardCommand command;
+    command.board = board;
+    command.move = move;
+    commands.push_back(command);
+}
+
+void Simulation::setBoardPosition(int board, const std::string& fen) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    BoardCommand command;
+    command.board = board;
+    command.move = NO_MOVE;
+    command.fen = fen;
+    commands.push_back(command);
+}
+
+void Simulation::setLamps(int count) {
+    // Spread over the board grid
+    int columns = 1;
+    while (columns * columns < (int)boards.size()) {
+        columns++;
+    }
+    lampRest = hallLamps(std::max(0, count), columns * BOARD_PITCH);
+    lamps = lampRest;
+}
+
+void Simulation::start() {
+    if (running.load()) {
+        return;
+    }
+    // Make sure the render thread has something to draw on its first frame
+    step();
+    running.store(true);
+    worker = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop() {
+    running.store(false);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+const FramePacket& Simulation::acquireFrame() {
+    packets.update();
+    return packets.readBuffer();
+}
+
+double Simulation::elapsedSeconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void Simulation::run() {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration interval =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(tickInterval));
+
+    Clock::time_point nextTick = Clock::now();
+    while (running.load(std::memory_order_relaxed)) {
+        step();
+
+        nextTick += interval;
+        Clock::time_point now = Clock::now();
+        if (nextTick < now) {
+            // Fell behind, do not try to catch up with a burst of ticks
+            nextTick = now;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Simulation::step() {
+    double now = elapsedSeconds();
+    applyCommands(now);
+    animate(now);
+    if (staticDirty) {
+        pieceInstances.clear();
+        for (size_t i = 0; i < boardInstances.size(); i++) {
+            pieceInstances.insert(pieceInstances.end(), boardInstances[i].begin(), boardInstances[i].end());
+        }
+        staticDirty = false;
+        staticVersion++;
+        layoutVersion++;
+    }
+
+    FramePacket& packet = packets.writeBuffer();
+
+    computeMatricesFromInputs();
+    packet.ViewMatrix = getViewMatrix();
+    packet.ProjectionMatrix = getProjectionMatrix();
+    packet.inputTime = getCameraInputTime();
+    packet.lightPosition = glm::vec3(0, 25, 0);
+    packet.lightEnabled = lightEnabled;
+    if (lamps.empty()) {
+        packet.pointLights.lights.clear();
+        packet.pointLights.ranges.clear();
+        packet.pointLights.indices.clear();
+    } else {
+        for (size_t i = 0; i < lamps.size(); i++) {
+            float phase = (float)i * 1.7f;
+            lamps[i].position = lampRest[i].position +
+                3.0f * glm::vec3(sinf(0.6f * (float)now + phase), 0.0f, cosf(0.5f * (float)now + phase));
+        }
+        clusterer.assign(lamps, packet.ViewMatrix, packet.ProjectionMatrix, packet.pointLights);
+    }
+    packet.frameNumber = ++frameCounter;
+    // Each slot of the triple buffer only needs a copy after the layout changed,
+    // and while pieces move only their tail of the instances is rewritten
+    if (packet.layoutVersion != layoutVersion) {
+        if (packet.staticVersion != staticVersion) {
+            packet.boards = boardMatrices;
+            packet.pieces = pieceInstances;
+            packet.staticVersion = staticVersion;
+        }
+        packet.pieces.resize(pieceInstances.size());
+        packet.restingPieces = pieceInstances.size();
+        packet.pieces.insert(packet.pieces.end(), animatedInstances.begin(), animatedInstances.end());
+        packet.layoutVersion = layoutVersion;
+    }
+
+    packets.publish();
+}
+
+void Simulation::layoutBoards() {
+    animator.clear();
+    animatedInstances.clear();
+    boardOffsets.clear();
+    boardMatrices.clear();
+    int count = (int)boards.size();
+    boardInstances.assign(count, std::vector<PieceInstance>());
+    for (int i = 0; i < count; i++) {
+        boardOffsets.push_back(boardGridOffset(i, count));
+        boardMatrices.push_back(boardModelMatrix(boardOffsets[i]));
+        placeBoard(i);
+    }
+    // Rebuilt right away, so a stopped simulation still publishes the new layout on start()
+    pieceInstances.clear();
+    for (int i = 0; i < count; i++) {
+        pieceInstances.insert(pieceInstances.end(), boardInstances[i].begin(), boardInstances[i].end());
+    }
+    staticDirty = false;
+    staticVersion++;
+    layoutVersion++;
+}
+
+void Simulation::placeBoard(int board) {
+    boardInstances[board].clear();
+    buildBoardInstances(boards[board], boardInstances[board], boardOffsets[board], animator.hiddenSquares(board));
+    for (PieceInstance& instance : boardInstances[board]) {
+        instance.board = board;
+    }
+    staticDirty = true;
+}
+
+void Simulation::applyCommands(double now) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        takenCommands.swap(commands);
+    }
+    if (takenCommands.empty()) {
+        return;
+    }
+    animator.setDuration(moveDuration.load());
+    for (size_t i = 0; i < takenCommands.size(); i++) {
+        const BoardCommand& command = takenCommands[i];
+        if (command.board < 0 || command.board >= (int)boards.size()) {
+            continue;
+        }
+        Position& position = boards[command.board];
+        if (!command.fen.empty()) {
+            if (!position.setFromFen(command.fen.c_str())) {
+                fprintf(stderr, "Invalid FEN for board %d, keeping its position\n", command.board);
+                continue;
+            }
+            animator.finishBoard(command.board);
+        } else {
+            MoveList legal;
+            generateLegalMoves(position, legal);
+            bool found = false;
+            for (int m = 0; m < legal.size() && !found; m++) {
+                found = legal[m] == command.move;
+            }
+            if (!found) {
+                fprintf(stderr, "Ignoring move %s, not legal on board %d\n", moveToUci(command.move).c_str(),
+                        command.board);
+                continue;
+            }
+            position.makeMove(command.move);
+            animator.addMove(command.board, position, boardOffsets[command.board], now);
+        }
+        placeBoard(command.board);
+    }
+    takenCommands.clear();
+}
+
+void Simulation::animate(double now) {
+    if (animator.activeTracks() == 0 && animatedInstances.empty()) {
+        return;
+    }
+    animatedInstances.clear();
+    landedBoards.clear();
+    animator.evaluate(now, animatedInstances, landedBoards);
+    for (size_t i = 0; i < landedBoards.size(); i++) {
+        placeBoard(landedBoards[i]);
+    }
+    layoutVersion++;
+}
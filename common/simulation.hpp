@@ -0,0 +1,142 @@
+/*
+Description:
+Simulation thread. Runs input consumption, camera math and piece placement on
+its own thread and publishes the result as frame packets through a triple
+buffer, so scene work overlaps GL submission and swap waits on the main thread.
+Moves played on a board are animated here too; only the boards they touch
+are re-placed, and the moving pieces are appended to the packet each tick.
+*/
+
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "animation.hpp"
+#include "framepacket.hpp"
+#include "lighting.hpp"
+#include "position.hpp"
+#include "triplebuffer.hpp"
+
+/**
+ * @brief Owns the simulation thread and the packets it produces
+ */
+class Simulation {
+public:
+    /**
+     * @brief Creates a stopped simulation
+     * @param tickRate Simulation updates per second
+     */
+    explicit Simulation(double tickRate = 240.0);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    /**
+     * @brief Sets the boards to simulate, laid out in a grid around the origin
+     * Must be called while the thread is stopped. Invalid FENs fall back to
+     * the starting position.
+     *
+     * @param fens FEN of each board; the piece placement alone is enough
+     */
+    void setBoards(const std::vector<std::string>& fens);
+
+    /**
+     * @brief Plays a move on one board with an animation
+     * Can be called from any thread, running or not; the move is made on the
+     * next tick, and ignored if it is not legal on that board by then.
+     */
+    void playMove(int board, Move move);
+
+    /**
+     * @brief Replaces the position of one board without an animation
+     * Like playMove(), can be called while the thread runs.
+     */
+    void setBoardPosition(int board, const std::string& fen);
+
+    /**
+     * @brief Sets how long the moves played from now on take, in seconds
+     */
+    void setMoveDuration(float seconds) { moveDuration.store(seconds); }
+
+    /**
+     * @brief Hangs lamps over the boards, swaying slightly, in addition to the scene light
+     * Must be called while the thread is stopped, after setBoards().
+     *
+     * @param count Number of lamps, 0 for none
+     */
+    void setLamps(int count);
+
+    /**
+     * @brief Publishes a first packet synchronously and starts the thread
+     */
+    void start();
+
+    /**
+     * @brief Stops and joins the thread
+     */
+    void stop();
+
+    /**
+     * @brief Gives the render thread the newest packet
+     * Must only be called from the render thread.
+     *
+     * @return Newest published packet, valid until the next call
+     */
+    const FramePacket& acquireFrame();
+
+private:
+    /// A move to play or, with a FEN, a position to set
+    struct BoardCommand {
+        int board;
+        Move move;
+        std::string fen;
+    };
+
+    void run();
+    void step();
+    void layoutBoards();
+    void applyCommands(double now);
+    void animate(double now);
+    void placeBoard(int board);
+    double elapsedSeconds() const;
+
+    TripleBuffer<FramePacket> packets;
+    std::thread worker;
+    std::atomic<bool> running;
+    double tickInterval;
+    unsigned long frameCounter;
+    unsigned long layoutVersion;
+    unsigned long staticVersion;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<Position> boards;
+
+    std::mutex commandMutex;
+    std::vector<BoardCommand> commands;      ///< Guarded by commandMutex
+    std::vector<BoardCommand> takenCommands; ///< Simulation thread only
+    std::atomic<float> moveDuration;
+
+    // Pieces at rest only change when a move is made or lands, so they are
+    // built per board and joined when one changes
+    std::vector<glm::vec3> boardOffsets;
+    std::vector<glm::mat4> boardMatrices;
+    std::vector<std::vector<PieceInstance> > boardInstances;
+    std::vector<PieceInstance> pieceInstances;
+    bool staticDirty;
+
+    MoveAnimator animator;
+    std::vector<PieceInstance> animatedInstances;
+    std::vector<int> landedBoards;
+
+    std::vector<PointLight> lampRest;   ///< Lamp positions at rest
+    std::vector<PointLight> lamps;      ///< Lamps of the current tick
+    LightClusterer clusterer;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+Description:
+Lock-free single-producer single-consumer ring buffer of fixed capacity. Each
+side owns one index and only reads the other's, so pushing and popping are a
+copy plus one release store; a full queue makes push() fail instead of
+waiting, which keeps a fast producer from ever stalling the consumer.
+*/
+
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <stddef.h>
+#include <atomic>
+
+/**
+ * @brief Bounded queue handing values of type T from one producer thread to one consumer thread
+ * @tparam Capacity Power of two; one slot is kept free to tell full from empty
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0 && Capacity >= 2, "capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Appends a value; producer thread only
+     * @return false if the queue is full
+     */
+    bool push(const T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        size_t next = (position + 1) & (Capacity - 1);
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots[position] = value;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest value; consumer thread only
+     * @return false if the queue is empty
+     */
+    bool pop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[position];
+        head.store((position + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots[Capacity];
+    // On separate cache lines so the two threads do not share one
+    alignas(64) std::atomic<size_t> head;  ///< Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail;  ///< Next slot to push, written by the producer
+};
+
+#endif
@@ -0,0 +1,482 @@
+/*
+Description:
+Tablebase probing through an LRU of lazily mapped files, and the retrograde
+generator for pawnless tables.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "tablebase.hpp"
+#include "movegen.hpp"
+
+namespace {
+    /// Piece letters in signature order, strongest first
+    const char* const SIGNATURE_ORDER = "KQRBNP";
+    const int SIGNATURE_TYPES[6] = { KING, QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+
+    const size_t HEADER_SIZE = 16;
+    const uint8_t FORMAT_VERSION = 1;
+    const char* const WDL_EXTENSION = ".ctbw";
+    const char* const DTZ_EXTENSION = ".ctbz";
+
+    /// WDL entry codes; CODE_UNKNOWN only exists while generating
+    enum { CODE_LOSS, CODE_DRAW, CODE_WIN, CODE_ILLEGAL, CODE_UNKNOWN };
+
+    std::string sideLetters(const Position& position, int color) {
+        std::string letters;
+        for (int i = 0; i < 6; i++) {
+            letters.append(popCount(position.pieces(color, SIGNATURE_TYPES[i])), SIGNATURE_ORDER[i]);
+        }
+        return letters;
+    }
+
+    /**
+     * @brief Piece counts of one side in signature order, four bits each, king highest
+     * Of two sides with as many pieces the larger value is the stronger one, as
+     * with compareSides() on their letters.
+     */
+    uint32_t sideMaterial(const Position& position, int color) {
+        uint32_t material = 0;
+        for (int i = 0; i < 6; i++) {
+            material = (material << 4) | (uint32_t)popCount(position.pieces(color, SIGNATURE_TYPES[i]));
+        }
+        return material;
+    }
+
+    /// Positive if side a is stronger than side b, from their sideMaterial()
+    int compareMaterial(uint32_t a, uint32_t b) {
+        int countA = 0, countB = 0;
+        for (int shift = 0; shift < 24; shift += 4) {
+            countA += (a >> shift) & 15;
+            countB += (b >> shift) & 15;
+        }
+        if (countA != countB) {
+            return countA > countB ? 1 : -1;
+        }
+        return a > b ? 1 : a < b ? -1 : 0;
+    }
+
+    /// Positive if side a is stronger than side b, both in signature order
+    int compareSides(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) {
+            return a.size() > b.size() ? 1 : -1;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i] != b[i]) {
+                return strchr(SIGNATURE_ORDER, a[i]) < strchr(SIGNATURE_ORDER, b[i]) ? 1 : -1;
+            }
+        }
+        return 0;
+    }
+
+    bool bySignatureOrder(char a, char b) {
+        return strchr(SIGNATURE_ORDER, a) < strchr(SIGNATURE_ORDER, b);
+    }
+
+    /// Signature with each side sorted and the stronger side first
+    std::string makeSignature(std::string a, std::string b) {
+        std::sort(a.begin(), a.end(), bySignatureOrder);
+        std::sort(b.begin(), b.end(), bySignatureOrder);
+        return compareSides(a, b) >= 0 ? a + "v" + b : b + "v" + a;
+    }
+
+    /**
+     * @brief Table index of a position
+     * @param flip Swap colours and mirror the board, for material stored the other way round
+     */
+    uint64_t tableIndex(const Position& position, bool flip) {
+        int first = flip ? BLACK : WHITE;
+        uint64_t index = (uint64_t)(position.sideToMove() ^ first);
+        for (int color = first, side = 0; side < 2; color ^= 1, side++) {
+            for (int i = 0; i < 6; i++) {
+                for (Bitboard b = position.pieces(color, SIGNATURE_TYPES[i]); b; ) {
+                    int square = popLsb(b);
+                    index = index * 64 + (uint64_t)(flip ? square ^ 56 : square);
+                }
+            }
+        }
+        return index;
+    }
+
+    bool onlyKings(const Position& position) {
+        return popCount(position.occupied()) == 2;
+    }
+
+    uint64_t entryCount(int pieceCount) {
+        return 2ull << (6 * pieceCount);
+    }
+
+    size_t tableSize(int pieceCount, bool dtz) {
+        uint64_t entries = entryCount(pieceCount);
+        return HEADER_SIZE + (size_t)(dtz ? entries : (entries + 3) / 4);
+    }
+
+    int signaturePieces(const std::string& signature) {
+        return (int)signature.size() - 1;
+    }
+
+    void makeHeader(uint8_t* header, const std::string& signature, bool dtz) {
+        memset(header, 0, HEADER_SIZE);
+        memcpy(header, dtz ? "CTBZ" : "CTBW", 4);
+        header[4] = FORMAT_VERSION;
+        header[5] = (uint8_t)signaturePieces(signature);
+        memcpy(header + 8, signature.c_str(), signature.size());
+    }
+
+    bool validTable(const MappedFile& file, const std::string& signature, bool dtz) {
+        uint8_t header[HEADER_SIZE];
+        makeHeader(header, signature, dtz);
+        return file.size() == tableSize(signaturePieces(signature), dtz) &&
+               memcmp(file.data(), header, HEADER_SIZE) == 0;
+    }
+
+    /**
+     * @brief Parses a signature into pieces, white (the first side) first
+     * @return false unless it is two sides of one king plus up to the maximum pieces
+     */
+    bool parseSignature(const std::string& signature, int* pieces, int& count) {
+        size_t split = signature.find('v');
+        if (split == std::string::npos || signature.find('v', split + 1) != std::string::npos ||
+            signaturePieces(signature) > TABLEBASE_MAX_PIECES) {
+            return false;
+        }
+        count = 0;
+        for (size_t i = 0; i < signature.size(); i++) {
+            if (i == split) {
+                continue;
+            }
+            const char* letter = strchr(SIGNATURE_ORDER, signature[i]);
+            if (!letter || !*letter) {
+                return false;
+            }
+            int color = i < split ? WHITE : BLACK;
+            bool sideStart = i == 0 || i == split + 1;
+            if ((signature[i] == 'K') != sideStart) {
+                return false;
+            }
+            pieces[count++] = makePiece(color, SIGNATURE_TYPES[letter - SIGNATURE_ORDER]);
+        }
+        return true;
+    }
+
+    bool fileExists(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file) {
+            fclose(file);
+        }
+        return file != NULL;
+    }
+
+    bool writeTable(const std::string& path, const std::string& signature, bool dtz,
+                    const std::vector<uint8_t>& data) {
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out) {
+            fprintf(stderr, "Could not write %s\n", path.c_str());
+            return false;
+        }
+        uint8_t header[HEADER_SIZE];
+        makeHeader(header, signature, dtz);
+        bool written = fwrite(header, HEADER_SIZE, 1, out) == 1 &&
+                       fwrite(&data[0], data.size(), 1, out) == 1;
+        return fclose(out) == 0 && written;
+    }
+
+    struct Update {
+        uint64_t index;
+        uint8_t code;
+        uint8_t dtz;
+    };
+
+    /// Source of cache generations, never 0 and never shared by two Tablebases
+    std::atomic<uint64_t> nextGeneration(1);
+
+    /**
+     * @brief Tables one thread has looked up, by material key
+     * Valid while its generation is the probed Tablebases' current one; a null
+     * file is a table known to be missing.
+     */
+    struct ThreadCache {
+        uint64_t generation;
+        std::map<uint64_t, std::shared_ptr<MappedFile> > files;
+
+        ThreadCache() : generation(0) {}
+    };
+
+    thread_local ThreadCache threadCache;
+}
+
+Tablebases::Tablebases()
+    : maxMapped(8), generation(nextGeneration.fetch_add(1)), probes(0), hits(0), maps(0), evictions(0) {}
+
+void Tablebases::setPath(const std::string& tableDirectory, int maxMappedFiles) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    directory = tableDirectory;
+    maxMapped = maxMappedFiles > 1 ? (size_t)maxMappedFiles : 1;
+    recent.clear();
+    byName.clear();
+    missing.clear();
+    generation.store(nextGeneration.fetch_add(1), std::memory_order_release);
+    maps.store(0);
+    evictions.store(0);
+}
+
+bool Tablebases::canProbe(const Position& position) const {
+    return popCount(position.occupied()) <= TABLEBASE_MAX_PIECES && position.castlingRights() == 0 &&
+           position.epSquare() == NO_SQUARE;
+}
+
+std::shared_ptr<MappedFile> Tablebases::acquire(const std::string& name) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::map<std::string, std::list<CachedFile>::iterator>::iterator found = byName.find(name);
+    if (found != byName.end()) {
+        recent.splice(recent.begin(), recent, found->second);
+        return found->second->file;
+    }
+    if (missing.count(name)) {
+        return std::shared_ptr<MappedFile>();
+    }
+
+    // Mapped on first use, so unused tables cost nothing
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    std::string signature = name.substr(0, name.find('.'));
+    bool dtz = name.compare(name.size() - 5, 5, DTZ_EXTENSION) == 0;
+    if (!file->open((directory + "/" + name).c_str(), MappedFile::ACCESS_RANDOM)) {
+        missing.insert(name);
+        return std::shared_ptr<MappedFile>();
+    }
+    if (!validTable(*file, signature, dtz)) {
+        fprintf(stderr, "%s/%s is not a valid table\n", directory.c_str(), name.c_str());
+        missing.insert(name);
+        return std::shared_ptr<MappedFile>();
+    }
+    maps.fetch_add(1, std::memory_order_relaxed);
+
+    CachedFile entry = { name, file };
+    recent.push_front(entry);
+    byName[name] = recent.begin();
+    while (recent.size() > maxMapped) {
+        byName.erase(recent.back().name);
+        recent.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+        generation.store(nextGeneration.fetch_add(1), std::memory_order_release);
+    }
+    return file;
+}
+
+bool Tablebases::lookup(const Position& position, const char* extension, int& value) {
+    bool dtz = strcmp(extension, DTZ_EXTENSION) == 0;
+    uint32_t white = sideMaterial(position, WHITE);
+    uint32_t black = sideMaterial(position, BLACK);
+    bool flip = compareMaterial(white, black) < 0;
+    uint64_t key = ((uint64_t)white << 25) | ((uint64_t)black << 1) | (dtz ? 1 : 0);
+
+    // Tables this thread already looked up need neither the lock nor a file name.
+    // The generation is read before acquire(), so an eviction racing with it
+    // only costs this thread one more trip through the lock.
+    uint64_t current = generation.load(std::memory_order_acquire);
+    if (threadCache.generation != current) {
+        threadCache.files.clear();
+        threadCache.generation = current;
+    }
+    std::map<uint64_t, std::shared_ptr<MappedFile> >::iterator cached = threadCache.files.find(key);
+    if (cached == threadCache.files.end()) {
+        std::string whiteLetters = sideLetters(position, WHITE);
+        std::string blackLetters = sideLetters(position, BLACK);
+        std::string name = (flip ? blackLetters + "v" + whiteLetters : whiteLetters + "v" + blackLetters) + extension;
+        cached = threadCache.files.insert(std::make_pair(key, acquire(name))).first;
+    }
+    const MappedFile* file = cached->second.get();
+    if (!file) {
+        return false;
+    }
+    uint64_t index = tableIndex(position, flip);
+    const uint8_t* data = file->data() + HEADER_SIZE;
+    if (dtz) {
+        value = data[index];
+    } else {
+        value = (data[index / 4] >> (2 * (index % 4))) & 3;
+    }
+    return true;
+}
+
+bool Tablebases::probeWdl(const Position& position, int& wdl) {
+    probes.fetch_add(1, std::memory_order_relaxed);
+    if (!canProbe(position)) {
+        return false;
+    }
+    int code = CODE_DRAW;
+    if (!onlyKings(position) && (!lookup(position, WDL_EXTENSION, code) || code == CODE_ILLEGAL)) {
+        return false;
+    }
+    hits.fetch_add(1, std::memory_order_relaxed);
+    wdl = code - CODE_DRAW;
+    return true;
+}
+
+bool Tablebases::probeDtz(const Position& position, int& dtz) {
+    int wdl;
+    if (!probeWdl(position, wdl)) {
+        return false;
+    }
+    int plies = 0;
+    if (wdl != WDL_DRAW && !lookup(position, DTZ_EXTENSION, plies)) {
+        return false;
+    }
+    dtz = wdl * plies;
+    return true;
+}
+
+bool generateTablebase(const char* directory, const char* signature) {
+    int pieces[TABLEBASE_MAX_PIECES];
+    int count;
+    std::string name(signature);
+    if (!parseSignature(name, pieces, count)) {
+        fprintf(stderr, "Invalid material signature %s\n", signature);
+        return false;
+    }
+    std::string white = name.substr(0, name.find('v'));
+    std::string black = name.substr(name.find('v') + 1);
+    if (makeSignature(white, black) != name) {
+        fprintf(stderr, "Write %s with the stronger side first, pieces in KQRBN order\n", signature);
+        return false;
+    }
+    if (name.find('P') != std::string::npos) {
+        fprintf(stderr, "%s: only pawnless tables can be generated\n", signature);
+        return false;
+    }
+
+    // Captures lead into smaller tables, which have to exist first
+    for (int i = 0; i < count; i++) {
+        if (pieceType(pieces[i]) == KING) {
+            continue;
+        }
+        std::string w = white;
+        std::string b = black;
+        std::string& side = pieceColor(pieces[i]) == WHITE ? w : b;
+        int letter = 0;
+        while (SIGNATURE_TYPES[letter] != pieceType(pieces[i])) {
+            letter++;
+        }
+        side.erase(side.find(SIGNATURE_ORDER[letter]), 1);
+        std::string reduced = makeSignature(w, b);
+        if (reduced != "KvK" && !fileExists(std::string(directory) + "/" + reduced + WDL_EXTENSION) &&
+            !generateTablebase(directory, reduced.c_str())) {
+            return false;
+        }
+    }
+    Tablebases captures;
+    captures.setPath(directory, 4);
+
+    uint64_t perSide = entryCount(count) / 2;
+    uint64_t total = entryCount(count);
+    std::vector<uint8_t> codes(total, CODE_UNKNOWN);
+    std::vector<uint8_t> distances(total, 0);
+    // Best result a capture reaches, from the side to move's view; WDL_LOSS - 1 if none
+    std::vector<int8_t> captureResult(total, WDL_LOSS - 1);
+    Position position;
+    int squares[TABLEBASE_MAX_PIECES];
+
+    // Pass 0: illegal positions, mates, stalemates and captures into smaller tables
+    for (uint64_t index = 0; index < total; index++) {
+        uint64_t rest = index % perSide;
+        for (int i = count - 1; i >= 0; i--) {
+            squares[i] = (int)(rest & 63);
+            rest >>= 6;
+        }
+        if (!position.setFromPieces(pieces, squares, count, (int)(index / perSide))) {
+            codes[index] = CODE_ILLEGAL;
+            continue;
+        }
+        MoveList list;
+        generateLegalMoves(position, list);
+        if (list.size() == 0) {
+            codes[index] = position.inCheck() ? CODE_LOSS : CODE_DRAW;
+            continue;
+        }
+        int best = WDL_LOSS - 1;
+        for (int i = 0; i < list.size(); i++) {
+            if (!isCapture(list[i])) {
+                continue;
+            }
+            position.makeMove(list[i]);
+            int childWdl;
+            bool found = captures.probeWdl(position, childWdl);
+            position.unmakeMove();
+            if (!found) {
+                fprintf(stderr, "%s: missing table after a capture\n", signature);
+                return false;
+            }
+            best = -childWdl > best ? -childWdl : best;
+        }
+        if (best == WDL_WIN) {
+            codes[index] = CODE_WIN;
+            distances[index] = 1;
+        }
+        captureResult[index] = (int8_t)best;
+    }
+
+    // Later passes: a win needs one move to a lost position, a loss needs every move
+    // to lose. Updates are applied after each pass, so pass n finds the distance n results.
+    for (;;) {
+        std::vector<Update> updates;
+        for (uint64_t index = 0; index < total; index++) {
+            if (codes[index] != CODE_UNKNOWN) {
+                continue;
+            }
+            uint64_t rest = index % perSide;
+            for (int i = count - 1; i >= 0; i--) {
+                squares[i] = (int)(rest & 63);
+                rest >>= 6;
+            }
+            position.setFromPieces(pieces, squares, count, (int)(index / perSide));
+            MoveList list;
+            generateLegalMoves(position, list);
+
+            int fastestWin = 256;
+            int slowestLoss = captureResult[index] == WDL_LOSS ? 1 : 0;
+            bool allLose = captureResult[index] <= WDL_LOSS;
+            for (int i = 0; i < list.size(); i++) {
+                if (isCapture(list[i])) {
+                    continue;
+                }
+                position.makeMove(list[i]);
+                uint64_t child = tableIndex(position, false);
+                position.unmakeMove();
+                int distance = distances[child] + 1;
+                if (codes[child] == CODE_LOSS) {
+                    fastestWin = distance < fastestWin ? distance : fastestWin;
+                } else if (codes[child] == CODE_WIN) {
+                    slowestLoss = distance > slowestLoss ? distance : slowestLoss;
+                } else {
+                    allLose = false;
+                }
+            }
+            if (fastestWin < 256) {
+                Update update = { index, (uint8_t)CODE_WIN, (uint8_t)(fastestWin < 255 ? fastestWin : 255) };
+                updates.push_back(update);
+            } else if (allLose) {
+                Update update = { index, (uint8_t)CODE_LOSS, (uint8_t)(slowestLoss < 255 ? slowestLoss : 255) };
+                updates.push_back(update);
+            }
+        }
+        if (updates.empty()) {
+            break;
+        }
+        for (size_t i = 0; i < updates.size(); i++) {
+            codes[updates[i].index] = updates[i].code;
+            distances[updates[i].index] = updates[i].dtz;
+        }
+    }
+
+    std::vector<uint8_t> wdl((total + 3) / 4, 0);
+    for (uint64_t index = 0; index < total; index++) {
+        int code = codes[index] == CODE_UNKNOWN ? (int)CODE_DRAW : (int)codes[index];
+        wdl[index / 4] |= (uint8_t)(code << (2 * (index % 4)));
+    }
+    std::string base = std::string(directory) + "/" + name;
+    return writeTable(base + WDL_EXTENSION, name, false, wdl) &&
+           writeTable(base + DTZ_EXTENSION, name, true, distances);
+}
@@ -0,0 +1,134 @@
+/*
+Description:
+Endgame tablebases in the style of Syzygy: a WDL table (win/draw/loss, small,
+probed during search) and a DTZ table (plies to the next capture or mate,
+probed at the root) per material signature such as "KQvK". Files are mapped
+lazily on the first probe that needs them and kept in a small LRU, which
+bounds both the address space and the page cache the tables pin. Each probing
+thread also remembers the tables it has looked up, present or missing, by a
+numeric material key, so repeated probes take no lock and build no file name;
+an eviction invalidates those caches, and a thread lets go of evicted files on
+its next probe.
+
+The tables use their own uncompressed format, not the Syzygy one. Each file
+has a 16-byte header ("CTBW" or "CTBZ", version, piece count, two reserved
+bytes and the signature padded with zeros to 8 bytes) followed by one entry
+per (side to move, square of every piece) index:
+
+    index = side * 64^n + square[0] * 64^(n-1) + ... + square[n-1]
+
+with the pieces in signature order, the stronger side as white. WDL entries
+take 2 bits (loss, draw, win, illegal; four to a byte, lowest bits first),
+DTZ entries one byte, saturating at 255. Both are from the side to move's
+point of view and ignore the fifty-move rule.
+
+generateTablebase() builds pawnless tables by retrograde analysis; positions
+with castling rights or an en passant square are never probed.
+*/
+
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "mappedfile.hpp"
+#include "position.hpp"
+
+/// Largest piece count, kings included, that the index can address
+const int TABLEBASE_MAX_PIECES = 5;
+
+enum WdlScore { WDL_LOSS = -1, WDL_DRAW = 0, WDL_WIN = 1 };
+
+/**
+ * @brief Probes the tables in one directory; safe to use from many threads
+ */
+class Tablebases {
+public:
+    Tablebases();
+
+    Tablebases(const Tablebases&) = delete;
+    Tablebases& operator=(const Tablebases&) = delete;
+
+    /**
+     * @brief Sets the table directory and unmaps every open table
+     * Must not be called while other threads are probing.
+     *
+     * @param directory Directory holding the .ctbw and .ctbz files
+     * @param maxMappedFiles Files kept mapped at most, least recently used first out
+     */
+    void setPath(const std::string& directory, int maxMappedFiles = 8);
+
+    /**
+     * @brief Cheap filter before a probe: small enough, no castling or en passant
+     */
+    bool canProbe(const Position& position) const;
+
+    /**
+     * @brief Looks up win, draw or loss for the side to move
+     * @param wdl Set to a WdlScore on success
+     * @return false if no table covers the position
+     */
+    bool probeWdl(const Position& position, int& wdl);
+
+    /**
+     * @brief Looks up the distance to the next capture or mate
+     * @param dtz Set to the plies on success, positive if the side to move
+     *            wins, negative if it loses, 0 for draws and mated positions
+     * @return false if no table covers the position
+     */
+    bool probeDtz(const Position& position, int& dtz);
+
+    uint64_t probeCount() const { return probes.load(std::memory_order_relaxed); }
+    uint64_t hitCount() const { return hits.load(std::memory_order_relaxed); }
+    /// Files mapped since setPath(), including ones evicted since
+    uint64_t mapCount() const { return maps.load(std::memory_order_relaxed); }
+    uint64_t evictionCount() const { return evictions.load(std::memory_order_relaxed); }
+
+private:
+    struct CachedFile {
+        std::string name;
+        std::shared_ptr<MappedFile> file;
+    };
+
+    bool lookup(const Position& position, const char* extension, int& value);
+    std::shared_ptr<MappedFile> acquire(const std::string& name);
+
+    std::string directory;
+    size_t maxMapped;
+
+    // Open files, most recently used first, with an index by file name.
+    // Probes and thread caches hold a reference, so an evicted file stays
+    // mapped until the threads that used it probe again.
+    std::mutex cacheMutex;
+    std::list<CachedFile> recent;
+    std::map<std::string, std::list<CachedFile>::iterator> byName;
+    std::set<std::string> missing;
+    /// Changed by setPath() and every eviction; older thread caches start over
+    std::atomic<uint64_t> generation;
+
+    std::atomic<uint64_t> probes;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> maps;
+    std::atomic<uint64_t> evictions;
+};
+
+/**
+ * @brief Writes the WDL and DTZ tables of a pawnless material signature
+ * Tables for the material left after a capture are generated first when the
+ * directory does not have them yet. Each table is a few seconds for three
+ * pieces and several minutes for four.
+ *
+ * @param directory Output directory, which must exist
+ * @param signature Material such as "KRvKN", stronger side first
+ * @return true on success
+ */
+bool generateTablebase(const char* directory, const char* signature);
+
+#endif
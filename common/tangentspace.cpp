@@ -1,6 +1,8 @@
+#include <math.h>
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "parallelfor.hpp"
 #include "tangentspace.hpp"
 
 void computeTangentBasis(
@@ -12,62 +14,62 @@ void computeTangentBasis(
 	std::vector<glm::vec3> & tangents,
 	std::vector<glm::vec3> & bitangents
 ){
+	// Every triangle writes only its own three vertices, so blocks of
+	// triangles are independent and run in parallel
+	tangents.resize(vertices.size());
+	bitangents.resize(vertices.size());
+
+	parallelFor(vertices.size() / 3, 2048, [&](size_t firstTriangle, size_t endTriangle){
+		for (size_t i=3*firstTriangle; i<3*endTriangle; i+=3 ){
+
+			// Shortcuts for vertices
+			glm::vec3 & v0 = vertices[i+0];
+			glm::vec3 & v1 = vertices[i+1];
+			glm::vec3 & v2 = vertices[i+2];
+
+			// Shortcuts for UVs
+			glm::vec2 & uv0 = uvs[i+0];
+			glm::vec2 & uv1 = uvs[i+1];
+			glm::vec2 & uv2 = uvs[i+2];
+
+			// Edges of the triangle : postion delta
+			glm::vec3 deltaPos1 = v1-v0;
+			glm::vec3 deltaPos2 = v2-v0;
+
+			// UV delta
+			glm::vec2 deltaUV1 = uv1-uv0;
+			glm::vec2 deltaUV2 = uv2-uv0;
+
+			// Triangles with degenerate UVs get no tangent from them,
+			// the fallback below picks one
+			float determinant = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+			float r = fabsf(determinant) > 1e-12f ? 1.0f / determinant : 0.0f;
+			glm::vec3 tangent = (deltaPos1 * deltaUV2.y   - deltaPos2 * deltaUV1.y)*r;
+			glm::vec3 bitangent = (deltaPos2 * deltaUV1.x   - deltaPos1 * deltaUV2.x)*r;
+
+			// Set the same tangent for all three vertices of the triangle.
+			// They will be merged later, in vboindexer.cpp
+			for (size_t j=i; j<i+3; j++ ){
+				glm::vec3 & n = normals[j];
+
+				// Gram-Schmidt orthogonalize
+				glm::vec3 t = tangent - n * glm::dot(n, tangent);
+				if (glm::dot(t, t) < 1e-12f){
+					t = glm::cross(n, fabsf(n.y) < 0.9f ? glm::vec3(0,1,0) : glm::vec3(1,0,0));
+				}
+				t = glm::normalize(t);
+
+				// Calculate handedness
+				if (glm::dot(glm::cross(n, t), bitangent) < 0.0f){
+					t = t * -1.0f;
+				}
+
+				tangents[j] = t;
+				bitangents[j] = bitangent;
+			}
 
-	for (unsigned int i=0; i<vertices.size(); i+=3 ){
-
-		// Shortcuts for vertices
-		glm::vec3 & v0 = vertices[i+0];
-		glm::vec3 & v1 = vertices[i+1];
-		glm::vec3 & v2 = vertices[i+2];
-
-		// Shortcuts for UVs
-		glm::vec2 & uv0 = uvs[i+0];
-		glm::vec2 & uv1 = uvs[i+1];
-		glm::vec2 & uv2 = uvs[i+2];
-
-		// Edges of the triangle : postion delta
-		glm::vec3 deltaPos1 = v1-v0;
-		glm::vec3 deltaPos2 = v2-v0;
-
-		// UV delta
-		glm::vec2 deltaUV1 = uv1-uv0;
-		glm::vec2 deltaUV2 = uv2-uv0;
-
-		float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-		glm::vec3 tangent = (deltaPos1 * deltaUV2.y   - deltaPos2 * deltaUV1.y)*r;
-		glm::vec3 bitangent = (deltaPos2 * deltaUV1.x   - deltaPos1 * deltaUV2.x)*r;
-
-		// Set the same tangent for all three vertices of the triangle.
-		// They will be merged later, in vboindexer.cpp
-		tangents.push_back(tangent);
-		tangents.push_back(tangent);
-		tangents.push_back(tangent);
-
-		// Same thing for binormals
-		bitangents.push_back(bitangent);
-		bitangents.push_back(bitangent);
-		bitangents.push_back(bitangent);
-
-	}
-
-	// See "Going Further"
-	for (unsigned int i=0; i<vertices.size(); i+=1 )
-	{
-		glm::vec3 & n = normals[i];
-		glm::vec3 & t = tangents[i];
-		glm::vec3 & b = bitangents[i];
-		
-		// Gram-Schmidt orthogonalize
-		t = glm::normalize(t - n * glm::dot(n, t));
-		
-		// Calculate handedness
-		if (glm::dot(glm::cross(n, t), b) < 0.0f){
-			t = t * -1.0f;
 		}
-
-	}
+	});
 
 
 }
-
-
@@ -1,6 +1,15 @@
 #ifndef TANGENTSPACE_HPP
 #define TANGENTSPACE_HPP
 
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Per-vertex tangents and bitangents of an unindexed triangle list
+ * Tangents are orthogonalized against the normals, so tangents, bitangents
+ * and normals form the TBN basis that normal maps are expressed in. Runs in
+ * parallel over blocks of triangles. The outputs are resized to one entry per vertex.
+ */
 void computeTangentBasis(
 	// inputs
 	std::vector<glm::vec3> & vertices,
@@ -13,6 +13,7 @@ This file contains texture loading functionality with improvements including:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -199,6 +200,88 @@ GLuint loadChessTexture(const char* imagepath) {
 }
 
 
+/**
+ * @brief Loads a grayscale BMP height map as a tangent-space normal map
+ * The height is read from the first channel and flipped like loadBMP_custom,
+ * so the normal map lines up with the diffuse texture of the same model.
+ *
+ * @param imagepath Path to the BMP file
+ * @param strength Slope of the surface per unit of height per texel
+ * @return GLuint OpenGL texture identifier
+ */
+GLuint loadBumpAsNormalMap(const char* imagepath, float strength) {
+    printf("Reading height map %s\n", imagepath);
+
+    unsigned char header[54];
+    FILE* file = fopen(imagepath, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s\n", imagepath);
+        return 0;
+    }
+    if (fread(header, 1, 54, file) != 54 ||
+        header[0] != 'B' || header[1] != 'M' ||
+        *(int*)&(header[0x1E]) != 0 ||
+        *(int*)&(header[0x1C]) != 24) {
+
+        fprintf(stderr, "Error: Invalid BMP format\n");
+        fclose(file);
+        return 0;
+    }
+    unsigned int dataPos = *(int*)&(header[0x0A]);
+    int width  = *(int*)&(header[0x12]);
+    int height = *(int*)&(header[0x16]);
+    if (dataPos == 0) dataPos = 54;
+
+    // Rows are padded to four bytes in the file
+    const int rowSize = width * 3;
+    const int filePitch = (rowSize + 3) & ~3;
+    unsigned char* data = new unsigned char[rowSize * height];
+    fseek(file, dataPos, SEEK_SET);
+    bool complete = true;
+    for (int y = 0; y < height && complete; y++) {
+        complete = fread(&data[y * rowSize], 1, rowSize, file) == (size_t)rowSize;
+        fseek(file, filePitch - rowSize, SEEK_CUR);
+    }
+    fclose(file);
+    if (!complete) {
+        fprintf(stderr, "Error: %s is truncated\n", imagepath);
+        delete[] data;
+        return 0;
+    }
+    flipTextureY(data, width, height);
+
+    // Central differences of the height, wrapping like the texture does.
+    // Rows follow v and columns u, so x and y point along the tangent and bitangent.
+    unsigned char* normals = new unsigned char[rowSize * height];
+    for (int y = 0; y < height; y++) {
+        const unsigned char* up   = &data[((y + 1) % height) * rowSize];
+        const unsigned char* down = &data[((y + height - 1) % height) * rowSize];
+        const unsigned char* row  = &data[y * rowSize];
+        for (int x = 0; x < width; x++) {
+            int right = ((x + 1) % width) * 3;
+            int left  = ((x + width - 1) % width) * 3;
+            float dx = (row[right] - row[left]) / 255.0f * 0.5f * strength;
+            float dy = (up[x * 3] - down[x * 3]) / 255.0f * 0.5f * strength;
+            float inverseLength = 1.0f / sqrtf(dx * dx + dy * dy + 1.0f);
+            unsigned char* normal = &normals[y * rowSize + x * 3];
+            normal[0] = (unsigned char)((-dx * inverseLength * 0.5f + 0.5f) * 255.0f + 0.5f);
+            normal[1] = (unsigned char)((-dy * inverseLength * 0.5f + 0.5f) * 255.0f + 0.5f);
+            normal[2] = (unsigned char)((inverseLength * 0.5f + 0.5f) * 255.0f + 0.5f);
+        }
+    }
+    delete[] data;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, normals);
+    delete[] normals;
+
+    setTextureParameters(textureID);
+
+    return textureID;
+}
+
 
 #define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
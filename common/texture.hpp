@@ -40,6 +40,17 @@ GLuint loadBMP_custom(const char* imagepath);
  */
 GLuint loadChessTexture(const char* imagepath);
 
+/**
+ * @brief Loads a grayscale BMP height map and converts it to a normal map
+ * The normals are in tangent space, packed to RGB as n * 0.5 + 0.5, with
+ * the same Y-flipping as loadBMP_custom
+ *
+ * @param imagepath Path to the 24-bit BMP height map
+ * @param strength Slope per unit of height per texel, higher is bumpier
+ * @return GLuint OpenGL texture identifier, 0 if loading fails
+ */
+GLuint loadBumpAsNormalMap(const char* imagepath, float strength);
+
 /**
  * @brief Loads a DDS file and creates an OpenGL texture
  * Supports DXT1, DXT3, and DXT5 compression formats
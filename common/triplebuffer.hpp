@@ -0,0 +1,72 @@
+/*
+Description:
+Lock-free single-producer single-consumer triple buffer. The producer always has
+a private slot to write into and the consumer always has a private slot to read
+from; the third slot is exchanged atomically, so neither side ever waits on the
+other and the consumer always sees the newest complete value.
+*/
+
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+/**
+ * @brief Triple buffer handing values of type T from one producer thread to one consumer thread
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * @brief Slot owned by the producer; fill it, then call publish()
+     * @return Writable slot, holding whatever was written to it two publishes ago
+     */
+    T& writeBuffer() {
+        return slots[back];
+    }
+
+    /**
+     * @brief Makes the producer slot visible to the consumer and takes a new producer slot
+     */
+    void publish() {
+        unsigned previous = middle.exchange(back | FRESH_BIT, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    /**
+     * @brief Takes the newest published slot if one arrived since the last call
+     * @return true if readBuffer() now refers to a newer value
+     */
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        unsigned previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /**
+     * @brief Slot owned by the consumer, stable until the next update()
+     * @return Newest value taken by update()
+     */
+    const T& readBuffer() const {
+        return slots[front];
+    }
+
+private:
+    static const unsigned INDEX_MASK = 0x3;
+    static const unsigned FRESH_BIT = 0x4;
+
+    T slots[3];
+    std::atomic<unsigned> middle; ///< Shared slot index, FRESH_BIT set when unread
+    unsigned back;                ///< Producer-owned slot index
+    unsigned front;               ///< Consumer-owned slot index
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*
+Description:
+Transposition table storage, replacement and aligned (optionally huge page)
+allocation.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "tt.hpp"
+
+namespace {
+    const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    uint64_t packData(Move move, int score, int eval, int depth, int bound, unsigned generation) {
+        return (uint64_t)move |
+               ((uint64_t)(uint16_t)(int16_t)score << 16) |
+               ((uint64_t)(uint16_t)(int16_t)eval << 32) |
+               ((uint64_t)(depth & 0xFF) << 48) |
+               ((uint64_t)(bound & 3) << 56) |
+               ((uint64_t)generation << 58);
+    }
+
+    int dataDepth(uint64_t data) { return (int)((data >> 48) & 0xFF); }
+    int dataBound(uint64_t data) { return (int)((data >> 56) & 3); }
+    unsigned dataGeneration(uint64_t data) { return (unsigned)(data >> 58); }
+
+    void* allocateAligned(size_t bytes, size_t alignment) {
+#if defined(_WIN32)
+        return _aligned_malloc(bytes, alignment);
+#else
+        void* memory = NULL;
+        return posix_memalign(&memory, alignment, bytes) == 0 ? memory : NULL;
+#endif
+    }
+
+    void freeAligned(void* memory) {
+#if defined(_WIN32)
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+}
+
+TranspositionTable::TranspositionTable()
+    : buckets(NULL), bucketCount(0), hugePagesAdvised(false), generation(0) {}
+
+TranspositionTable::~TranspositionTable() {
+    freeMemory();
+}
+
+void TranspositionTable::freeMemory() {
+    if (buckets) {
+        freeAligned(buckets);
+    }
+    buckets = NULL;
+    bucketCount = 0;
+    hugePagesAdvised = false;
+}
+
+bool TranspositionTable::resize(size_t megabytes, bool hugePages) {
+    freeMemory();
+
+    size_t count = 1;
+    size_t maxCount = (megabytes ? megabytes : 1) * 1024 * 1024 / sizeof(Bucket);
+    while (count * 2 <= maxCount) {
+        count *= 2;
+    }
+    size_t bytes = count * sizeof(Bucket);
+
+    // Huge pages need the table to start on a huge page boundary
+    bool wantHugePages = hugePages && bytes >= HUGE_PAGE_SIZE;
+    buckets = (Bucket*)allocateAligned(bytes, wantHugePages ? HUGE_PAGE_SIZE : sizeof(Bucket));
+    if (!buckets) {
+        return false;
+    }
+    bucketCount = count;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (wantHugePages) {
+        // Only a hint: hugePageBytes() tells whether the kernel followed it
+        hugePagesAdvised = madvise(buckets, bytes, MADV_HUGEPAGE) == 0;
+    }
+#endif
+
+    generation = 0;
+    clear();
+    return true;
+}
+
+size_t TranspositionTable::hugePageBytes() const {
+    size_t huge = 0;
+#if defined(__linux__)
+    if (!buckets) {
+        return 0;
+    }
+    FILE* smaps = fopen("/proc/self/smaps", "r");
+    if (!smaps) {
+        return 0;
+    }
+    // Mapping headers start with "start-end"; field lines follow until the next header
+    uintptr_t table = (uintptr_t)buckets;
+    bool inTable = false;
+    char line[512];
+    while (fgets(line, sizeof(line), smaps)) {
+        unsigned long long start, end;
+        char dash;
+        if (sscanf(line, "%llx%c%llx", &start, &dash, &end) == 3 && dash == '-') {
+            if (inTable) {
+                break;
+            }
+            inTable = table >= start && table < end;
+            continue;
+        }
+        unsigned long long kilobytes;
+        if (inTable && sscanf(line, "AnonHugePages: %llu kB", &kilobytes) == 1) {
+            huge = (size_t)kilobytes * 1024;
+        }
+    }
+    fclose(smaps);
+#endif
+    return huge < sizeBytes() ? huge : sizeBytes();
+}
+
+void TranspositionTable::clear(int threads) {
+    if (!buckets) {
+        return;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    // Each thread touches its own slice first, which also spreads the pages
+    // over NUMA nodes the way the search threads will use them
+    size_t stride = (bucketCount + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        size_t first = i * stride;
+        if (first >= bucketCount) {
+            break;
+        }
+        size_t count = first + stride > bucketCount ? bucketCount - first : stride;
+        Bucket* start = buckets + first;
+        workers.push_back(std::thread([start, count] {
+            memset((void*)start, 0, count * sizeof(Bucket));
+        }));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void TranspositionTable::prefetch(uint64_t key) const {
+    if (!buckets) {
+        return;
+    }
+#if defined(__SSE__) || defined(_M_X64)
+    _mm_prefetch((const char*)&bucketFor(key), _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(&bucketFor(key));
+#endif
+}
+
+bool TranspositionTable::read(uint64_t key, uint64_t& data) const {
+    if (!buckets) {
+        return false;
+    }
+    const Bucket& bucket = bucketFor(key);
+    for (int i = 0; i < ENTRIES_PER_BUCKET; i++) {
+        const Entry& entry = bucket.entries[i];
+        uint64_t value = entry.data.load(std::memory_order_relaxed);
+        uint64_t check = entry.keyXorData.load(std::memory_order_relaxed);
+        // A write torn by another thread fails this check and reads as a miss
+        if (value != 0 && (check ^ value) == key) {
+            data = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::write(uint64_t key, uint64_t data, int depth, bool sameKeyOnlyIfDeeper) {
+    if (!buckets) {
+        return;
+    }
+    Bucket& bucket = bucketFor(key);
+    Entry* target = NULL;
+    int worstValue = 0;
+
+    for (int i = 0; i < ENTRIES_PER_BUCKET; i++) {
+        Entry& entry = bucket.entries[i];
+        uint64_t value = entry.data.load(std::memory_order_relaxed);
+        uint64_t check = entry.keyXorData.load(std::memory_order_relaxed);
+        if (value == 0 || (check ^ value) == key) {
+            // Keep a deeper result for the same position from this search
+            if (value != 0 && sameKeyOnlyIfDeeper && dataGeneration(value) == generation &&
+                depth + 2 < dataDepth(value) && dataBound(data) != BOUND_EXACT) {
+                return;
+            }
+            target = &entry;
+            break;
+        }
+
+        // Otherwise replace the shallowest entry, counting old searches as shallower
+        unsigned age = (generation - dataGeneration(value)) & GENERATION_MASK;
+        int replaceValue = dataDepth(value) - 8 * (int)age;
+        if (!target || replaceValue < worstValue) {
+            target = &entry;
+            worstValue = replaceValue;
+        }
+    }
+
+    target->keyXorData.store(key ^ data, std::memory_order_relaxed);
+    target->data.store(data, std::memory_order_relaxed);
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData& data) const {
+    uint64_t value;
+    if (!read(key, value)) {
+        return false;
+    }
+    data.move = (Move)(value & 0xFFFF);
+    data.score = (int16_t)(uint16_t)(value >> 16);
+    data.eval = (int16_t)(uint16_t)(value >> 32);
+    data.depth = dataDepth(value);
+    data.bound = dataBound(value);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, Move move, int score, int eval, int depth, int bound) {
+    if (depth < 0) {
+        depth = 0;
+    }
+    write(key, packData(move, score, eval, depth, bound, generation), depth, true);
+}
+
+bool TranspositionTable::probeCount(uint64_t key, int depth, uint64_t& count) const {
+    uint64_t value;
+    if (!read(key, value) || dataDepth(value) != depth) {
+        return false;
+    }
+    count = value & 0xFFFFFFFFFFFFull;
+    return true;
+}
+
+void TranspositionTable::storeCount(uint64_t key, int depth, uint64_t count) {
+    uint64_t data = (count & 0xFFFFFFFFFFFFull) | ((uint64_t)(depth & 0xFF) << 48) |
+                    ((uint64_t)BOUND_EXACT << 56) | ((uint64_t)generation << 58);
+    write(key, data, depth, false);
+}
+
+int TranspositionTable::hashfull() const {
+    if (!buckets) {
+        return 0;
+    }
+    size_t samples = bucketCount < 250 ? bucketCount : 250;
+    int used = 0;
+    for (size_t i = 0; i < samples; i++) {
+        for (int j = 0; j < ENTRIES_PER_BUCKET; j++) {
+            uint64_t value = buckets[i].entries[j].data.load(std::memory_order_relaxed);
+            if (value != 0 && dataGeneration(value) == generation) {
+                used++;
+            }
+        }
+    }
+    return (int)(used * 1000 / (samples * ENTRIES_PER_BUCKET));
+}
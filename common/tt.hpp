@@ -0,0 +1,144 @@
+/*
+Description:
+Shared transposition table. Entries are two 64-bit words, the key stored XORed
+with the data, so a reader can tell a torn write from another thread apart
+from a real hit without any locking. Four entries make a 64-byte bucket, one
+cache line per probe. On Linux the table can be backed by transparent huge
+pages to cut TLB misses on large tables.
+*/
+
+#ifndef TT_HPP
+#define TT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "position.hpp"
+
+/// Score bound stored with an entry
+enum Bound {
+    BOUND_NONE  = 0,
+    BOUND_UPPER = 1, ///< Score is at most the stored value (fail low)
+    BOUND_LOWER = 2, ///< Score is at least the stored value (fail high)
+    BOUND_EXACT = 3
+};
+
+/**
+ * @brief Decoded contents of a table entry
+ */
+struct TTData {
+    Move move;
+    int score;
+    int eval;
+    int depth;
+    int bound;
+};
+
+/**
+ * @brief Fixed-size hash table shared by all search threads
+ */
+class TranspositionTable {
+public:
+    TranspositionTable();
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    /**
+     * @brief Reallocates the table and clears it
+     * Must not be called while other threads use the table.
+     *
+     * @param megabytes Table size, rounded down to a power-of-two bucket count
+     * @param hugePages Ask the OS for huge page backing where supported
+     * @return true if the memory was allocated
+     */
+    bool resize(size_t megabytes, bool hugePages = true);
+
+    /**
+     * @brief Zeroes every entry, splitting the work over threads
+     * @param threads Number of threads to clear with
+     */
+    void clear(int threads = 1);
+
+    /**
+     * @brief Starts a new search; entries from older searches get replaced first
+     */
+    void newSearch() { generation = (generation + 1) & GENERATION_MASK; }
+
+    /**
+     * @brief Looks up a position
+     *
+     * @param key Zobrist key
+     * @param data Output, valid when the function returns true
+     * @return true on a verified hit
+     */
+    bool probe(uint64_t key, TTData& data) const;
+
+    /**
+     * @brief Stores a search result
+     * Scores must fit in 16 bits and depth in 0..255.
+     */
+    void store(uint64_t key, Move move, int score, int eval, int depth, int bound);
+
+    /**
+     * @brief Looks up a node count stored with storeCount()
+     */
+    bool probeCount(uint64_t key, int depth, uint64_t& count) const;
+
+    /**
+     * @brief Caches a perft node count below 2^48 for a key and depth
+     */
+    void storeCount(uint64_t key, int depth, uint64_t count);
+
+    /**
+     * @brief Hints the CPU to start loading the bucket for a key
+     */
+    void prefetch(uint64_t key) const;
+
+    /**
+     * @brief Samples how full the table is with entries of the current search
+     * @return Permille of used entries
+     */
+    int hashfull() const;
+
+    size_t sizeBytes() const { return bucketCount * sizeof(Bucket); }
+    /// Whether resize() advised the OS to use huge pages, which it may still decline
+    bool hugePagesRequested() const { return hugePagesAdvised; }
+
+    /**
+     * @brief Bytes of the table the OS actually backs with transparent huge pages
+     * Read from AnonHugePages in /proc/self/smaps; 0 off Linux or if it cannot be read.
+     */
+    size_t hugePageBytes() const;
+
+private:
+    static const int ENTRIES_PER_BUCKET = 4;
+    static const unsigned GENERATION_MASK = 0x3F;
+
+    /**
+     * Entry layout of the data word: move (bits 0-15), score (16-31),
+     * static eval (32-47), depth (48-55), bound (56-57), generation (58-63).
+     */
+    struct Entry {
+        std::atomic<uint64_t> keyXorData;
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Entry entries[ENTRIES_PER_BUCKET];
+    };
+
+    Bucket& bucketFor(uint64_t key) const { return buckets[key & (bucketCount - 1)]; }
+    bool read(uint64_t key, uint64_t& data) const;
+    void write(uint64_t key, uint64_t data, int depth, bool sameKeyOnlyIfDeeper);
+    void freeMemory();
+
+    Bucket* buckets;
+    size_t bucketCount;
+    bool hugePagesAdvised;
+    unsigned generation;
+};
+
+#endif
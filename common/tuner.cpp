@@ -0,0 +1,380 @@
+/*
+Description:
+Texel tuner: loading labelled quiet positions, the parallel loss and gradient
+kernels and the Adam update.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#include "tuner.hpp"
+#include "gamestore.hpp"
+#include "pgn.hpp"
+
+namespace {
+    /// Plies skipped at the start of every game, where positions come from opening theory
+    const int SKIPPED_PLIES = 8;
+
+    /// Positions evaluated together; their scratch arrays stay in L1
+    const size_t BLOCK = 256;
+
+    const int MATERIAL_OFFSET = 0;
+    const int PST_OFFSET = 12;
+    const int BISHOP_PAIR_OFFSET = PST_OFFSET + 2 * 6 * 64;
+    const int TEMPO_OFFSET = BISHOP_PAIR_OFFSET + 2;
+    const int PARAMETER_COUNT = TEMPO_OFFSET + 1;
+
+    /// Entries of a signed feature table: none, white features, black features
+    const int TABLE_SIZE = 1 + 2 * TUNING_FEATURES;
+
+    const double ADAM_BETA1 = 0.9;
+    const double ADAM_BETA2 = 0.999;
+    const double ADAM_EPSILON = 1e-8;
+
+    /**
+     * @brief Game result from white's point of view, negative if unknown
+     */
+    float parseResult(const TextSpan& result) {
+        if (result.equals("1-0")) return 1.0f;
+        if (result.equals("0-1")) return 0.0f;
+        if (result.equals("1/2-1/2")) return 0.5f;
+        return -1.0f;
+    }
+
+    /**
+     * @brief Adds the quiet positions of one game to a chunk
+     */
+    void addGame(TuningChunk& chunk, Position position, const std::vector<Move>& moves, float result,
+                 size_t maxPositions) {
+        for (size_t ply = 0; ply < moves.size() && chunk.size() < maxPositions; ply++) {
+            Move move = moves[ply];
+            if ((int)ply >= SKIPPED_PLIES && !position.inCheck() && !isCapture(move) && !isPromotion(move)) {
+                chunk.add(position, result);
+            }
+            position.makeMove(move);
+        }
+    }
+
+    void loadPgnPart(TextSpan part, size_t maxPositions, TuningChunk* chunk) {
+        PgnReader reader(part.begin, part.end);
+        PgnGame game;
+        while (chunk->size() < maxPositions && reader.next(game)) {
+            float result = parseResult(game.result);
+            if (result >= 0.0f) {
+                addGame(*chunk, game.start, game.moves, result, maxPositions);
+            }
+        }
+    }
+
+    void loadStoreRange(const GameStore* store, uint64_t first, uint64_t last, size_t maxPositions,
+                        TuningChunk* chunk) {
+        Position start;
+        std::vector<Move> moves;
+        for (uint64_t game = first; game < last && chunk->size() < maxPositions; game++) {
+            float result = parseResult(store->tag(game, "Result"));
+            if (result >= 0.0f && store->moves(game, start, moves)) {
+                addGame(*chunk, start, moves, result, maxPositions);
+            }
+        }
+    }
+
+    bool isStorePath(const char* path) {
+        size_t length = strlen(path);
+        return length > 4 && strcmp(path + length - 4, ".cgs") == 0;
+    }
+
+    struct ChunkResult {
+        double loss;
+        std::vector<double> midgame;    ///< Gradient per signed feature code
+        std::vector<double> endgame;
+        double tempo;
+    };
+
+    /**
+     * @brief Loss, and optionally the gradient, of one chunk
+     * The gather loops over a slot's codes and the sigmoid loop run over
+     * contiguous float arrays and are left to the compiler to vectorise.
+     */
+    void evaluateChunk(const TuningChunk* chunk, const float* midgameTable, const float* endgameTable, float tempo,
+                       float k, bool gradient, ChunkResult* out) {
+        out->loss = 0.0;
+        out->tempo = 0.0;
+        if (gradient) {
+            out->midgame.assign(TABLE_SIZE, 0.0);
+            out->endgame.assign(TABLE_SIZE, 0.0);
+        }
+        float midgame[BLOCK], endgame[BLOCK], delta[BLOCK];
+        size_t count = chunk->size();
+        for (size_t start = 0; start < count; start += BLOCK) {
+            size_t n = std::min(BLOCK, count - start);
+            const float* phase = &chunk->phase[start];
+            const float* result = &chunk->result[start];
+            const float* side = &chunk->side[start];
+            for (size_t i = 0; i < n; i++) {
+                midgame[i] = 0.0f;
+                endgame[i] = 0.0f;
+            }
+            for (int slot = 0; slot < chunk->usedSlots; slot++) {
+                const uint16_t* codes = &chunk->features[slot][start];
+                for (size_t i = 0; i < n; i++) {
+                    midgame[i] += midgameTable[codes[i]];
+                    endgame[i] += endgameTable[codes[i]];
+                }
+            }
+            double blockLoss = 0.0;
+            for (size_t i = 0; i < n; i++) {
+                float eval = midgame[i] * phase[i] + endgame[i] * (1.0f - phase[i]) + tempo * side[i];
+                float sigmoid = 1.0f / (1.0f + expf(-k * eval));
+                float error = result[i] - sigmoid;
+                blockLoss += error * error;
+                delta[i] = -2.0f * error * sigmoid * (1.0f - sigmoid) * k;
+            }
+            out->loss += blockLoss;
+            if (!gradient) {
+                continue;
+            }
+            // Scattering into the tables does not vectorise; it runs once per slot
+            for (int slot = 0; slot < chunk->usedSlots; slot++) {
+                const uint16_t* codes = &chunk->features[slot][start];
+                for (size_t i = 0; i < n; i++) {
+                    out->midgame[codes[i]] += delta[i] * phase[i];
+                    out->endgame[codes[i]] += delta[i] * (1.0f - phase[i]);
+                }
+            }
+            for (size_t i = 0; i < n; i++) {
+                out->tempo += delta[i] * side[i];
+            }
+        }
+    }
+}
+
+void TuningChunk::add(const Position& position, float whiteResult) {
+    int slot = 0;
+    for (int color = WHITE; color <= BLACK; color++) {
+        int mirror = color == WHITE ? 0 : 56;
+        int base = 1 + (color == WHITE ? 0 : TUNING_FEATURES);
+        for (int type = PAWN; type <= KING; type++) {
+            for (Bitboard b = position.pieces(color, type); b && slot < TUNING_SLOTS; ) {
+                int square = popLsb(b) ^ mirror;
+                features[slot++].push_back((uint16_t)(base + type * 64 + square));
+            }
+        }
+        if (popCount(position.pieces(color, BISHOP)) >= 2 && slot < TUNING_SLOTS) {
+            features[slot++].push_back((uint16_t)(base + 6 * 64));
+        }
+    }
+    usedSlots = std::max(usedSlots, slot);
+    for (; slot < TUNING_SLOTS; slot++) {
+        features[slot].push_back(0);
+    }
+    phase.push_back((float)gamePhase(position) / PHASE_TOTAL);
+    result.push_back(whiteResult);
+    side.push_back(position.sideToMove() == WHITE ? 1.0f : -1.0f);
+}
+
+size_t TuningData::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        total += chunks[i].size();
+    }
+    return total;
+}
+
+size_t TuningData::memoryBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        bytes += chunks[i].size() * (TUNING_SLOTS * sizeof(uint16_t) + 3 * sizeof(float));
+    }
+    return bytes;
+}
+
+bool loadTuningData(const char* path, int threads, size_t maxPositions, TuningData& data) {
+    threads = std::max(1, threads);
+    size_t perThread = maxPositions > 0 ? (maxPositions + threads - 1) / threads : (size_t)-1;
+    std::vector<std::thread> workers;
+    PgnFile pgn;
+    GameStore store;
+    if (isStorePath(path)) {
+        if (!store.open(path)) {
+            return false;
+        }
+        uint64_t games = store.gameCount();
+        data.chunks.assign(threads, TuningChunk());
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(loadStoreRange, &store, games * i / threads, games * (i + 1) / threads,
+                                          perThread, &data.chunks[i]));
+        }
+    } else {
+        if (!pgn.open(path)) {
+            return false;
+        }
+        std::vector<TextSpan> parts = pgn.split(threads);
+        data.chunks.assign(parts.size(), TuningChunk());
+        for (size_t i = 0; i < parts.size(); i++) {
+            workers.push_back(std::thread(loadPgnPart, parts[i], perThread, &data.chunks[i]));
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return true;
+}
+
+EvalTuner::EvalTuner(const TuningData& data)
+    : data(data), parameters(PARAMETER_COUNT, 0.0), gradient(PARAMETER_COUNT, 0.0),
+      firstMoment(PARAMETER_COUNT, 0.0), secondMoment(PARAMETER_COUNT, 0.0), steps(0), sigmoidScale(1.0) {
+    setWeights(evalWeights());
+}
+
+void EvalTuner::setWeights(const EvalWeights& weights) {
+    for (int phase = 0; phase < 2; phase++) {
+        for (int type = 0; type < 6; type++) {
+            parameters[MATERIAL_OFFSET + phase * 6 + type] = weights.material[phase][type];
+            for (int square = 0; square < 64; square++) {
+                parameters[PST_OFFSET + (phase * 6 + type) * 64 + square] = weights.pst[phase][type][square];
+            }
+        }
+        parameters[BISHOP_PAIR_OFFSET + phase] = weights.bishopPair[phase];
+    }
+    parameters[TEMPO_OFFSET] = weights.tempo;
+    std::fill(firstMoment.begin(), firstMoment.end(), 0.0);
+    std::fill(secondMoment.begin(), secondMoment.end(), 0.0);
+    steps = 0;
+}
+
+EvalWeights EvalTuner::weights() const {
+    EvalWeights weights;
+    for (int phase = 0; phase < 2; phase++) {
+        for (int type = 0; type < 6; type++) {
+            weights.material[phase][type] = (int)lround(parameters[MATERIAL_OFFSET + phase * 6 + type]);
+            for (int square = 0; square < 64; square++) {
+                weights.pst[phase][type][square] = (int)lround(parameters[PST_OFFSET + (phase * 6 + type) * 64 + square]);
+            }
+        }
+        weights.bishopPair[phase] = (int)lround(parameters[BISHOP_PAIR_OFFSET + phase]);
+    }
+    weights.tempo = (int)lround(parameters[TEMPO_OFFSET]);
+    return weights;
+}
+
+void EvalTuner::buildTables(std::vector<float>& midgame, std::vector<float>& endgame) const {
+    std::vector<float>* tables[2] = { &midgame, &endgame };
+    for (int phase = 0; phase < 2; phase++) {
+        std::vector<float>& table = *tables[phase];
+        table.assign(TABLE_SIZE, 0.0f);
+        for (int feature = 0; feature < TUNING_FEATURES; feature++) {
+            double value = feature < 6 * 64
+                ? parameters[MATERIAL_OFFSET + phase * 6 + feature / 64] + parameters[PST_OFFSET + phase * 6 * 64 + feature]
+                : parameters[BISHOP_PAIR_OFFSET + phase];
+            table[1 + feature] = (float)value;
+            table[1 + TUNING_FEATURES + feature] = (float)-value;
+        }
+    }
+}
+
+double EvalTuner::evaluateAll(bool withGradient) {
+    std::vector<float> midgame, endgame;
+    buildTables(midgame, endgame);
+    float k = (float)(sigmoidScale * log(10.0) / 400.0);
+    float tempo = (float)parameters[TEMPO_OFFSET];
+
+    std::vector<ChunkResult> results(data.chunks.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < data.chunks.size(); i++) {
+        workers.push_back(std::thread(evaluateChunk, &data.chunks[i], &midgame[0], &endgame[0], tempo, k,
+                                      withGradient, &results[i]));
+    }
+    if (!data.chunks.empty()) {
+        evaluateChunk(&data.chunks[0], &midgame[0], &endgame[0], tempo, k, withGradient, &results[0]);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double count = (double)std::max<size_t>(data.size(), 1);
+    double loss = 0.0;
+    for (size_t i = 0; i < results.size(); i++) {
+        loss += results[i].loss;
+    }
+    if (!withGradient) {
+        return loss / count;
+    }
+
+    // Back from signed feature codes to the weights they were built from
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    for (size_t i = 0; i < results.size(); i++) {
+        const std::vector<double>* tables[2] = { &results[i].midgame, &results[i].endgame };
+        for (int phase = 0; phase < 2; phase++) {
+            const std::vector<double>& table = *tables[phase];
+            for (int feature = 0; feature < TUNING_FEATURES; feature++) {
+                double g = table[1 + feature] - table[1 + TUNING_FEATURES + feature];
+                if (feature < 6 * 64) {
+                    gradient[MATERIAL_OFFSET + phase * 6 + feature / 64] += g;
+                    gradient[PST_OFFSET + phase * 6 * 64 + feature] += g;
+                } else {
+                    gradient[BISHOP_PAIR_OFFSET + phase] += g;
+                }
+            }
+        }
+        gradient[TEMPO_OFFSET] += results[i].tempo;
+    }
+    // Both sides always have a king, so its material cancels out
+    gradient[MATERIAL_OFFSET + KING] = 0.0;
+    gradient[MATERIAL_OFFSET + 6 + KING] = 0.0;
+    for (int i = 0; i < PARAMETER_COUNT; i++) {
+        gradient[i] /= count;
+    }
+    return loss / count;
+}
+
+double EvalTuner::loss() {
+    return evaluateAll(false);
+}
+
+double EvalTuner::fitScale() {
+    // Golden section search; the loss is unimodal in the scale
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double low = 0.1, high = 4.0;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    sigmoidScale = a;
+    double lossA = loss();
+    sigmoidScale = b;
+    double lossB = loss();
+    for (int i = 0; i < 30; i++) {
+        if (lossA < lossB) {
+            high = b;
+            b = a;
+            lossB = lossA;
+            a = high - ratio * (high - low);
+            sigmoidScale = a;
+            lossA = loss();
+        } else {
+            low = a;
+            a = b;
+            lossA = lossB;
+            b = low + ratio * (high - low);
+            sigmoidScale = b;
+            lossB = loss();
+        }
+    }
+    sigmoidScale = (low + high) / 2.0;
+    return sigmoidScale;
+}
+
+double EvalTuner::step(double learningRate) {
+    double before = evaluateAll(true);
+    steps++;
+    double correction1 = 1.0 - pow(ADAM_BETA1, steps);
+    double correction2 = 1.0 - pow(ADAM_BETA2, steps);
+    for (int i = 0; i < PARAMETER_COUNT; i++) {
+        firstMoment[i] = ADAM_BETA1 * firstMoment[i] + (1.0 - ADAM_BETA1) * gradient[i];
+        secondMoment[i] = ADAM_BETA2 * secondMoment[i] + (1.0 - ADAM_BETA2) * gradient[i] * gradient[i];
+        double moment = firstMoment[i] / correction1;
+        double variance = secondMoment[i] / correction2;
+        parameters[i] -= learningRate * moment / (sqrt(variance) + ADAM_EPSILON);
+    }
+    return before;
+}
@@ -0,0 +1,118 @@
+/*
+Description:
+Texel tuning of the hand-written evaluation. Quiet positions from finished
+games are labelled with the game result, and the weights are fitted so that
+sigmoid(eval) predicts the result, minimising the mean squared error with
+Adam over the whole set each epoch.
+
+The evaluation is linear in its weights per game phase: every piece adds its
+material plus piece-square value and a bishop pair adds its bonus. A position
+is therefore stored as a short list of signed feature codes, one per piece or
+bonus, laid out slot by slot (structure of arrays) so that the loss loops
+walk contiguous arrays of codes, phases and results. Each thread owns the
+positions it loaded and computes their loss and gradient on its own.
+*/
+
+#ifndef TUNER_HPP
+#define TUNER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "evaluate.hpp"
+#include "position.hpp"
+
+/// Feature slots per position: up to 32 pieces and two bishop pairs
+const int TUNING_SLOTS = 34;
+
+/// Feature codes: a piece type and square as seen from its own side, then the bishop pair
+const int TUNING_FEATURES = 6 * 64 + 1;
+
+/**
+ * @brief Positions owned by one tuning thread, stored as structure of arrays
+ */
+struct TuningChunk {
+    /// Per slot: 0 for none, 1 + feature for white, 1 + TUNING_FEATURES + feature for black
+    std::vector<uint16_t> features[TUNING_SLOTS];
+    std::vector<float> phase;   ///< Middlegame share, gamePhase() / PHASE_TOTAL
+    std::vector<float> result;  ///< 1, 0.5 or 0 from white's point of view
+    std::vector<float> side;    ///< 1 with white to move, -1 with black
+    int usedSlots;              ///< Slots that are not 0 for every position
+
+    TuningChunk() : usedSlots(0) {}
+    size_t size() const { return result.size(); }
+    void add(const Position& position, float whiteResult);
+};
+
+/**
+ * @brief Labelled positions, one chunk per thread
+ */
+struct TuningData {
+    std::vector<TuningChunk> chunks;
+
+    size_t size() const;
+    size_t memoryBytes() const;
+};
+
+/**
+ * @brief Collects quiet positions from a PGN file or a game store (.cgs)
+ * Games without a result are skipped, and so are the first plies of every
+ * game, positions in check and positions where the game continued with a
+ * capture or a promotion.
+ *
+ * @param threads Loading threads, and the number of chunks produced
+ * @param maxPositions Positions kept at most, 0 for all
+ * @return true if the file could be read
+ */
+bool loadTuningData(const char* path, int threads, size_t maxPositions, TuningData& data);
+
+/**
+ * @brief Adam optimiser over the evaluation weights
+ */
+class EvalTuner {
+public:
+    explicit EvalTuner(const TuningData& data);
+
+    void setWeights(const EvalWeights& weights);
+
+    /**
+     * @brief Current weights rounded to centipawns
+     */
+    EvalWeights weights() const;
+
+    /**
+     * @brief Fits the sigmoid scale to the current weights by a line search
+     * @return The scale, in the units of sigmoid(scale * eval / 400) with base 10
+     */
+    double fitScale();
+    double scale() const { return sigmoidScale; }
+
+    /**
+     * @brief Mean squared error of the current weights
+     */
+    double loss();
+
+    /**
+     * @brief One Adam step over every position
+     * @param learningRate Step size in centipawns
+     * @return Loss before the step
+     */
+    double step(double learningRate);
+
+private:
+    /// Per phase signed tables indexed by feature code, built from the weights
+    void buildTables(std::vector<float>& midgame, std::vector<float>& endgame) const;
+    double evaluateAll(bool gradient);
+
+    const TuningData& data;
+    // Tunable weights in EvalWeights order: material, pst, bishop pair, tempo
+    std::vector<double> parameters;
+    std::vector<double> gradient;
+    std::vector<double> firstMoment;
+    std::vector<double> secondMoment;
+    int steps;
+    double sigmoidScale;
+};
+
+#endif
@@ -0,0 +1,481 @@
+/*
+Description:
+UCI engine process on POSIX (fork, pipes, poll) and Windows (CreateProcess,
+anonymous pipes), and the parsing of its output.
+*/
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "uciengine.hpp"
+#include "movegen.hpp"
+
+namespace {
+    const size_t READ_BUFFER_SIZE = 64 * 1024;
+    /// How often a pending info is retried while the engine prints nothing
+    const int PENDING_RETRY_MS = 5;
+
+    /// How long quit() gives the engine to exit before killing it
+    const int QUIT_TIMEOUT_MS = 1000;
+
+    /**
+     * @brief Next space separated word of a line
+     * @return Pointer past the word; word is empty at the end of the line
+     */
+    const char* nextWord(const char* c, std::string& word) {
+        while (*c == ' ' || *c == '\t') c++;
+        const char* begin = c;
+        while (*c && *c != ' ' && *c != '\t') c++;
+        word.assign(begin, c);
+        return c;
+    }
+
+    bool startsWith(const char* line, const char* prefix) {
+        return strncmp(line, prefix, strlen(prefix)) == 0;
+    }
+}
+
+UciEngine::UciEngine()
+#if defined(_WIN32)
+    : process(NULL), input(NULL), output(NULL),
+#else
+    : pid(-1), input(-1), output(-1), wakeRead(-1), wakeWrite(-1),
+#endif
+      running(false), stopping(false), lines(0), dropped(0), searchesStarted(0), searchesFinished(0),
+      infoPending(false) {}
+
+UciEngine::~UciEngine() {
+    quit();
+}
+
+#if defined(_WIN32)
+
+bool UciEngine::start(const char* command) {
+    quit();
+    SECURITY_ATTRIBUTES attributes = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE childInput = NULL, parentInput = NULL, parentOutput = NULL, childOutput = NULL;
+    if (!CreatePipe(&childInput, &parentInput, &attributes, 0) ||
+        !CreatePipe(&parentOutput, &childOutput, &attributes, 0)) {
+        fprintf(stderr, "Error: Could not create pipes for %s\n", command);
+        return false;
+    }
+    SetHandleInformation(parentInput, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(parentOutput, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFOA startup;
+    ZeroMemory(&startup, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = childInput;
+    startup.hStdOutput = childOutput;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION info;
+    std::string commandLine = command;
+    BOOL created = CreateProcessA(NULL, &commandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL,
+                                  &startup, &info);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+    if (!created) {
+        fprintf(stderr, "Error: Could not start engine %s\n", command);
+        CloseHandle(parentInput);
+        CloseHandle(parentOutput);
+        return false;
+    }
+    CloseHandle(info.hThread);
+    process = info.hProcess;
+    input = parentInput;
+    output = parentOutput;
+
+    stopping.store(false);
+    running.store(true);
+    reader = std::thread(&UciEngine::readLoop, this);
+    return send("uci");
+}
+
+bool UciEngine::send(const std::string& line) {
+    if (!input) {
+        return false;
+    }
+    std::string text = line + "\n";
+    DWORD written = 0;
+    return WriteFile((HANDLE)input, text.data(), (DWORD)text.size(), &written, NULL) && written == text.size();
+}
+
+void UciEngine::quit() {
+    if (!process) {
+        return;
+    }
+    send("quit");
+    if (WaitForSingleObject((HANDLE)process, QUIT_TIMEOUT_MS) != WAIT_OBJECT_0) {
+        TerminateProcess((HANDLE)process, 1);
+    }
+    // The engine is gone, so the reader's ReadFile fails and the thread ends
+    stopping.store(true);
+    if (reader.joinable()) {
+        reader.join();
+    }
+    closeHandles();
+}
+
+void UciEngine::closeHandles() {
+    HANDLE handles[3] = { (HANDLE)process, (HANDLE)input, (HANDLE)output };
+    for (int i = 0; i < 3; i++) {
+        if (handles[i]) {
+            CloseHandle(handles[i]);
+        }
+    }
+    process = input = output = NULL;
+}
+
+#else
+
+bool UciEngine::start(const char* command) {
+    quit();
+    int toChild[2], fromChild[2], wake[2];
+    if (pipe(toChild) != 0) {
+        fprintf(stderr, "Error: Could not create pipes for %s\n", command);
+        return false;
+    }
+    if (pipe(fromChild) != 0) {
+        ::close(toChild[0]);
+        ::close(toChild[1]);
+        fprintf(stderr, "Error: Could not create pipes for %s\n", command);
+        return false;
+    }
+    if (pipe(wake) != 0) {
+        int ends[4] = { toChild[0], toChild[1], fromChild[0], fromChild[1] };
+        for (int i = 0; i < 4; i++) ::close(ends[i]);
+        fprintf(stderr, "Error: Could not create pipes for %s\n", command);
+        return false;
+    }
+    // An engine that dies must not take the viewer down with SIGPIPE on the next command
+    signal(SIGPIPE, SIG_IGN);
+
+    pid = fork();
+    if (pid == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        int ends[6] = { toChild[0], toChild[1], fromChild[0], fromChild[1], wake[0], wake[1] };
+        for (int i = 0; i < 6; i++) ::close(ends[i]);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+    ::close(toChild[0]);
+    ::close(fromChild[1]);
+    input = toChild[1];
+    output = fromChild[0];
+    wakeRead = wake[0];
+    wakeWrite = wake[1];
+    if (pid < 0) {
+        fprintf(stderr, "Error: Could not start engine %s\n", command);
+        closeHandles();
+        return false;
+    }
+    int handles[4] = { input, output, wakeRead, wakeWrite };
+    for (int i = 0; i < 4; i++) {
+        fcntl(handles[i], F_SETFD, FD_CLOEXEC);
+    }
+    fcntl(output, F_SETFL, fcntl(output, F_GETFL) | O_NONBLOCK);
+
+    stopping.store(false);
+    running.store(true);
+    reader = std::thread(&UciEngine::readLoop, this);
+    return send("uci");
+}
+
+bool UciEngine::send(const std::string& line) {
+    if (input < 0) {
+        return false;
+    }
+    std::string text = line + "\n";
+    const char* data = text.data();
+    size_t left = text.size();
+    while (left > 0) {
+        ssize_t written = write(input, data, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        left -= (size_t)written;
+    }
+    return true;
+}
+
+void UciEngine::quit() {
+    if (pid < 0) {
+        return;
+    }
+    send("quit");
+    int status = 0;
+    bool exited = false;
+    for (int waited = 0; waited < QUIT_TIMEOUT_MS && !exited; waited += 10) {
+        exited = waitpid(pid, &status, WNOHANG) == pid;
+        if (!exited) {
+            usleep(10 * 1000);
+        }
+    }
+    if (!exited) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    stopping.store(true);
+    char byte = 0;
+    if (write(wakeWrite, &byte, 1) < 0) {
+        // The reader also ends on end of file, which the exit has caused
+    }
+    if (reader.joinable()) {
+        reader.join();
+    }
+    closeHandles();
+}
+
+void UciEngine::closeHandles() {
+    int* handles[4] = { &input, &output, &wakeRead, &wakeWrite };
+    for (int i = 0; i < 4; i++) {
+        if (*handles[i] >= 0) {
+            ::close(*handles[i]);
+            *handles[i] = -1;
+        }
+    }
+    pid = -1;
+}
+
+#endif
+
+void UciEngine::setOption(const char* name, const char* value) {
+    send(std::string("setoption name ") + name + " value " + value);
+}
+
+unsigned UciEngine::go(const Position& root, const char* limits) {
+    unsigned search;
+    {
+        std::lock_guard<std::mutex> lock(rootMutex);
+        search = ++searchesStarted;
+        roots[search % ROOT_HISTORY] = root;
+    }
+    send("position fen " + root.fen());
+    send(std::string("go ") + limits);
+    return search;
+}
+
+void UciEngine::stop() {
+    send("stop");
+}
+
+bool UciEngine::rootOf(unsigned search, Position& root) {
+    std::lock_guard<std::mutex> lock(rootMutex);
+    if (search == 0 || search > searchesStarted || searchesStarted - search >= ROOT_HISTORY) {
+        return false;
+    }
+    root = roots[search % ROOT_HISTORY];
+    return true;
+}
+
+bool UciEngine::flushInfo(bool wait) {
+    while (infoPending) {
+        if (updates.push(latestInfo)) {
+            infoPending = false;
+        } else if (!wait || stopping.load(std::memory_order_relaxed)) {
+            return false;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return true;
+}
+
+void UciEngine::queue(const UciUpdate& update) {
+    if (update.type == UCI_INFO) {
+        // Infos go out in order; when the queue is full the newest one waits and replaces older ones
+        if (flushInfo(false) && updates.push(update)) {
+            return;
+        }
+        if (infoPending) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        latestInfo = update;
+        infoPending = true;
+        return;
+    }
+    // Search results and state changes must arrive, after the last info before them;
+    // wait for the render loop to make room
+    flushInfo(true);
+    while (!updates.push(update) && !stopping.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void UciEngine::readLoop() {
+    std::vector<char> buffer(READ_BUFFER_SIZE + 1);
+    std::string partial;
+    bool open = true;
+    while (open && !stopping.load(std::memory_order_relaxed)) {
+#if defined(_WIN32)
+        DWORD count = 0;
+        if (!ReadFile((HANDLE)output, &buffer[0], (DWORD)READ_BUFFER_SIZE, &count, NULL) || count == 0) {
+            break;
+        }
+#else
+        // A pending info is retried every few milliseconds while the engine is quiet
+        pollfd descriptors[2] = { { output, POLLIN, 0 }, { wakeRead, POLLIN, 0 } };
+        int ready = ::poll(descriptors, 2, infoPending ? PENDING_RETRY_MS : -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (descriptors[1].revents != 0) {
+            break;
+        }
+        if (ready == 0) {
+            flushInfo(false);
+            continue;
+        }
+        ssize_t count = read(output, &buffer[0], READ_BUFFER_SIZE);
+        if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR)) {
+            open = false;
+        }
+        if (count <= 0) {
+            continue;
+        }
+#endif
+        // Complete lines are parsed in place; a line cut by the read waits in partial
+        char* line = &buffer[0];
+        char* end = line + count;
+        for (char* c = line; c < end; c++) {
+            if (*c != '\n') {
+                continue;
+            }
+            *c = '\0';
+            if (c > line && c[-1] == '\r') {
+                c[-1] = '\0';
+            }
+            if (!partial.empty()) {
+                partial += line;
+                handleLine(partial.c_str());
+                partial.clear();
+            } else {
+                handleLine(line);
+            }
+            line = c + 1;
+        }
+        partial.append(line, end);
+        flushInfo(false);
+    }
+    running.store(false);
+    if (!stopping.load(std::memory_order_relaxed)) {
+        UciUpdate update;
+        update.type = UCI_EXITED;
+        queue(update);
+    }
+}
+
+void UciEngine::handleLine(const char* line) {
+    lines.fetch_add(1, std::memory_order_relaxed);
+    UciUpdate update;
+    if (startsWith(line, "info ")) {
+        update.type = UCI_INFO;
+        update.search = searchesFinished + 1;
+        parseInfo(line + 5, update);
+        if (update.pvLength > 0 || update.depth > 0) {
+            queue(update);
+        }
+    } else if (startsWith(line, "bestmove")) {
+        update.type = UCI_BESTMOVE;
+        update.search = ++searchesFinished;
+        Position position;
+        std::string word;
+        const char* c = nextWord(line + 8, word);
+        if (rootOf(update.search, position)) {
+            Move best = parseUciMove(position, word);
+            if (best != NO_MOVE) {
+                update.pv[update.pvLength++] = best;
+                position.makeMove(best);
+                c = nextWord(c, word);
+                if (word == "ponder") {
+                    nextWord(c, word);
+                    Move ponder = parseUciMove(position, word);
+                    if (ponder != NO_MOVE) {
+                        update.pv[update.pvLength++] = ponder;
+                    }
+                }
+            }
+        }
+        queue(update);
+    } else if (startsWith(line, "id name ")) {
+        engineName = line + 8;
+    } else if (strcmp(line, "uciok") == 0) {
+        update.type = UCI_READY;
+        snprintf(update.name, sizeof(update.name), "%s", engineName.c_str());
+        queue(update);
+    }
+}
+
+void UciEngine::parseInfo(const char* line, UciUpdate& update) {
+    std::string word;
+    bool hasScore = false;
+    for (const char* c = nextWord(line, word); !word.empty(); c = nextWord(c, word)) {
+        if (word == "depth") {
+            c = nextWord(c, word);
+            update.depth = atoi(word.c_str());
+        } else if (word == "seldepth") {
+            c = nextWord(c, word);
+            update.seldepth = atoi(word.c_str());
+        } else if (word == "nodes") {
+            c = nextWord(c, word);
+            update.nodes = strtoull(word.c_str(), NULL, 10);
+        } else if (word == "nps") {
+            c = nextWord(c, word);
+            update.nps = strtoull(word.c_str(), NULL, 10);
+        } else if (word == "time") {
+            c = nextWord(c, word);
+            update.timeMs = strtoll(word.c_str(), NULL, 10);
+        } else if (word == "score") {
+            c = nextWord(c, word);
+            update.mate = word == "mate";
+            c = nextWord(c, word);
+            update.score = atoi(word.c_str());
+            hasScore = true;
+        } else if (word == "string") {
+            break;
+        } else if (word == "pv") {
+            // The rest of the line; moves are checked against the searched position
+            Position position;
+            if (!rootOf(update.search, position)) {
+                break;
+            }
+            for (c = nextWord(c, word); !word.empty() && update.pvLength < UCI_MAX_PV; c = nextWord(c, word)) {
+                Move move = parseUciMove(position, word);
+                if (move == NO_MOVE) {
+                    break;
+                }
+                update.pv[update.pvLength++] = move;
+                position.makeMove(move);
+            }
+            break;
+        }
+    }
+    // Lines without a score (currmove, hashfull, ...) carry nothing to show
+    if (!hasScore) {
+        update.depth = 0;
+        update.pvLength = 0;
+    }
+}
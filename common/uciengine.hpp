@@ -0,0 +1,158 @@
+/*
+Description:
+Client for an external UCI engine running as a child process. Commands are
+written to the engine's stdin from the calling thread; its stdout is read by
+a dedicated thread from a non-blocking pipe, which splits and parses the
+lines and hands the results to the render loop through a lock-free queue.
+
+Lines that carry neither a score nor a principal variation (currmove,
+hashfull, strings) are counted and dropped on the reader thread. When the
+render loop falls behind, the newest info update waits in a single slot on
+the reader thread and replaces older ones instead of queueing, so however
+chatty the engine is, the render loop only ever pops a bounded number of
+small fixed-size updates per frame, and the last info before a bestmove is
+never lost.
+*/
+
+#ifndef UCIENGINE_HPP
+#define UCIENGINE_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "position.hpp"
+#include "spscqueue.hpp"
+
+/// Longest principal variation carried by an update
+const int UCI_MAX_PV = 16;
+
+enum UciUpdateType {
+    UCI_INFO,       ///< Search progress with a score and/or principal variation
+    UCI_BESTMOVE,   ///< The search finished
+    UCI_READY,      ///< The engine answered uciok; name holds its id name
+    UCI_EXITED      ///< The engine closed its output
+};
+
+/**
+ * @brief One parsed engine line, fixed size so queueing never allocates
+ */
+struct UciUpdate {
+    UciUpdateType type;
+    unsigned search;        ///< Search the line belongs to, as returned by go()
+    int depth;
+    int seldepth;
+    int score;              ///< Centipawns, or moves to mate if mate is set, side to move's view
+    bool mate;
+    uint64_t nodes;
+    uint64_t nps;
+    int64_t timeMs;
+    Move pv[UCI_MAX_PV];    ///< For UCI_BESTMOVE, pv[0] is the best move and pv[1] the ponder move
+    int pvLength;
+    char name[64];
+
+    UciUpdate()
+        : type(UCI_INFO), search(0), depth(0), seldepth(0), score(0), mate(false), nodes(0), nps(0), timeMs(0),
+          pvLength(0) {
+        name[0] = '\0';
+    }
+    Move bestMove() const { return pvLength > 0 ? pv[0] : NO_MOVE; }
+};
+
+/**
+ * @brief Runs one engine process; commands from one thread, updates to one thread
+ */
+class UciEngine {
+public:
+    UciEngine();
+    ~UciEngine();
+
+    UciEngine(const UciEngine&) = delete;
+    UciEngine& operator=(const UciEngine&) = delete;
+
+    /**
+     * @brief Starts the engine through the shell and sends "uci"
+     * UCI_READY is queued once it answers.
+     *
+     * @param command Command line, e.g. "stockfish" or "/opt/engines/lc0 --threads=2"
+     * @return false if the process could not be started
+     */
+    bool start(const char* command);
+
+    /**
+     * @brief Sends "quit", waits briefly for the process and stops the reader thread
+     */
+    void quit();
+
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+    void setOption(const char* name, const char* value);
+
+    /**
+     * @brief Starts a search of a position
+     * @param limits Arguments of the go command, e.g. "infinite" or "movetime 1000"
+     * @return Search number carried by the updates of this search
+     */
+    unsigned go(const Position& root, const char* limits);
+
+    /**
+     * @brief Asks the running search to finish; its bestmove still arrives
+     */
+    void stop();
+
+    /**
+     * @brief Takes the next update; render thread only, never blocks
+     */
+    bool poll(UciUpdate& update) { return updates.pop(update); }
+
+    /// Lines read from the engine
+    uint64_t lineCount() const { return lines.load(std::memory_order_relaxed); }
+    /// Info updates dropped because a newer one replaced them while the queue was full
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    /// Roots of recent searches, to resolve the moves of lines that arrive late
+    static const unsigned ROOT_HISTORY = 4;
+
+    bool send(const std::string& line);
+    void readLoop();
+    void handleLine(const char* line);
+    void parseInfo(const char* line, UciUpdate& update);
+    bool rootOf(unsigned search, Position& root);
+    void queue(const UciUpdate& update);
+    /// Pushes the pending info, with wait until the render loop makes room; true if none is left
+    bool flushInfo(bool wait);
+    void closeHandles();
+
+#if defined(_WIN32)
+    void* process;
+    void* input;
+    void* output;
+#else
+    int pid;
+    int input;
+    int output;
+    int wakeRead;    ///< Self-pipe that wakes the reader thread for shutdown
+    int wakeWrite;
+#endif
+
+    std::thread reader;
+    std::atomic<bool> running;
+    std::atomic<bool> stopping;
+    SpscQueue<UciUpdate, 256> updates;
+    std::atomic<uint64_t> lines;
+    std::atomic<uint64_t> dropped;
+
+    // Written by go() on the command thread, read by the reader thread
+    std::mutex rootMutex;
+    Position roots[ROOT_HISTORY];
+    unsigned searchesStarted;
+    unsigned searchesFinished;   ///< Reader thread only: bestmove lines seen
+    std::string engineName;      ///< Reader thread only: from "id name"
+    UciUpdate latestInfo;        ///< Reader thread only: newest info the full queue did not take
+    bool infoPending;
+};
+
+#endif
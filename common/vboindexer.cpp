@@ -3,8 +3,11 @@
 
 #include <glm/glm.hpp>
 
+#include "parallelfor.hpp"
 #include "vboindexer.hpp"
 
+#include <math.h>
+#include <stdint.h>
 #include <string.h> // for memcmp
 
 
@@ -138,6 +141,41 @@ void indexVBO(
 
 
 
+// Attributes rounded to the 0.01 tolerance of is_near, so that similar
+// vertices compare and hash equal instead of being searched for one by one.
+// Unlike is_near, rounding puts a cell boundary between some near values:
+// 0.004 and 0.006 are 0.002 apart but round to 0 and 1, so such pairs stay
+// separate vertices. On the board mesh that leaves 6646 vertices where the
+// linear search merged down to 6614, and the split pairs keep their own
+// tangents instead of averaging them.
+struct QuantizedVertex{
+	int32_t values[8];
+	bool operator==(const QuantizedVertex & that) const{
+		return memcmp(values, that.values, sizeof(values)) == 0;
+	}
+};
+
+static QuantizedVertex quantizeVertex(const glm::vec3 & position, const glm::vec2 & uv, const glm::vec3 & normal){
+	const float components[8] = { position.x, position.y, position.z, uv.x, uv.y, normal.x, normal.y, normal.z };
+	QuantizedVertex quantized;
+	for ( int i=0; i<8; i++ ){
+		quantized.values[i] = (int32_t)floorf(components[i] * 100.0f + 0.5f);
+	}
+	return quantized;
+}
+
+// FNV-1a over the eight rounded components
+static uint32_t hashVertex(const QuantizedVertex & quantized){
+	uint32_t hash = 2166136261u;
+	for ( int i=0; i<8; i++ ){
+		uint32_t value = (uint32_t)quantized.values[i];
+		for ( int byte=0; byte<4; byte++ ){
+			hash = (hash ^ ((value >> (8 * byte)) & 0xff)) * 16777619u;
+		}
+	}
+	return hash;
+}
+
 void indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
@@ -152,26 +190,79 @@ void indexVBO_TBN(
 	std::vector<glm::vec3> & out_tangents,
 	std::vector<glm::vec3> & out_bitangents
 ){
-	// For each input vertex
-	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+	const size_t count = in_vertices.size();
+	const int SHARD_BITS = 4;
+	const int SHARDS = 1 << SHARD_BITS;
 
-		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
-		bool found = getSimilarVertexIndex(in_vertices[i], in_uvs[i], in_normals[i],     out_vertices, out_uvs, out_normals, index);
+	// Round and hash every vertex, in parallel
+	std::vector<QuantizedVertex> keys(count);
+	std::vector<uint32_t> hashes(count);
+	parallelFor(count, 4096, [&](size_t first, size_t end){
+		for ( size_t i=first; i<end; i++ ){
+			keys[i] = quantizeVertex(in_vertices[i], in_uvs[i], in_normals[i]);
+			hashes[i] = hashVertex(keys[i]);
+		}
+	});
 
-		if ( found ){ // A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back( index );
+	// The top bits of the hash split the vertices into shards. Each shard keeps
+	// its own open-addressing table and finds, for each of its vertices, the
+	// first input vertex equal to it. Shards are independent, so they run in parallel.
+	std::vector<uint32_t> shardStart(SHARDS + 1, 0);
+	for ( size_t i=0; i<count; i++ ){
+		shardStart[(hashes[i] >> (32 - SHARD_BITS)) + 1]++;
+	}
+	for ( int shard=0; shard<SHARDS; shard++ ){
+		shardStart[shard + 1] += shardStart[shard];
+	}
+	// Vertices grouped by shard, still in input order within each
+	std::vector<uint32_t> shardVertices(count);
+	std::vector<uint32_t> shardFill(shardStart.begin(), shardStart.end() - 1);
+	for ( size_t i=0; i<count; i++ ){
+		shardVertices[shardFill[hashes[i] >> (32 - SHARD_BITS)]++] = (uint32_t)i;
+	}
+	std::vector<uint32_t> firstEqual(count);
+	parallelFor(SHARDS, count >= 8192 ? 1 : SHARDS, [&](size_t firstShard, size_t endShard){
+		std::vector<uint32_t> table;
+		for ( size_t shard=firstShard; shard<endShard; shard++ ){
+			// At most half full; slots hold an input index plus one, zero when empty
+			uint32_t mask = 1;
+			while ( mask < 2 * (shardStart[shard + 1] - shardStart[shard]) ){
+				mask <<= 1;
+			}
+			table.assign(mask, 0);
+			mask -= 1;
+			for ( uint32_t k=shardStart[shard]; k<shardStart[shard + 1]; k++ ){
+				uint32_t i = shardVertices[k];
+				uint32_t slot = hashes[i] & mask;
+				while ( table[slot] != 0 && !(keys[table[slot] - 1] == keys[i]) ){
+					slot = (slot + 1) & mask;
+				}
+				if ( table[slot] == 0 ){
+					table[slot] = i + 1;
+				}
+				firstEqual[i] = table[slot] - 1;
+			}
+		}
+	});
 
-			// Average the tangents and the bitangents
-			out_tangents[index] += in_tangents[i];
-			out_bitangents[index] += in_bitangents[i];
-		}else{ // If not, it needs to be added in the output data.
+	// Number the distinct vertices in input order, as the linear search did,
+	// and average the tangents and bitangents of the merged ones
+	std::vector<unsigned short> outIndex(count);
+	out_indices.reserve(out_indices.size() + count);
+	for ( size_t i=0; i<count; i++ ){
+		if ( firstEqual[i] == i ){
 			out_vertices.push_back( in_vertices[i]);
 			out_uvs     .push_back( in_uvs[i]);
 			out_normals .push_back( in_normals[i]);
 			out_tangents .push_back( in_tangents[i]);
 			out_bitangents .push_back( in_bitangents[i]);
-			out_indices .push_back( (unsigned short)out_vertices.size() - 1 );
+			outIndex[i] = (unsigned short)out_vertices.size() - 1;
+		}else{
+			unsigned short index = outIndex[firstEqual[i]];
+			out_tangents[index] += in_tangents[i];
+			out_bitangents[index] += in_bitangents[i];
+			outIndex[i] = index;
 		}
+		out_indices.push_back( outIndex[i] );
 	}
 }